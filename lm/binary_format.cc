@@ -6,6 +6,7 @@
 
 #include <cstddef>
 #include <cstring>
+#include <iostream>
 #include <limits>
 #include <string>
 #include <cstdlib>
@@ -137,6 +138,7 @@ const std::size_t kInvalidSize = static_cast<std::size_t>(-1);
 
 BinaryFormat::BinaryFormat(const Config &config)
   : write_method_(config.write_method), write_mmap_(config.write_mmap), load_method_(config.load_method),
+    numa_policy_(config.numa_policy), numa_node_(config.numa_node), huge_directory_(config.huge_directory), messages_(config.messages),
     header_size_(kInvalidSize), vocab_size_(kInvalidSize), vocab_string_offset_(kInvalidOffset) {}
 
 void BinaryFormat::InitializeBinary(int fd, ModelType model_type, unsigned int search_version, Parameters &params) {
@@ -159,7 +161,10 @@ void *BinaryFormat::LoadBinary(std::size_t size) {
   uint64_t total_map = static_cast<uint64_t>(header_size_) + static_cast<uint64_t>(size);
   UTIL_THROW_IF(file_size != util::kBadSize && file_size < total_map, FormatLoadException, "Binary file has size " << file_size << " but the headers say it should be at least " << total_map);
 
-  util::MapRead(load_method_, file_.get(), 0, util::CheckOverflow(total_map), mapping_);
+  util::MapRead(load_method_, file_.get(), 0, util::CheckOverflow(total_map), mapping_, numa_policy_, numa_node_, huge_directory_.empty() ? NULL : huge_directory_.c_str());
+  if (messages_ && (load_method_ == util::READ || load_method_ == util::PARALLEL_READ || load_method_ == util::HUGE_SHARED)) {
+    *messages_ << "Loaded " << total_map << " bytes backed by " << (util::MappedPageSize(mapping_.get()) >> 10) << " kB pages." << std::endl;
+  }
 
   vocab_string_offset_ = total_map;
   return reinterpret_cast<uint8_t*>(mapping_.get()) + header_size_;
@@ -10,6 +10,8 @@
 #include "util/scoped.hh"
 
 #include <cstddef>
+#include <iosfwd>
+#include <string>
 #include <vector>
 
 #include <stdint.h>
@@ -78,6 +80,10 @@ class BinaryFormat {
     const Config::WriteMethod write_method_;
     const char *write_mmap_;
     util::LoadMethod load_method_;
+    util::NumaPolicy numa_policy_;
+    int numa_node_;
+    std::string huge_directory_;
+    std::ostream *messages_;
 
     // File behind memory, if any.
     util::scoped_fd file_;
@@ -24,7 +24,10 @@ Config::Config() :
   prob_bits(8),
   backoff_bits(8),
   pointer_bhiksha_bits(22),
-  load_method(util::POPULATE_OR_READ) {}
+  load_method(util::POPULATE_OR_READ),
+  numa_policy(util::NUMA_DEFAULT),
+  numa_node(0),
+  huge_directory("") {}
 
 } // namespace ngram
 } // namespace lm
@@ -114,6 +114,16 @@ struct Config {
   // See util/mmap.hh for details of MapMethod.
   util::LoadMethod load_method;
 
+  // NUMA placement of the model for the READ, PARALLEL_READ, and HUGE_SHARED
+  // load methods.  numa_node is only used by util::NUMA_BIND.
+  util::NumaPolicy numa_policy;
+  int numa_node;
+
+  // Directory for util::HUGE_SHARED copies: a hugetlbfs mount for explicit
+  // huge pages or tmpfs for transparent huge pages.  Empty means
+  // util::kDefaultHugeDirectory.
+  std::string huge_directory;
+
 
   // Set defaults.
   Config();
@@ -14,7 +14,10 @@ void Usage(const char *name) {
     "-b: Do not buffer output.\n"
     "-n: Do not wrap the input in <s> and </s>.\n"
     "-v summary|sentence|word: Level of verbosity\n"
-    "-l lazy|populate|read|parallel: Load lazily, with populate, or malloc+read\n"
+    "-l lazy|populate|read|parallel|huge: Load lazily, with populate, malloc+read,\n"
+    "   or as a huge page copy shared between processes\n"
+    "-N interleave|node: Interleave the model across NUMA nodes or bind it to one\n"
+    "-H dir: Directory (tmpfs or hugetlbfs) for huge page copies\n"
     "The default loading method is populate on Linux and read on others.\n";
   exit(1);
 }
@@ -29,7 +32,7 @@ int main(int argc, char *argv[]) {
   bool flush = false;
 
   int opt;
-  while ((opt = getopt(argc, argv, "bnv:l:")) != -1) {
+  while ((opt = getopt(argc, argv, "bnv:l:N:H:")) != -1) {
     switch (opt) {
       case 'b':
         flush = true;
@@ -57,10 +60,23 @@ int main(int argc, char *argv[]) {
           config.load_method = util::READ;
         } else if (!strcmp(optarg, "parallel")) {
           config.load_method = util::PARALLEL_READ;
+        } else if (!strcmp(optarg, "huge")) {
+          config.load_method = util::HUGE_SHARED;
         } else {
           Usage(argv[0]);
         }
         break;
+      case 'N':
+        if (!strcmp(optarg, "interleave")) {
+          config.numa_policy = util::NUMA_INTERLEAVE;
+        } else {
+          config.numa_policy = util::NUMA_BIND;
+          config.numa_node = atoi(optarg);
+        }
+        break;
+      case 'H':
+        config.huge_directory = optarg;
+        break;
       case 'h':
       default:
         Usage(argv[0]);
@@ -128,7 +128,7 @@ void BleuDocScorer::prepareStats(size_t sid, const string& text, ScoreStats& ent
     // stats for this line
     vector<ScoreStatsType> stats(kBleuNgramOrder * 2);
     string sentence = preprocessSentence(sentences[i]);
-    const size_t length = CountNgrams(sentence, testcounts, kBleuNgramOrder);
+    const size_t length = CountNgrams(sentence, testcounts, kBleuNgramOrder, true);
 
     //precision on each ngram type
     for (NgramCounts::const_iterator testcounts_it = testcounts.begin();
@@ -60,7 +60,7 @@ void CderScorer::prepareStats(size_t sid, const string& text, ScoreStats& entry)
 void CderScorer::prepareStatsVector(size_t sid, const string& text, vector<ScoreStatsType>& stats)
 {
   sent_t cand;
-  TokenizeAndEncode(text, cand);
+  TokenizeAndEncodeHypothesis(text, cand);
 
   float max = -2;
   vector<ScoreStatsType> tmp;
@@ -22,6 +22,9 @@ public:
   virtual void setReferenceFiles(const std::vector<std::string>& referenceFiles);
 
   virtual void prepareStats(std::size_t sid, const std::string& text, ScoreStats& entry);
+  virtual bool isThreadSafe() const {
+    return !hasFilter();
+  }
 
   virtual void prepareStatsVector(std::size_t sid, const std::string& text, std::vector<ScoreStatsType>& stats);
 
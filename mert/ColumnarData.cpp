@@ -0,0 +1,407 @@
+/*
+ *  ColumnarData.cpp
+ *  mert - Minimum Error Rate Training
+ *
+ *  Memory mappable, columnar storage of feature and score statistics.
+ */
+
+#include "ColumnarData.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+#include <fcntl.h>
+#include <sys/file.h>
+
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "util/exception.hh"
+#include "util/file.hh"
+
+#include "FeatureArray.h"
+#include "FeatureData.h"
+#include "ScoreArray.h"
+#include "ScoreData.h"
+#include "Util.h"
+
+using namespace std;
+
+namespace MosesTuning
+{
+
+namespace
+{
+
+const char kMagic[8] = {'M', 'E', 'R', 'T', 'C', 'O', 'L', '1'};
+
+// Followed by, each padded to a multiple of 8 bytes:
+//   int32_t  sentence index[sentences]
+//   uint64_t first row of each sentence[sentences + 1]
+//   float    dense features[rows * dense_dims]
+//   uint64_t first sparse entry of each row[rows + 1]
+//   uint32_t sparse name id[sparse_entries]
+//   float    sparse value[sparse_entries]
+//   float    scores[rows * score_dims]
+//   char     names[names_bytes]: dense feature names, score type and the
+//            sparse feature names, each terminated by '\0'.
+struct SegmentHeader {
+  char magic[8];
+  uint64_t segment_bytes;
+  uint64_t sentences;
+  uint64_t rows;
+  uint64_t dense_dims;
+  uint64_t score_dims;
+  uint64_t sparse_entries;
+  uint64_t sparse_names;
+  uint64_t names_bytes;
+};
+
+inline uint64_t Pad(uint64_t bytes)
+{
+  return (bytes + 7) & ~static_cast<uint64_t>(7);
+}
+
+template <class T> void WriteSection(string& out, const vector<T>& values)
+{
+  const uint64_t bytes = values.size() * sizeof(T);
+  if (bytes) out.append(reinterpret_cast<const char*>(&values[0]), bytes);
+  out.append(Pad(bytes) - bytes, '\0');
+}
+
+// Holds an flock() on a file for its lifetime.
+class FileLock
+{
+public:
+  FileLock(int fd, int operation, const string& file) : m_fd(fd) {
+    UTIL_THROW_IF(flock(m_fd, operation), util::ErrnoException, "Unable to lock " << file);
+  }
+  ~FileLock() {
+    flock(m_fd, LOCK_UN);
+  }
+private:
+  int m_fd;
+};
+
+template <class T> const T* ReadSection(const uint8_t*& at, uint64_t count)
+{
+  const T* ret = reinterpret_cast<const T*>(at);
+  at += Pad(count * sizeof(T));
+  return ret;
+}
+
+} // namespace
+
+bool ColumnarData::IsColumnar(const string& file)
+{
+  ifstream in(file.c_str(), ios::in | ios::binary);
+  char magic[sizeof(kMagic)];
+  return in.read(magic, sizeof(magic)) && !memcmp(magic, kMagic, sizeof(kMagic));
+}
+
+void ColumnarData::Append(const string& file, const FeatureData& features, const ScoreData& scores)
+{
+  vector<int32_t> sentence_ids;
+  vector<uint64_t> sentence_rows(1, 0);
+  vector<float> dense;
+  vector<uint64_t> sparse_rows(1, 0);
+  vector<uint32_t> sparse_ids;
+  vector<float> sparse_values;
+  vector<float> score_values;
+  // SparseVector id to segment id, and the names in segment id order.
+  map<size_t, uint32_t> sparse_local;
+  string sparse_names;
+
+  uint64_t dense_dims = 0, score_dims = 0;
+  bool first = true;
+  for (size_t i = 0; i < features.size(); ++i) {
+    const FeatureArray& feature_array = features.get(i);
+    const int score_pos = scores.getIndex(feature_array.getIndex());
+    UTIL_THROW_IF(score_pos < 0, util::Exception, "No score statistics for sentence " << feature_array.getIndex());
+    const ScoreArray& score_array = scores.get(score_pos);
+    UTIL_THROW_IF(feature_array.size() != score_array.size(), util::Exception,
+                  "Sentence " << feature_array.getIndex() << " has " << feature_array.size()
+                  << " feature rows but " << score_array.size() << " score rows");
+
+    sentence_ids.push_back(feature_array.getIndex());
+    for (size_t j = 0; j < feature_array.size(); ++j) {
+      const FeatureStats& f = feature_array.get(j);
+      const ScoreStats& s = score_array.get(j);
+      if (first) {
+        dense_dims = f.size();
+        score_dims = s.size();
+        first = false;
+      }
+      UTIL_THROW_IF(f.size() != dense_dims || s.size() != score_dims, util::Exception,
+                    "Inconsistent number of features or scores in sentence " << feature_array.getIndex());
+      for (size_t k = 0; k < f.size(); ++k) dense.push_back(f.get(k));
+      for (size_t k = 0; k < s.size(); ++k) score_values.push_back(s.get(k));
+
+      const SparseVector& sparse = f.getSparse();
+      const vector<size_t> ids = sparse.feats();
+      for (size_t k = 0; k < ids.size(); ++k) {
+        map<size_t, uint32_t>::iterator found = sparse_local.find(ids[k]);
+        if (found == sparse_local.end()) {
+          found = sparse_local.insert(make_pair(ids[k], static_cast<uint32_t>(sparse_local.size()))).first;
+          sparse_names += SparseVector::decode(ids[k]);
+          sparse_names += '\0';
+        }
+        sparse_ids.push_back(found->second);
+        sparse_values.push_back(sparse.get(ids[k]));
+      }
+      sparse_rows.push_back(sparse_ids.size());
+    }
+    sentence_rows.push_back(dense_dims ? dense.size() / dense_dims : sentence_rows.back() + feature_array.size());
+  }
+
+  string names(features.Features());
+  names += '\0';
+  names += scores.name();
+  names += '\0';
+  names += sparse_names;
+  vector<char> names_section(names.begin(), names.end());
+
+  SegmentHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.sentences = sentence_ids.size();
+  header.rows = sentence_rows.back();
+  header.dense_dims = dense_dims;
+  header.score_dims = score_dims;
+  header.sparse_entries = sparse_ids.size();
+  header.sparse_names = sparse_local.size();
+  header.names_bytes = names_section.size();
+  header.segment_bytes = sizeof(SegmentHeader)
+                         + Pad(sentence_ids.size() * sizeof(int32_t))
+                         + Pad(sentence_rows.size() * sizeof(uint64_t))
+                         + Pad(dense.size() * sizeof(float))
+                         + Pad(sparse_rows.size() * sizeof(uint64_t))
+                         + Pad(sparse_ids.size() * sizeof(uint32_t))
+                         + Pad(sparse_values.size() * sizeof(float))
+                         + Pad(score_values.size() * sizeof(float))
+                         + Pad(names_section.size());
+
+  string segment;
+  segment.reserve(header.segment_bytes);
+  segment.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  WriteSection(segment, sentence_ids);
+  WriteSection(segment, sentence_rows);
+  WriteSection(segment, dense);
+  WriteSection(segment, sparse_rows);
+  WriteSection(segment, sparse_ids);
+  WriteSection(segment, sparse_values);
+  WriteSection(segment, score_values);
+  WriteSection(segment, names_section);
+
+  TRACE_ERR("appending " << header.sentences << " sentences and " << header.rows << " rows to " << file << endl);
+  util::scoped_fd fd(open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0666));
+  UTIL_THROW_IF(fd.get() == -1, util::ErrnoException, "Unable to open " << file << " for appending");
+  FileLock lock(fd.get(), LOCK_EX, file);
+  util::WriteOrThrow(fd.get(), segment.data(), segment.size());
+}
+
+ColumnarData::ColumnarData(const string& file)
+  : m_dense_dims(0), m_score_dims(0)
+{
+  TRACE_ERR("mapping columnar data from " << file << endl);
+  util::scoped_fd fd(util::OpenReadOrThrow(file.c_str()));
+  uint64_t size;
+  {
+    // Segments are only ever appended: whatever is there once no append is
+    // in progress stays as it is.
+    FileLock lock(fd.get(), LOCK_SH, file);
+    size = util::SizeOrThrow(fd.get());
+  }
+  UTIL_THROW_IF(size == 0, util::Exception, "Columnar file " << file << " is empty");
+  // Lazy mmap: pages are read on demand and shared between processes.
+  util::MapRead(util::LAZY, fd.get(), 0, size, m_mem);
+
+  map<int, size_t> sentence_pos;
+  const uint8_t* at = reinterpret_cast<const uint8_t*>(m_mem.get());
+  const uint8_t* const end = at + size;
+  while (at < end) {
+    UTIL_THROW_IF(static_cast<uint64_t>(end - at) < sizeof(SegmentHeader), util::Exception,
+                  "Truncated segment header in " << file);
+    const SegmentHeader* header = reinterpret_cast<const SegmentHeader*>(at);
+    UTIL_THROW_IF(memcmp(header->magic, kMagic, sizeof(kMagic)), util::Exception,
+                  "Bad segment magic at offset " << (at - reinterpret_cast<const uint8_t*>(m_mem.get())) << " of " << file);
+    UTIL_THROW_IF(header->segment_bytes > static_cast<uint64_t>(end - at), util::Exception,
+                  "Truncated segment in " << file);
+    const uint8_t* const segment_end = at + header->segment_bytes;
+    at += sizeof(SegmentHeader);
+
+    Segment segment;
+    segment.sentence_ids = ReadSection<int32_t>(at, header->sentences);
+    segment.sentence_rows = ReadSection<uint64_t>(at, header->sentences + 1);
+    segment.dense = ReadSection<float>(at, header->rows * header->dense_dims);
+    segment.sparse_rows = ReadSection<uint64_t>(at, header->rows + 1);
+    segment.sparse_ids = ReadSection<uint32_t>(at, header->sparse_entries);
+    segment.sparse_values = ReadSection<float>(at, header->sparse_entries);
+    segment.scores = ReadSection<float>(at, header->rows * header->score_dims);
+    const char* names = ReadSection<char>(at, header->names_bytes);
+    UTIL_THROW_IF(at != segment_end, util::Exception, "Inconsistent segment sizes in " << file);
+
+    const char* names_end = names + header->names_bytes;
+    string features(names);
+    names += features.size() + 1;
+    string score_type(names);
+    names += score_type.size() + 1;
+    for (uint64_t i = 0; i < header->sparse_names; ++i) {
+      UTIL_THROW_IF(names >= names_end, util::Exception, "Truncated sparse feature names in " << file);
+      string name(names);
+      names += name.size() + 1;
+      segment.sparse_global.push_back(SparseVector::encode(name));
+    }
+
+    if (m_segments.empty()) {
+      m_features = features;
+      m_score_type = score_type;
+      m_dense_dims = header->dense_dims;
+      m_score_dims = header->score_dims;
+    } else {
+      UTIL_THROW_IF(header->dense_dims != m_dense_dims || header->score_dims != m_score_dims,
+                    util::Exception, "Segments of " << file << " disagree on the number of features or scores");
+    }
+
+    const size_t segment_id = m_segments.size();
+    m_segments.push_back(segment);
+    for (uint64_t i = 0; i < header->sentences; ++i) {
+      const int index = segment.sentence_ids[i];
+      map<int, size_t>::iterator found = sentence_pos.find(index);
+      if (found == sentence_pos.end()) {
+        found = sentence_pos.insert(make_pair(index, m_sentences.size())).first;
+        m_sentences.push_back(Sentence());
+        m_sentences.back().index = index;
+      }
+      Row row;
+      row.segment = segment_id;
+      for (row.index = segment.sentence_rows[i]; row.index < segment.sentence_rows[i + 1]; ++row.index) {
+        m_sentences[found->second].rows.push_back(row);
+      }
+    }
+  }
+
+  // Iterations find many of the candidates of earlier ones again.
+  size_t removed = 0;
+  for (size_t s = 0; s < m_sentences.size(); ++s) {
+    removed += RemoveDuplicates(m_sentences[s]);
+  }
+  TRACE_ERR("ignoring " << removed << " duplicate rows of " << file << endl);
+}
+
+void ColumnarData::GetSparse(const Row& row, vector<pair<size_t, float> >& out) const
+{
+  const Segment& segment = m_segments[row.segment];
+  out.clear();
+  for (uint64_t k = segment.sparse_rows[row.index]; k < segment.sparse_rows[row.index + 1]; ++k) {
+    out.push_back(make_pair(segment.sparse_global[segment.sparse_ids[k]], segment.sparse_values[k]));
+  }
+  sort(out.begin(), out.end());
+}
+
+size_t ColumnarData::RemoveDuplicates(Sentence& sentence) const
+{
+  // Rows are hashed by their dense features and scores; sparse features
+  // are only compared when those are equal.
+  boost::unordered_multimap<size_t, size_t> seen;
+  vector<pair<size_t, float> > sparse, other;
+  vector<Row> kept;
+  for (vector<Row>::const_iterator row = sentence.rows.begin(); row != sentence.rows.end(); ++row) {
+    const float* dense = Dense(*row);
+    const float* scores = Scores(*row);
+    size_t hash = boost::hash_range(dense, dense + m_dense_dims);
+    boost::hash_range(hash, scores, scores + m_score_dims);
+
+    bool duplicate = false;
+    typedef boost::unordered_multimap<size_t, size_t>::const_iterator iter;
+    const pair<iter, iter> candidates = seen.equal_range(hash);
+    if (candidates.first != candidates.second) GetSparse(*row, sparse);
+    for (iter c = candidates.first; c != candidates.second && !duplicate; ++c) {
+      const Row& earlier = kept[c->second];
+      if (equal(dense, dense + m_dense_dims, Dense(earlier))
+          && equal(scores, scores + m_score_dims, Scores(earlier))) {
+        GetSparse(earlier, other);
+        duplicate = (sparse == other);
+      }
+    }
+    if (duplicate) continue;
+    seen.insert(make_pair(hash, kept.size()));
+    kept.push_back(*row);
+  }
+  const size_t removed = sentence.rows.size() - kept.size();
+  sentence.rows.swap(kept);
+  return removed;
+}
+
+void ColumnarData::GetFeatures(size_t s, vector<FeatureDataItem>& out) const
+{
+  const vector<Row>& rows = m_sentences[s].rows;
+  for (vector<Row>::const_iterator row = rows.begin(); row != rows.end(); ++row) {
+    const Segment& segment = m_segments[row->segment];
+    out.push_back(FeatureDataItem());
+    const float* dense = Dense(*row);
+    out.back().dense.assign(dense, dense + m_dense_dims);
+    for (uint64_t k = segment.sparse_rows[row->index]; k < segment.sparse_rows[row->index + 1]; ++k) {
+      out.back().sparse.set(segment.sparse_global[segment.sparse_ids[k]], segment.sparse_values[k]);
+    }
+  }
+}
+
+void ColumnarData::GetScores(size_t s, vector<ScoreDataItem>& out) const
+{
+  const vector<Row>& rows = m_sentences[s].rows;
+  for (vector<Row>::const_iterator row = rows.begin(); row != rows.end(); ++row) {
+    const float* scores = Scores(*row);
+    out.push_back(ScoreDataItem(scores, scores + m_score_dims));
+  }
+}
+
+void ColumnarData::GetFeatureArray(size_t s, const SparseVector& sparseWeights, FeatureArray& out) const
+{
+  out.clear();
+  out.setIndex(m_sentences[s].index);
+  out.NumberOfFeatures(m_dense_dims);
+  out.Features(m_features);
+
+  FeatureStats entry(m_dense_dims);
+  SparseVector sparse;
+  const vector<Row>& rows = m_sentences[s].rows;
+  for (vector<Row>::const_iterator row = rows.begin(); row != rows.end(); ++row) {
+    const Segment& segment = m_segments[row->segment];
+    entry.reset();
+    const float* dense = Dense(*row);
+    for (size_t k = 0; k < m_dense_dims; ++k) entry.add(dense[k]);
+    sparse.clear();
+    for (uint64_t k = segment.sparse_rows[row->index]; k < segment.sparse_rows[row->index + 1]; ++k) {
+      sparse.set(segment.sparse_global[segment.sparse_ids[k]], segment.sparse_values[k]);
+    }
+    if (sparseWeights.size()) {
+      // Merge the sparse features, as FeatureStats::set does.
+      entry.add(inner_product(sparseWeights, sparse));
+    } else {
+      entry.addSparse(sparse);
+    }
+    out.add(entry);
+  }
+}
+
+void ColumnarData::GetScoreArray(size_t s, ScoreArray& out) const
+{
+  out.clear();
+  out.setIndex(m_sentences[s].index);
+  out.NumberOfScores(m_score_dims);
+  string score_type(m_score_type);
+  out.name(score_type);
+
+  ScoreStats entry(m_score_dims);
+  const vector<Row>& rows = m_sentences[s].rows;
+  for (vector<Row>::const_iterator row = rows.begin(); row != rows.end(); ++row) {
+    entry.reset();
+    const float* scores = Scores(*row);
+    for (size_t k = 0; k < m_score_dims; ++k) entry.add(scores[k]);
+    out.add(entry);
+  }
+}
+
+}
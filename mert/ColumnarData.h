@@ -0,0 +1,158 @@
+/*
+ *  ColumnarData.h
+ *  mert - Minimum Error Rate Training
+ *
+ *  Memory mappable, columnar storage of feature and score statistics.
+ */
+
+#ifndef MERT_COLUMNAR_DATA_H_
+#define MERT_COLUMNAR_DATA_H_
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include "util/mmap.hh"
+
+#include "FeatureDataIterator.h"
+#include "ScoreDataIterator.h"
+#include "Types.h"
+
+namespace MosesTuning
+{
+
+class FeatureArray;
+class FeatureData;
+class ScoreArray;
+class ScoreData;
+
+/**
+ * A file of feature and score statistics in columnar form, meant to replace
+ * the feature and score text files of the optimizers.
+ *
+ * The file is a sequence of segments, one per tuning iteration.  Each
+ * iteration appends the candidates of its n-best list without touching the
+ * old segments.  A segment stores for each sentence the range of its rows in
+ *  - a row-major matrix of dense feature values,
+ *  - sparse features in CSR form (row pointers, name ids, values),
+ *  - a row-major matrix of score statistics.
+ *
+ * Readers map the file and see it sentence by sentence, with the rows of a
+ * sentence from all segments together and rows that repeat an earlier row of
+ * the sentence dropped, as Data::removeDuplicates() does.  That is the shape
+ * of a text feature or score file, so the same columnar file can be passed
+ * as both the feature file and the score file to mert, pro and kbmira.  The
+ * rows of a sentence are copied out of the mapping into the usual in-memory
+ * structures (FeatureArray, ScoreArray and the iterator items); what is saved
+ * is parsing text, not memory.
+ */
+class ColumnarData
+{
+public:
+  /** Open and map a columnar file. */
+  explicit ColumnarData(const std::string& file);
+
+  /** True iff file starts like a columnar file. */
+  static bool IsColumnar(const std::string& file);
+
+  /**
+   * Append the contents of features and scores to file as a new segment,
+   * creating the file if needed.  Sentences are matched by index.  The file
+   * is locked while appending, so several processes may append to it, and
+   * readers that open it meanwhile see only whole segments.
+   */
+  static void Append(const std::string& file, const FeatureData& features, const ScoreData& scores);
+
+  std::size_t NumberOfSentences() const {
+    return m_sentences.size();
+  }
+
+  /** Sentence index (as in the n-best list) of the s-th sentence. */
+  int SentenceIndex(std::size_t s) const {
+    return m_sentences[s].index;
+  }
+
+  /** Dense feature names, as in FeatureData::Features(). */
+  const std::string& Features() const {
+    return m_features;
+  }
+
+  std::size_t NumberOfFeatures() const {
+    return m_dense_dims;
+  }
+
+  std::size_t NumberOfScores() const {
+    return m_score_dims;
+  }
+
+  const std::string& ScoreType() const {
+    return m_score_type;
+  }
+
+  /** Append the feature rows of the s-th sentence to out. */
+  void GetFeatures(std::size_t s, std::vector<FeatureDataItem>& out) const;
+
+  /** Append the score rows of the s-th sentence to out. */
+  void GetScores(std::size_t s, std::vector<ScoreDataItem>& out) const;
+
+  /**
+   * Fill out with the feature rows of the s-th sentence.  Sparse features are
+   * merged into one dense feature if sparseWeights is not empty, like the text
+   * loader does.
+   */
+  void GetFeatureArray(std::size_t s, const SparseVector& sparseWeights, FeatureArray& out) const;
+
+  /** Fill out with the score rows of the s-th sentence. */
+  void GetScoreArray(std::size_t s, ScoreArray& out) const;
+
+private:
+  struct Segment {
+    const int32_t* sentence_ids;
+    const uint64_t* sentence_rows;
+    const float* dense;
+    const uint64_t* sparse_rows;
+    const uint32_t* sparse_ids;
+    const float* sparse_values;
+    const float* scores;
+    // Segment sparse name id to SparseVector id.
+    std::vector<std::size_t> sparse_global;
+  };
+
+  struct Row {
+    std::size_t segment;
+    uint64_t index;
+  };
+
+  struct Sentence {
+    int index;
+    std::vector<Row> rows;
+  };
+
+  const float* Dense(const Row& row) const {
+    return m_segments[row.segment].dense + row.index * m_dense_dims;
+  }
+
+  const float* Scores(const Row& row) const {
+    return m_segments[row.segment].scores + row.index * m_score_dims;
+  }
+
+  // Sparse features of row as sorted (SparseVector id, value) pairs.
+  void GetSparse(const Row& row, std::vector<std::pair<std::size_t, float> >& out) const;
+
+  // Drop the rows of sentence that repeat an earlier row; returns how many.
+  std::size_t RemoveDuplicates(Sentence& sentence) const;
+
+  util::scoped_memory m_mem;
+  std::vector<Segment> m_segments;
+  std::vector<Sentence> m_sentences;
+
+  std::string m_features;
+  std::string m_score_type;
+  std::size_t m_dense_dims;
+  std::size_t m_score_dims;
+};
+
+}
+
+#endif  // MERT_COLUMNAR_DATA_H_
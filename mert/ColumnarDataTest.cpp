@@ -0,0 +1,107 @@
+#include "ColumnarData.h"
+#include "Data.h"
+#include "Scorer.h"
+#include "ScorerFactory.h"
+
+#define BOOST_TEST_MODULE MertColumnarData
+#include <boost/test/unit_test.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+
+using namespace MosesTuning;
+
+namespace
+{
+
+// Two sentences, two hypotheses each, one with a sparse feature.
+void FillData(Data& data, float offset)
+{
+  data.InitFeatureMap("lm= -1 w= -2 ");
+  data.AddFeatures("lm= -1 w= -2 ", 0);
+  data.AddFeatures(" lm= -3 w= -4 ", 0);
+  data.AddFeatures(" lm= -5 w= -6 ", 1);
+  data.AddFeatures(" lm= -7 w= -8 pp_x= 0.5 ", 1);
+  // Bleu needs 9 statistics.
+  for (int sentence = 0; sentence < 2; ++sentence) {
+    for (int hyp = 0; hyp < 2; ++hyp) {
+      ScoreStats stats;
+      for (int k = 0; k < 9; ++k) stats.add(offset + 10 * sentence + hyp + k);
+      data.getScoreData()->add(stats, sentence);
+    }
+  }
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(append_and_read)
+{
+  boost::scoped_ptr<Scorer> scorer(ScorerFactory::getScorer("BLEU", ""));
+  const std::string file = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+
+  Data first(scorer.get());
+  FillData(first, 0);
+  ColumnarData::Append(file, *first.getFeatureData(), *first.getScoreData());
+  Data second(scorer.get());
+  FillData(second, 100);
+  ColumnarData::Append(file, *second.getFeatureData(), *second.getScoreData());
+
+  BOOST_REQUIRE(ColumnarData::IsColumnar(file));
+  {
+    ColumnarData columnar(file);
+    BOOST_CHECK_EQUAL(columnar.NumberOfSentences(), (std::size_t)2);
+    BOOST_CHECK_EQUAL(columnar.NumberOfFeatures(), (std::size_t)2);
+    BOOST_CHECK_EQUAL(columnar.NumberOfScores(), (std::size_t)9);
+    BOOST_CHECK_EQUAL(columnar.Features(), "lm_0 w_0 ");
+  }
+
+  // Rows of both segments come back together, sentence by sentence.
+  FeatureDataIterator features(file);
+  ScoreDataIterator scores(file);
+  BOOST_REQUIRE_EQUAL(features->size(), (std::size_t)4);
+  BOOST_REQUIRE_EQUAL(scores->size(), (std::size_t)4);
+  BOOST_CHECK_EQUAL((*features)[1].dense[1], -4);
+  BOOST_CHECK_EQUAL((*scores)[2][0], 100);
+  ++features;
+  ++scores;
+  BOOST_REQUIRE_EQUAL(features->size(), (std::size_t)4);
+  BOOST_CHECK_EQUAL((*features)[3].sparse.get("pp_x="), 0.5);
+  BOOST_CHECK_EQUAL((*scores)[3][8], 119);
+  ++features;
+  ++scores;
+  BOOST_CHECK(features == FeatureDataIterator::end());
+  BOOST_CHECK(scores == ScoreDataIterator::end());
+
+  Data loaded(scorer.get());
+  loaded.load(file, file);
+  BOOST_CHECK_EQUAL(loaded.getFeatureData()->size(), (std::size_t)2);
+  BOOST_CHECK_EQUAL(loaded.getFeatureData()->get(1).size(), (std::size_t)4);
+  BOOST_CHECK_EQUAL(loaded.getFeatureData()->get(1, 1).get(0), -7);
+  BOOST_CHECK_EQUAL(loaded.getScoreData()->get(0, 3).get(1), 102);
+
+  boost::filesystem::remove(file);
+}
+
+BOOST_AUTO_TEST_CASE(duplicates_and_score_type)
+{
+  boost::scoped_ptr<Scorer> scorer(ScorerFactory::getScorer("BLEU", ""));
+  const std::string file = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+
+  // A later iteration finds the same candidates again.
+  Data first(scorer.get());
+  FillData(first, 0);
+  ColumnarData::Append(file, *first.getFeatureData(), *first.getScoreData());
+  ColumnarData::Append(file, *first.getFeatureData(), *first.getScoreData());
+  Data loaded(scorer.get());
+  loaded.load(file, file);
+  BOOST_CHECK_EQUAL(loaded.getFeatureData()->get(1).size(), (std::size_t)2);
+  BOOST_CHECK_EQUAL(loaded.getScoreData()->get(1).size(), (std::size_t)2);
+  BOOST_CHECK_EQUAL(loaded.getFeatureData()->get(1, 1).getSparse().get("pp_x="), 0.5);
+
+  // Score statistics of another metric are refused.
+  boost::scoped_ptr<Scorer> ter(ScorerFactory::getScorer("TER", ""));
+  Data other(ter.get());
+  BOOST_CHECK_THROW(other.load(file, file), std::runtime_error);
+
+  boost::filesystem::remove(file);
+}
@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <cmath>
 #include <fstream>
+#include <set>
 
 #include "Data.h"
 #include "Scorer.h"
@@ -21,12 +22,110 @@
 #include "util/tokenize_piece.hh"
 #include "util/string_piece.hh"
 #include "FeatureDataIterator.h"
+#include "moses/BinaryNBest.h"
+
+#ifdef WITH_THREADS
+#include <boost/scoped_ptr.hpp>
+#include "moses/ThreadPool.h"
+#endif
 
 using namespace std;
 
 namespace MosesTuning
 {
 
+namespace
+{
+
+// Split an n-best line into sentence index, hypothesis and feature string.
+// The hypothesis gets "|||" and the alignment appended if the scorer uses it.
+void ParseNBestLine(const StringPiece& line, bool useAlignment,
+                    int& sentence_index, string& sentence, string& feature_str)
+{
+  string alignment;
+  util::TokenIter<util::MultiCharacter> it(line, util::MultiCharacter("|||"));
+
+  sentence_index = ParseInt(*it);
+  ++it;
+  sentence = it->as_string();
+  ++it;
+  feature_str = it->as_string();
+  ++it;
+
+  if (it) {
+    ++it;                             // skip model score.
+
+    if (it) {
+      alignment = it->as_string(); //fifth field (if present) is either phrase or word alignment
+      ++it;
+      if (it) {
+        alignment = it->as_string(); //sixth field (if present) is word alignment
+      }
+    }
+  }
+  //TODO check alignment exists if scorers need it
+
+  if (useAlignment) {
+    sentence += "|||";
+    sentence += alignment;
+  }
+}
+
+// An n-best entry waiting for its score statistics.
+struct NBestEntry {
+  int sentence_index;
+  string sentence;
+  string feature_str;
+  ScoreStats stats;
+};
+
+#ifdef WITH_THREADS
+// Counts down finished tasks so a block can be collected once it is scored.
+class BlockLatch
+{
+public:
+  explicit BlockLatch(size_t count) : m_count(count) {}
+
+  void Done() {
+    boost::mutex::scoped_lock lock(m_mutex);
+    if (--m_count == 0) m_finished.notify_all();
+  }
+
+  void Wait() {
+    boost::mutex::scoped_lock lock(m_mutex);
+    while (m_count) m_finished.wait(lock);
+  }
+
+private:
+  size_t m_count;
+  boost::mutex m_mutex;
+  boost::condition_variable m_finished;
+};
+
+// Scores a contiguous slice of a block with a scorer of its own.
+class ScoreNBestTask : public Moses::Task
+{
+public:
+  ScoreNBestTask(Scorer* scorer, NBestEntry* begin, NBestEntry* end, BlockLatch& latch)
+    : m_scorer(scorer), m_begin(begin), m_end(end), m_latch(latch) {}
+
+  virtual void Run() {
+    for (NBestEntry* entry = m_begin; entry != m_end; ++entry) {
+      m_scorer->prepareStats(entry->sentence_index, entry->sentence, entry->stats);
+    }
+    m_latch.Done();
+  }
+
+private:
+  Scorer* m_scorer;
+  NBestEntry* m_begin;
+  NBestEntry* m_end;
+  BlockLatch& m_latch;
+};
+#endif // WITH_THREADS
+
+} // namespace
+
 Data::Data(Scorer* scorer, const string& sparse_weights_file)
   : m_scorer(scorer),
     m_score_type(m_scorer->getName()),
@@ -138,11 +237,15 @@ void Data::load(const std::string &featfile, const std::string &scorefile)
 
 void Data::loadNBest(const string &file, bool oneBest)
 {
+  if (Moses::BinaryNBestReader::IsBinary(file)) {
+    loadBinaryNBest(file, vector<Scorer*>(1, m_scorer), 1000, oneBest);
+    return;
+  }
   TRACE_ERR("loading nbest from " << file << endl);
   util::FilePiece in(file.c_str());
 
   ScoreStats scoreentry;
-  string sentence, feature_str, alignment;
+  string sentence, feature_str;
   int sentence_index;
 
   while (true) {
@@ -152,33 +255,9 @@ void Data::loadNBest(const string &file, bool oneBest)
       // adding statistics for error measures
       scoreentry.clear();
 
-      util::TokenIter<util::MultiCharacter> it(line, util::MultiCharacter("|||"));
-
-      sentence_index = ParseInt(*it);
+      ParseNBestLine(line, m_scorer->useAlignment(), sentence_index, sentence, feature_str);
       if (oneBest && m_score_data->exists(sentence_index)) continue;
-      ++it;
-      sentence = it->as_string();
-      ++it;
-      feature_str = it->as_string();
-      ++it;
-
-      if (it) {
-        ++it;                             // skip model score.
 
-        if (it) {
-          alignment = it->as_string(); //fifth field (if present) is either phrase or word alignment
-          ++it;
-          if (it) {
-            alignment = it->as_string(); //sixth field (if present) is word alignment
-          }
-        }
-      }
-      //TODO check alignment exists if scorers need it
-
-      if (m_scorer->useAlignment()) {
-        sentence += "|||";
-        sentence += alignment;
-      }
       m_scorer->prepareStats(sentence_index, sentence, scoreentry);
 
       m_score_data->add(scoreentry, sentence_index);
@@ -195,6 +274,165 @@ void Data::loadNBest(const string &file, bool oneBest)
   }
 }
 
+void Data::loadNBestParallel(const string &file, const vector<Scorer*> &scorers, size_t block_size)
+{
+  if (Moses::BinaryNBestReader::IsBinary(file)) {
+    loadBinaryNBest(file, scorers, block_size, false);
+    return;
+  }
+#ifdef WITH_THREADS
+  if (scorers.size() <= 1) {
+    loadNBest(file);
+    return;
+  }
+  TRACE_ERR("loading nbest from " << file << " with " << scorers.size() << " threads" << endl);
+  util::FilePiece in(file.c_str());
+  Moses::ThreadPool pool(scorers.size());
+
+  const size_t limit = max<size_t>(block_size, 1) * scorers.size();
+  vector<NBestEntry> block;
+  NBestEntry next;
+  bool have_next = false;
+  bool eof = false;
+  while (!eof || have_next) {
+    // Read about block_size lines per thread, then finish the sentence in
+    // progress so that blocks are made of whole n-best lists.
+    block.clear();
+    block.reserve(limit);
+    if (have_next) {
+      block.push_back(next);
+      have_next = false;
+    }
+    while (!eof) {
+      StringPiece line;
+      try {
+        line = in.ReadLine();
+      } catch (util::EndOfFileException &e) {
+        eof = true;
+        break;
+      }
+      if (line.empty()) continue;
+      NBestEntry entry;
+      ParseNBestLine(line, m_scorer->useAlignment(), entry.sentence_index, entry.sentence, entry.feature_str);
+      if (block.size() >= limit && entry.sentence_index != block.back().sentence_index) {
+        next = entry;
+        have_next = true;
+        break;
+      }
+      block.push_back(entry);
+    }
+    if (block.empty()) continue;
+
+    const size_t slices = min(scorers.size(), block.size());
+    BlockLatch latch(slices);
+    for (size_t i = 0; i < slices; ++i) {
+      NBestEntry* begin = &block[0] + block.size() * i / slices;
+      NBestEntry* end = &block[0] + block.size() * (i + 1) / slices;
+      pool.Submit(boost::shared_ptr<Moses::Task>(new ScoreNBestTask(scorers[i], begin, end, latch)));
+    }
+    latch.Wait();
+
+    for (size_t i = 0; i < block.size(); ++i) {
+      m_score_data->add(block[i].stats, block[i].sentence_index);
+      // examine first line for name of features
+      if (!existsFeatureNames()) {
+        InitFeatureMap(block[i].feature_str);
+      }
+      AddFeatures(block[i].feature_str, block[i].sentence_index);
+    }
+  }
+  pool.Stop(true);
+  PrintUserTime("Loaded N-best lists");
+#else
+  loadNBest(file);
+#endif // WITH_THREADS
+}
+
+void Data::loadBinaryNBest(const string &file, const vector<Scorer*> &scorers,
+                           size_t block_size, bool oneBest)
+{
+  TRACE_ERR("loading binary nbest from " << file << endl);
+  Moses::BinaryNBestReader in(file);
+#ifdef WITH_THREADS
+  boost::scoped_ptr<Moses::ThreadPool> pool;
+  if (scorers.size() > 1) pool.reset(new Moses::ThreadPool(scorers.size()));
+#endif
+
+  const size_t limit = max<size_t>(block_size, 1) * scorers.size();
+  set<int> seen;
+  vector<NBestEntry> block;
+  vector<FeatureStats> features;
+  bool more = true;
+  while (more) {
+    // Blocks are made of whole n-best lists, as in loadNBestParallel.
+    block.clear();
+    features.clear();
+    while (block.size() < limit && (more = in.NextSentence())) {
+      if (!existsFeatureNames()) {
+        m_feature_data->setFeatureMap(in.DenseFeatureNames());
+      }
+      if (oneBest && !seen.insert(in.Sentence()).second) continue;
+      while (in.NextHypothesis()) {
+        NBestEntry entry;
+        entry.sentence_index = in.Sentence();
+        if (m_scorer->useAlignment()) {
+          // the alignment is kept as text, so go through the text line
+          ostringstream line;
+          in.WriteText(line);
+          ParseNBestLine(line.str(), true, entry.sentence_index, entry.sentence, entry.feature_str);
+          entry.feature_str.clear();
+        } else {
+          entry.sentence = " " + in.Surface() + " ";
+        }
+        block.push_back(entry);
+
+        // The scores are used where they are mapped, without parsing.
+        features.push_back(FeatureStats(in.NumDense()));
+        FeatureStats& stats = features.back();
+        stats.reset();
+        const float* dense = in.Dense();
+        for (size_t i = 0; i < in.NumDense(); ++i) {
+          stats.add(dense[i]);
+        }
+        for (size_t i = 0; i < in.NumSparse(); ++i) {
+          // as AddFeatures: sparse feature names have an underscore
+          if (in.SparseName(i).find('_') == StringPiece::npos) continue;
+          stats.addSparse(in.SparseName(i).as_string() + "=", in.SparseValue(i));
+        }
+        if (oneBest) break;
+      }
+    }
+    if (block.empty()) continue;
+
+#ifdef WITH_THREADS
+    if (pool) {
+      const size_t slices = min(scorers.size(), block.size());
+      BlockLatch latch(slices);
+      for (size_t i = 0; i < slices; ++i) {
+        NBestEntry* begin = &block[0] + block.size() * i / slices;
+        NBestEntry* end = &block[0] + block.size() * (i + 1) / slices;
+        pool->Submit(boost::shared_ptr<Moses::Task>(new ScoreNBestTask(scorers[i], begin, end, latch)));
+      }
+      latch.Wait();
+    } else
+#endif
+    {
+      for (size_t i = 0; i < block.size(); ++i) {
+        m_scorer->prepareStats(block[i].sentence_index, block[i].sentence, block[i].stats);
+      }
+    }
+
+    for (size_t i = 0; i < block.size(); ++i) {
+      m_score_data->add(block[i].stats, block[i].sentence_index);
+      m_feature_data->add(features[i], block[i].sentence_index);
+    }
+  }
+#ifdef WITH_THREADS
+  if (pool) pool->Stop(true);
+#endif
+  PrintUserTime("Loaded N-best lists");
+}
+
 void Data::save(const std::string &featfile, const std::string &scorefile, bool bin)
 {
   if (bin)
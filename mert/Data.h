@@ -69,6 +69,25 @@ public:
 
   void loadNBest(const std::string &file, bool oneBest=false);
 
+  /**
+   * Same as loadNBest(file), but score the hypotheses in parallel, one thread
+   * per scorer.  The scorers must be set up like the one given to the
+   * constructor (same type, config, factors, filter and references) since
+   * they are used interchangeably.  The file is read in blocks of about
+   * block_size lines per thread, ending on a sentence boundary; statistics
+   * are added in file order, so the result is identical to loadNBest.
+   */
+  void loadNBestParallel(const std::string &file, const std::vector<Scorer*> &scorers,
+                         std::size_t block_size = 1000);
+
+  /**
+   * Load a binary n-best list written by the decoder with
+   * -binary-n-best-list.  loadNBest and loadNBestParallel call this when
+   * they are given such a file.
+   */
+  void loadBinaryNBest(const std::string &file, const std::vector<Scorer*> &scorers,
+                       std::size_t block_size, bool oneBest);
+
   void load(const std::string &featfile, const std::string &scorefile);
 
   void save(const std::string &featfile, const std::string &scorefile, bool bin=false);
@@ -9,6 +9,7 @@
 #include "FeatureData.h"
 
 #include <limits>
+#include "ColumnarData.h"
 #include "FileStream.h"
 #include "Util.h"
 
@@ -69,6 +70,17 @@ void FeatureData::load(istream* is, const SparseVector& sparseWeights)
 
 void FeatureData::load(const string &file, const SparseVector& sparseWeights)
 {
+  if (ColumnarData::IsColumnar(file)) {
+    ColumnarData columnar(file);
+    FeatureArray entry;
+    for (size_t s = 0; s < columnar.NumberOfSentences(); ++s) {
+      columnar.GetFeatureArray(s, sparseWeights, entry);
+      if (size() == 0)
+        setFeatureMap(entry.Features());
+      add(entry);
+    }
+    return;
+  }
   TRACE_ERR("loading feature data from " << file << endl);
   inputfilestream input_stream(file); // matches a stream with a file. Opens the file
   if (!input_stream) {
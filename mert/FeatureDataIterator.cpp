@@ -23,6 +23,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "util/file_piece.hh"
 #include "util/tokenize_piece.hh"
 
+#include "ColumnarData.h"
 #include "FeatureArray.h"
 #include "FeatureDataIterator.h"
 
@@ -69,11 +70,15 @@ size_t hash_value(FeatureDataItem const& item)
 }
 
 
-FeatureDataIterator::FeatureDataIterator() {}
+FeatureDataIterator::FeatureDataIterator() : m_sentence(0) {}
 
-FeatureDataIterator::FeatureDataIterator(const string& filename)
+FeatureDataIterator::FeatureDataIterator(const string& filename) : m_sentence(0)
 {
-  m_in.reset(new FilePiece(filename.c_str()));
+  if (ColumnarData::IsColumnar(filename)) {
+    m_columnar.reset(new ColumnarData(filename));
+  } else {
+    m_in.reset(new FilePiece(filename.c_str()));
+  }
   readNext();
 }
 
@@ -82,6 +87,14 @@ FeatureDataIterator::~FeatureDataIterator() {}
 void FeatureDataIterator::readNext()
 {
   m_next.clear();
+  if (m_columnar) {
+    if (m_sentence < m_columnar->NumberOfSentences()) {
+      m_columnar->GetFeatures(m_sentence++, m_next);
+    } else {
+      m_columnar.reset();
+    }
+    return;
+  }
   try {
     StringPiece marker = m_in->ReadDelimited();
     if (marker != StringPiece(FEATURES_TXT_BEGIN)) {
@@ -131,6 +144,9 @@ void FeatureDataIterator::increment()
 
 bool FeatureDataIterator::equal(const FeatureDataIterator& rhs) const
 {
+  if (m_columnar || rhs.m_columnar) {
+    return m_columnar == rhs.m_columnar && m_sentence == rhs.m_sentence;
+  }
   if (!m_in && !rhs.m_in) {
     return true;
   } else if (!m_in) {
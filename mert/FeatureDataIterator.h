@@ -45,6 +45,7 @@ class FilePiece;
 namespace MosesTuning
 {
 
+class ColumnarData;
 
 class FileFormatException : public util::Exception
 {
@@ -97,6 +98,9 @@ private:
   void readNext();
 
   boost::shared_ptr<util::FilePiece> m_in;
+  // Set instead of m_in when reading a columnar file.
+  boost::shared_ptr<ColumnarData> m_columnar;
+  std::size_t m_sentence;
   std::vector<FeatureDataItem> m_next;
 };
 
@@ -92,6 +92,9 @@ public:
   void expand();
   void add(FeatureStatsType v);
   void addSparse(const std::string& name, FeatureStatsType v);
+  void addSparse(const SparseVector& sparse) {
+    m_map += sparse;
+  }
 
   void clear() {
     memset((void*)m_array, 0, GetArraySizeWithBytes());
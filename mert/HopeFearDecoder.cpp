@@ -132,6 +132,17 @@ InitialiseWeights(const string& denseInitFile, const string& sparseInitFile,
   return pair<MiraWeightVector*,size_t>(new MiraWeightVector(initParams), initDenseSize);
 }
 
+void HopeFearDecoder::HopeFearAt(size_t, const std::vector<ValType>&,
+                                 const MiraWeightVector&, HopeFearData*) const
+{
+  UTIL_THROW(util::Exception, "This hope/fear decoder does not support random access");
+}
+
+void HopeFearDecoder::MaxModelAt(size_t, const AvgWeightVector&, std::vector<ValType>*) const
+{
+  UTIL_THROW(util::Exception, "This hope/fear decoder does not support random access");
+}
+
 ValType HopeFearDecoder::Evaluate(const AvgWeightVector& wv)
 {
   vector<ValType> stats(scorer_->NumberOfScores(),0);
@@ -157,8 +168,10 @@ NbestHopeFearDecoder::NbestHopeFearDecoder(
   scorer_ = scorer;
   if (streaming) {
     train_.reset(new StreamingHypPackEnumerator(featureFiles, scoreFiles));
+    randomAccess_ = NULL;
   } else {
-    train_.reset(new RandomAccessHypPackEnumerator(featureFiles, scoreFiles, no_shuffle));
+    randomAccess_ = new RandomAccessHypPackEnumerator(featureFiles, scoreFiles, no_shuffle);
+    train_.reset(randomAccess_);
   }
 }
 
@@ -178,24 +191,66 @@ void NbestHopeFearDecoder::reset()
   train_->reset();
 }
 
-void NbestHopeFearDecoder::HopeFear(
+namespace
+{
+
+// The k-best list at the current position of an enumerator
+class CurrentPack
+{
+public:
+  CurrentPack(HypPackEnumerator& train) : train_(train) {}
+  size_t size() const {
+    return train_.cur_size();
+  }
+  const MiraFeatureVector& featuresAt(size_t i) const {
+    return train_.featuresAt(i);
+  }
+  const ScoreDataItem& scoresAt(size_t i) const {
+    return train_.scoresAt(i);
+  }
+private:
+  HypPackEnumerator& train_;
+};
+
+// The k-best list of a given sentence
+class IndexedPack
+{
+public:
+  IndexedPack(const RandomAccessHypPackEnumerator& train, size_t sentence)
+    : train_(train), sentence_(sentence) {}
+  size_t size() const {
+    return train_.size(sentence_);
+  }
+  const MiraFeatureVector& featuresAt(size_t i) const {
+    return train_.featuresAt(sentence_, i);
+  }
+  const ScoreDataItem& scoresAt(size_t i) const {
+    return train_.scoresAt(sentence_, i);
+  }
+private:
+  const RandomAccessHypPackEnumerator& train_;
+  size_t sentence_;
+};
+
+template <class Pack> void NbestHopeFear(
+  const Pack& pack,
+  Scorer* scorer,
+  bool safe_hope,
   const std::vector<ValType>& backgroundBleu,
   const MiraWeightVector& wv,
   HopeFearData* hopeFear
 )
 {
-
-
   // Hope / fear decode
   ValType hope_scale = 1.0;
   size_t hope_index=0, fear_index=0, model_index=0;
   ValType hope_score=0, fear_score=0, model_score=0;
   for(size_t safe_loop=0; safe_loop<2; safe_loop++) {
     ValType hope_bleu=0, hope_model=0;
-    for(size_t i=0; i< train_->cur_size(); i++) {
-      const MiraFeatureVector& vec=train_->featuresAt(i);
+    for(size_t i=0; i< pack.size(); i++) {
+      const MiraFeatureVector& vec=pack.featuresAt(i);
       ValType score = wv.score(vec);
-      ValType bleu = scorer_->calculateSentenceLevelBackgroundScore(train_->scoresAt(i),backgroundBleu);
+      ValType bleu = scorer->calculateSentenceLevelBackgroundScore(pack.scoresAt(i),backgroundBleu);
       // Hope
       if(i==0 || (hope_scale*score + bleu) > hope_score) {
         hope_score = hope_scale*score + bleu;
@@ -217,37 +272,75 @@ void NbestHopeFearDecoder::HopeFear(
     // Outer loop rescales the contribution of model score to 'hope' in antagonistic cases
     // where model score is having far more influence than BLEU
     hope_bleu *= BLEU_RATIO; // We only care about cases where model has MUCH more influence than BLEU
-    if(safe_hope_ && safe_loop==0 && abs(hope_model)>1e-8 && abs(hope_bleu)/abs(hope_model)<hope_scale)
+    if(safe_hope && safe_loop==0 && abs(hope_model)>1e-8 && abs(hope_bleu)/abs(hope_model)<hope_scale)
       hope_scale = abs(hope_bleu) / abs(hope_model);
     else break;
   }
-  hopeFear->modelFeatures = train_->featuresAt(model_index);
-  hopeFear->hopeFeatures = train_->featuresAt(hope_index);
-  hopeFear->fearFeatures = train_->featuresAt(fear_index);
+  hopeFear->modelFeatures = pack.featuresAt(model_index);
+  hopeFear->hopeFeatures = pack.featuresAt(hope_index);
+  hopeFear->fearFeatures = pack.featuresAt(fear_index);
 
-  hopeFear->hopeStats = train_->scoresAt(hope_index);
-  hopeFear->hopeBleu = scorer_->calculateSentenceLevelBackgroundScore(hopeFear->hopeStats, backgroundBleu);
-  const vector<float>& fear_stats = train_->scoresAt(fear_index);
-  hopeFear->fearBleu = scorer_->calculateSentenceLevelBackgroundScore(fear_stats, backgroundBleu);
+  hopeFear->hopeStats = pack.scoresAt(hope_index);
+  hopeFear->hopeBleu = scorer->calculateSentenceLevelBackgroundScore(hopeFear->hopeStats, backgroundBleu);
+  const vector<float>& fear_stats = pack.scoresAt(fear_index);
+  hopeFear->fearBleu = scorer->calculateSentenceLevelBackgroundScore(fear_stats, backgroundBleu);
 
-  hopeFear->modelStats = train_->scoresAt(model_index);
+  hopeFear->modelStats = pack.scoresAt(model_index);
   hopeFear->hopeFearEqual = (hope_index == fear_index);
 }
 
-void NbestHopeFearDecoder::MaxModel(const AvgWeightVector& wv, std::vector<ValType>* stats)
+template <class Pack> void NbestMaxModel(const Pack& pack, const AvgWeightVector& wv, std::vector<ValType>* stats)
 {
   // Find max model
   size_t max_index=0;
   ValType max_score=0;
-  for(size_t i=0; i<train_->cur_size(); i++) {
-    MiraFeatureVector vec(train_->featuresAt(i));
+  for(size_t i=0; i<pack.size(); i++) {
+    MiraFeatureVector vec(pack.featuresAt(i));
     ValType score = wv.score(vec);
     if(i==0 || score > max_score) {
       max_index = i;
       max_score = score;
     }
   }
-  *stats = train_->scoresAt(max_index);
+  *stats = pack.scoresAt(max_index);
+}
+
+} // namespace
+
+void NbestHopeFearDecoder::HopeFear(
+  const std::vector<ValType>& backgroundBleu,
+  const MiraWeightVector& wv,
+  HopeFearData* hopeFear
+)
+{
+  NbestHopeFear(CurrentPack(*train_), scorer_, safe_hope_, backgroundBleu, wv, hopeFear);
+}
+
+void NbestHopeFearDecoder::MaxModel(const AvgWeightVector& wv, std::vector<ValType>* stats)
+{
+  NbestMaxModel(CurrentPack(*train_), wv, stats);
+}
+
+size_t NbestHopeFearDecoder::NumSentences() const
+{
+  return randomAccess_ ? randomAccess_->num_sentences() : 0;
+}
+
+void NbestHopeFearDecoder::HopeFearAt(
+  size_t sentence,
+  const std::vector<ValType>& backgroundBleu,
+  const MiraWeightVector& wv,
+  HopeFearData* hopeFear
+) const
+{
+  UTIL_THROW_IF(!randomAccess_, util::Exception, "Random access is not supported when streaming");
+  NbestHopeFear(IndexedPack(*randomAccess_, sentence), scorer_, safe_hope_, backgroundBleu, wv, hopeFear);
+}
+
+void NbestHopeFearDecoder::MaxModelAt(size_t sentence, const AvgWeightVector& wv, std::vector<ValType>* stats) const
+{
+  UTIL_THROW_IF(!randomAccess_, util::Exception, "Random access is not supported when streaming");
+  NbestMaxModel(IndexedPack(*randomAccess_, sentence), wv, stats);
 }
 
 
@@ -328,16 +421,37 @@ bool HypergraphHopeFearDecoder::finished()
   return sentenceIdIter_ == sentenceIds_.end();
 }
 
+const Graph& HypergraphHopeFearDecoder::GetGraph(size_t sentenceId) const
+{
+  GraphColl::const_iterator graph = graphs_.find(sentenceId);
+  UTIL_THROW_IF(graph == graphs_.end(), HypergraphException, "No hypergraph for sentence " << sentenceId);
+  return *(graph->second);
+}
+
+size_t HypergraphHopeFearDecoder::NumSentences() const
+{
+  return sentenceIds_.size();
+}
+
 void HypergraphHopeFearDecoder::HopeFear(
   const vector<ValType>& backgroundBleu,
   const MiraWeightVector& wv,
   HopeFearData* hopeFear
 )
 {
-  size_t sentenceId = *sentenceIdIter_;
+  HopeFearAt(*sentenceIdIter_, backgroundBleu, wv, hopeFear);
+}
+
+void HypergraphHopeFearDecoder::HopeFearAt(
+  size_t sentenceId,
+  const vector<ValType>& backgroundBleu,
+  const MiraWeightVector& wv,
+  HopeFearData* hopeFear
+) const
+{
   SparseVector weights;
   wv.ToSparse(&weights, num_dense_);
-  const Graph& graph = *(graphs_[sentenceId]);
+  const Graph& graph = GetGraph(sentenceId);
 
   // ValType hope_scale = 1.0;
   HgHypothesis hopeHypo, fearHypo, modelHypo;
@@ -428,13 +542,17 @@ void HypergraphHopeFearDecoder::HopeFear(
 void HypergraphHopeFearDecoder::MaxModel(const AvgWeightVector& wv, vector<ValType>* stats)
 {
   assert(!finished());
+  MaxModelAt(*sentenceIdIter_, wv, stats);
+}
+
+void HypergraphHopeFearDecoder::MaxModelAt(size_t sentenceId, const AvgWeightVector& wv, vector<ValType>* stats) const
+{
   HgHypothesis bestHypo;
-  size_t sentenceId = *sentenceIdIter_;
   SparseVector weights;
   wv.ToSparse(&weights, num_dense_);
   vector<ValType> bg(scorer_->NumberOfScores());
   //cerr << "Calculating bleu on " << sentenceId << endl;
-  Viterbi(*(graphs_[sentenceId]), weights, 0, references_, sentenceId, bg, &bestHypo);
+  Viterbi(GetGraph(sentenceId), weights, 0, references_, sentenceId, bg, &bestHypo);
   stats->resize(bestHypo.bleuStats.size());
   /*
   for (size_t i = 0; i < bestHypo.text.size(); ++i) {
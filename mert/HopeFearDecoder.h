@@ -87,6 +87,27 @@ public:
   /** Calculate bleu on training set */
   ValType Evaluate(const AvgWeightVector& wv);
 
+  /**
+    * Number of sentences available by index to HopeFearAt() and MaxModelAt(),
+    * or 0 if the decoder can only be iterated.  The indexed methods do not
+    * move the iterator and may be called concurrently.
+    **/
+  virtual std::size_t NumSentences() const {
+    return 0;
+  }
+
+  /** Hope, fear and model hypotheses of the given sentence */
+  virtual void HopeFearAt(
+    std::size_t sentence,
+    const std::vector<ValType>& backgroundBleu,
+    const MiraWeightVector& wv,
+    HopeFearData* hopeFear
+  ) const;
+
+  /** Max score decoding of the given sentence */
+  virtual void MaxModelAt(std::size_t sentence, const AvgWeightVector& wv,
+                          std::vector<ValType>* stats) const;
+
 protected:
   Scorer* scorer_;
 };
@@ -116,8 +137,22 @@ public:
 
   virtual void MaxModel(const AvgWeightVector& wv, std::vector<ValType>* stats);
 
+  virtual std::size_t NumSentences() const;
+
+  virtual void HopeFearAt(
+    std::size_t sentence,
+    const std::vector<ValType>& backgroundBleu,
+    const MiraWeightVector& wv,
+    HopeFearData* hopeFear
+  ) const;
+
+  virtual void MaxModelAt(std::size_t sentence, const AvgWeightVector& wv,
+                          std::vector<ValType>* stats) const;
+
 private:
   boost::scoped_ptr<HypPackEnumerator> train_;
+  // Same object as train_ when not streaming, for random access
+  RandomAccessHypPackEnumerator* randomAccess_;
   bool safe_hope_;
 
 };
@@ -152,7 +187,21 @@ public:
 
   virtual void MaxModel(const AvgWeightVector& wv, std::vector<ValType>* stats);
 
+  virtual std::size_t NumSentences() const;
+
+  virtual void HopeFearAt(
+    std::size_t sentence,
+    const std::vector<ValType>& backgroundBleu,
+    const MiraWeightVector& wv,
+    HopeFearData* hopeFear
+  ) const;
+
+  virtual void MaxModelAt(std::size_t sentence, const AvgWeightVector& wv,
+                          std::vector<ValType>* stats) const;
+
 private:
+  const Graph& GetGraph(std::size_t sentenceId) const;
+
   size_t num_dense_;
   //maps sentence Id to graph ptr
   typedef std::map<size_t, boost::shared_ptr<Graph> > GraphColl;
@@ -95,6 +95,20 @@ public:
   virtual const MiraFeatureVector& featuresAt(std::size_t i);
   virtual const ScoreDataItem& scoresAt(std::size_t i);
 
+  // Random access by sentence, independent of the current position
+  std::size_t num_sentences() const {
+    return m_features.size();
+  }
+  std::size_t size(std::size_t sentence) const {
+    return m_features[sentence].size();
+  }
+  const MiraFeatureVector& featuresAt(std::size_t sentence, std::size_t i) const {
+    return m_features[sentence][i];
+  }
+  const ScoreDataItem& scoresAt(std::size_t sentence, std::size_t i) const {
+    return m_scores[sentence][i];
+  }
+
 private:
   bool m_no_shuffle;
   std::size_t m_cur_index;
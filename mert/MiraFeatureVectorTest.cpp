@@ -48,3 +48,29 @@ BOOST_AUTO_TEST_CASE(from_sparse)
   BOOST_CHECK_CLOSE(sp2.get("sparse2"), 0.1,1e-5);
 
 }
+
+BOOST_AUTO_TEST_CASE(mix_shards)
+{
+  std::vector<ValType> init(2, 1.0);
+  MiraWeightVector base(init);
+
+  // Shard 0 moves the first weight, shard 1 adds a new feature.
+  std::vector<MiraWeightVector> shards(2, base);
+  std::vector<ValType> dense(2, 0.0);
+  dense[0] = 2.0;
+  shards[0].update(MiraFeatureVector(dense, std::vector<size_t>(), std::vector<ValType>()), 1.0);
+  std::vector<size_t> feats(1, 2);
+  std::vector<ValType> vals(1, 4.0);
+  shards[1].update(MiraFeatureVector(std::vector<ValType>(2, 0.0), feats, vals), 1.0);
+
+  base.mix(shards);
+  MiraFeatureVector probe(std::vector<ValType>(2, 1.0), feats, std::vector<ValType>(1, 1.0));
+  // Mixed weights are (2, 1, 2)
+  BOOST_CHECK_CLOSE(base.score(probe), 5.0, 1e-5);
+  // Totals start at the initial weights and gain the weights after each
+  // update of either shard: ((1,1,0) + (3,1,0) + (1,1,4)) / 2
+  AvgWeightVector avg = base.avg();
+  BOOST_CHECK_CLOSE(avg.weight(0), 2.5, 1e-5);
+  BOOST_CHECK_CLOSE(avg.weight(1), 1.5, 1e-5);
+  BOOST_CHECK_CLOSE(avg.weight(2), 2.0, 1e-5);
+}
@@ -1,5 +1,6 @@
 #include "MiraWeightVector.h"
 
+#include <algorithm>
 #include <cmath>
 
 using namespace std;
@@ -74,6 +75,38 @@ AvgWeightVector MiraWeightVector::avg()
   return AvgWeightVector(*this);
 }
 
+/**
+ * Replace by the uniform mixture of shards trained from copies of this vector
+ */
+void MiraWeightVector::mix(vector<MiraWeightVector>& shards)
+{
+  if (shards.empty()) return;
+  fixTotals();
+  size_t size = m_weights.size();
+  for (size_t k = 0; k < shards.size(); ++k) {
+    shards[k].fixTotals();
+    size = max(size, shards[k].m_weights.size());
+  }
+  // Totals and update counts of the shards start out as ours, so add up
+  // what each shard gained on top.
+  vector<ValType> weights(size, 0.0);
+  vector<ValType> totals(m_totals);
+  totals.resize(size, 0.0);
+  size_t numUpdates = m_numUpdates;
+  for (size_t k = 0; k < shards.size(); ++k) {
+    const MiraWeightVector& shard = shards[k];
+    for (size_t i = 0; i < shard.m_weights.size(); ++i) {
+      weights[i] += shard.m_weights[i] / shards.size();
+      totals[i] += shard.m_totals[i] - (i < m_totals.size() ? m_totals[i] : 0.0);
+    }
+    numUpdates += shard.m_numUpdates - m_numUpdates;
+  }
+  m_weights.swap(weights);
+  m_totals.swap(totals);
+  m_numUpdates = numUpdates;
+  m_lastUpdated.assign(size, m_numUpdates);
+}
+
 /**
  * Updates a weight and lazily updates its total
  */
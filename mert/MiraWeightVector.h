@@ -63,6 +63,14 @@ public:
    */
   AvgWeightVector avg();
 
+  /**
+   * Iterative parameter mixing: replace this vector with the uniform mixture
+   * of shards, each trained from a copy of this vector on part of the data.
+   * The running average covers the updates of all shards.
+   * \param shards Weight vectors trained in parallel
+   */
+  void mix(std::vector<MiraWeightVector>& shards);
+
   /**
     * Convert to sparse vector, interpreting all features as sparse. Only used by hgmira.
    **/
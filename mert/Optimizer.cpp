@@ -1,5 +1,6 @@
 #include "Optimizer.h"
 
+#include <algorithm>
 #include <cmath>
 #include "util/exception.hh"
 #include <vector>
@@ -71,196 +72,169 @@ statscore_t Optimizer::GetStatScore(const Point& param) const
   return score;
 }
 
-map<float,diff_t >::iterator AddThreshold(map<float,diff_t >& thresholdmap, float newt, const pair<unsigned,unsigned>& newdiff)
+namespace
+{
+
+/**
+ * A change of 1-best: from x on, hypothesis best is the 1-best of sentence.
+ */
+struct Threshold {
+  float x;
+  unsigned sentence;
+  unsigned best;
+};
+
+inline bool ThresholdLess(const Threshold& a, const Threshold& b)
+{
+  return a.x < b.x;
+}
+
+/**
+ * Orders hypotheses by slope.
+ */
+class SlopeLess
 {
-  map<float,diff_t>::iterator it = thresholdmap.find(newt);
-  if (it != thresholdmap.end()) {
-    // the threshold already exists!! this is very unlikely
-    if (it->second.back().first == newdiff.first)
-      // there was already a diff for this sentence, we change the 1 best;
-      it->second.back().second = newdiff.second;
-    else
-      it->second.push_back(newdiff);
-  } else {
-    // normal case
-    pair<map<float,diff_t>::iterator, bool> ins = thresholdmap.insert(threshold(newt, diff_t(1, newdiff)));
-    UTIL_THROW_IF(!ins.second, util::Exception, "Error");                // we really inserted something
-    it = ins.first;
+public:
+  explicit SlopeLess(const vector<float>& slopes) : m_slopes(slopes) {}
+  bool operator()(unsigned a, unsigned b) const {
+    return m_slopes[a] < m_slopes[b];
+  }
+private:
+  const vector<float>& m_slopes;
+};
+
+/**
+ * Upper envelope of the lines y = slopes[j] * x + intercepts[j].  On return,
+ * hull holds the lines of the envelope from left to right and starts[k] is
+ * the x from which hull[k] is on top (MIN_FLOAT for hull[0]).  order is
+ * scratch space.
+ *
+ * Ties are broken like the former quadratic search did: among the lines
+ * with the lowest slope the first highest one is taken, and elsewhere the
+ * line with the higher slope wins when several cross at the same point.
+ */
+void UpperEnvelope(const vector<float>& slopes, const vector<float>& intercepts,
+                   vector<unsigned>& order, vector<unsigned>& hull, vector<float>& starts)
+{
+  order.resize(slopes.size());
+  for (unsigned j = 0; j < order.size(); ++j) order[j] = j;
+  stable_sort(order.begin(), order.end(), SlopeLess(slopes));
+
+  hull.clear();
+  starts.clear();
+  for (size_t k = 0; k < order.size(); ++k) {
+    const unsigned j = order[k];
+    if (!hull.empty() && slopes[hull.back()] == slopes[j]) {
+      // Parallel lines, only the highest one can be on top.
+      const float top = intercepts[hull.back()];
+      if (intercepts[j] < top || (intercepts[j] == top && hull.size() == 1))
+        continue;
+      hull.pop_back();
+      starts.pop_back();
+    }
+    float x = MIN_FLOAT;
+    while (!hull.empty()) {
+      x = intersect(slopes[hull.back()], intercepts[hull.back()], slopes[j], intercepts[j]);
+      if (hull.size() == 1 || x > starts.back())
+        break;
+      // The new line overtakes the top one before the top one gets on top.
+      hull.pop_back();
+      starts.pop_back();
+    }
+    hull.push_back(j);
+    starts.push_back(x);
   }
-  return it;
 }
 
+} // namespace
+
 statscore_t Optimizer::LineOptimize(const Point& origin, const Point& direction, Point& bestpoint) const
 {
   // We are looking for the best Point on the line y=Origin+x*direction
   float min_int = 0.0001;
-  //typedef pair<unsigned,unsigned> diff;//first the sentence that changes, second is the new 1best for this sentence
-  //list<threshold> thresholdlist;
 
-  map<float,diff_t> thresholdmap;
-  thresholdmap[MIN_FLOAT] = diff_t();
+  // Each hypothesis is a line: its model score is f0 + x * gradient.
+  // Scratch arrays are reused across sentences.
+  vector<float> gradient, f0, starts;
+  vector<unsigned> order, hull;
+  vector<Threshold> thresholds;
   vector<unsigned> first1best;       // the vector of nbests for x=-inf
+  first1best.reserve(size());
   for (unsigned int S = 0; S < size(); S++) {
-    map<float,diff_t >::iterator previnserted = thresholdmap.begin();
-    // First, we determine the translation with the best feature score
-    // for each sentence and each value of x.
-    //cerr << "Sentence " << S << endl;
-    multimap<float, unsigned> gradient;
-    vector<float> f0;
-    f0.resize(m_feature_data->get(S).size());
-    for (unsigned j = 0; j < m_feature_data->get(S).size(); j++) {
+    const FeatureArray& nbest = m_feature_data->get(S);
+    gradient.resize(nbest.size());
+    f0.resize(nbest.size());
+    for (unsigned j = 0; j < nbest.size(); j++) {
       // gradient of the feature function for this particular target sentence
-      gradient.insert(pair<float, unsigned>(direction * (m_feature_data->get(S,j)), j));
+      gradient[j] = direction * nbest.get(j);
       // compute the feature function at the origin point
-      f0[j] = origin * m_feature_data->get(S, j);
-    }
-    // Now let's compute the 1best for each value of x.
-
-    //    vector<pair<float,unsigned> > onebest;
-
-
-    multimap<float,unsigned>::iterator gradientit = gradient.begin();
-    multimap<float,unsigned>::iterator highest_f0 = gradient.begin();
-
-    float smallest = gradientit->first;//smallest gradient
-    // Several candidates can have the lowest slope (e.g., for word penalty where the gradient is an integer).
-
-    gradientit++;
-    while (gradientit != gradient.end() && gradientit->first == smallest) {
-      //   cerr<<"ni"<<gradientit->second<<endl;;
-      //cerr<<"fos"<<f0[gradientit->second]<<" "<<f0[index]<<" "<<index<<endl;
-      if (f0[gradientit->second] > f0[highest_f0->second])
-        highest_f0 = gradientit;//the highest line is the one with he highest f0
-      gradientit++;
+      f0[j] = origin * nbest.get(j);
     }
 
-    gradientit = highest_f0;
-    first1best.push_back(highest_f0->second);
-
-    // Now we look for the intersections points indicating a change of 1 best.
-    // We use the fact that the function is convex, which means that the gradient can only go up.
-    while (gradientit != gradient.end()) {
-      map<float,unsigned>::iterator leftmost = gradientit;
-      float m = gradientit->first;
-      float b = f0[gradientit->second];
-      multimap<float,unsigned>::iterator gradientit2 = gradientit;
-      gradientit2++;
-      float leftmostx = MAX_FLOAT;
-      for (; gradientit2 != gradient.end(); gradientit2++) {
-        //cerr<<"--"<<d++<<' '<<gradientit2->first<<' '<<gradientit2->second<<endl;
-        // Look for all candidate with a gradient bigger than the current one, and
-        // find the one with the leftmost intersection.
-        float curintersect;
-        if (m != gradientit2->first) {
-          curintersect = intersect(m, b, gradientit2->first, f0[gradientit2->second]);
-          //cerr << "curintersect: " << curintersect << " leftmostx: " << leftmostx << endl;
-          if (curintersect<=leftmostx) {
-            // We have found an intersection to the left of the leftmost we had so far.
-            // We might have curintersect==leftmostx for example is 2 candidates are the same
-            // in that case its better its better to update leftmost to gradientit2 to avoid some recomputing later.
-            leftmostx = curintersect;
-            leftmost = gradientit2; // this is the new reference
-          }
-        }
-      }
-      if (leftmost == gradientit) {
-        // We didn't find any more intersections.
-        // The rightmost bestindex is the one with the highest slope.
-
-        // They should be equal but there might be.
-        UTIL_THROW_IF(abs(leftmost->first-gradient.rbegin()->first) >= 0.0001,
-                      util::Exception, "Error");
-        // A small difference due to rounding error
-        break;
-      }
-      // We have found the next intersection!
+    // The 1best for each value of x changes at the corners of the envelope.
+    UpperEnvelope(gradient, f0, order, hull, starts);
+    first1best.push_back(hull[0]);
 
-      pair<unsigned,unsigned> newd(S, leftmost->second);//new onebest for Sentence S is leftmost->second
-
-      if (leftmostx-previnserted->first < min_int) {
+    size_t previnserted = thresholds.size();
+    for (size_t k = 1; k < hull.size(); ++k) {
+      if (previnserted < thresholds.size() && starts[k] - thresholds[previnserted].x < min_int) {
         // Require that the intersection Point be at least min_int to the right of the previous
         // one (for this sentence). If not, we replace the previous intersection Point with
-        // this one.
-        // Yes, it can even happen that the new intersection Point is slightly to the left of
-        // the old one, because of numerical imprecision. We do not check that we are to the
-        // right of the penultimate point also. It this happen the 1best the interval will
-        // be wrong we are going to replace previnsert by the new one because we do not want to keep
-        // 2 very close threshold: if the minima is there it could be an artifact.
-
-        map<float,diff_t>::iterator tit = thresholdmap.find(leftmostx);
-        if (tit == previnserted) {
-          // The threshold is the same as before can happen if 2 candidates are the same for example.
-          UTIL_THROW_IF(previnserted->second.back().first != newd.first,
-                        util::Exception,
-                        "Error");
-          previnserted->second.back()=newd; // just replace the 1 best for sentence S
-          // previnsert doesn't change
-        } else {
-
-          if (tit == thresholdmap.end()) {
-            thresholdmap[leftmostx]=previnserted->second; // We keep the diffs at previnsert
-            thresholdmap.erase(previnserted); // erase old previnsert
-            previnserted = thresholdmap.find(leftmostx); // point previnsert to the new threshold
-            previnserted->second.back()=newd; // We update the diff for sentence S
-            // Threshold already exists but is not the previous one.
-          } else {
-            // We append the diffs in previnsert to tit before destroying previnsert.
-            tit->second.insert(tit->second.end(),previnserted->second.begin(),previnserted->second.end());
-            UTIL_THROW_IF(tit->second.back().first != newd.first,
-                          util::Exception,
-                          "Error");
-            tit->second.back()=newd;    // change diff for sentence S
-            thresholdmap.erase(previnserted); // erase old previnsert
-            previnserted = tit;  // point previnsert to the new threshold
-          }
-        }
-
-        UTIL_THROW_IF(previnserted == thresholdmap.end(),
-                      util::Exception,
-                      "Error");
-      } else { //normal insertion process
-        previnserted = AddThreshold(thresholdmap, leftmostx, newd);
+        // this one: we do not want to keep 2 very close thresholds, if the minimum is there
+        // it could be an artifact.
+        thresholds[previnserted].x = starts[k];
+        thresholds[previnserted].best = hull[k];
+      } else {
+        previnserted = thresholds.size();
+        Threshold t = {starts[k], S, hull[k]};
+        thresholds.push_back(t);
       }
-      gradientit = leftmost;
-    } // while (gradientit!=gradient.end()){
-  }   // loop on S
+    }
+  }
 
-  // Now the thresholdlist is up to date: it contains a list of all the parameter_ts where
+  // Merge the thresholds of all sentences into one sweep; the diffs at each
+  // point stay in sentence order.
+  stable_sort(thresholds.begin(), thresholds.end(), ThresholdLess);
+  vector<float> thresholdx(1, MIN_FLOAT);
+  diffs_t diffs;
+  for (size_t i = 0; i < thresholds.size(); ++i) {
+    if (i == 0 || thresholds[i].x != thresholds[i - 1].x) {
+      thresholdx.push_back(thresholds[i].x);
+      diffs.push_back(diff_t());
+    }
+    diffs.back().push_back(make_pair(thresholds[i].sentence, thresholds[i].best));
+  }
+
+  // Now the thresholds are up to date: a list of all the parameter_ts where
   // the function changed its value, along with the nbest list for the interval after each threshold.
 
-  map<float,diff_t >::iterator thrit;
   if (verboselevel() > 6) {
-    cerr << "Thresholds:(" << thresholdmap.size() << ")" << endl;
-    for (thrit = thresholdmap.begin(); thrit != thresholdmap.end(); thrit++) {
-      cerr << "x: " << thrit->first << " diffs";
-      for (size_t j = 0; j < thrit->second.size(); ++j) {
-        cerr << " " <<thrit->second[j].first << "," << thrit->second[j].second;
+    cerr << "Thresholds:(" << thresholdx.size() << ")" << endl;
+    cerr << "x: " << thresholdx[0] << " diffs" << endl;
+    for (size_t i = 0; i < diffs.size(); ++i) {
+      cerr << "x: " << thresholdx[i + 1] << " diffs";
+      for (size_t j = 0; j < diffs[i].size(); ++j) {
+        cerr << " " << diffs[i][j].first << "," << diffs[i][j].second;
       }
       cerr << endl;
     }
   }
 
   // Last thing to do is compute the Stat score (i.e., BLEU) and find the minimum.
-  thrit = thresholdmap.begin();
-  ++thrit;       // first diff corrrespond to MIN_FLOAT and first1best
-  diffs_t diffs;
-  for (; thrit != thresholdmap.end(); thrit++)
-    diffs.push_back(thrit->second);
+  // The first score corresponds to MIN_FLOAT and first1best.
   vector<statscore_t> scores = GetIncStatScore(first1best, diffs);
 
-  thrit = thresholdmap.begin();
   statscore_t bestscore = MIN_FLOAT;
   float bestx = MIN_FLOAT;
 
-  // We skipped the first el of thresholdlist but GetIncStatScore return 1 more for first1best.
-  UTIL_THROW_IF(scores.size() != thresholdmap.size(),
+  UTIL_THROW_IF(scores.size() != thresholdx.size(),
                 util::Exception,
                 "Error");
   for (unsigned int sc = 0; sc != scores.size(); sc++) {
-    //cerr << "x=" << thrit->first << " => " << scores[sc] << endl;
+    //cerr << "x=" << thresholdx[sc] << " => " << scores[sc] << endl;
 
     //enforce positivity
-    Point respoint = origin + direction * thrit->first;
+    Point respoint = origin + direction * thresholdx[sc];
     bool is_valid = true;
     for (unsigned int k=0; k < respoint.getdim(); k++) {
       if (m_positive[k] && respoint[k] <= 0.0)
@@ -268,9 +242,9 @@ statscore_t Optimizer::LineOptimize(const Point& origin, const Point& direction,
     }
 
     if (is_valid && scores[sc] > bestscore) {
-      // This is the score for the interval [lit2->first, (lit2+1)->first]
+      // This is the score for the interval [thresholdx[sc], thresholdx[sc+1]]
       // unless we're at the last score, when it's the score
-      // for the interval [lit2->first,+inf].
+      // for the interval [thresholdx[sc],+inf].
       bestscore = scores[sc];
 
       // If we're not in [-inf,x1] or [xn,+inf], then just take the value
@@ -278,16 +252,8 @@ statscore_t Optimizer::LineOptimize(const Point& origin, const Point& direction,
       // take x to be the last interval boundary + 0.1, and for the leftmost
       // interval, take x to be the first interval boundary - 1000.
       // These values are taken from cmert.
-      float leftx = thrit->first;
-      if (thrit == thresholdmap.begin()) {
-        leftx = MIN_FLOAT;
-      }
-      ++thrit;
-      float rightx = MAX_FLOAT;
-      if (thrit != thresholdmap.end()) {
-        rightx = thrit->first;
-      }
-      --thrit;
+      float leftx = sc == 0 ? MIN_FLOAT : thresholdx[sc];
+      float rightx = sc + 1 < thresholdx.size() ? thresholdx[sc + 1] : MAX_FLOAT;
       //cerr << "leftx: " << leftx << " rightx: " << rightx << endl;
       if (leftx == MIN_FLOAT) {
         bestx = rightx-1000;
@@ -298,7 +264,6 @@ statscore_t Optimizer::LineOptimize(const Point& origin, const Point& direction,
       }
       //cerr << "x = " << "set new bestx to: " << bestx << endl;
     }
-    ++thrit;
   }
 
   if (abs(bestx) < 0.00015) {
@@ -63,7 +63,7 @@ void PerScorer::prepareStats(size_t sid, const string& text, ScoreStats& entry)
   // Calculate correct, output_length and ref_length for
   // the line and store it in entry
   vector<int> testtokens;
-  TokenizeAndEncode(sentence, testtokens);
+  TokenizeAndEncodeHypothesis(sentence, testtokens);
   multiset<int> testtokens_all(testtokens.begin(),testtokens.end());
   set<int> testtokens_unique(testtokens.begin(),testtokens.end());
   int correct = 0;
@@ -27,6 +27,9 @@ public:
 
   virtual void setReferenceFiles(const std::vector<std::string>& referenceFiles);
   virtual void prepareStats(std::size_t sid, const std::string& text, ScoreStats& entry);
+  virtual bool isThreadSafe() const {
+    return !hasFilter();
+  }
   virtual std::size_t NumberOfScores() const {
     return 3;
   }
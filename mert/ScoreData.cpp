@@ -10,6 +10,8 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include "ColumnarData.h"
 #include "Scorer.h"
 #include "Util.h"
 #include "FileStream.h"
@@ -74,6 +76,22 @@ void ScoreData::load(istream* is)
 
 void ScoreData::load(const string &file)
 {
+  if (ColumnarData::IsColumnar(file)) {
+    ColumnarData columnar(file);
+    if (columnar.ScoreType() != m_score_type || columnar.NumberOfScores() != m_num_scores) {
+      ostringstream msg;
+      msg << "Score file " << file << " holds " << columnar.NumberOfScores() << " "
+          << columnar.ScoreType() << " statistics, expected " << m_num_scores << " "
+          << m_score_type;
+      throw runtime_error(msg.str());
+    }
+    ScoreArray entry;
+    for (size_t s = 0; s < columnar.NumberOfSentences(); ++s) {
+      columnar.GetScoreArray(s, entry);
+      add(entry);
+    }
+    return;
+  }
   TRACE_ERR("loading score data from " << file << endl);
   inputfilestream input_stream(file); // matches a stream with a file. Opens the file
   if (!input_stream) {
@@ -69,6 +69,9 @@ private:
   void readNext();
 
   boost::shared_ptr<util::FilePiece> m_in;
+  // Set instead of m_in when reading a columnar file.
+  boost::shared_ptr<ColumnarData> m_columnar;
+  std::size_t m_sentence;
   std::vector<ScoreDataItem> m_next;
 };
 
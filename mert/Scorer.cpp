@@ -1,6 +1,7 @@
 #include "Scorer.h"
 
 #include <limits>
+#include <map>
 #include "Vocabulary.h"
 #include "Util.h"
 #include "Singleton.h"
@@ -108,6 +109,38 @@ void Scorer::TokenizeAndEncodeTesting(const string& line, vector<int>& encoded)
   }
 }
 
+void Scorer::TokenizeAndEncodeHypothesis(const string& line, vector<int>& encoded) const
+{
+  // ids of the tokens of line that are not in the vocabulary
+  map<string, int> unknown;
+  for (util::TokenIter<util::AnyCharacter, true> it(line, util::AnyCharacter(" "));
+       it; ++it) {
+    string token = it->as_string();
+    if (!m_enable_preserve_case) {
+      for (std::string::iterator sit = token.begin();
+           sit != token.end(); ++sit) {
+        *sit = tolower(*sit);
+      }
+    }
+    mert::Vocabulary::const_iterator cit = m_vocab->find(token);
+    if (cit != m_vocab->end()) {
+      encoded.push_back(cit->second);
+    } else {
+      const int id = static_cast<int>(m_vocab->size() + unknown.size());
+      encoded.push_back(unknown.insert(make_pair(token, id)).first->second);
+    }
+  }
+}
+
+bool Scorer::hasFilter() const
+{
+#if defined(__GLIBCXX__) || defined(__GLIBCPP__)
+  return m_filter != NULL;
+#else
+  return false;
+#endif
+}
+
 /**
  * Set the factors, which should be used for this metric
  */
@@ -130,6 +130,16 @@ public:
     return false;
   };
 
+  /**
+   * Whether prepareStats() may be called from several threads at once, once
+   * the references are set, so that the threads can share this scorer and
+   * its references.  Scorers with state (filters, external processes) must
+   * not be shared.
+   */
+  virtual bool isThreadSafe() const {
+    return false;
+  }
+
   /**
    * Set the factors, which should be used for this metric
    */
@@ -193,6 +203,19 @@ protected:
    */
   void TokenizeAndEncodeTesting(const std::string& line, std::vector<int>& encoded) const;
 
+  /**
+   * Tokenise and encode a hypothesis without adding to the vocabulary, so
+   * that several threads can do it at once.  Tokens that are not in the
+   * vocabulary get ids past it, which are only valid within line: they
+   * differ from every reference token and equal tokens get equal ids.
+   */
+  void TokenizeAndEncodeHypothesis(const std::string& line, std::vector<int>& encoded) const;
+
+  /**
+   * Whether sentences are preprocessed with a filter (see setFilter()).
+   */
+  bool hasFilter() const;
+
   /**
    * Every inherited scorer should call this function for each sentence
    */
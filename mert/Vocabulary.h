@@ -22,7 +22,12 @@ public:
   Vocabulary() {}
   virtual ~Vocabulary() {}
 
-  /** Returns the assiged id for given "token". */
+  /**
+   * Returns the assiged id for given "token".
+   * Adds new tokens, so it must not run concurrently with anything else;
+   * scorers only call it while loading references, and lookups from several
+   * threads are safe after that.
+   */
   int Encode(const std::string& token);
 
   /**
@@ -9,9 +9,10 @@
 #include <vector>
 
 #include <getopt.h>
-#include <boost/scoped_ptr.hpp>
 
+#include "ColumnarData.h"
 #include "Data.h"
+#include "ScopedVector.h"
 #include "Scorer.h"
 #include "ScorerFactory.h"
 #include "Timer.h"
@@ -34,11 +35,15 @@ void usage()
   cerr << "[--nbest|-n] the nbest file" << endl;
   cerr << "[--scfile|-S] the scorer data output file" << endl;
   cerr << "[--ffile|-F] the feature data output file" << endl;
+  cerr << "[--columnar|-C] append features and scores to this columnar file instead" << endl;
   cerr << "[--prev-ffile|-E] comma separated list of previous feature data" << endl;
   cerr << "[--prev-scfile|-R] comma separated list of previous scorer data" << endl;
   cerr << "[--factors|-f] list of factors passed to the scorer (e.g. 0|2)" << endl;
   cerr << "[--filter|-l] filter command used to preprocess the sentences" << endl;
   cerr << "[--allow-duplicates|-d] omit the duplicate removal step" << endl;
+#ifdef WITH_THREADS
+  cerr << "[--threads|-T] score the nbest file with multiple threads (default 1)" << endl;
+#endif
   cerr << "[-v] verbose level" << endl;
   cerr << "[--help|-h] print this message and exit" << endl;
   exit(1);
@@ -54,11 +59,15 @@ static struct option long_options[] = {
   {"nbest", required_argument, 0, 'n'},
   {"scfile", required_argument, 0, 'S'},
   {"ffile", required_argument, 0, 'F'},
+  {"columnar", required_argument, 0, 'C'},
   {"prev-scfile", required_argument, 0, 'R'},
   {"prev-ffile", required_argument, 0, 'E'},
   {"verbose", required_argument, 0, 'v'},
   {"help", no_argument, 0, 'h'},
   {"allow-duplicates", no_argument, 0, 'd'},
+#ifdef WITH_THREADS
+  {"threads", required_argument, 0, 'T'},
+#endif
   {0, 0, 0, 0}
 };
 
@@ -72,11 +81,13 @@ struct ProgramOption {
   string nbestFile;
   string scoreDataFile;
   string featureDataFile;
+  string columnarFile;
   string prevScoreDataFile;
   string prevFeatureDataFile;
   bool binmode;
   bool allowDuplicates;
   int verbosity;
+  size_t numThreads;
 
   ProgramOption()
     : scorerType("BLEU"),
@@ -87,11 +98,13 @@ struct ProgramOption {
       nbestFile(""),
       scoreDataFile("statscore.data"),
       featureDataFile("features.data"),
+      columnarFile(""),
       prevScoreDataFile(""),
       prevFeatureDataFile(""),
       binmode(false),
       allowDuplicates(false),
-      verbosity(0) { }
+      verbosity(0),
+      numThreads(1) { }
 };
 
 void ParseCommandOptions(int argc, char** argv, ProgramOption* opt)
@@ -99,7 +112,7 @@ void ParseCommandOptions(int argc, char** argv, ProgramOption* opt)
   int c;
   int option_index;
 
-  while ((c = getopt_long(argc, argv, "s:r:f:l:n:S:F:R:E:v:hbd", long_options, &option_index)) != -1) {
+  while ((c = getopt_long(argc, argv, "s:r:f:l:n:S:F:C:R:E:v:T:hbd", long_options, &option_index)) != -1) {
     switch (c) {
     case 's':
       opt->scorerType = string(optarg);
@@ -128,6 +141,9 @@ void ParseCommandOptions(int argc, char** argv, ProgramOption* opt)
     case 'F':
       opt->featureDataFile = string(optarg);
       break;
+    case 'C':
+      opt->columnarFile = string(optarg);
+      break;
     case 'E':
       opt->prevFeatureDataFile = string(optarg);
       break;
@@ -140,6 +156,15 @@ void ParseCommandOptions(int argc, char** argv, ProgramOption* opt)
     case 'd':
       opt->allowDuplicates = true;
       break;
+    case 'T': {
+      const int threads = atoi(optarg);
+      if (threads < 1) {
+        cerr << "Error: the number of threads must be positive" << endl;
+        usage();
+      }
+      opt->numThreads = threads;
+      break;
+    }
     default:
       usage();
     }
@@ -195,6 +220,11 @@ int main(int argc, char** argv)
       throw runtime_error("Error: there is a different number of previous score and feature files");
     }
 
+    // the columnar file keeps the previous data itself
+    if (!option.columnarFile.empty() && !prevScoreDataFiles.empty()) {
+      throw runtime_error("Error: previous score and feature files can not be used with a columnar file");
+    }
+
     if (option.binmode) {
       cerr << "Binary write mode is selected" << endl;
     } else {
@@ -203,20 +233,30 @@ int main(int argc, char** argv)
 
     TRACE_ERR("Scorer type: " << option.scorerType << endl);
 
-    boost::scoped_ptr<Scorer> scorer(
-      ScorerFactory::getScorer(option.scorerType, option.scorerConfig));
-
-    // set Factors and Filter used to preprocess the sentences
-    scorer->setFactors(option.scorerFactors);
-    scorer->setFilter(option.scorerFilter);
-
-    // load references
-    if (referenceFiles.size() > 0)
-      scorer->setReferenceFiles(referenceFiles);
+    // The threads share one scorer and its references if it is thread safe.
+    // Otherwise (filters, external processes) each thread gets its own,
+    // set up the same way.
+    ScopedVector<Scorer> scorers;
+    for (size_t i = 0; i < option.numThreads; ++i) {
+      if (i > 0 && scorers[0]->isThreadSafe()) break;
+      Scorer* scorer = ScorerFactory::getScorer(option.scorerType, option.scorerConfig);
+      scorers.push_back(scorer);
+
+      // set Factors and Filter used to preprocess the sentences
+      scorer->setFactors(option.scorerFactors);
+      scorer->setFilter(option.scorerFilter);
+
+      // load references
+      if (referenceFiles.size() > 0)
+        scorer->setReferenceFiles(referenceFiles);
+    }
+    Scorer* scorer = scorers[0];
+    vector<Scorer*> threadScorers(scorers.get());
+    threadScorers.resize(option.numThreads, scorer);
 
 //    PrintUserTime("References loaded");
 
-    Data data(scorer.get());
+    Data data(scorer);
 
     // load old data
     for (size_t i = 0; i < prevScoreDataFiles.size(); i++) {
@@ -227,7 +267,11 @@ int main(int argc, char** argv)
 
     // computing score statistics of each nbest file
     for (size_t i = 0; i < nbestFiles.size(); i++) {
-      data.loadNBest(nbestFiles.at(i));
+      if (option.numThreads > 1) {
+        data.loadNBestParallel(nbestFiles.at(i), threadScorers);
+      } else {
+        data.loadNBest(nbestFiles.at(i));
+      }
     }
 
 //    PrintUserTime("Nbest entries loaded and scored");
@@ -238,7 +282,12 @@ int main(int argc, char** argv)
     }
     //END_ADDED
 
-    data.save(option.featureDataFile, option.scoreDataFile, option.binmode);
+    if (!option.columnarFile.empty()) {
+      // candidates also found in earlier iterations are dropped on reading
+      ColumnarData::Append(option.columnarFile, *data.getFeatureData(), *data.getScoreData());
+    } else {
+      data.save(option.featureDataFile, option.scoreDataFile, option.binmode);
+    }
     PrintUserTime("Stopping...");
 
     return EXIT_SUCCESS;
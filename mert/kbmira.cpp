@@ -38,6 +38,7 @@ de recherches du Canada
 
 #include <boost/program_options.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include "util/exception.hh"
 #include "util/random.hh"
@@ -49,12 +50,178 @@ de recherches du Canada
 
 #include "Scorer.h"
 #include "ScorerFactory.h"
+#include "moses/ThreadPool.h"
 
 using namespace std;
 using namespace MosesTuning;
 
 namespace po = boost::program_options;
 
+namespace
+{
+
+struct MiraOptions {
+  float c;         // Step-size cap C
+  float decay;     // Pseudo-corpus decay \gamma
+  bool model_bg;   // Use model for background corpus
+  bool verbose;    // Verbose updates
+};
+
+struct EpochStats {
+  EpochStats() : numExamples(0), numUpdates(0), totalLoss(0) {}
+  int numExamples;
+  int numUpdates;
+  ValType totalLoss;
+};
+
+// One MIRA step on a hope/fear pair, updating the weights and the
+// background BLEU statistics
+void MiraUpdate(const HopeFearData& hfd, size_t sentenceIndex, const MiraOptions& opt,
+                MiraWeightVector& wv, vector<ValType>& bg, EpochStats& stats)
+{
+  if (!hfd.hopeFearEqual && hfd.hopeBleu  > hfd.fearBleu) {
+    // Vector difference
+    MiraFeatureVector diff = hfd.hopeFeatures - hfd.fearFeatures;
+    // Bleu difference
+    //assert(hfd.hopeBleu + 1e-8 >= hfd.fearBleu);
+    ValType delta = hfd.hopeBleu - hfd.fearBleu;
+    // Loss and update
+    ValType diff_score = wv.score(diff);
+    ValType loss = delta - diff_score;
+    if(opt.verbose) {
+      cerr << "Updating sent " << sentenceIndex << endl;
+      cerr << "Wght: " << wv << endl;
+      cerr << "Hope: " << hfd.hopeFeatures << " BLEU:" << hfd.hopeBleu << " Score:" << wv.score(hfd.hopeFeatures) << endl;
+      cerr << "Fear: " << hfd.fearFeatures << " BLEU:" << hfd.fearBleu << " Score:" << wv.score(hfd.fearFeatures) << endl;
+      cerr << "Diff: " << diff << " BLEU:" << delta << " Score:" << diff_score << endl;
+      cerr << "Loss: " << loss <<  " Scale: " << 1 << endl;
+      cerr << endl;
+    }
+    if(loss > 0) {
+      ValType eta = min(opt.c, loss / diff.sqrNorm());
+      wv.update(diff,eta);
+      stats.totalLoss+=loss;
+      stats.numUpdates++;
+    }
+    // Update BLEU statistics
+    for(size_t k=0; k<bg.size(); k++) {
+      bg[k]*=opt.decay;
+      if(opt.model_bg)
+        bg[k]+=hfd.modelStats[k];
+      else
+        bg[k]+=hfd.hopeStats[k];
+    }
+  }
+  stats.numExamples++;
+}
+
+// Trains a private copy of the weights and background on a shard of the
+// sentences, for iterative parameter mixing
+class MiraShardTask : public Moses::Task
+{
+public:
+  MiraShardTask(const HopeFearDecoder& decoder, const MiraOptions& opt,
+                const MiraWeightVector& wv, const vector<ValType>& bg,
+                vector<size_t>::const_iterator begin, vector<size_t>::const_iterator end)
+    : m_decoder(decoder), m_opt(opt), m_wv(wv), m_bg(bg), m_sentences(begin, end) {}
+
+  virtual void Run() {
+    for (size_t i = 0; i < m_sentences.size(); ++i) {
+      HopeFearData hfd;
+      m_decoder.HopeFearAt(m_sentences[i], m_bg, m_wv, &hfd);
+      MiraUpdate(hfd, m_sentences[i], m_opt, m_wv, m_bg, m_stats);
+    }
+  }
+
+  virtual bool DeleteAfterExecution() {
+    return false;
+  }
+
+  const MiraWeightVector& GetWeights() const {
+    return m_wv;
+  }
+  const vector<ValType>& GetBackground() const {
+    return m_bg;
+  }
+  const EpochStats& GetStats() const {
+    return m_stats;
+  }
+
+private:
+  const HopeFearDecoder& m_decoder;
+  const MiraOptions& m_opt;
+  MiraWeightVector m_wv;
+  vector<ValType> m_bg;
+  vector<size_t> m_sentences;
+  EpochStats m_stats;
+};
+
+// Sums the model-best statistics of a range of sentences
+class EvaluateTask : public Moses::Task
+{
+public:
+  EvaluateTask(const HopeFearDecoder& decoder, const AvgWeightVector& wv,
+               size_t numScores, size_t begin, size_t end)
+    : m_decoder(decoder), m_wv(wv), m_stats(numScores, 0), m_begin(begin), m_end(end) {}
+
+  virtual void Run() {
+    vector<ValType> sent;
+    for (size_t s = m_begin; s < m_end; ++s) {
+      m_decoder.MaxModelAt(s, m_wv, &sent);
+      for (size_t i = 0; i < sent.size(); ++i) m_stats[i] += sent[i];
+    }
+  }
+
+  virtual bool DeleteAfterExecution() {
+    return false;
+  }
+
+  const vector<ValType>& GetStats() const {
+    return m_stats;
+  }
+
+private:
+  const HopeFearDecoder& m_decoder;
+  const AvgWeightVector& m_wv;
+  vector<ValType> m_stats;
+  size_t m_begin, m_end;
+};
+
+void RunTasks(const vector<boost::shared_ptr<Moses::Task> >& tasks, size_t threads)
+{
+#ifdef WITH_THREADS
+  Moses::ThreadPool pool(threads);
+  for (size_t i = 0; i < tasks.size(); ++i) pool.Submit(tasks[i]);
+  pool.Stop(true);
+#else
+  for (size_t i = 0; i < tasks.size(); ++i) tasks[i]->Run();
+#endif
+}
+
+// Bleu on the training set, evaluating shards of the sentences concurrently.
+// Statistics are added up in sentence order, whatever the thread count.
+ValType ParallelEvaluate(const HopeFearDecoder& decoder, const Scorer& scorer,
+                         const AvgWeightVector& wv, size_t shards, size_t threads)
+{
+  const size_t size = decoder.NumSentences();
+  vector<boost::shared_ptr<Moses::Task> > tasks;
+  vector<EvaluateTask*> evaluators;
+  for (size_t k = 0; k < shards; ++k) {
+    EvaluateTask* task = new EvaluateTask(decoder, wv, scorer.NumberOfScores(),
+                                          size * k / shards, size * (k + 1) / shards);
+    evaluators.push_back(task);
+    tasks.push_back(boost::shared_ptr<Moses::Task>(task));
+  }
+  RunTasks(tasks, threads);
+  vector<ValType> stats(scorer.NumberOfScores(), 0);
+  for (size_t k = 0; k < evaluators.size(); ++k) {
+    for (size_t i = 0; i < stats.size(); ++i) stats[i] += evaluators[k]->GetStats()[i];
+  }
+  return scorer.calculateScore(stats);
+}
+
+} // namespace
+
 int main(int argc, char** argv)
 {
   bool help;
@@ -79,6 +246,8 @@ int main(int argc, char** argv)
   bool verbose = false; // Verbose updates
   bool safe_hope = false; // Model score cannot have more than BLEU_RATIO times more influence than BLEU
   size_t hgPruning = 50; //prune hypergraphs to have this many edges per reference word
+  size_t threads = 1; // Worker threads for parallel training
+  size_t shards = 0; // Sentence shards for parallel training, 0 means one per thread
 
   // Command-line processing follows pro.cpp
   po::options_description desc("Allowed options");
@@ -105,6 +274,10 @@ int main(int argc, char** argv)
   ("verbose", po::value(&verbose)->zero_tokens()->default_value(false), "Verbose updates")
   ("safe-hope", po::value(&safe_hope)->zero_tokens()->default_value(false), "Mode score's influence on hope decoding is limited")
   ("hg-prune", po::value<size_t>(&hgPruning), "Prune hypergraphs to have this many edges per reference word")
+#ifdef WITH_THREADS
+  ("threads,T", po::value<size_t>(&threads), "Train shards of the sentences on this many threads, mixing their weights after each epoch (default 1)")
+#endif
+  ("shards", po::value<size_t>(&shards), "Number of sentence shards for parallel training (default: one per thread). Results depend on the seed and the shard count only, not on the thread count")
   ;
 
   po::options_description cmdline_options;
@@ -121,7 +294,18 @@ int main(int argc, char** argv)
 
   cerr << "kbmira with c=" << c << " decay=" << decay << " no_shuffle=" << no_shuffle << endl;
 
-  if (vm.count("random-seed")) {
+  if (threads == 0) threads = 1;
+  if (shards == 0) shards = threads;
+  const bool parallel = shards > 1;
+  if (parallel) {
+    UTIL_THROW_IF(streaming, util::Exception, "Parallel training needs the n-best lists in memory, drop --streaming");
+    UTIL_THROW_IF(streaming_out, util::Exception, "--streaming-out is not supported with parallel training");
+    cerr << "Training " << shards << " shards on " << threads << " threads" << endl;
+  }
+
+  if (vm.count("random-seed") || parallel) {
+    // Parallel runs are reproducible unless a seed is given
+    if (!vm.count("random-seed")) seed = 0;
     cerr << "Initialising random seed to " << seed << endl;
     util::rand_init(seed);
   } else {
@@ -152,67 +336,68 @@ int main(int argc, char** argv)
     UTIL_THROW(util::Exception, "Unknown batch mira type: '" << type << "'");
   }
 
+  if (parallel) {
+    UTIL_THROW_IF(decoder->NumSentences() < shards, util::Exception,
+                  "Cannot split " << decoder->NumSentences() << " sentences into " << shards << " shards");
+  }
+  MiraOptions opt;
+  opt.c = c;
+  opt.decay = decay;
+  opt.model_bg = model_bg;
+  opt.verbose = verbose;
+
   // Training loop
   if (!streaming_out)
-    cerr << "Initial BLEU = " << decoder->Evaluate(wv->avg()) << endl;
+    cerr << "Initial BLEU = " << (parallel ? ParallelEvaluate(*decoder, *scorer, wv->avg(), shards, threads) : decoder->Evaluate(wv->avg())) << endl;
   ValType bestBleu = 0;
+  vector<size_t> order(decoder->NumSentences());
+  for (size_t i = 0; i < order.size(); ++i) order[i] = i;
   for(int j=0; j<n_iters; j++) {
     // MIRA train for one epoch
-    int iNumExamples = 0;
-    int iNumUpdates = 0;
-    ValType totalLoss = 0.0;
-    size_t sentenceIndex = 0;
-    for(decoder->reset(); !decoder->finished(); decoder->next()) {
-      HopeFearData hfd;
-      decoder->HopeFear(bg,*wv,&hfd);
-
-      // Update weights
-      if (!hfd.hopeFearEqual && hfd.hopeBleu  > hfd.fearBleu) {
-        // Vector difference
-        MiraFeatureVector diff = hfd.hopeFeatures - hfd.fearFeatures;
-        // Bleu difference
-        //assert(hfd.hopeBleu + 1e-8 >= hfd.fearBleu);
-        ValType delta = hfd.hopeBleu - hfd.fearBleu;
-        // Loss and update
-        ValType diff_score = wv->score(diff);
-        ValType loss = delta - diff_score;
-        if(verbose) {
-          cerr << "Updating sent " << sentenceIndex << endl;
-          cerr << "Wght: " << *wv << endl;
-          cerr << "Hope: " << hfd.hopeFeatures << " BLEU:" << hfd.hopeBleu << " Score:" << wv->score(hfd.hopeFeatures) << endl;
-          cerr << "Fear: " << hfd.fearFeatures << " BLEU:" << hfd.fearBleu << " Score:" << wv->score(hfd.fearFeatures) << endl;
-          cerr << "Diff: " << diff << " BLEU:" << delta << " Score:" << diff_score << endl;
-          cerr << "Loss: " << loss <<  " Scale: " << 1 << endl;
-          cerr << endl;
-        }
-        if(loss > 0) {
-          ValType eta = min(c, loss / diff.sqrNorm());
-          wv->update(diff,eta);
-          totalLoss+=loss;
-          iNumUpdates++;
-        }
-        // Update BLEU statistics
-        for(size_t k=0; k<bg.size(); k++) {
-          bg[k]*=decay;
-          if(model_bg)
-            bg[k]+=hfd.modelStats[k];
-          else
-            bg[k]+=hfd.hopeStats[k];
-        }
+    EpochStats stats;
+    if (parallel) {
+      // Each shard starts from the current weights and background and is
+      // trained on its own; the results are mixed in shard order.
+      if (!no_shuffle) random_shuffle(order.begin(), order.end());
+      vector<boost::shared_ptr<Moses::Task> > tasks;
+      vector<MiraShardTask*> trainers;
+      for (size_t k = 0; k < shards; ++k) {
+        MiraShardTask* task = new MiraShardTask(*decoder, opt, *wv, bg,
+                                                order.begin() + order.size() * k / shards,
+                                                order.begin() + order.size() * (k + 1) / shards);
+        trainers.push_back(task);
+        tasks.push_back(boost::shared_ptr<Moses::Task>(task));
+      }
+      RunTasks(tasks, threads);
+      vector<MiraWeightVector> mixture;
+      fill(bg.begin(), bg.end(), 0);
+      for (size_t k = 0; k < trainers.size(); ++k) {
+        mixture.push_back(trainers[k]->GetWeights());
+        for (size_t i = 0; i < bg.size(); ++i) bg[i] += trainers[k]->GetBackground()[i] / shards;
+        stats.numExamples += trainers[k]->GetStats().numExamples;
+        stats.numUpdates += trainers[k]->GetStats().numUpdates;
+        stats.totalLoss += trainers[k]->GetStats().totalLoss;
+      }
+      wv->mix(mixture);
+    } else {
+      size_t sentenceIndex = 0;
+      for(decoder->reset(); !decoder->finished(); decoder->next()) {
+        HopeFearData hfd;
+        decoder->HopeFear(bg,*wv,&hfd);
+        MiraUpdate(hfd, sentenceIndex, opt, *wv, bg, stats);
+        ++sentenceIndex;
+        if (streaming_out)
+          cout << *wv << endl;
       }
-      iNumExamples++;
-      ++sentenceIndex;
-      if (streaming_out)
-        cout << *wv << endl;
     }
     // Training Epoch summary
-    cerr << iNumUpdates << "/" << iNumExamples << " updates"
-         << ", avg loss = " << (totalLoss / iNumExamples);
+    cerr << stats.numUpdates << "/" << stats.numExamples << " updates"
+         << ", avg loss = " << (stats.totalLoss / stats.numExamples);
 
 
     // Evaluate current average weights
     AvgWeightVector avg = wv->avg();
-    ValType bleu = decoder->Evaluate(avg);
+    ValType bleu = parallel ? ParallelEvaluate(*decoder, *scorer, avg, shards, threads) : decoder->Evaluate(avg);
     cerr << ", BLEU = " << bleu << endl;
     if(bleu > bestBleu) {
       /*
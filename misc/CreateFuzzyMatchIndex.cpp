@@ -0,0 +1,58 @@
+// Builds the suffix array index of the source side of a translation memory
+// for PhraseDictionaryFuzzyMatch, so that the decoder can memory map it
+// (source=<index>) instead of sorting the corpus every time it starts.
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <boost/program_options.hpp>
+#include "moses/TranslationModel/fuzzy-match/SuffixArray.h"
+#include "util/exception.hh"
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+  string inPath, outPath;
+  size_t threads = 1;
+
+  namespace po = boost::program_options;
+  po::options_description desc("Options");
+  desc.add_options()
+  ("help", "Print help messages")
+  ("input", po::value<string>()->required(), "Source side of the translation memory, one sentence per line")
+  ("output", po::value<string>()->required(), "Index file to write")
+  ("threads", po::value<size_t>()->default_value(threads), "Number of threads to sort with")
+  ;
+
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, desc),
+              vm); // can throw
+
+    if ( vm.count("help")) {
+      std::cout << desc << std::endl;
+      return EXIT_SUCCESS;
+    }
+
+    po::notify(vm);
+  } catch(po::error& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
+    std::cerr << desc << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  inPath = vm["input"].as<string>();
+  outPath = vm["output"].as<string>();
+  threads = vm["threads"].as<size_t>();
+
+  try {
+    UTIL_THROW_IF2(tmmt::SuffixArray::IsIndex(inPath), inPath << " is already an index");
+    tmmt::SuffixArray suffixArray(inPath, threads);
+    suffixArray.Save(outPath);
+  } catch (const util::Exception &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
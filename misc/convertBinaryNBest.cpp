@@ -0,0 +1,43 @@
+// Converts binary n-best lists (moses -binary-n-best-list) into text n-best
+// lists, exactly as the decoder would have written them.
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "moses/BinaryNBest.h"
+#include "util/exception.hh"
+
+using namespace Moses;
+
+void printHelp()
+{
+  std::cerr << "Usage: convertBinaryNBest binary-nbest [...] > text-nbest\n"
+            "Files are converted in the order given.\n";
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2 || std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help") {
+    printHelp();
+    return 1;
+  }
+  std::ios_base::sync_with_stdio(false);
+  try {
+    for (int i = 1; i < argc; ++i) {
+      UTIL_THROW_IF(!BinaryNBestReader::IsBinary(argv[i]), util::Exception,
+                    argv[i] << " is not a binary n-best list");
+      BinaryNBestReader reader(argv[i]);
+      while (reader.NextSentence()) {
+        while (reader.NextHypothesis()) {
+          reader.WriteText(std::cout);
+        }
+      }
+    }
+  } catch (const util::Exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  std::cout.flush();
+  return 0;
+}
@@ -0,0 +1,371 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width: 2 -*-
+#include "BinaryNBest.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "util/exception.hh"
+#include "util/file.hh"
+#include "util/read_compressed.hh"
+
+using namespace std;
+
+namespace Moses
+{
+
+namespace
+{
+
+const char kMagic[8] = {'M', 'O', 'S', 'E', 'S', 'N', 'B', '2'};
+
+const uint32_t kWithLabels = 1;
+
+// Followed by, each padded to a multiple of 8 bytes:
+//   uint32_t dense scores of each feature function[groups]
+//   uint32_t whether each feature function has tuneable components[groups]
+//   uint32_t feature function of each sparse name[sparse_names]
+//   char     strings[strings_bytes]: the feature function labels, the words
+//            and the sparse names, each terminated by '\0'
+// and the hypotheses, each
+//   HypothesisHeader
+//   uint32_t word ids[words]
+//   float    dense scores[dense_dims]
+//   uint32_t sparse name ids[sparse]
+//   float    sparse values[sparse]
+//   char     trailer[trailer_bytes]
+// with every array padded to 8 bytes.
+struct BlockHeader {
+  char magic[8];
+  uint64_t block_bytes;
+  uint32_t sentence;
+  uint32_t flags;
+  uint32_t hypotheses;
+  uint32_t groups;
+  uint32_t dense_dims;
+  uint32_t words;
+  uint32_t sparse_names;
+  uint32_t strings_bytes;
+};
+
+struct HypothesisHeader {
+  float total;
+  uint32_t words;
+  uint32_t sparse;
+  uint32_t trailer_bytes;
+};
+
+inline uint64_t Pad(uint64_t bytes)
+{
+  return (bytes + 7) & ~static_cast<uint64_t>(7);
+}
+
+void Append(string &out, const void *data, uint64_t bytes)
+{
+  out.append(reinterpret_cast<const char*>(data), bytes);
+  out.append(Pad(bytes) - bytes, '\0');
+}
+
+template <class T> void AppendSection(string &out, const vector<T> &values)
+{
+  Append(out, values.empty() ? NULL : &values[0], values.size() * sizeof(T));
+}
+
+void AppendStrings(string &out, const vector<string> &strings)
+{
+  for (size_t i = 0; i < strings.size(); ++i) {
+    out.append(strings[i].c_str(), strings[i].size() + 1);
+  }
+}
+
+template <class T> const T *ReadSection(const uint8_t *&at, uint64_t count)
+{
+  const T *ret = reinterpret_cast<const T*>(at);
+  at += Pad(count * sizeof(T));
+  return ret;
+}
+
+void ReadStrings(const char *&at, const char *end, size_t count,
+                 vector<StringPiece> &strings, const string &file)
+{
+  strings.clear();
+  strings.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    const char *stop = static_cast<const char*>(memchr(at, '\0', end - at));
+    UTIL_THROW_IF(stop == NULL, util::Exception, "Truncated strings in binary n-best file " << file);
+    strings.push_back(StringPiece(at, stop - at));
+    at = stop + 1;
+  }
+}
+
+} // namespace
+
+BinaryNBestWriter::BinaryNBestWriter(long sentence, bool withLabels)
+  : m_sentence(sentence)
+  , m_withLabels(withLabels)
+  , m_hypotheses(0)
+  , m_denseDims(0)
+{
+}
+
+uint32_t BinaryNBestWriter::WordId(const StringPiece &word)
+{
+  string key(word.data(), word.size());
+  boost::unordered_map<string, uint32_t>::const_iterator i = m_wordIds.find(key);
+  if (i != m_wordIds.end()) {
+    return i->second;
+  }
+  const uint32_t id = m_words.size();
+  m_wordIds[key] = id;
+  m_words.push_back(key);
+  return id;
+}
+
+uint32_t BinaryNBestWriter::SparseId(const NBestFeatureScores::Sparse &sparse)
+{
+  boost::unordered_map<string, uint32_t>::const_iterator i = m_sparseIds.find(sparse.name);
+  if (i != m_sparseIds.end()) {
+    return i->second;
+  }
+  const uint32_t id = m_sparseNames.size();
+  m_sparseIds[sparse.name] = id;
+  m_sparseNames.push_back(sparse.name);
+  m_sparseGroups.push_back(sparse.group);
+  return id;
+}
+
+void BinaryNBestWriter::AddHypothesis(const string &surface, const NBestFeatureScores &scores,
+                                      float total, const string &trailer)
+{
+  if (m_hypotheses == 0) {
+    m_labels = scores.labels;
+    m_sizes = scores.sizes;
+    m_tuneable = scores.tuneable;
+    m_denseDims = scores.dense.size();
+  }
+  UTIL_THROW_IF2(scores.dense.size() != m_denseDims || scores.sizes != m_sizes
+                 || scores.tuneable != m_tuneable,
+                 "Hypotheses of sentence " << m_sentence << " have different dense features");
+
+  // Split on single blanks, keeping empty words, so that joining the words
+  // with blanks gives back the surface string.
+  vector<uint32_t> words;
+  size_t begin = 0;
+  while (true) {
+    size_t end = surface.find(' ', begin);
+    if (end == string::npos) {
+      words.push_back(WordId(StringPiece(surface.data() + begin, surface.size() - begin)));
+      break;
+    }
+    words.push_back(WordId(StringPiece(surface.data() + begin, end - begin)));
+    begin = end + 1;
+  }
+
+  vector<uint32_t> sparseIds(scores.sparse.size());
+  vector<float> sparseValues(scores.sparse.size());
+  for (size_t i = 0; i < scores.sparse.size(); ++i) {
+    sparseIds[i] = SparseId(scores.sparse[i]);
+    sparseValues[i] = scores.sparse[i].value;
+  }
+
+  HypothesisHeader header;
+  header.total = total;
+  header.words = words.size();
+  header.sparse = sparseIds.size();
+  header.trailer_bytes = trailer.size();
+  Append(m_records, &header, sizeof(header));
+  AppendSection(m_records, words);
+  AppendSection(m_records, scores.dense);
+  AppendSection(m_records, sparseIds);
+  AppendSection(m_records, sparseValues);
+  Append(m_records, trailer.data(), trailer.size());
+  ++m_hypotheses;
+}
+
+void BinaryNBestWriter::Write(ostream &out) const
+{
+  if (m_hypotheses == 0) {
+    return;
+  }
+  string strings;
+  AppendStrings(strings, m_labels);
+  AppendStrings(strings, m_words);
+  AppendStrings(strings, m_sparseNames);
+
+  string sections;
+  AppendSection(sections, m_sizes);
+  AppendSection(sections, m_tuneable);
+  AppendSection(sections, m_sparseGroups);
+  Append(sections, strings.data(), strings.size());
+
+  BlockHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.block_bytes = sizeof(header) + sections.size() + m_records.size();
+  header.sentence = m_sentence;
+  header.flags = m_withLabels ? kWithLabels : 0;
+  header.hypotheses = m_hypotheses;
+  header.groups = m_sizes.size();
+  header.dense_dims = m_denseDims;
+  header.words = m_words.size();
+  header.sparse_names = m_sparseNames.size();
+  header.strings_bytes = strings.size();
+
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(sections.data(), sections.size());
+  out.write(m_records.data(), m_records.size());
+}
+
+string BinaryNBestWriter::Str() const
+{
+  ostringstream out;
+  Write(out);
+  return out.str();
+}
+
+bool BinaryNBestReader::IsBinary(const string &file)
+{
+  util::ReadCompressed in(util::OpenReadOrThrow(file.c_str()));
+  char magic[sizeof(kMagic)];
+  return in.ReadOrEOF(magic, sizeof(magic)) == sizeof(magic)
+         && !memcmp(magic, kMagic, sizeof(kMagic));
+}
+
+BinaryNBestReader::BinaryNBestReader(const string &file)
+  : m_file(file)
+  , m_next(NULL)
+  , m_end(NULL)
+  , m_hypotheses(0)
+  , m_read(0)
+{
+  util::scoped_fd fd(util::OpenReadOrThrow(file.c_str()));
+  const uint64_t size = util::SizeOrThrow(fd.get());
+  char magic[util::ReadCompressed::kMagicSize];
+  if (size >= sizeof(magic)) {
+    util::ReadOrThrow(fd.get(), magic, sizeof(magic));
+    util::SeekOrThrow(fd.get(), 0);
+  }
+  if (size >= sizeof(magic) && util::ReadCompressed::DetectCompressedMagic(magic)) {
+    // e.g. gzipped by mert-moses.pl; keep 8-byte alignment
+    util::ReadCompressed in(fd.release());
+    string data;
+    char chunk[1 << 16];
+    for (size_t got; (got = in.ReadOrEOF(chunk, sizeof(chunk)));) {
+      data.append(chunk, got);
+    }
+    m_buffer.resize((data.size() + 7) / 8);
+    if (!data.empty()) memcpy(&m_buffer[0], data.data(), data.size());
+    m_next = reinterpret_cast<const uint8_t*>(m_buffer.empty() ? NULL : &m_buffer[0]);
+    m_end = m_next + data.size();
+  } else if (size) {
+    util::MapRead(util::LAZY, fd.get(), 0, size, m_mem);
+    m_next = reinterpret_cast<const uint8_t*>(m_mem.get());
+    m_end = m_next + size;
+  }
+}
+
+bool BinaryNBestReader::NextSentence()
+{
+  if (m_next == m_end) {
+    return false;
+  }
+  UTIL_THROW_IF(static_cast<uint64_t>(m_end - m_next) < sizeof(BlockHeader), util::Exception,
+                "Truncated block header in binary n-best file " << m_file);
+  const BlockHeader *header = reinterpret_cast<const BlockHeader*>(m_next);
+  UTIL_THROW_IF(memcmp(header->magic, kMagic, sizeof(kMagic)), util::Exception,
+                "Bad block magic at offset " << (m_next - reinterpret_cast<const uint8_t*>(m_mem.get()))
+                << " of binary n-best file " << m_file);
+  UTIL_THROW_IF(header->block_bytes > static_cast<uint64_t>(m_end - m_next), util::Exception,
+                "Truncated block in binary n-best file " << m_file);
+
+  m_sentence = header->sentence;
+  m_flags = header->flags;
+  m_hypotheses = header->hypotheses;
+  m_denseDims = header->dense_dims;
+  m_read = 0;
+
+  const uint8_t *at = m_next + sizeof(BlockHeader);
+  m_blockEnd = m_next + header->block_bytes;
+  m_sizes = ReadSection<uint32_t>(at, header->groups);
+  m_tuneable = ReadSection<uint32_t>(at, header->groups);
+  m_sparseGroups = ReadSection<uint32_t>(at, header->sparse_names);
+  const char *strings = ReadSection<char>(at, header->strings_bytes);
+  UTIL_THROW_IF(at > m_blockEnd, util::Exception, "Inconsistent block sizes in binary n-best file " << m_file);
+  const char *stringsEnd = strings + header->strings_bytes;
+  ReadStrings(strings, stringsEnd, header->groups, m_labels, m_file);
+  ReadStrings(strings, stringsEnd, header->words, m_words, m_file);
+  ReadStrings(strings, stringsEnd, header->sparse_names, m_sparseNames, m_file);
+
+  m_at = at;
+  m_next = m_blockEnd;
+  return true;
+}
+
+bool BinaryNBestReader::NextHypothesis()
+{
+  if (m_read == m_hypotheses) {
+    return false;
+  }
+  const uint8_t *at = m_at;
+  const HypothesisHeader *header = ReadSection<HypothesisHeader>(at, 1);
+  UTIL_THROW_IF(at > m_blockEnd, util::Exception, "Truncated hypothesis in binary n-best file " << m_file);
+  m_total = header->total;
+  m_numWords = header->words;
+  m_numSparse = header->sparse;
+  m_wordIds = ReadSection<uint32_t>(at, m_numWords);
+  m_dense = ReadSection<float>(at, m_denseDims);
+  m_sparseIds = ReadSection<uint32_t>(at, m_numSparse);
+  m_sparseValues = ReadSection<float>(at, m_numSparse);
+  const char *trailer = ReadSection<char>(at, header->trailer_bytes);
+  UTIL_THROW_IF(at > m_blockEnd, util::Exception, "Truncated hypothesis in binary n-best file " << m_file);
+  m_trailer = StringPiece(trailer, header->trailer_bytes);
+  m_at = at;
+  ++m_read;
+  return true;
+}
+
+string BinaryNBestReader::DenseFeatureNames() const
+{
+  ostringstream names;
+  for (size_t g = 0; g < m_labels.size(); ++g) {
+    for (size_t i = 0; i < m_sizes[g]; ++i) {
+      names << m_labels[g] << "_" << i << " ";
+    }
+  }
+  return names.str();
+}
+
+string BinaryNBestReader::Surface() const
+{
+  string surface;
+  for (size_t i = 0; i < m_numWords; ++i) {
+    if (i) surface += ' ';
+    surface.append(Word(i).data(), Word(i).size());
+  }
+  return surface;
+}
+
+void BinaryNBestReader::WriteText(ostream &out) const
+{
+  out << m_sentence << " ||| " << Surface() << " |||";
+  // as ScoreComponentCollection::OutputAllFeatureScores()
+  StringPiece lastName;
+  const float *dense = m_dense;
+  for (size_t g = 0; g < m_labels.size(); ++g) {
+    if ((m_flags & kWithLabels) && m_tuneable[g] && m_labels[g] != lastName) {
+      lastName = m_labels[g];
+      out << " " << m_labels[g] << "=";
+    }
+    for (size_t i = 0; i < m_sizes[g]; ++i) {
+      out << " " << *dense++;
+    }
+    for (size_t i = 0; i < m_numSparse; ++i) {
+      if (m_sparseGroups[m_sparseIds[i]] == g) {
+        out << " " << SparseName(i) << "= " << m_sparseValues[i];
+      }
+    }
+  }
+  out << " ||| " << m_total << m_trailer << "\n";
+}
+
+}
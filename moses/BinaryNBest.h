@@ -0,0 +1,205 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width: 2 -*-
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <boost/unordered_map.hpp>
+
+#include "util/mmap.hh"
+#include "util/string_piece.hh"
+
+namespace Moses
+{
+
+/** Feature scores of one n-best hypothesis, in the order in which
+ *  ScoreComponentCollection::OutputAllFeatureScores() prints them.
+ */
+struct NBestFeatureScores {
+  struct Sparse {
+    uint32_t group; // index of the feature function that produced it
+    std::string name;
+    float value;
+  };
+
+  // One entry per tuneable feature function: its description, the number
+  // of its tuneable dense scores and whether it has tuneable components at
+  // all (only then is the label printed).
+  std::vector<std::string> labels;
+  std::vector<uint32_t> sizes;
+  std::vector<uint32_t> tuneable;
+  std::vector<float> dense;
+  std::vector<Sparse> sparse;
+
+  void clear() {
+    labels.clear();
+    sizes.clear();
+    tuneable.clear();
+    dense.clear();
+    sparse.clear();
+  }
+};
+
+/** Binary n-best lists.
+ *
+ * A binary n-best file is a sequence of self-contained blocks, one per input
+ * sentence, so the output of several decoder processes can simply be
+ * concatenated like text n-best lists.  A block holds
+ *  - the feature function labels and the number of dense scores of each,
+ *  - the words and sparse feature names used by its hypotheses, each once,
+ *  - per hypothesis: the total score, the target words as ids into the word
+ *    list, the dense scores as floats, the sparse scores as (name id, value)
+ *    pairs and the remaining fields (segmentation, alignment) as text.
+ *
+ * Everything is 4-byte data padded to 8 bytes, so that readers can map the
+ * file and use the scores in place.  BinaryNBestReader::WriteText() turns a
+ * hypothesis back into the line the decoder would have printed.  Compressed
+ * files are read too, but then decompressed into memory first.
+ */
+class BinaryNBestWriter
+{
+public:
+  explicit BinaryNBestWriter(long sentence, bool withLabels = true);
+
+  /** surface: the target words as printed to a text n-best list, i.e. each
+   *  word followed by a blank.  trailer: everything printed after the total
+   *  score, starting with " |||" (may be empty).
+   */
+  void AddHypothesis(const std::string &surface, const NBestFeatureScores &scores,
+                     float total, const std::string &trailer);
+
+  /** Write the block (nothing if there are no hypotheses). */
+  void Write(std::ostream &out) const;
+
+  std::string Str() const;
+
+private:
+  uint32_t WordId(const StringPiece &word);
+  uint32_t SparseId(const NBestFeatureScores::Sparse &sparse);
+
+  const uint32_t m_sentence;
+  const bool m_withLabels;
+  uint32_t m_hypotheses;
+
+  std::vector<std::string> m_labels;
+  std::vector<uint32_t> m_sizes;
+  std::vector<uint32_t> m_tuneable;
+  uint32_t m_denseDims;
+
+  boost::unordered_map<std::string, uint32_t> m_wordIds;
+  std::vector<std::string> m_words;
+  boost::unordered_map<std::string, uint32_t> m_sparseIds;
+  std::vector<std::string> m_sparseNames;
+  std::vector<uint32_t> m_sparseGroups;
+
+  // The serialised hypothesis records.
+  std::string m_records;
+};
+
+/** Memory maps a binary n-best file and walks through it sentence by
+ *  sentence and hypothesis by hypothesis.
+ */
+class BinaryNBestReader
+{
+public:
+  explicit BinaryNBestReader(const std::string &file);
+
+  /** True iff file starts with a binary n-best block, after decompression. */
+  static bool IsBinary(const std::string &file);
+
+  /** Go to the next sentence block; false at the end of the file. */
+  bool NextSentence();
+
+  /** Go to the next hypothesis of the current sentence; false after the last. */
+  bool NextHypothesis();
+
+  uint32_t Sentence() const {
+    return m_sentence;
+  }
+  std::size_t NumHypotheses() const {
+    return m_hypotheses;
+  }
+
+  /** Feature function labels and the number of dense scores of each. */
+  const std::vector<StringPiece> &Labels() const {
+    return m_labels;
+  }
+  const uint32_t *Sizes() const {
+    return m_sizes;
+  }
+
+  /** Dense feature names as mert numbers them: label_0 label_1 ... */
+  std::string DenseFeatureNames() const;
+
+  // The current hypothesis.
+  float Total() const {
+    return m_total;
+  }
+  std::size_t NumWords() const {
+    return m_numWords;
+  }
+  StringPiece Word(std::size_t i) const {
+    return m_words[m_wordIds[i]];
+  }
+  std::size_t NumDense() const {
+    return m_denseDims;
+  }
+  const float *Dense() const {
+    return m_dense;
+  }
+  std::size_t NumSparse() const {
+    return m_numSparse;
+  }
+  StringPiece SparseName(std::size_t i) const {
+    return m_sparseNames[m_sparseIds[i]];
+  }
+  float SparseValue(std::size_t i) const {
+    return m_sparseValues[i];
+  }
+  StringPiece Trailer() const {
+    return m_trailer;
+  }
+
+  /** The target words as in a text n-best list. */
+  std::string Surface() const;
+
+  /** Write the current hypothesis as a line of a text n-best list. */
+  void WriteText(std::ostream &out) const;
+
+private:
+  const std::string m_file;
+  util::scoped_memory m_mem;
+  std::vector<uint64_t> m_buffer; // the decompressed file, if it is compressed
+  const uint8_t *m_next;
+  const uint8_t *m_end;
+
+  // current block
+  uint32_t m_sentence;
+  uint32_t m_flags;
+  uint32_t m_hypotheses;
+  uint32_t m_denseDims;
+  std::vector<StringPiece> m_labels;
+  const uint32_t *m_sizes;
+  const uint32_t *m_tuneable;
+  std::vector<StringPiece> m_words;
+  std::vector<StringPiece> m_sparseNames;
+  const uint32_t *m_sparseGroups;
+  const uint8_t *m_at;
+  const uint8_t *m_blockEnd;
+  uint32_t m_read;
+
+  // current hypothesis
+  float m_total;
+  uint32_t m_numWords;
+  const uint32_t *m_wordIds;
+  const float *m_dense;
+  uint32_t m_numSparse;
+  const uint32_t *m_sparseIds;
+  const float *m_sparseValues;
+  StringPiece m_trailer;
+};
+
+}
@@ -0,0 +1,131 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2015- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include <zlib.h>
+
+#include "BinaryNBest.h"
+
+using namespace Moses;
+using namespace std;
+
+namespace
+{
+
+NBestFeatureScores MakeScores(float lm, float tm0, float tm1, float sparse)
+{
+  NBestFeatureScores scores;
+  scores.labels.push_back("LM0");
+  scores.sizes.push_back(1);
+  scores.tuneable.push_back(1);
+  scores.labels.push_back("Sparse0");
+  scores.sizes.push_back(0);
+  scores.tuneable.push_back(0);
+  scores.labels.push_back("TM0");
+  scores.sizes.push_back(2);
+  scores.tuneable.push_back(1);
+  scores.dense.push_back(lm);
+  scores.dense.push_back(tm0);
+  scores.dense.push_back(tm1);
+  if (sparse) {
+    NBestFeatureScores::Sparse entry;
+    entry.group = 1;
+    entry.name = "Sparse0_x";
+    entry.value = sparse;
+    scores.sparse.push_back(entry);
+  }
+  return scores;
+}
+
+string Convert(const string &file)
+{
+  ostringstream text;
+  BinaryNBestReader reader(file);
+  while (reader.NextSentence()) {
+    while (reader.NextHypothesis()) {
+      reader.WriteText(text);
+    }
+  }
+  return text.str();
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(binary_nbest)
+
+BOOST_AUTO_TEST_CASE(round_trip)
+{
+  const string file = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+  {
+    ofstream out(file.c_str(), ios::out | ios::binary);
+    BinaryNBestWriter first(3);
+    first.AddHypothesis("a house ", MakeScores(-1.5, -2, -0.25, 1), -4.5, " ||| 0-1=0-1");
+    first.AddHypothesis("a  house ", MakeScores(-2, -2, -0.5, 0), -5, " ||| 0-1=0-1");
+    first.Write(out);
+    BinaryNBestWriter second(4, false);
+    second.AddHypothesis("", MakeScores(0, 0, 0, 0), 0, "");
+    second.Write(out);
+  }
+
+  BOOST_CHECK(BinaryNBestReader::IsBinary(file));
+  BOOST_CHECK_EQUAL(Convert(file),
+                    "3 ||| a house  ||| LM0= -1.5 Sparse0_x= 1 TM0= -2 -0.25 ||| -4.5 ||| 0-1=0-1\n"
+                    "3 ||| a  house  ||| LM0= -2 TM0= -2 -0.5 ||| -5 ||| 0-1=0-1\n"
+                    "4 |||  ||| 0 0 0 ||| 0\n");
+
+  BinaryNBestReader reader(file);
+  BOOST_REQUIRE(reader.NextSentence());
+  BOOST_CHECK_EQUAL(reader.Sentence(), 3);
+  BOOST_CHECK_EQUAL(reader.NumHypotheses(), 2);
+  BOOST_CHECK_EQUAL(reader.DenseFeatureNames(), "LM0_0 TM0_0 TM0_1 ");
+  BOOST_REQUIRE(reader.NextHypothesis());
+  BOOST_CHECK_EQUAL(reader.NumDense(), 3);
+  BOOST_CHECK_EQUAL(reader.Dense()[2], -0.25);
+  BOOST_CHECK_EQUAL(reader.NumSparse(), 1);
+  BOOST_CHECK_EQUAL(reader.SparseName(0), "Sparse0_x");
+  BOOST_CHECK_EQUAL(reader.Surface(), "a house ");
+
+  boost::filesystem::remove(file);
+}
+
+BOOST_AUTO_TEST_CASE(compressed)
+{
+  BinaryNBestWriter writer(7);
+  writer.AddHypothesis("a ", MakeScores(-1, -2, -3, 0), -6, "");
+  const string block = writer.Str();
+
+  const string file = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string() + ".gz";
+  gzFile out = gzopen(file.c_str(), "wb");
+  BOOST_REQUIRE(out);
+  gzwrite(out, block.data(), block.size());
+  gzclose(out);
+
+  BOOST_CHECK(BinaryNBestReader::IsBinary(file));
+  BOOST_CHECK_EQUAL(Convert(file), "7 ||| a  ||| LM0= -1 TM0= -2 -3 ||| -6\n");
+
+  boost::filesystem::remove(file);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
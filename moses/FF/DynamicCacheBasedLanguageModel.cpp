@@ -11,6 +11,8 @@ DynamicCacheBasedLanguageModel *DynamicCacheBasedLanguageModel::s_instance = NUL
 
 DynamicCacheBasedLanguageModel::DynamicCacheBasedLanguageModel(const std::string &line)
   : StatelessFeatureFunction(1, line)
+  , m_snapshot(new decaying_cache_t)
+  , m_batchDepth(0)
 {
   VERBOSE(2,"Initializing DynamicCacheBasedLanguageModel feature..." << std::endl);
 
@@ -30,11 +32,37 @@ DynamicCacheBasedLanguageModel::DynamicCacheBasedLanguageModel(const std::string
 
 DynamicCacheBasedLanguageModel::~DynamicCacheBasedLanguageModel() {};
 
-void DynamicCacheBasedLanguageModel::SetPreComputedScores()
+DynamicCacheBasedLanguageModel::Batch::Batch(DynamicCacheBasedLanguageModel& lm)
+  : m_lm(lm)
+{
+#ifdef WITH_THREADS
+  m_lm.m_writeLock.lock();
+#endif
+  if (m_lm.m_batchDepth++ == 0) {
+    m_lm.m_cache = *m_lm.GetSnapshot();
+  }
+}
+
+DynamicCacheBasedLanguageModel::Batch::~Batch()
 {
+  if (--m_lm.m_batchDepth == 0) {
+    boost::shared_ptr<decaying_cache_t> snapshot(new decaying_cache_t);
+    snapshot->swap(m_lm.m_cache);
+    boost::atomic_store(&m_lm.m_snapshot, snapshot_t(snapshot));
+    StaticData::Instance().BumpModelEpoch();
+  }
 #ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> lock(m_cacheLock);
+  m_lm.m_writeLock.unlock();
 #endif
+}
+
+DynamicCacheBasedLanguageModel::snapshot_t DynamicCacheBasedLanguageModel::GetSnapshot() const
+{
+  return boost::atomic_load(&m_snapshot);
+}
+
+void DynamicCacheBasedLanguageModel::SetPreComputedScores()
+{
   precomputedScores.clear();
   for (unsigned int i=0; i<m_maxAge; i++) {
     precomputedScores.push_back(decaying_score(i));
@@ -91,12 +119,13 @@ void DynamicCacheBasedLanguageModel::EvaluateInIsolation(const Phrase &sp
     , ScoreComponentCollection &estimatedScores) const
 {
   float score = m_lower_score;
+  snapshot_t cache = GetSnapshot();
   switch(m_query_type) {
   case CBLM_QUERY_TYPE_WHOLESTRING:
-    score = Evaluate_Whole_String(tp);
+    score = Evaluate_Whole_String(*cache, tp);
     break;
   case CBLM_QUERY_TYPE_ALLSUBSTRINGS:
-    score = Evaluate_All_Substrings(tp);
+    score = Evaluate_All_Substrings(*cache, tp);
     break;
   default:
     UTIL_THROW_IF2(false, "This score type (" << m_query_type << ") is unknown.");
@@ -105,7 +134,7 @@ void DynamicCacheBasedLanguageModel::EvaluateInIsolation(const Phrase &sp
   scoreBreakdown.Assign(this, score);
 }
 
-float DynamicCacheBasedLanguageModel::Evaluate_Whole_String(const TargetPhrase& tp) const
+float DynamicCacheBasedLanguageModel::Evaluate_Whole_String(const decaying_cache_t& cache, const TargetPhrase& tp) const
 {
   //consider all words in the TargetPhrase as one n-gram
   // and compute the decaying_score for the whole n-gram
@@ -122,10 +151,10 @@ float DynamicCacheBasedLanguageModel::Evaluate_Whole_String(const TargetPhrase&
       w += " ";
     }
   }
-  it = m_cache.find(w);
+  it = cache.find(w);
 
   VERBOSE(4,"cblm::Evaluate_Whole_String: searching w:|" << w << "|" << std::endl);
-  if (it != m_cache.end()) { //found!
+  if (it != cache.end()) { //found!
     score = ((*it).second).second;
     VERBOSE(4,"cblm::Evaluate_Whole_String: found w:|" << w << "|" << std::endl);
   }
@@ -134,7 +163,7 @@ float DynamicCacheBasedLanguageModel::Evaluate_Whole_String(const TargetPhrase&
   return score;
 }
 
-float DynamicCacheBasedLanguageModel::Evaluate_All_Substrings(const TargetPhrase& tp) const
+float DynamicCacheBasedLanguageModel::Evaluate_All_Substrings(const decaying_cache_t& cache, const TargetPhrase& tp) const
 {
   //loop over all n-grams in the TargetPhrase (no matter of n)
   //and compute the decaying_score for all words
@@ -147,9 +176,9 @@ float DynamicCacheBasedLanguageModel::Evaluate_All_Substrings(const TargetPhrase
     std::string w = "";
     for (size_t endpos = startpos; endpos < tp.GetSize() ; ++endpos) {
       w += tp.GetWord(endpos).GetFactor(0)->GetString().as_string();
-      it = m_cache.find(w);
+      it = cache.find(w);
 
-      if (it != m_cache.end()) { //found!
+      if (it != cache.end()) { //found!
         score += ((*it).second).second;
         VERBOSE(3,"cblm::Evaluate_All_Substrings: found w:|" << w << "| actual score:|" << ((*it).second).second << "| score:|" << score << "|" << std::endl);
       } else {
@@ -168,45 +197,37 @@ float DynamicCacheBasedLanguageModel::Evaluate_All_Substrings(const TargetPhrase
 
 void DynamicCacheBasedLanguageModel::Print() const
 {
-#ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> read_lock(m_cacheLock);
-#endif
+  snapshot_t cache = GetSnapshot();
   decaying_cache_t::const_iterator it;
   std::cout << "Content of the cache of Cache-Based Language Model" << std::endl;
-  std::cout << "Size of the cache of Cache-Based Language Model:|" << m_cache.size() << "|" << std::endl;
-  for ( it=m_cache.begin() ; it != m_cache.end(); it++ ) {
+  std::cout << "Size of the cache of Cache-Based Language Model:|" << cache->size() << "|" << std::endl;
+  for ( it=cache->begin() ; it != cache->end(); it++ ) {
     std::cout << "word:|" << (*it).first << "| age:|" << ((*it).second).first << "| score:|" << ((*it).second).second << "|" << std::endl;
   }
 }
 
 void DynamicCacheBasedLanguageModel::Decay()
 {
-#ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> lock(m_cacheLock);
-#endif
   decaying_cache_t::iterator it;
 
   unsigned int age;
   float score;
-  for ( it=m_cache.begin() ; it != m_cache.end(); it++ ) {
+  for ( it=m_cache.begin() ; it != m_cache.end(); ) {
     age=((*it).second).first + 1;
     if (age > m_maxAge) {
-      m_cache.erase(it);
-      it--;
+      m_cache.erase(it++);
     } else {
       score = GetPreComputedScores(age);
 //      score = decaying_score(age);
       decaying_cache_value_t p (age, score);
       (*it).second = p;
+      ++it;
     }
   }
 }
 
 void DynamicCacheBasedLanguageModel::Update(std::vector<std::string> words, int age)
 {
-#ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> lock(m_cacheLock);
-#endif
   VERBOSE(3,"words.size():|" << words.size() << "|" << std::endl);
   for (size_t j=0; j<words.size(); j++) {
     words[j] = Trim(words[j]);
@@ -222,6 +243,7 @@ void DynamicCacheBasedLanguageModel::Update(std::vector<std::string> words, int
 
 void DynamicCacheBasedLanguageModel::ClearEntries(std::string &entries)
 {
+  Batch batch(*this);
   if (entries != "") {
     VERBOSE(3,"entries:|" << entries << "|" << std::endl);
     std::vector<std::string> elements = TokenizeMultiCharSeparator(entries, "||");
@@ -232,9 +254,6 @@ void DynamicCacheBasedLanguageModel::ClearEntries(std::string &entries)
 
 void DynamicCacheBasedLanguageModel::ClearEntries(std::vector<std::string> words)
 {
-#ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> lock(m_cacheLock);
-#endif
   VERBOSE(3,"words.size():|" << words.size() << "|" << std::endl);
   for (size_t j=0; j<words.size(); j++) {
     words[j] = Trim(words[j]);
@@ -245,6 +264,7 @@ void DynamicCacheBasedLanguageModel::ClearEntries(std::vector<std::string> words
 
 void DynamicCacheBasedLanguageModel::Insert(std::string &entries)
 {
+  Batch batch(*this);
   if (entries != "") {
     VERBOSE(3,"entries:|" << entries << "|" << std::endl);
     std::vector<std::string> elements = TokenizeMultiCharSeparator(entries, "||");
@@ -265,6 +285,7 @@ void DynamicCacheBasedLanguageModel::Insert(std::vector<std::string> ngrams)
 
 void DynamicCacheBasedLanguageModel::ExecuteDlt(std::map<std::string, std::string> dlt_meta)
 {
+  Batch batch(*this);
   if (dlt_meta.find("cblm") != dlt_meta.end()) {
     Insert(dlt_meta["cblm"]);
   }
@@ -285,6 +306,7 @@ void DynamicCacheBasedLanguageModel::ExecuteDlt(std::map<std::string, std::strin
 
 void DynamicCacheBasedLanguageModel::Execute(std::string command)
 {
+  Batch batch(*this);
   VERBOSE(2,"DynamicCacheBasedLanguageModel::Execute(std::string command:|" << command << "|" << std::endl);
   std::vector<std::string> commands = Tokenize(command, "||");
   Execute(commands);
@@ -317,9 +339,7 @@ void DynamicCacheBasedLanguageModel::Execute_Single_Command(std::string command)
 
 void DynamicCacheBasedLanguageModel::Clear()
 {
-#ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> lock(m_cacheLock);
-#endif
+  Batch batch(*this);
   m_cache.clear();
 }
 
@@ -333,6 +353,7 @@ void DynamicCacheBasedLanguageModel::Load(AllOptions::ptr const& opts)
 
 void DynamicCacheBasedLanguageModel::Load(const std::string filestr)
 {
+  Batch batch(*this);
   VERBOSE(2,"DynamicCacheBasedLanguageModel::Load(const std::string filestr)" << std::endl);
 //  std::vector<std::string> files = Tokenize(m_initfiles, "||");
   std::vector<std::string> files = Tokenize(filestr, "||");
@@ -384,10 +405,6 @@ void DynamicCacheBasedLanguageModel::Load_Single_File(const std::string file)
 
 void DynamicCacheBasedLanguageModel::SetQueryType(size_t type)
 {
-#ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> read_lock(m_cacheLock);
-#endif
-
   m_query_type = type;
   if ( m_query_type != CBLM_QUERY_TYPE_WHOLESTRING
        && m_query_type != CBLM_QUERY_TYPE_ALLSUBSTRINGS ) {
@@ -400,9 +417,6 @@ void DynamicCacheBasedLanguageModel::SetQueryType(size_t type)
 
 void DynamicCacheBasedLanguageModel::SetScoreType(size_t type)
 {
-#ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> read_lock(m_cacheLock);
-#endif
   m_score_type = type;
   if ( m_score_type != CBLM_SCORE_TYPE_HYPERBOLA
        && m_score_type != CBLM_SCORE_TYPE_POWER
@@ -419,9 +433,6 @@ void DynamicCacheBasedLanguageModel::SetScoreType(size_t type)
 
 void DynamicCacheBasedLanguageModel::SetMaxAge(unsigned int age)
 {
-#ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> read_lock(m_cacheLock);
-#endif
   m_maxAge = age;
   VERBOSE(2, "CacheBasedLanguageModel MaxAge:  " << m_maxAge << std::endl);
 };
@@ -6,9 +6,10 @@
 #include "moses/Util.h"
 #include "FeatureFunction.h"
 
+#include <boost/shared_ptr.hpp>
+
 #ifdef WITH_THREADS
-#include <boost/thread/shared_mutex.hpp>
-#include <boost/thread/locks.hpp>
+#include <boost/thread/recursive_mutex.hpp>
 #endif
 
 typedef std::pair<int, float> decaying_cache_value_t;
@@ -34,12 +35,20 @@ namespace Moses
 class Range;
 
 /** Calculates score for the Dynamic Cache-Based pseudo LM
+ *
+ * As in PhraseDictionaryDynamicCacheBased, scoring reads an immutable
+ * snapshot of the cache without locking, and changes are published as a
+ * new snapshot at the end of each batch.
  */
 class DynamicCacheBasedLanguageModel : public StatelessFeatureFunction
 {
+  typedef boost::shared_ptr<decaying_cache_t const> snapshot_t;
+
   // data structure for the cache;
   // the key is the word and the value is the decaying score
-  decaying_cache_t m_cache;
+  snapshot_t m_snapshot; // the published cache; use GetSnapshot() to read
+  decaying_cache_t m_cache; // the cache being changed, valid inside a Batch only
+  size_t m_batchDepth;
   size_t m_query_type; //way of querying the cache
   size_t m_score_type; //way of scoring entries of the cache
   std::string m_initfiles; // vector of files loaded in the initialization phase
@@ -50,17 +59,31 @@ class DynamicCacheBasedLanguageModel : public StatelessFeatureFunction
   unsigned int m_maxAge;
 
 #ifdef WITH_THREADS
-  //multiple readers - single writer lock
-  mutable boost::shared_mutex m_cacheLock;
+  // single writer; readers do not lock
+  boost::recursive_mutex m_writeLock;
 #endif
 
+  // Changes made while a Batch exists are published together when the
+  // outermost Batch of the writing thread is destroyed.
+  class Batch
+  {
+    DynamicCacheBasedLanguageModel& m_lm;
+  public:
+    Batch(DynamicCacheBasedLanguageModel& lm);
+    ~Batch();
+  };
+
+  snapshot_t GetSnapshot() const;
+
   float decaying_score(unsigned int age);
   void SetPreComputedScores();
   float GetPreComputedScores(const unsigned int age);
 
-  float Evaluate_Whole_String( const TargetPhrase&) const;
-  float Evaluate_All_Substrings( const TargetPhrase&) const;
+  float Evaluate_Whole_String(const decaying_cache_t&, const TargetPhrase&) const;
+  float Evaluate_All_Substrings(const decaying_cache_t&, const TargetPhrase&) const;
 
+  // those of the functions below that change m_cache must be called
+  // inside a Batch
   void Decay();
   void Update(std::vector<std::string> words, int age);
 
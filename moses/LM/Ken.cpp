@@ -103,6 +103,9 @@ template <class Model> void LanguageModelKen<Model>::LoadModel(const std::string
   MappingBuilder builder(collection, m_lmIdLookup);
   config.enumerate_vocab = &builder;
   config.load_method = load_method;
+  config.numa_policy = m_numaPolicy;
+  config.numa_node = m_numaNode;
+  config.huge_directory = m_hugeDirectory;
 
   m_ngram.reset(new Model(file.c_str(), config));
   VERBOSE(2, "LanguageModelKen " << m_description << " reset to " << file << "\n");
@@ -112,6 +115,8 @@ template <class Model> LanguageModelKen<Model>::LanguageModelKen(const std::stri
   :LanguageModel(line)
   ,m_beginSentenceFactor(FactorCollection::Instance().AddFactor(BOS_))
   ,m_factorType(factorType)
+  ,m_numaPolicy(util::NUMA_DEFAULT)
+  ,m_numaNode(0)
 {
   ReadParameters();
   LoadModel(file, load_method);
@@ -121,6 +126,8 @@ template <class Model> LanguageModelKen<Model>::LanguageModelKen()
   :LanguageModel("KENLM")
   ,m_beginSentenceFactor(FactorCollection::Instance().AddFactor(BOS_))
   ,m_factorType(0)
+  ,m_numaPolicy(util::NUMA_DEFAULT)
+  ,m_numaNode(0)
 {
   ReadParameters();
 }
@@ -132,10 +139,31 @@ template <class Model> LanguageModelKen<Model>::LanguageModelKen(const LanguageM
 // TODO: don't copy this.
    m_beginSentenceFactor(copy_from.m_beginSentenceFactor),
    m_factorType(copy_from.m_factorType),
-   m_lmIdLookup(copy_from.m_lmIdLookup)
+   m_lmIdLookup(copy_from.m_lmIdLookup),
+   m_numaPolicy(copy_from.m_numaPolicy),
+   m_numaNode(copy_from.m_numaNode),
+   m_hugeDirectory(copy_from.m_hugeDirectory)
 {
 }
 
+template <class Model> void LanguageModelKen<Model>::SetParameter(const std::string& key, const std::string& value)
+{
+  if (key == "numa") {
+    if (value == "interleave") {
+      m_numaPolicy = util::NUMA_INTERLEAVE;
+    } else if (value == "default") {
+      m_numaPolicy = util::NUMA_DEFAULT;
+    } else {
+      m_numaPolicy = util::NUMA_BIND;
+      m_numaNode = Scan<int>(value);
+    }
+  } else if (key == "huge-dir") {
+    m_hugeDirectory = value;
+  } else {
+    LanguageModel::SetParameter(key, value);
+  }
+}
+
 template <class Model> const FFState * LanguageModelKen<Model>::EmptyHypothesisState(const InputType &/*input*/) const
 {
   KenLMState *ret = new KenLMState();
@@ -458,7 +486,7 @@ LanguageModel *ConstructKenLM(const std::string &lineOrig)
       } else if (value == "1" || value == "true") {
         load_method = util::LAZY;
       } else {
-        UTIL_THROW2("Can't parse lazyken argument " << value << ".  Also, lazyken is deprecated.  Use load with one of the arguments lazy, populate_or_lazy, populate_or_read, read, or parallel_read.");
+        UTIL_THROW2("Can't parse lazyken argument " << value << ".  Also, lazyken is deprecated.  Use load with one of the arguments lazy, populate_or_lazy, populate_or_read, read, parallel_read, or huge_shared.");
       }
     } else if (name == "load") {
       if (value == "lazy") {
@@ -471,6 +499,8 @@ LanguageModel *ConstructKenLM(const std::string &lineOrig)
         load_method = util::READ;
       } else if (value == "parallel_read") {
         load_method = util::PARALLEL_READ;
+      } else if (value == "huge_shared") {
+        load_method = util::HUGE_SHARED;
       } else {
         UTIL_THROW2("Unknown KenLM load method " << value);
       }
@@ -70,6 +70,9 @@ public:
 
   virtual bool IsUseable(const FactorMask &mask) const;
 
+  // numa=interleave|<node> and huge-dir=<tmpfs or hugetlbfs directory>
+  virtual void SetParameter(const std::string& key, const std::string& value);
+
   friend class InMemoryPerSentenceOnDemandLM;
 
 protected:
@@ -88,6 +91,11 @@ protected:
 
   std::vector<lm::WordIndex> m_lmIdLookup;
 
+  // Placement of the model in memory; see lm::ngram::Config.
+  util::NumaPolicy m_numaPolicy;
+  int m_numaNode;
+  std::string m_hugeDirectory;
+
 private:
   LanguageModelKen();
   LanguageModelKen(const LanguageModelKen<Model> &copy_from);
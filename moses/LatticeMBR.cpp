@@ -10,14 +10,17 @@
 #include "LatticeMBR.h"
 #include "moses/StaticData.h"
 #include <algorithm>
+#include <limits>
 #include <set>
+#include <boost/unordered_set.hpp>
+#include "util/murmur_hash.hh"
 
 using namespace std;
 
 namespace Moses
 {
 
-size_t bleu_order = 4;
+const size_t bleu_order = MBRNgram::MAX_ORDER;
 float UNKNGRAMLOGPROB = -20;
 void GetOutputWords(const TrellisPath &path, vector <Word> &translation)
 {
@@ -34,46 +37,372 @@ void GetOutputWords(const TrellisPath &path, vector <Word> &translation)
   }
 }
 
+size_t hash_value(const MBRNgram& ngram)
+{
+  return util::MurmurHashNative(ngram.words, ngram.size * sizeof(uint32_t), ngram.size);
+}
 
-void extract_ngrams(const vector<Word >& sentence, map < Phrase, int >  & allngrams)
+namespace
 {
-  for (int k = 0; k < (int)bleu_order; k++) {
-    for(int i =0; i < max((int)sentence.size()-k,0); i++) {
-      Phrase ngram( k+1);
-      for ( int j = i; j<= i+k; j++) {
-        ngram.AddWord(sentence[j]);
-      }
-      ++allngrams[ngram];
-    }
+const uint32_t NO_PATH = numeric_limits<uint32_t>::max();
+}
+
+MBRLattice::MBRLattice()
+{
+}
+
+uint32_t MBRLattice::AddNode(bool complete)
+{
+  m_complete.push_back(complete);
+  return m_complete.size() - 1;
+}
+
+void MBRLattice::AddEdge(uint32_t tail, uint32_t head, float score, const Phrase& words)
+{
+  Edge edge;
+  edge.tail = tail;
+  edge.head = head;
+  edge.score = score;
+  edge.wordBegin = m_words.size();
+  for (size_t i = 0; i < words.GetSize(); ++i) {
+    m_words.push_back(GetWordId(words.GetWord(i)));
   }
+  edge.wordEnd = m_words.size();
+  m_edges.push_back(edge);
 }
 
+void MBRLattice::Finish()
+{
+  // counting sort of the edges by head node, stable within each node
+  const size_t numNodes = GetNumNodes();
+  m_firstIncoming.assign(numNodes + 1, 0);
+  m_numOutgoing.assign(numNodes, 0);
+  for (size_t i = 0; i < m_edges.size(); ++i) {
+    ++m_firstIncoming[m_edges[i].head + 1];
+    ++m_numOutgoing[m_edges[i].tail];
+  }
+  for (size_t node = 0; node < numNodes; ++node) {
+    m_firstIncoming[node + 1] += m_firstIncoming[node];
+  }
+  vector<uint32_t> next(m_firstIncoming.begin(), m_firstIncoming.end() - 1);
+  vector<Edge> sorted(m_edges.size());
+  for (size_t i = 0; i < m_edges.size(); ++i) {
+    sorted[next[m_edges[i].head]++] = m_edges[i];
+  }
+  m_edges.swap(sorted);
+}
 
+uint32_t MBRLattice::GetWordId(const Word& word)
+{
+  boost::unordered_map<Word, uint32_t>::const_iterator it = m_wordIds.find(word);
+  if (it != m_wordIds.end()) {
+    return it->second;
+  }
+  const uint32_t id = m_wordIds.size();
+  m_wordIds[word] = id;
+  return id;
+}
+
+bool MBRLattice::FindWordId(const Word& word, uint32_t& id) const
+{
+  boost::unordered_map<Word, uint32_t>::const_iterator it = m_wordIds.find(word);
+  if (it == m_wordIds.end()) {
+    return false;
+  }
+  id = it->second;
+  return true;
+}
 
-void NgramScores::addScore(const Hypothesis* node, const Phrase& ngram, float score)
+uint32_t MBRLattice::GetNgramId(const MBRNgram& ngram)
 {
-  set<Phrase>::const_iterator ngramIter = m_ngrams.find(ngram);
-  if (ngramIter == m_ngrams.end()) {
-    ngramIter = m_ngrams.insert(ngram).first;
-  }
-  map<const Phrase*,float>& ngramScores = m_scores[node];
-  map<const Phrase*,float>::iterator scoreIter = ngramScores.find(&(*ngramIter));
-  if (scoreIter == ngramScores.end()) {
-    ngramScores[&(*ngramIter)] = score;
+  boost::unordered_map<MBRNgram, uint32_t>::const_iterator it = m_ngramIds.find(ngram);
+  if (it != m_ngramIds.end()) {
+    return it->second;
+  }
+  const uint32_t id = m_ngrams.size();
+  m_ngramIds[ngram] = id;
+  m_ngrams.push_back(ngram);
+  return id;
+}
+
+bool MBRLattice::FindNgramId(const MBRNgram& ngram, uint32_t& id) const
+{
+  boost::unordered_map<MBRNgram, uint32_t>::const_iterator it = m_ngramIds.find(ngram);
+  if (it == m_ngramIds.end()) {
+    return false;
+  }
+  id = it->second;
+  return true;
+}
+
+uint32_t MBRLattice::GetPathId(uint32_t prefix, uint32_t edge)
+{
+  const uint64_t key = (static_cast<uint64_t>(prefix) << 32) | edge;
+  boost::unordered_map<uint64_t, uint32_t>::const_iterator it = m_pathIds.find(key);
+  if (it != m_pathIds.end()) {
+    return it->second;
+  }
+  Path path;
+  path.prefix = prefix;
+  if (prefix == NO_PATH) {
+    path.firstTail = m_edges[edge].tail;
+    path.score = m_edges[edge].score;
   } else {
-    ngramScores[&(*ngramIter)] = log_sum(score,scoreIter->second);
+    path.firstTail = m_paths[prefix].firstTail;
+    path.score = m_paths[prefix].score + m_edges[edge].score;
+  }
+  const uint32_t id = m_paths.size();
+  m_pathIds[key] = id;
+  m_paths.push_back(path);
+  return id;
+}
+
+//Find the n-grams that end on this edge: those within its words, and those
+//that continue an n-gram ending at the end of an edge into its tail node.
+//The histories of the edges into the tail node must have been calculated.
+void MBRLattice::CalcHistory(uint32_t edgeId, vector<HistoryEntry>& history)
+{
+  const Edge& edge = m_edges[edgeId];
+  const size_t size = edge.wordEnd - edge.wordBegin;
+  history.clear();
+
+  if (size > 0) {
+    const uint32_t* words = &m_words[edge.wordBegin];
+    HistoryEntry entry;
+    entry.path = GetPathId(NO_PATH, edgeId);
+    entry.count = 1;
+    for (size_t start = 0; start < size; ++start) {
+      MBRNgram ngram;
+      for (size_t end = start; end < start + bleu_order && end < size; ++end) {
+        ngram.Append(words[end]);
+        entry.ngram = GetNgramId(ngram);
+        history.push_back(entry);
+      }
+    }
+  }
+
+  for (uint32_t in = m_firstIncoming[edge.tail]; in < m_firstIncoming[edge.tail + 1] && size > 0; ++in) {
+    const Edge& prev = m_edges[in];
+    const size_t prevSize = prev.wordEnd - prev.wordBegin;
+    const uint32_t* prevEnd = &m_words[0] + prev.wordEnd;
+    const vector<HistoryEntry>& prevHistory = m_histories[in];
+    for (size_t h = 0; h < prevHistory.size(); ++h) {
+      MBRNgram ngram = m_ngrams[prevHistory[h].ngram];
+      if (ngram.size >= bleu_order) {
+        continue;
+      }
+      //the n-gram must end with the words at the end of the previous edge
+      const size_t back = min<size_t>(ngram.size, prevSize);
+      if (!std::equal(ngram.words + ngram.size - back, ngram.words + ngram.size, prevEnd - back)) {
+        continue;
+      }
+      HistoryEntry entry;
+      entry.path = GetPathId(prevHistory[h].path, edgeId);
+      entry.count = prevHistory[h].count;
+      const uint32_t* words = &m_words[edge.wordBegin];
+      for (size_t i = 0; i < size && ngram.size < bleu_order; ++i) {
+        ngram.Append(words[i]);
+        entry.ngram = GetNgramId(ngram);
+        history.push_back(entry);
+      }
+    }
+  }
+
+  //merge repeated (n-gram, path) pairs
+  sort(history.begin(), history.end());
+  size_t last = 0;
+  for (size_t i = 1; i < history.size(); ++i) {
+    if (history[i].ngram == history[last].ngram && history[i].path == history[last].path) {
+      history[last].count += history[i].count;
+    } else {
+      history[++last] = history[i];
+    }
+  }
+  if (!history.empty()) {
+    history.resize(last + 1);
   }
 }
 
-NgramScores::NodeScoreIterator NgramScores::nodeBegin(const Hypothesis* node)
+void MBRLattice::CalcNgramExpectations(bool posteriors, vector<float>& ngramScores)
 {
-  return m_scores[node].begin();
+  const size_t numNodes = GetNumNodes();
+
+  //forward score of node 0 is 1 (or 0 in logprob space); so is that of any
+  //node that lost all of its incoming edges in pruning
+  vector<float> forwardScore(numNodes, 0.0f);
+  //ngram scores for each node, kept until all successors are processed
+  vector<vector<pair<uint32_t, float> > > nodeScores(numNodes);
+  vector<uint32_t> pendingOutgoing(m_numOutgoing);
+  m_histories.assign(m_edges.size(), vector<HistoryEntry>());
+
+  //scratch space, indexed by n-gram id
+  vector<float> scores;
+  vector<uint32_t> scoreStamp;
+  vector<uint32_t> edgeStamp;
+  vector<uint32_t> touched;
+  uint32_t stamp = 0;
+
+  vector<float> finalScores;
+  float Z = 9999999; //the total score of the lattice
+
+  for (size_t node = 1; node < numNodes; ++node) {
+    const uint32_t first = m_firstIncoming[node];
+    const uint32_t last = m_firstIncoming[node + 1];
+    for (uint32_t e = first; e < last; ++e) {
+      const Edge& edge = m_edges[e];
+      if (e == first) {
+        forwardScore[node] = forwardScore[edge.tail] + edge.score;
+      } else {
+        forwardScore[node] = log_sum(forwardScore[node], forwardScore[edge.tail] + edge.score);
+      }
+    }
+
+    //Process ngrams now
+    touched.clear();
+    const uint32_t nodeStamp = ++stamp;
+    for (uint32_t e = first; e < last; ++e) {
+      const Edge& edge = m_edges[e];
+      vector<HistoryEntry>& history = m_histories[e];
+      CalcHistory(e, history);
+      if (scores.size() < m_ngrams.size()) {
+        scores.resize(m_ngrams.size());
+        scoreStamp.resize(m_ngrams.size(), 0);
+        edgeStamp.resize(m_ngrams.size(), 0);
+      }
+
+      //let's first score ngrams introduced by this edge
+      const uint32_t historyStamp = ++stamp;
+      for (size_t h = 0; h < history.size(); ++h) {
+        const HistoryEntry& entry = history[h];
+        edgeStamp[entry.ngram] = historyStamp;
+        //Score of an n-gram is forward score of tail node of leftmost edge + all edge scores
+        const Path& path = m_paths[entry.path];
+        const float score = forwardScore[path.firstTail] + path.score;
+        //if we're doing expectations, then the number of times the ngram
+        //appears on the path is relevant.
+        const size_t count = posteriors ? 1 : entry.count;
+        for (size_t k = 0; k < count; ++k) {
+          if (scoreStamp[entry.ngram] != nodeStamp) {
+            scoreStamp[entry.ngram] = nodeStamp;
+            scores[entry.ngram] = score;
+            touched.push_back(entry.ngram);
+          } else {
+            scores[entry.ngram] = log_sum(score, scores[entry.ngram]);
+          }
+        }
+      }
+
+      //Now score ngrams that are just being propagated from the history
+      const vector<pair<uint32_t, float> >& tailScores = nodeScores[edge.tail];
+      for (size_t i = 0; i < tailScores.size(); ++i) {
+        const uint32_t ngram = tailScores[i].first;
+        // For posteriors, don't double count ngrams
+        if (posteriors && edgeStamp[ngram] == historyStamp) {
+          continue;
+        }
+        const float score = edge.score + tailScores[i].second;
+        if (scoreStamp[ngram] != nodeStamp) {
+          scoreStamp[ngram] = nodeStamp;
+          scores[ngram] = score;
+          touched.push_back(ngram);
+        } else {
+          scores[ngram] = log_sum(score, scores[ngram]);
+        }
+      }
+    }
+
+    vector<pair<uint32_t, float> >& currScores = nodeScores[node];
+    currScores.reserve(touched.size());
+    for (size_t i = 0; i < touched.size(); ++i) {
+      currScores.push_back(make_pair(touched[i], scores[touched[i]]));
+    }
+
+    if (m_complete[node]) {
+      finalScores.resize(m_ngrams.size(), -numeric_limits<float>::infinity());
+      for (size_t i = 0; i < currScores.size(); ++i) {
+        float& finalScore = finalScores[currScores[i].first];
+        if (finalScore == -numeric_limits<float>::infinity()) {
+          finalScore = currScores[i].second;
+        } else {
+          finalScore = log_sum(currScores[i].second, finalScore);
+        }
+      }
+      if (Z == 9999999) {
+        Z = forwardScore[node];
+      } else {
+        Z = log_sum(Z, forwardScore[node]);
+      }
+    }
+
+    //release what no other node needs
+    for (uint32_t e = first; e < last; ++e) {
+      const uint32_t tail = m_edges[e].tail;
+      if (--pendingOutgoing[tail] == 0) {
+        vector<pair<uint32_t, float> >().swap(nodeScores[tail]);
+        for (uint32_t in = m_firstIncoming[tail]; in < m_firstIncoming[tail + 1]; ++in) {
+          vector<HistoryEntry>().swap(m_histories[in]);
+        }
+      }
+    }
+  }
+  m_histories.clear();
+
+  ngramScores.assign(m_ngrams.size(), -numeric_limits<float>::infinity());
+  for (size_t i = 0; i < finalScores.size(); ++i) {
+    if (finalScores[i] != -numeric_limits<float>::infinity()) {
+      ngramScores[i] = finalScores[i] - Z;
+      VERBOSE(4, "ngram " << i << " [" << ngramScores[i] << "]" << endl);
+    }
+  }
+}
+
+MBRNgramScores::MBRNgramScores(MBRLattice& lattice, bool posteriors)
+  : m_lattice(lattice)
+{
+  lattice.CalcNgramExpectations(posteriors, m_scores);
+}
+
+void MBRNgramScores::CountNgrams(const vector<Word>& words, Counts& counts) const
+{
+  vector<uint32_t> ids(words.size());
+  boost::unordered_map<Word, uint32_t> unknown;
+  for (size_t i = 0; i < words.size(); ++i) {
+    if (!m_lattice.FindWordId(words[i], ids[i])) {
+      boost::unordered_map<Word, uint32_t>::const_iterator it = unknown.find(words[i]);
+      if (it == unknown.end()) {
+        it = unknown.insert(make_pair(words[i], numeric_limits<uint32_t>::max() - unknown.size())).first;
+      }
+      ids[i] = it->second;
+    }
+  }
+  for (size_t start = 0; start < ids.size(); ++start) {
+    MBRNgram ngram;
+    for (size_t end = start; end < start + bleu_order && end < ids.size(); ++end) {
+      ngram.Append(ids[end]);
+      ++counts[ngram];
+    }
+  }
 }
 
+bool MBRNgramScores::Find(const MBRNgram& ngram, float& score) const
+{
+  uint32_t id;
+  if (!m_lattice.FindNgramId(ngram, id) || m_scores[id] == -numeric_limits<float>::infinity()) {
+    return false;
+  }
+  score = m_scores[id];
+  return true;
+}
 
-NgramScores::NodeScoreIterator NgramScores::nodeEnd(const Hypothesis* node)
+float MBRNgramScores::ExpectedLength() const
 {
-  return m_scores[node].end();
+  float length = 0.0f;
+  for (size_t id = 0; id < m_scores.size(); ++id) {
+    if (m_lattice.GetNgram(id).size == 1 && m_scores[id] != -numeric_limits<float>::infinity()) {
+      length += exp(m_scores[id]);
+    }
+  }
+  return length;
 }
 
 LatticeMBRSolution::LatticeMBRSolution(const TrellisPath& path, bool isMap) :
@@ -97,24 +426,21 @@ LatticeMBRSolution::LatticeMBRSolution(const TrellisPath& path, bool isMap) :
 }
 
 
-void LatticeMBRSolution::CalcScore(map<Phrase, float>& finalNgramScores, const vector<float>& thetas, float mapWeight)
+void LatticeMBRSolution::CalcScore(const MBRNgramScores& finalNgramScores, const vector<float>& thetas, float mapWeight)
 {
   m_ngramScores.assign(thetas.size()-1, -10000);
 
-  map < Phrase, int > counts;
-  extract_ngrams(m_words,counts);
+  MBRNgramScores::Counts counts;
+  finalNgramScores.CountNgrams(m_words, counts);
 
   //Now score this translation
   m_score = thetas[0] * m_words.size();
 
   //Calculate the ngramScores, working in log space at first
-  for (map < Phrase, int >::iterator ngrams = counts.begin(); ngrams != counts.end(); ++ngrams) {
+  for (MBRNgramScores::Counts::const_iterator ngrams = counts.begin(); ngrams != counts.end(); ++ngrams) {
     float ngramPosterior = UNKNGRAMLOGPROB;
-    map<Phrase,float>::const_iterator ngramPosteriorIt = finalNgramScores.find(ngrams->first);
-    if (ngramPosteriorIt != finalNgramScores.end()) {
-      ngramPosterior = ngramPosteriorIt->second;
-    }
-    size_t ngramSize = ngrams->first.GetSize();
+    finalNgramScores.Find(ngrams->first, ngramPosterior);
+    size_t ngramSize = ngrams->first.size;
     m_ngramScores[ngramSize-1] = log_sum(log((float)ngrams->second) + ngramPosterior,m_ngramScores[ngramSize-1]);
   }
 
@@ -130,7 +456,20 @@ void LatticeMBRSolution::CalcScore(map<Phrase, float>& finalNgramScores, const v
 }
 
 
-void pruneLatticeFB(Lattice & connectedHyp, map < const Hypothesis*, set <const Hypothesis* > > & outgoingHyps, map<const Hypothesis*, vector<Edge> >& incomingEdges,
+namespace
+{
+//An edge of the pruned lattice, before nodes are numbered
+struct PrunedEdge {
+  const Hypothesis* tail;
+  const Hypothesis* head;
+  float score;
+  const Phrase* words;
+  PrunedEdge(const Hypothesis* from, const Hypothesis* to, float s, const Phrase& phrase)
+    : tail(from), head(to), score(s), words(&phrase) {}
+};
+}
+
+void pruneLatticeFB(Lattice & connectedHyp, map < const Hypothesis*, set <const Hypothesis* > > & outgoingHyps, MBRLattice& lattice,
                     const vector< float> & estimatedScores, const Hypothesis* bestHypo, size_t edgeDensity, float scale)
 {
 
@@ -168,7 +507,8 @@ void pruneLatticeFB(Lattice & connectedHyp, map < const Hypothesis*, set <const
   }
 
 
-  set <const Hypothesis*> survivingHyps; //store hyps that make the cut in this
+  boost::unordered_set<const Hypothesis*> survivingHyps; //store hyps that make the cut in this
+  vector<PrunedEdge> edges;
 
   VERBOSE(2, "BEST HYPO TARGET LENGTH : " << bestHypo->GetSize() << endl)
   size_t numEdgesTotal = edgeDensity * bestHypo->GetSize(); //as per Shankar, aim for (density * target length of MAP solution) arcs
@@ -193,9 +533,7 @@ void pruneLatticeFB(Lattice & connectedHyp, map < const Hypothesis*, set <const
 
     // is its best predecessor already included ?
     if (survivingHyps.find(currHyp->GetPrevHypo()) != survivingHyps.end()) { //yes, then add an edge
-      vector <Edge>& edges = incomingEdges[currHyp];
-      Edge winningEdge(currHyp->GetPrevHypo(),currHyp,scale*(currHyp->GetScore() - currHyp->GetPrevHypo()->GetScore()),currHyp->GetCurrTargetPhrase());
-      edges.push_back(winningEdge);
+      edges.push_back(PrunedEdge(currHyp->GetPrevHypo(),currHyp,scale*(currHyp->GetScore() - currHyp->GetPrevHypo()->GetScore()),currHyp->GetCurrTargetPhrase()));
       ++numEdgesCreated;
     }
 
@@ -208,9 +546,7 @@ void pruneLatticeFB(Lattice & connectedHyp, map < const Hypothesis*, set <const
         const Hypothesis* loserPrevHypo = loserHypo->GetPrevHypo();
         if (survivingHyps.find(loserPrevHypo) != survivingHyps.end()) { //found it, add edge
           double arcScore = loserHypo->GetScore() - loserPrevHypo->GetScore();
-          Edge losingEdge(loserPrevHypo, currHyp, arcScore*scale, loserHypo->GetCurrTargetPhrase());
-          vector <Edge>& edges = incomingEdges[currHyp];
-          edges.push_back(losingEdge);
+          edges.push_back(PrunedEdge(loserPrevHypo, currHyp, arcScore*scale, loserHypo->GetCurrTargetPhrase()));
           ++numEdgesCreated;
         }
       }
@@ -229,10 +565,7 @@ void pruneLatticeFB(Lattice & connectedHyp, map < const Hypothesis*, set <const
 
         //Curr Hyp can be : a) the best predecessor  of succ b) or an arc attached to succ
         if (succHyp->GetPrevHypo() == currHyp) { //best predecessor
-          vector <Edge>& succEdges = incomingEdges[succHyp];
-          Edge succWinningEdge(currHyp, succHyp, scale*(succHyp->GetScore() - currHyp->GetScore()), succHyp->GetCurrTargetPhrase());
-          succEdges.push_back(succWinningEdge);
-          survivingHyps.insert(succHyp);
+          edges.push_back(PrunedEdge(currHyp, succHyp, scale*(succHyp->GetScore() - currHyp->GetScore()), succHyp->GetCurrTargetPhrase()));
           ++numEdgesCreated;
         }
 
@@ -245,10 +578,8 @@ void pruneLatticeFB(Lattice & connectedHyp, map < const Hypothesis*, set <const
             const Hypothesis *loserHypo = *iterArcList;
             const Hypothesis* loserPrevHypo = loserHypo->GetPrevHypo();
             if (loserPrevHypo == currHyp) { //found it
-              vector <Edge>& succEdges = incomingEdges[succHyp];
               double arcScore = loserHypo->GetScore() - currHyp->GetScore();
-              Edge losingEdge(currHyp, succHyp,scale* arcScore, loserHypo->GetCurrTargetPhrase());
-              succEdges.push_back(losingEdge);
+              edges.push_back(PrunedEdge(currHyp, succHyp,scale* arcScore, loserHypo->GetCurrTargetPhrase()));
               ++numEdgesCreated;
             }
           }
@@ -257,17 +588,25 @@ void pruneLatticeFB(Lattice & connectedHyp, map < const Hypothesis*, set <const
     }
   }
 
-  connectedHyp.clear();
-  for (set <const Hypothesis*>::iterator it =  survivingHyps.begin(); it != survivingHyps.end(); ++it) {
-    connectedHyp.push_back(*it);
+  //number the surviving hyps by increasing source word coverage, which
+  //orders them topologically, and build the lattice
+  connectedHyp.assign(survivingHyps.begin(), survivingHyps.end());
+  stable_sort(connectedHyp.begin(), connectedHyp.end(), ascendingCoverageCmp);
+  boost::unordered_map<const Hypothesis*, uint32_t> nodeIds;
+  for (size_t i = 0; i < connectedHyp.size(); ++i) {
+    nodeIds[connectedHyp[i]] = lattice.AddNode(connectedHyp[i]->GetWordsBitmap().IsComplete());
+  }
+  for (size_t i = 0; i < edges.size(); ++i) {
+    lattice.AddEdge(nodeIds[edges[i].tail], nodeIds[edges[i].head], edges[i].score, *edges[i].words);
   }
+  lattice.Finish();
 
   VERBOSE(2, "Done! Num edges created : "<< numEdgesCreated << ", numEdges wanted " << numEdgesTotal << endl)
 
   IFVERBOSE(3) {
     cerr << "Surviving hyps: " ;
-    for (set <const Hypothesis*>::iterator it =  survivingHyps.begin(); it != survivingHyps.end(); ++it) {
-      cerr << (*it)->GetId() << " ";
+    for (size_t i = 0; i < connectedHyp.size(); ++i) {
+      cerr << connectedHyp[i]->GetId() << " ";
     }
     cerr << endl;
   }
@@ -275,228 +614,6 @@ void pruneLatticeFB(Lattice & connectedHyp, map < const Hypothesis*, set <const
 
 }
 
-void calcNgramExpectations(Lattice & connectedHyp, map<const Hypothesis*, vector<Edge> >& incomingEdges,
-                           map<Phrase, float>& finalNgramScores, bool posteriors)
-{
-
-  sort(connectedHyp.begin(),connectedHyp.end(),ascendingCoverageCmp); //sort by increasing source word cov
-
-  /*cerr << "Lattice:" << endl;
-  for (Lattice::const_iterator i = connectedHyp.begin(); i != connectedHyp.end(); ++i) {
-      const Hypothesis* h = *i;
-      cerr << *h << endl;
-      const vector<Edge>& edges = incomingEdges[h];
-      for (size_t e = 0; e < edges.size(); ++e) {
-          cerr << edges[e];
-      }
-  }*/
-
-  map<const Hypothesis*, float> forwardScore;
-  forwardScore[connectedHyp[0]] = 0.0f; //forward score of hyp 0 is 1 (or 0 in logprob space)
-  set< const Hypothesis *> finalHyps; //store completed hyps
-
-  NgramScores ngramScores;//ngram scores for each hyp
-
-  for (size_t i = 1; i < connectedHyp.size(); ++i) {
-    const Hypothesis* currHyp = connectedHyp[i];
-    if (currHyp->GetWordsBitmap().IsComplete()) {
-      finalHyps.insert(currHyp);
-    }
-
-    VERBOSE(3, "Processing hyp: " << currHyp->GetId() << ", num words cov= " << currHyp->GetWordsBitmap().GetNumWordsCovered() <<  endl)
-
-    vector <Edge> & edges = incomingEdges[currHyp];
-    for (size_t e = 0; e < edges.size(); ++e) {
-      const Edge& edge = edges[e];
-      if (forwardScore.find(currHyp) == forwardScore.end()) {
-        forwardScore[currHyp] = forwardScore[edge.GetTailNode()] + edge.GetScore();
-        VERBOSE(3, "Fwd score["<<currHyp->GetId()<<"] = fwdScore["<<edge.GetTailNode()->GetId() << "] + edge Score: " << edge.GetScore() << endl)
-      } else {
-        forwardScore[currHyp] = log_sum(forwardScore[currHyp], forwardScore[edge.GetTailNode()] + edge.GetScore());
-        VERBOSE(3, "Fwd score["<<currHyp->GetId()<<"] += fwdScore["<<edge.GetTailNode()->GetId() << "] + edge Score: " << edge.GetScore() << endl)
-      }
-    }
-
-    //Process ngrams now
-    for (size_t j =0 ; j < edges.size(); ++j) {
-      Edge& edge = edges[j];
-      const NgramHistory & incomingPhrases = edge.GetNgrams(incomingEdges);
-
-      //let's first score ngrams introduced by this edge
-      for (NgramHistory::const_iterator it = incomingPhrases.begin(); it != incomingPhrases.end(); ++it) {
-        const Phrase& ngram = it->first;
-        const PathCounts& pathCounts = it->second;
-        VERBOSE(4, "Calculating score for: " << it->first << endl)
-
-        for (PathCounts::const_iterator pathCountIt = pathCounts.begin(); pathCountIt != pathCounts.end(); ++pathCountIt) {
-          //Score of an n-gram is forward score of head node of leftmost edge + all edge scores
-          const Path&  path = pathCountIt->first;
-          //cerr << "path count for " << ngram << " is " << pathCountIt->second << endl;
-          float score = forwardScore[path[0]->GetTailNode()];
-          for (size_t i = 0; i < path.size(); ++i) {
-            score += path[i]->GetScore();
-          }
-          //if we're doing expectations, then the number of times the ngram
-          //appears on the path is relevant.
-          size_t count = posteriors ? 1 : pathCountIt->second;
-          for (size_t k = 0; k < count; ++k) {
-            ngramScores.addScore(currHyp,ngram,score);
-          }
-        }
-      }
-
-      //Now score ngrams that are just being propagated from the history
-      for (NgramScores::NodeScoreIterator it = ngramScores.nodeBegin(edge.GetTailNode());
-           it != ngramScores.nodeEnd(edge.GetTailNode()); ++it) {
-        const Phrase & currNgram = *(it->first);
-        float currNgramScore = it->second;
-        VERBOSE(4, "Calculating score for: " << currNgram << endl)
-
-        // For posteriors, don't double count ngrams
-        if (!posteriors || incomingPhrases.find(currNgram) == incomingPhrases.end()) {
-          float score = edge.GetScore() + currNgramScore;
-          ngramScores.addScore(currHyp,currNgram,score);
-        }
-      }
-
-    }
-  }
-
-  float Z = 9999999; //the total score of the lattice
-
-  //Done - Print out ngram posteriors for final hyps
-  for (set< const Hypothesis *>::iterator finalHyp = finalHyps.begin(); finalHyp != finalHyps.end(); ++finalHyp) {
-    const Hypothesis* hyp = *finalHyp;
-
-    for (NgramScores::NodeScoreIterator it = ngramScores.nodeBegin(hyp); it != ngramScores.nodeEnd(hyp); ++it) {
-      const Phrase& ngram = *(it->first);
-      if (finalNgramScores.find(ngram) == finalNgramScores.end()) {
-        finalNgramScores[ngram] = it->second;
-      } else {
-        finalNgramScores[ngram] = log_sum(it->second,  finalNgramScores[ngram]);
-      }
-    }
-
-    if (Z == 9999999) {
-      Z = forwardScore[hyp];
-    } else {
-      Z = log_sum(Z, forwardScore[hyp]);
-    }
-  }
-
-  //Z *= scale;  //scale the score
-
-  for (map<Phrase, float>::iterator finalScoresIt = finalNgramScores.begin();  finalScoresIt != finalNgramScores.end(); ++finalScoresIt) {
-    finalScoresIt->second =  finalScoresIt->second - Z;
-    IFVERBOSE(2) {
-      VERBOSE(2,finalScoresIt->first << " [" << finalScoresIt->second << "]" << endl);
-    }
-  }
-
-}
-
-const NgramHistory& Edge::GetNgrams(map<const Hypothesis*, vector<Edge> > & incomingEdges)
-{
-
-  if (m_ngrams.size() > 0)
-    return m_ngrams;
-
-  const Phrase& currPhrase = GetWords();
-  //Extract the n-grams local to this edge
-  for (size_t start = 0; start < currPhrase.GetSize(); ++start) {
-    for (size_t end = start; end < start + bleu_order; ++end) {
-      if (end < currPhrase.GetSize()) {
-        Phrase edgeNgram(end-start+1);
-        for (size_t index = start; index <= end; ++index) {
-          edgeNgram.AddWord(currPhrase.GetWord(index));
-        }
-        //cout << "Inserting Phrase : " << edgeNgram << endl;
-        vector<const Edge*> edgeHistory;
-        edgeHistory.push_back(this);
-        storeNgramHistory(edgeNgram, edgeHistory);
-      } else {
-        break;
-      }
-    }
-  }
-
-  map<const Hypothesis*, vector<Edge> >::iterator it = incomingEdges.find(m_tailNode);
-  if (it != incomingEdges.end()) { //node has incoming edges
-    vector<Edge> & inEdges = it->second;
-
-    for (vector<Edge>::iterator edge = inEdges.begin(); edge != inEdges.end(); ++edge) {//add the ngrams straddling prev and curr edge
-      const NgramHistory & edgeIncomingNgrams = edge->GetNgrams(incomingEdges);
-      for (NgramHistory::const_iterator edgeInNgramHist = edgeIncomingNgrams.begin(); edgeInNgramHist != edgeIncomingNgrams.end(); ++edgeInNgramHist) {
-        const Phrase& edgeIncomingNgram = edgeInNgramHist->first;
-        const PathCounts &  edgeIncomingNgramPaths = edgeInNgramHist->second;
-        size_t back = min(edgeIncomingNgram.GetSize(), edge->GetWordsSize());
-        const Phrase&  edgeWords = edge->GetWords();
-        IFVERBOSE(3) {
-          cerr << "Edge: "<< *edge <<endl;
-          cerr << "edgeWords: " << edgeWords << endl;
-          cerr << "edgeInNgram: " << edgeIncomingNgram << endl;
-        }
-
-        Phrase edgeSuffix(ARRAY_SIZE_INCR);
-        Phrase ngramSuffix(ARRAY_SIZE_INCR);
-        GetPhraseSuffix(edgeWords,back,edgeSuffix);
-        GetPhraseSuffix(edgeIncomingNgram,back,ngramSuffix);
-
-        if (ngramSuffix == edgeSuffix) { //we've got the suffix of previous edge
-          size_t  edgeInNgramSize =  edgeIncomingNgram.GetSize();
-
-          for (size_t i = 0; i < GetWordsSize() && i + edgeInNgramSize < bleu_order ; ++i) {
-            Phrase newNgram(edgeIncomingNgram);
-            for (size_t j = 0; j <= i ; ++j) {
-              newNgram.AddWord(GetWords().GetWord(j));
-            }
-            VERBOSE(3, "Inserting New Phrase : " << newNgram << endl)
-
-            for (PathCounts::const_iterator pathIt = edgeIncomingNgramPaths.begin(); pathIt !=  edgeIncomingNgramPaths.end(); ++pathIt) {
-              Path newNgramPath = pathIt->first;
-              newNgramPath.push_back(this);
-              storeNgramHistory(newNgram, newNgramPath, pathIt->second);
-            }
-          }
-        }
-      }
-    }
-  }
-  return m_ngrams;
-}
-
-//Add the last lastN words of origPhrase to targetPhrase
-void Edge::GetPhraseSuffix(const Phrase&  origPhrase, size_t lastN, Phrase& targetPhrase) const
-{
-  size_t origSize = origPhrase.GetSize();
-  size_t startIndex = origSize - lastN;
-  for (size_t index = startIndex; index < origPhrase.GetSize(); ++index) {
-    targetPhrase.AddWord(origPhrase.GetWord(index));
-  }
-}
-
-bool Edge::operator< (const Edge& compare ) const
-{
-  if (m_headNode->GetId() < compare.m_headNode->GetId())
-    return true;
-  if (compare.m_headNode->GetId() < m_headNode->GetId())
-    return false;
-  if (m_tailNode->GetId() < compare.m_tailNode->GetId())
-    return true;
-  if (compare.m_tailNode->GetId() < m_tailNode->GetId())
-    return false;
-  return GetScore() <  compare.GetScore();
-}
-
-ostream& operator<< (ostream& out, const Edge& edge)
-{
-  out << "Head: " << edge.m_headNode->GetId()
-      << ", Tail: " << edge.m_tailNode->GetId()
-      << ", Score: " << edge.m_score
-      << ", Phrase: " << edge.m_targetPhrase << endl;
-  return out;
-}
-
 bool ascendingCoverageCmp(const Hypothesis* a, const Hypothesis* b)
 {
   return (a->GetWordsBitmap().GetNumWordsCovered()
@@ -509,17 +626,16 @@ void getLatticeMBRNBest(const Manager& manager, const TrellisPathList& nBestList
 {
   std::map < int, bool > connected;
   std::vector< const Hypothesis *> connectedList;
-  map<Phrase, float> ngramPosteriors;
   std::map < const Hypothesis*, set <const Hypothesis*> > outgoingHyps;
-  map<const Hypothesis*, vector<Edge> > incomingEdges;
+  MBRLattice lattice;
   vector< float> estimatedScores;
   manager.GetForwardBackwardSearchGraph(&connected, &connectedList,
                                         &outgoingHyps, &estimatedScores);
   LMBR_Options const& lmbr = manager.options()->lmbr;
   MBR_Options  const& mbr  = manager.options()->mbr;
-  pruneLatticeFB(connectedList, outgoingHyps, incomingEdges, estimatedScores,
+  pruneLatticeFB(connectedList, outgoingHyps, lattice, estimatedScores,
                  manager.GetBestHypothesis(), lmbr.pruning_factor, mbr.scale);
-  calcNgramExpectations(connectedList, incomingEdges, ngramPosteriors,true);
+  MBRNgramScores ngramPosteriors(lattice, true);
 
   vector<float> mbrThetas = lmbr.theta;
   float p = lmbr.precision;
@@ -541,16 +657,15 @@ void getLatticeMBRNBest(const Manager& manager, const TrellisPathList& nBestList
     VERBOSE(2,endl);
   }
   TrellisPathList::const_iterator iter;
-  size_t ctr = 0;
   LatticeMBRSolutionComparator comparator;
-  for (iter = nBestList.begin() ; iter != nBestList.end() ; ++iter, ++ctr) {
+  for (iter = nBestList.begin() ; iter != nBestList.end() ; ++iter) {
     const TrellisPath &path = **iter;
     solutions.push_back(LatticeMBRSolution(path,iter==nBestList.begin()));
     solutions.back().CalcScore(ngramPosteriors, mbrThetas, mapWeight);
-    sort(solutions.begin(), solutions.end(), comparator);
-    while (solutions.size() > n) {
-      solutions.pop_back();
-    }
+  }
+  stable_sort(solutions.begin(), solutions.end(), comparator);
+  if (solutions.size() > n) {
+    solutions.erase(solutions.begin() + n, solutions.end());
   }
   VERBOSE(2,"LMBR Score: " << solutions[0].GetScore() << endl);
 }
@@ -569,32 +684,20 @@ const TrellisPath doConsensusDecoding(const Manager& manager, const TrellisPathL
   static const float SMOOTH = 1;
 
   //calculate the ngram expectations
-  const StaticData& staticData = StaticData::Instance();
   std::map < int, bool > connected;
   std::vector< const Hypothesis *> connectedList;
-  map<Phrase, float> ngramExpectations;
   std::map < const Hypothesis*, set <const Hypothesis*> > outgoingHyps;
-  map<const Hypothesis*, vector<Edge> > incomingEdges;
+  MBRLattice lattice;
   vector< float> estimatedScores;
   manager.GetForwardBackwardSearchGraph(&connected, &connectedList, &outgoingHyps, &estimatedScores);
   LMBR_Options const& lmbr = manager.options()->lmbr;
   MBR_Options  const&  mbr = manager.options()->mbr;
-  pruneLatticeFB(connectedList, outgoingHyps, incomingEdges, estimatedScores,
+  pruneLatticeFB(connectedList, outgoingHyps, lattice, estimatedScores,
                  manager.GetBestHypothesis(), lmbr.pruning_factor, mbr.scale);
-  calcNgramExpectations(connectedList, incomingEdges, ngramExpectations,false);
+  MBRNgramScores ngramExpectations(lattice, false);
 
   //expected length is sum of expected unigram counts
-  //cerr << "Thread " << pthread_self() <<  " Ngram expectations size: " << ngramExpectations.size() << endl;
-  float ref_length = 0.0f;
-  for (map<Phrase,float>::const_iterator ref_iter = ngramExpectations.begin();
-       ref_iter != ngramExpectations.end(); ++ref_iter) {
-    //cerr << "Ngram: " << ref_iter->first << " score: " <<
-    //    ref_iter->second << endl;
-    if (ref_iter->first.GetSize() == 1) {
-      ref_length += exp(ref_iter->second);
-      //    cerr << "Expected for " << ref_iter->first << " is " << exp(ref_iter->second) << endl;
-    }
-  }
+  float ref_length = ngramExpectations.ExpectedLength();
 
   VERBOSE(2,"REF Length: " << ref_length << endl);
 
@@ -606,14 +709,9 @@ const TrellisPath doConsensusDecoding(const Manager& manager, const TrellisPathL
   for (iter = nBestList.begin() ; iter != nBestList.end() ; ++iter) {
     const TrellisPath &path = **iter;
     vector<Word> words;
-    map<Phrase,int> ngrams;
+    MBRNgramScores::Counts ngrams;
     GetOutputWords(path,words);
-    /*for (size_t i = 0; i < words.size(); ++i) {
-        cerr << words[i].GetFactor(0)->GetString() << " ";
-    }
-    cerr << endl;
-    */
-    extract_ngrams(words,ngrams);
+    ngramExpectations.CountNgrams(words,ngrams);
 
     vector<float> comps(2*BLEU_ORDER+1);
     float logbleu = 0.0;
@@ -624,11 +722,11 @@ const TrellisPath doConsensusDecoding(const Manager& manager, const TrellisPathL
       comps[2*i+1] = max(hyp_length-i,0);
     }
 
-    for (map<Phrase,int>::const_iterator hyp_iter = ngrams.begin();
+    for (MBRNgramScores::Counts::const_iterator hyp_iter = ngrams.begin();
          hyp_iter != ngrams.end(); ++hyp_iter) {
-      map<Phrase,float>::const_iterator ref_iter = ngramExpectations.find(hyp_iter->first);
-      if (ref_iter != ngramExpectations.end()) {
-        comps[2*(hyp_iter->first.GetSize()-1)] += min(exp(ref_iter->second), (float)(hyp_iter->second));
+      float expectation;
+      if (ngramExpectations.Find(hyp_iter->first, expectation)) {
+        comps[2*(hyp_iter->first.size-1)] += min(exp(expectation), (float)(hyp_iter->second));
       }
 
     }
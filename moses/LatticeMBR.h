@@ -10,9 +10,12 @@
 #ifndef moses_cmd_LatticeMBR_h
 #define moses_cmd_LatticeMBR_h
 
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <set>
+#include <stdint.h>
+#include <boost/unordered_map.hpp>
 #include "moses/Hypothesis.h"
 #include "moses/Manager.h"
 #include "moses/TrellisPathList.h"
@@ -22,82 +25,145 @@
 namespace Moses
 {
 
-class Edge;
-
 typedef std::vector< const Moses::Hypothesis *> Lattice;
-typedef std::vector<const Edge*> Path;
-typedef std::map<Path, size_t> PathCounts;
-typedef std::map<Moses::Phrase, PathCounts > NgramHistory;
 
-class Edge
-{
-  const Moses::Hypothesis* m_tailNode;
-  const Moses::Hypothesis* m_headNode;
-  float m_score;
-  Moses::TargetPhrase m_targetPhrase;
-  NgramHistory m_ngrams;
+/** An n-gram of at most four target words, given by their ids */
+struct MBRNgram {
+  static const size_t MAX_ORDER = 4;
 
-public:
-  Edge(const Moses::Hypothesis* from, const Moses::Hypothesis* to, float score, const Moses::TargetPhrase& targetPhrase) : m_tailNode(from), m_headNode(to), m_score(score), m_targetPhrase(targetPhrase) {
-    //cout << "Creating new edge from Node " << from->GetId() << ", to Node : " << to->GetId() << ", score: " << score << " phrase: " << targetPhrase << endl;
-  }
+  uint32_t words[MAX_ORDER];
+  uint32_t size;
 
-  const Moses::Hypothesis* GetHeadNode() const {
-    return m_headNode;
-  }
+  MBRNgram() : size(0) {}
 
-  const Moses::Hypothesis* GetTailNode() const {
-    return m_tailNode;
+  void Append(uint32_t word) {
+    words[size++] = word;
   }
 
-  float GetScore() const {
-    return m_score;
-  }
-
-  size_t GetWordsSize() const {
-    return m_targetPhrase.GetSize();
+  bool operator==(const MBRNgram& other) const {
+    return size == other.size && std::equal(words, words + size, other.words);
   }
+};
 
-  const Moses::Phrase& GetWords() const {
-    return m_targetPhrase;
-  }
+size_t hash_value(const MBRNgram& ngram);
 
-  friend std::ostream& operator<< (std::ostream& out, const Edge& edge);
+/**
+* The pruned search lattice as a DAG with integer node ids, together with a
+* hashed store of the n-grams found on it.
+*
+* Nodes must be added in a topological order (e.g. by increasing source
+* coverage), starting with the empty hypothesis. Edges may be added in any
+* order; Finish() groups them by head node, keeping the order in which the
+* edges of each node were added.
+*/
+class MBRLattice
+{
+public:
+  MBRLattice();
 
-  const NgramHistory&  GetNgrams(  std::map<const Moses::Hypothesis*, std::vector<Edge> > & incomingEdges) ;
+  uint32_t AddNode(bool complete);
+  void AddEdge(uint32_t tail, uint32_t head, float score, const Moses::Phrase& words);
+  void Finish();
 
-  bool operator < (const Edge & compare) const;
+  size_t GetNumNodes() const {
+    return m_complete.size();
+  }
+  size_t GetNumEdges() const {
+    return m_edges.size();
+  }
 
-  void GetPhraseSuffix(const Moses::Phrase& origPhrase, size_t lastN, Moses::Phrase& targetPhrase) const;
+  /** Id of a target word, adding it if it is new */
+  uint32_t GetWordId(const Moses::Word& word);
+  /** Id of a target word, false if the lattice does not contain it */
+  bool FindWordId(const Moses::Word& word, uint32_t& id) const;
 
-  void storeNgramHistory(const Moses::Phrase& phrase, Path & path, size_t count = 1) {
-    m_ngrams[phrase][path]+= count;
+  size_t GetNumNgrams() const {
+    return m_ngrams.size();
+  }
+  const MBRNgram& GetNgram(uint32_t id) const {
+    return m_ngrams[id];
   }
+  /** Id of an n-gram, false if no path of the lattice contains it */
+  bool FindNgramId(const MBRNgram& ngram, uint32_t& id) const;
+
+  /**
+  * Calculate the log expected count of each n-gram (indexed by n-gram id),
+  * clipping counts at 1 (ie calculating posteriors) if posteriors==true.
+  * N-grams that are not on a path to a complete hypothesis get -inf.
+  */
+  void CalcNgramExpectations(bool posteriors, std::vector<float>& ngramScores);
 
+private:
+  struct Edge {
+    uint32_t tail;
+    uint32_t head;
+    float score;
+    uint32_t wordBegin;
+    uint32_t wordEnd;
+  };
+
+  /** A sequence of edges, stored as its last edge and the path before it */
+  struct Path {
+    uint32_t prefix;
+    uint32_t firstTail;
+    float score; // sum of edge scores
+  };
+
+  /** An n-gram ending on an edge, the path of edges it spans and the
+   *  number of times it occurs on that path */
+  struct HistoryEntry {
+    uint32_t ngram;
+    uint32_t path;
+    uint32_t count;
+    bool operator<(const HistoryEntry& other) const {
+      return ngram < other.ngram || (ngram == other.ngram && path < other.path);
+    }
+  };
+
+  uint32_t GetNgramId(const MBRNgram& ngram);
+  uint32_t GetPathId(uint32_t prefix, uint32_t edge);
+  void CalcHistory(uint32_t edge, std::vector<HistoryEntry>& history);
+
+  std::vector<bool> m_complete;
+  std::vector<Edge> m_edges;
+  std::vector<uint32_t> m_firstIncoming; // CSR index into m_edges by head
+  std::vector<uint32_t> m_numOutgoing;
+  std::vector<uint32_t> m_words;
+
+  boost::unordered_map<Moses::Word, uint32_t> m_wordIds;
+  boost::unordered_map<MBRNgram, uint32_t> m_ngramIds;
+  std::vector<MBRNgram> m_ngrams;
+  boost::unordered_map<uint64_t, uint32_t> m_pathIds;
+  std::vector<Path> m_paths;
+
+  //! n-grams ending on each edge, while successors of its head are pending
+  std::vector<std::vector<HistoryEntry> > m_histories;
 };
 
-/**
-* Data structure to hold the ngram scores as we traverse the lattice. Maps (hypo,ngram) to score
-*/
-class NgramScores
+/** Log posteriors (or expected counts) of the n-grams of a lattice */
+class MBRNgramScores
 {
 public:
-  NgramScores() {}
+  typedef boost::unordered_map<MBRNgram, int> Counts;
 
-  /** logsum this score to the existing score */
-  void addScore(const Moses::Hypothesis* node, const Moses::Phrase& ngram, float score);
+  MBRNgramScores(MBRLattice& lattice, bool posteriors);
 
-  /** Iterate through ngrams for selected node */
-  typedef std::map<const Moses::Phrase*, float>::const_iterator NodeScoreIterator;
-  NodeScoreIterator nodeBegin(const Moses::Hypothesis* node);
-  NodeScoreIterator nodeEnd(const Moses::Hypothesis* node);
+  /** Count the n-grams of a translation. Words that are not in the lattice
+   *  get ids of their own, so that their n-grams are never found. */
+  void CountNgrams(const std::vector<Moses::Word>& words, Counts& counts) const;
+
+  /** Log score of an n-gram, false if no complete path of the lattice has it */
+  bool Find(const MBRNgram& ngram, float& score) const;
+
+  /** Sum of the scores of all unigrams, ie the expected length if the
+   *  scores are expected counts */
+  float ExpectedLength() const;
 
 private:
-  std::set<Moses::Phrase> m_ngrams;
-  std::map<const Moses::Hypothesis*, std::map<const Moses::Phrase*, float> > m_scores;
+  const MBRLattice& m_lattice;
+  std::vector<float> m_scores;
 };
 
-
 /** Holds a lattice mbr solution, and its scores */
 class LatticeMBRSolution
 {
@@ -118,7 +184,7 @@ public:
   }
 
   /** Initialise ngram scores */
-  void CalcScore(std::map<Moses::Phrase, float>& finalNgramScores, const std::vector<float>& thetas, float mapWeight);
+  void CalcScore(const MBRNgramScores& finalNgramScores, const std::vector<float>& thetas, float mapWeight);
 
 private:
   std::vector<Moses::Word> m_words;
@@ -133,16 +199,13 @@ struct LatticeMBRSolutionComparator {
   }
 };
 
-void pruneLatticeFB(Lattice & connectedHyp, std::map < const Moses::Hypothesis*, std::set <const Moses::Hypothesis* > > & outgoingHyps, std::map<const Moses::Hypothesis*, std::vector<Edge> >& incomingEdges,
+//Prune the search graph to the given edge density (edges per target word of the best hypothesis) and build the lattice from what survives
+void pruneLatticeFB(Lattice & connectedHyp, std::map < const Moses::Hypothesis*, std::set <const Moses::Hypothesis* > > & outgoingHyps, MBRLattice& lattice,
                     const std::vector< float> & estimatedScores, const Moses::Hypothesis*, size_t edgeDensity,float scale);
 
 //Use the ngram scores to rerank the nbest list, return at most n solutions
 void getLatticeMBRNBest(const Moses::Manager& manager, const Moses::TrellisPathList& nBestList, std::vector<LatticeMBRSolution>& solutions, size_t n);
-//calculate expectated ngram counts, clipping at 1 (ie calculating posteriors) if posteriors==true.
-void calcNgramExpectations(Lattice & connectedHyp, std::map<const Moses::Hypothesis*, std::vector<Edge> >& incomingEdges, std::map<Moses::Phrase,
-                           float>& finalNgramScores, bool posteriors);
 void GetOutputFactors(const Moses::TrellisPath &path, std::vector <Moses::Word> &translation);
-void extract_ngrams(const std::vector<Moses::Word >& sentence, std::map < Moses::Phrase, int >  & allngrams);
 bool ascendingCoverageCmp(const Moses::Hypothesis* a, const Moses::Hypothesis* b);
 std::vector<Moses::Word> doLatticeMBR(const Moses::Manager& manager, const Moses::TrellisPathList& nBestList);
 const Moses::TrellisPath doConsensusDecoding(const Moses::Manager& manager, const Moses::TrellisPathList& nBestList);
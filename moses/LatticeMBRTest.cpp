@@ -0,0 +1,116 @@
+/***********************************************************************
+Moses - factored phrase-based language decoder
+Copyright (C) 2015- University of Edinburgh
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+***********************************************************************/
+
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <sstream>
+
+#include "FactorCollection.h"
+#include "LatticeMBR.h"
+
+using namespace Moses;
+using namespace std;
+
+namespace
+{
+
+Word MakeWord(const string &str)
+{
+  Word word;
+  word.SetFactor(0, FactorCollection::Instance().AddFactor(str));
+  return word;
+}
+
+Phrase MakePhrase(const string &str)
+{
+  Phrase phrase(0);
+  istringstream in(str);
+  string token;
+  while (in >> token) {
+    phrase.AddWord(MakeWord(token));
+  }
+  return phrase;
+}
+
+vector<Word> MakeWords(const string &str)
+{
+  Phrase phrase = MakePhrase(str);
+  vector<Word> words;
+  for (size_t i = 0; i < phrase.GetSize(); ++i) {
+    words.push_back(phrase.GetWord(i));
+  }
+  return words;
+}
+
+// Posterior (or expectation) of str as one n-gram, 0 if the lattice lacks it.
+float Score(const MBRNgramScores &scores, const string &str)
+{
+  MBRNgramScores::Counts counts;
+  vector<Word> words = MakeWords(str);
+  scores.CountNgrams(words, counts);
+  for (MBRNgramScores::Counts::const_iterator i = counts.begin(); i != counts.end(); ++i) {
+    float score;
+    if (i->first.size == words.size()) {
+      return scores.Find(i->first, score) ? exp(score) : 0.0f;
+    }
+  }
+  return -1;
+}
+
+// 0 -a-> 1 -b-> 2 with probability 1/4, 0 -a-> 1 -c a-> 2 with 3/4
+void MakeLattice(MBRLattice &lattice)
+{
+  lattice.AddNode(false);
+  lattice.AddNode(false);
+  lattice.AddNode(true);
+  lattice.AddEdge(1, 2, log(0.25f), MakePhrase("b"));
+  lattice.AddEdge(0, 1, 0.0f, MakePhrase("a"));
+  lattice.AddEdge(1, 2, log(0.75f), MakePhrase("c a"));
+  lattice.Finish();
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(lattice_mbr)
+
+BOOST_AUTO_TEST_CASE(posteriors)
+{
+  MBRLattice lattice;
+  MakeLattice(lattice);
+  MBRNgramScores scores(lattice, true);
+  BOOST_CHECK_CLOSE(Score(scores, "a"), 1.0f, 0.01);
+  BOOST_CHECK_CLOSE(Score(scores, "b"), 0.25f, 0.01);
+  BOOST_CHECK_CLOSE(Score(scores, "a b"), 0.25f, 0.01);
+  BOOST_CHECK_CLOSE(Score(scores, "a c a"), 0.75f, 0.01);
+  BOOST_CHECK_EQUAL(Score(scores, "b a"), 0.0f);
+  BOOST_CHECK_EQUAL(Score(scores, "unseen"), 0.0f);
+}
+
+BOOST_AUTO_TEST_CASE(expectations)
+{
+  MBRLattice lattice;
+  MakeLattice(lattice);
+  MBRNgramScores scores(lattice, false);
+  BOOST_CHECK_CLOSE(Score(scores, "a"), 1.75f, 0.01);
+  BOOST_CHECK_CLOSE(Score(scores, "c"), 0.75f, 0.01);
+  BOOST_CHECK_CLOSE(scores.ExpectedLength(), 2.75f, 0.01);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -39,6 +39,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "TranslationOptionCollection.h"
 #include "Timer.h"
 #include "moses/OutputCollector.h"
+#include "moses/BinaryNBest.h"
 #include "moses/FF/DistortionScoreProducer.h"
 #include "moses/LM/Base.h"
 #include "moses/TranslationModel/PhraseDictionary.h"
@@ -1595,7 +1596,11 @@ void Manager::OutputNBest(OutputCollector *collector) const
     ostringstream out;
     NBestOptions const& nbo = options()->nbest;
     CalcNBest(nbo.nbest_size, nBestList, nbo.only_distinct);
-    OutputNBest(out, nBestList);
+    if (nbo.binary) {
+      OutputBinaryNBest(out, nBestList);
+    } else {
+      OutputNBest(out, nBestList);
+    }
     collector->Write(m_source.GetTranslationId(), out.str());
   }
 
@@ -1605,11 +1610,6 @@ void
 Manager::
 OutputNBest(std::ostream& out, Moses::TrellisPathList const& nBestList) const
 {
-  NBestOptions const& nbo = options()->nbest;
-  bool reportAllFactors     = nbo.include_all_factors;
-  bool includeSegmentation  = nbo.include_segmentation;
-  bool includeWordAlignment = nbo.include_alignment_info;
-
   TrellisPathList::const_iterator iter;
   for (iter = nBestList.begin() ; iter != nBestList.end() ; ++iter) {
     const TrellisPath &path = **iter;
@@ -1630,47 +1630,84 @@ OutputNBest(std::ostream& out, Moses::TrellisPathList const& nBestList) const
     // total
     out << " ||| " << path.GetFutureScore();
 
-    //phrase-to-phrase segmentation
-    if (includeSegmentation) {
-      out << " |||";
-      for (int currEdge = (int)edges.size() - 2 ; currEdge >= 0 ; currEdge--) {
-        const Hypothesis &edge = *edges[currEdge];
-        const Range &sourceRange = edge.GetCurrSourceWordsRange();
-        Range targetRange = path.GetTargetWordsRange(edge);
-        out << " " << sourceRange.GetStartPos();
-        if (sourceRange.GetStartPos() < sourceRange.GetEndPos()) {
-          out << "-" << sourceRange.GetEndPos();
-        }
-        out<< "=" << targetRange.GetStartPos();
-        if (targetRange.GetStartPos() < targetRange.GetEndPos()) {
-          out<< "-" << targetRange.GetEndPos();
-        }
-      }
-    }
+    OutputNBestTrailer(out, path);
+
+    out << endl;
+  }
 
-    if (includeWordAlignment) {
-      out << " ||| ";
-      for (int currEdge = (int)edges.size() - 2 ; currEdge >= 0 ; currEdge--) {
-        const Hypothesis &edge = *edges[currEdge];
-        const Range &sourceRange = edge.GetCurrSourceWordsRange();
-        Range targetRange = path.GetTargetWordsRange(edge);
-        const int sourceOffset = sourceRange.GetStartPos();
-        const int targetOffset = targetRange.GetStartPos();
-        const AlignmentInfo &ai = edge.GetCurrTargetPhrase().GetAlignTerm();
+  out << std::flush;
+}
 
-        OutputAlignment(out, ai, sourceOffset, targetOffset);
+void
+Manager::
+OutputNBestTrailer(std::ostream& out, const TrellisPath &path) const
+{
+  NBestOptions const& nbo = options()->nbest;
+  bool includeSegmentation  = nbo.include_segmentation;
+  bool includeWordAlignment = nbo.include_alignment_info;
+  const std::vector<const Hypothesis *> &edges = path.GetEdges();
 
+  //phrase-to-phrase segmentation
+  if (includeSegmentation) {
+    out << " |||";
+    for (int currEdge = (int)edges.size() - 2 ; currEdge >= 0 ; currEdge--) {
+      const Hypothesis &edge = *edges[currEdge];
+      const Range &sourceRange = edge.GetCurrSourceWordsRange();
+      Range targetRange = path.GetTargetWordsRange(edge);
+      out << " " << sourceRange.GetStartPos();
+      if (sourceRange.GetStartPos() < sourceRange.GetEndPos()) {
+        out << "-" << sourceRange.GetEndPos();
+      }
+      out<< "=" << targetRange.GetStartPos();
+      if (targetRange.GetStartPos() < targetRange.GetEndPos()) {
+        out<< "-" << targetRange.GetEndPos();
       }
     }
+  }
+
+  if (includeWordAlignment) {
+    out << " ||| ";
+    for (int currEdge = (int)edges.size() - 2 ; currEdge >= 0 ; currEdge--) {
+      const Hypothesis &edge = *edges[currEdge];
+      const Range &sourceRange = edge.GetCurrSourceWordsRange();
+      Range targetRange = path.GetTargetWordsRange(edge);
+      const int sourceOffset = sourceRange.GetStartPos();
+      const int targetOffset = targetRange.GetStartPos();
+      const AlignmentInfo &ai = edge.GetCurrTargetPhrase().GetAlignTerm();
+
+      OutputAlignment(out, ai, sourceOffset, targetOffset);
 
-    if (options()->output.RecoverPath) {
-      out << " ||| ";
-      OutputInput(out, edges[0]);
     }
+  }
 
-    out << endl;
+  if (options()->output.RecoverPath) {
+    out << " ||| ";
+    OutputInput(out, edges[0]);
   }
+}
 
+void
+Manager::
+OutputBinaryNBest(std::ostream& out, Moses::TrellisPathList const& nBestList) const
+{
+  BinaryNBestWriter writer(m_source.GetTranslationId(),
+                           options()->nbest.include_feature_labels);
+  NBestFeatureScores scores;
+  TrellisPathList::const_iterator iter;
+  for (iter = nBestList.begin() ; iter != nBestList.end() ; ++iter) {
+    const TrellisPath &path = **iter;
+    const std::vector<const Hypothesis *> &edges = path.GetEdges();
+
+    ostringstream surface;
+    for (int currEdge = (int)edges.size() - 1 ; currEdge >= 0 ; currEdge--) {
+      OutputSurface(surface, *edges[currEdge]);
+    }
+    path.GetScoreBreakdown()->GetAllFeatureScores(scores);
+    ostringstream trailer;
+    OutputNBestTrailer(trailer, path);
+    writer.AddHypothesis(surface.str(), scores, path.GetFutureScore(), trailer.str());
+  }
+  writer.Write(out);
   out << std::flush;
 }
 
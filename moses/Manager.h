@@ -133,6 +133,9 @@ protected:
   mutable std::ostringstream m_alignmentOut;
 public:
   void OutputNBest(std::ostream& out, const Moses::TrellisPathList &nBestList) const;
+  void OutputBinaryNBest(std::ostream& out, const Moses::TrellisPathList &nBestList) const;
+  //! the fields after the total score of an n-best entry (segmentation, alignment, input path)
+  void OutputNBestTrailer(std::ostream& out, const TrellisPath &path) const;
   void OutputSurface(std::ostream &out,
                      Hypothesis const& edge,
                      bool const recursive=false) const;
@@ -214,6 +214,7 @@ Parameter::Parameter()
   AddParam(nbest_opts,"include-segmentation-in-n-best", "include phrasal segmentation in the n-best list. default is false");
   AddParam(nbest_opts,"print-alignment-info-in-n-best",
            "Include word-to-word alignment in the n-best list. Word-to-word alignments are taken from the phrase table if any. Default is false");
+  AddParam(nbest_opts,"binary-n-best-list", "write the n-best list in binary form, which mert's extractor reads directly and convertBinaryNBest turns into text (phrase-based decoding only). Default is false");
 
   ///////////////////////////////////////////////////////////////////////////////////////
   // server options
@@ -240,6 +241,23 @@ Parameter::Parameter()
            "Timeout for sessions, e.g. '2h30m' or 1d (=24h)");
   AddParam(server_opts,"session-cache-size", string("Max. number of sessions cached.")
            +"Least recently used session is dumped first.");
+  AddParam(server_opts,"server-client-concurrency",
+           "Max. number of translation requests (or batch segments) per client IP "
+           "queued or decoded at the same time; requests and batches beyond it "
+           "are refused at once (default: 0 = no limit).");
+  AddParam(server_opts,"server-cache-size",
+           "Max. number of translation results cached by the server "
+           "(default: 0 = no cache).");
+  AddParam(server_opts,"server-max-queue",
+           "Reject requests right away when more than this many are waiting "
+           "for a decoder thread (default: 0 = never).");
+  AddParam(server_opts,"server-degrade-queue",
+           "Decode with smaller stack, cube pruning pop limit and number of "
+           "translation options per span when this many requests are waiting; "
+           "halved again at twice and three times this depth (default: 0 = never).");
+  AddParam(server_opts,"server-deadline",
+           "Default deadline of a request in milliseconds; requests can set "
+           "their own with the 'deadline' parameter (default: 0 = none).");
 
   po::options_description irstlm_opts("IRSTLM Options");
   AddParam(irstlm_opts,"clean-lm-cache",
@@ -6,6 +6,7 @@
 #include "util/exception.hh"
 #include "util/string_stream.hh"
 #include "ScoreComponentCollection.h"
+#include "BinaryNBest.h"
 #include "StaticData.h"
 #include "moses/FF/StatelessFeatureFunction.h"
 #include "moses/FF/StatefulFeatureFunction.h"
@@ -330,6 +331,50 @@ OutputAllFeatureScores(std::ostream &out, bool with_labels) const
   }
 }
 
+void
+ScoreComponentCollection::
+GetAllFeatureScores(NBestFeatureScores &scores) const
+{
+  scores.clear();
+  std::vector<const FeatureFunction*> ffs;
+  const vector<const StatefulFeatureFunction*>& sff
+  = StatefulFeatureFunction::GetStatefulFeatureFunctions();
+  for( size_t i=0; i<sff.size(); i++ ) {
+    if (sff[i]->IsTuneable()) ffs.push_back(sff[i]);
+  }
+  const vector<const StatelessFeatureFunction*>& slf
+  = StatelessFeatureFunction::GetStatelessFeatureFunctions();
+  for( size_t i=0; i<slf.size(); i++ ) {
+    if (slf[i]->IsTuneable()) ffs.push_back(slf[i]);
+  }
+
+  for (size_t g = 0; g < ffs.size(); ++g) {
+    const FeatureFunction *ff = ffs[g];
+    scores.labels.push_back(ff->GetScoreProducerDescription());
+    uint32_t size = 0;
+    if (ff->HasTuneableComponents()) {
+      vector<float> dense = GetScoresForProducer( ff );
+      for (size_t j = 0; j<dense.size(); ++j) {
+        if (ff->IsTuneableComponent(j)) {
+          scores.dense.push_back(dense[j]);
+          ++size;
+        }
+      }
+    }
+    scores.sizes.push_back(size);
+    scores.tuneable.push_back(ff->HasTuneableComponents());
+
+    const FVector sparse = GetVectorForProducer( ff );
+    for(FVector::FNVmap::const_iterator i = sparse.cbegin(); i != sparse.cend(); i++) {
+      NBestFeatureScores::Sparse entry;
+      entry.group = g;
+      entry.name = i->first.name();
+      entry.value = i->second;
+      scores.sparse.push_back(entry);
+    }
+  }
+}
+
 void
 ScoreComponentCollection::
 OutputFeatureScores(std::ostream& out, FeatureFunction const* ff,
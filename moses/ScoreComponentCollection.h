@@ -38,6 +38,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 namespace Moses
 {
 
+struct NBestFeatureScores;
+
 /**
  * Smaller version for just 1 FF.
  */
@@ -442,6 +444,8 @@ public:
   void OutputAllFeatureScores(std::ostream &out, bool with_labels) const;
   void OutputFeatureScores(std::ostream& out, Moses::FeatureFunction const* ff,
                            std::string &lastName, bool with_labels) const;
+  //! the scores printed by OutputAllFeatureScores(), for binary n-best lists
+  void GetAllFeatureScores(NBestFeatureScores &scores) const;
 
 #ifdef MPI_ENABLE
 public:
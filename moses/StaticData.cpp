@@ -23,6 +23,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include <string>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/atomic.hpp>
 
 #include "moses/FF/Factory.h"
 #include "TypeDef.h"
@@ -253,6 +254,7 @@ void StaticData::SetWeight(const FeatureFunction* sp, float weight)
 {
   m_allWeights.Resize();
   m_allWeights.Assign(sp,weight);
+  BumpModelEpoch();
 }
 
 void StaticData::SetWeights(const FeatureFunction* sp,
@@ -260,6 +262,22 @@ void StaticData::SetWeights(const FeatureFunction* sp,
 {
   m_allWeights.Resize();
   m_allWeights.Assign(sp,weights);
+  BumpModelEpoch();
+}
+
+namespace
+{
+boost::atomic<size_t> modelEpoch(0);
+}
+
+size_t StaticData::GetModelEpoch() const
+{
+  return modelEpoch.load();
+}
+
+void StaticData::BumpModelEpoch() const
+{
+  ++modelEpoch;
 }
 
 void StaticData::LoadNonTerminals()
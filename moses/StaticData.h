@@ -235,6 +235,12 @@ public:
   //Weights for feature with fixed number of values
   void SetWeights(const FeatureFunction* sp, const std::vector<float>& weights);
 
+  //! Incremented whenever weights or models change at run time (e.g. by
+  //! online updates), so that translations made before can be recognized
+  //! as outdated.
+  size_t GetModelEpoch() const;
+  void BumpModelEpoch() const;
+
   const std::string& GetFactorDelimiter() const {
     return m_factorDelimiter;
   }
@@ -74,6 +74,12 @@ void ThreadPool::Submit(boost::shared_ptr<Task> task)
   m_threadNeeded.notify_all();
 }
 
+size_t ThreadPool::GetQueueSize()
+{
+  boost::mutex::scoped_lock lock(m_mutex);
+  return m_tasks.size();
+}
+
 void ThreadPool::Stop(bool processRemainingJobs)
 {
   {
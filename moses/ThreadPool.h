@@ -88,6 +88,11 @@ public:
     m_queueLimit = limit;
   }
 
+  /**
+   * Number of jobs waiting for a thread
+   **/
+  size_t GetQueueSize();
+
 private:
   /**
    * The main loop executed by each thread.
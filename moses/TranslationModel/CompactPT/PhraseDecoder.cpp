@@ -31,6 +31,9 @@ namespace Moses
 
 PhraseDecoder::PhraseDecoder(
   PhraseDictionaryCompact &phraseDictionary,
+  BlockHashIndex &hash,
+  StringVector<unsigned char, size_t, MmapAllocator> &targetPhrasesMapped,
+  StringVector<unsigned char, size_t, std::allocator> &targetPhrasesMemory,
   const std::vector<FactorType>* input,
   const std::vector<FactorType>* output,
   size_t numScoreComponent
@@ -40,7 +43,10 @@ PhraseDecoder::PhraseDecoder(
     m_containsAlignmentInfo(true), m_maxRank(0),
     m_symbolTree(0), m_multipleScoreTrees(false),
     m_scoreTrees(1), m_alignTree(0),
-    m_phraseDictionary(phraseDictionary), m_input(input), m_output(output),
+    m_phraseDictionary(phraseDictionary), m_hash(hash),
+    m_targetPhrasesMapped(targetPhrasesMapped),
+    m_targetPhrasesMemory(targetPhrasesMemory),
+    m_input(input), m_output(output),
     // m_weight(weight),
     m_separator(" ||| ")
 { }
@@ -218,19 +224,19 @@ TargetPhraseVectorPtr PhraseDecoder::CreateTargetPhraseCollection(const Phrase &
 
   // Retrieve source phrase identifier
   std::string sourcePhraseString = sourcePhrase.GetStringRep(*m_input);
-  size_t sourcePhraseId = m_phraseDictionary.m_hash[MakeSourceKey(sourcePhraseString)];
+  size_t sourcePhraseId = m_hash[MakeSourceKey(sourcePhraseString)];
   /*
   cerr << "sourcePhraseString=" << sourcePhraseString << " "
   	  << sourcePhraseId
   	  << endl;
   */
-  if(sourcePhraseId != m_phraseDictionary.m_hash.GetSize()) {
+  if(sourcePhraseId != m_hash.GetSize()) {
     // Retrieve compressed and encoded target phrase collection
     std::string encodedPhraseCollection;
     if(m_phraseDictionary.m_inMemory)
-      encodedPhraseCollection = m_phraseDictionary.m_targetPhrasesMemory[sourcePhraseId].str();
+      encodedPhraseCollection = m_targetPhrasesMemory[sourcePhraseId].str();
     else
-      encodedPhraseCollection = m_phraseDictionary.m_targetPhrasesMapped[sourcePhraseId].str();
+      encodedPhraseCollection = m_targetPhrasesMapped[sourcePhraseId].str();
 
     BitWrapper<> encodedBitStream(encodedPhraseCollection);
     if(m_coding == PREnc && bitsLeft)
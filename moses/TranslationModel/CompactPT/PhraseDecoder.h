@@ -83,6 +83,13 @@ protected:
 
   PhraseDictionaryCompact& m_phraseDictionary;
 
+  // Source phrase index and encoded target phrase collections of the table
+  // that this decoder reads, either the base table or the delta table of
+  // m_phraseDictionary.
+  BlockHashIndex& m_hash;
+  StringVector<unsigned char, size_t, MmapAllocator>& m_targetPhrasesMapped;
+  StringVector<unsigned char, size_t, std::allocator>& m_targetPhrasesMemory;
+
   // ***********************************************
 
   const std::vector<FactorType>* m_input;
@@ -118,6 +125,9 @@ public:
 
   PhraseDecoder(
     PhraseDictionaryCompact &phraseDictionary,
+    BlockHashIndex &hash,
+    StringVector<unsigned char, size_t, MmapAllocator> &targetPhrasesMapped,
+    StringVector<unsigned char, size_t, std::allocator> &targetPhrasesMemory,
     const std::vector<FactorType>* input,
     const std::vector<FactorType>* output,
     size_t numScoreComponent
@@ -24,6 +24,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <iterator>
 #include <queue>
 #include <algorithm>
+#include <set>
 #include <sys/stat.h>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/thread/tss.hpp>
@@ -52,6 +53,9 @@ PhraseDictionaryCompact::PhraseDictionaryCompact(const std::string &line)
   ,m_useAlignmentInfo(true)
   ,m_hash(10, 16)
   ,m_phraseDecoder(0)
+  ,m_deltaMerge(false)
+  ,m_deltaHash(10, 16)
+  ,m_deltaPhraseDecoder(0)
 {
   ReadParameters();
 }
@@ -63,40 +67,103 @@ void PhraseDictionaryCompact::Load(AllOptions::ptr const& opts)
 
   SetFeaturesToApply();
 
-  std::string tFilePath = m_filePath;
+  m_phraseDecoder
+  = new PhraseDecoder(*this, m_hash, m_targetPhrasesMapped, m_targetPhrasesMemory,
+                      &m_input, &m_output, m_numScoreComponents);
+  LoadTable(m_filePath, m_hash, *m_phraseDecoder,
+            m_targetPhrasesMapped, m_targetPhrasesMemory);
+
+  if(!m_deltaFilePath.empty()) {
+    m_deltaPhraseDecoder
+    = new PhraseDecoder(*this, m_deltaHash, m_deltaTargetPhrasesMapped,
+                        m_deltaTargetPhrasesMemory,
+                        &m_input, &m_output, m_numScoreComponents);
+    LoadTable(m_deltaFilePath, m_deltaHash, *m_deltaPhraseDecoder,
+              m_deltaTargetPhrasesMapped, m_deltaTargetPhrasesMemory);
+  }
+}
 
+void PhraseDictionaryCompact::LoadTable(std::string tFilePath,
+                                        BlockHashIndex &hash,
+                                        PhraseDecoder &phraseDecoder,
+                                        StringVector<unsigned char, size_t, MmapAllocator> &targetPhrasesMapped,
+                                        StringVector<unsigned char, size_t, std::allocator> &targetPhrasesMemory)
+{
   std::string suffix = ".minphr";
   if (!ends_with(tFilePath, suffix)) tFilePath += suffix;
   if (!FileExists(tFilePath))
     throw runtime_error("Error: File " + tFilePath + " does not exist.");
 
-  m_phraseDecoder
-  = new PhraseDecoder(*this, &m_input, &m_output, m_numScoreComponents);
-
   std::FILE* pFile = std::fopen(tFilePath.c_str() , "r");
 
   size_t indexSize;
   //if(m_inMemory)
   // Load source phrase index into memory
-  indexSize = m_hash.Load(pFile);
+  indexSize = hash.Load(pFile);
   // else
   // Keep source phrase index on disk
-  //indexSize = m_hash.LoadIndex(pFile);
+  //indexSize = hash.LoadIndex(pFile);
 
-  size_t coderSize = m_phraseDecoder->Load(pFile);
+  size_t coderSize = phraseDecoder.Load(pFile);
 
   size_t phraseSize;
   if(m_inMemory)
     // Load target phrase collections into memory
-    phraseSize = m_targetPhrasesMemory.load(pFile, false);
+    phraseSize = targetPhrasesMemory.load(pFile, false);
   else
     // Keep target phrase collections on disk
-    phraseSize = m_targetPhrasesMapped.load(pFile, true);
+    phraseSize = targetPhrasesMapped.load(pFile, true);
 
   UTIL_THROW_IF2(indexSize == 0 || coderSize == 0 || phraseSize == 0,
                  "Not successfully loaded");
 }
 
+void
+PhraseDictionaryCompact::
+SetParameter(const std::string& key, const std::string& value)
+{
+  if (key == "delta-path") {
+    m_deltaFilePath = value;
+  } else if (key == "delta-mode") {
+    UTIL_THROW_IF2(value != "override" && value != "merge",
+                   "Unknown delta-mode " << value << ", expected override or merge");
+    m_deltaMerge = (value == "merge");
+  } else {
+    PhraseDictionary::SetParameter(key, value);
+  }
+}
+
+TargetPhraseVectorPtr
+PhraseDictionaryCompact::
+DecodeWithDelta(const Phrase &sourcePhrase, bool eval) const
+{
+  // There is no such source phrase if source phrase is longer than longest
+  // observed source phrase during compilation
+  TargetPhraseVectorPtr base;
+  if(sourcePhrase.GetSize() <= m_phraseDecoder->GetMaxSourcePhraseLength())
+    base = m_phraseDecoder->CreateTargetPhraseCollection(sourcePhrase, true, eval);
+
+  if(!m_deltaPhraseDecoder
+      || sourcePhrase.GetSize() > m_deltaPhraseDecoder->GetMaxSourcePhraseLength())
+    return base;
+
+  TargetPhraseVectorPtr delta
+  = m_deltaPhraseDecoder->CreateTargetPhraseCollection(sourcePhrase, true, eval);
+  if(delta == NULL || delta->empty())
+    return base;
+  if(!m_deltaMerge || base == NULL || base->empty())
+    return delta;
+
+  // Keep the base target phrases that the delta table does not have. The
+  // decoded collections belong to the decoders' caches, so merge into a copy.
+  std::set<Phrase> deltaPhrases(delta->begin(), delta->end());
+  TargetPhraseVectorPtr merged(new TargetPhraseVector(*delta));
+  for(TargetPhraseVector::const_iterator it = base->begin(); it != base->end(); it++)
+    if(!deltaPhrases.count(*it))
+      merged->push_back(*it);
+  return merged;
+}
+
 TargetPhraseCollection::shared_ptr
 PhraseDictionaryCompact::
 GetTargetPhraseCollectionNonCacheLEGACY(const Phrase &sourcePhrase) const
@@ -104,14 +171,9 @@ GetTargetPhraseCollectionNonCacheLEGACY(const Phrase &sourcePhrase) const
   //cerr << "sourcePhrase=" << sourcePhrase << endl;
 
   TargetPhraseCollection::shared_ptr ret;
-  // There is no souch source phrase if source phrase is longer than longest
-  // observed source phrase during compilation
-  if(sourcePhrase.GetSize() > m_phraseDecoder->GetMaxSourcePhraseLength())
-    return ret;
 
-  // Retrieve target phrase collection from phrase table
-  TargetPhraseVectorPtr decodedPhraseColl
-  = m_phraseDecoder->CreateTargetPhraseCollection(sourcePhrase, true, true);
+  // Retrieve target phrase collection from phrase table (and delta table)
+  TargetPhraseVectorPtr decodedPhraseColl = DecodeWithDelta(sourcePhrase, true);
 
   if(decodedPhraseColl != NULL && decodedPhraseColl->size()) {
     TargetPhraseVectorPtr tpv(new TargetPhraseVector(*decodedPhraseColl));
@@ -139,14 +201,8 @@ TargetPhraseVectorPtr
 PhraseDictionaryCompact::
 GetTargetPhraseCollectionRaw(const Phrase &sourcePhrase) const
 {
-
-  // There is no such source phrase if source phrase is longer than longest
-  // observed source phrase during compilation
-  if(sourcePhrase.GetSize() > m_phraseDecoder->GetMaxSourcePhraseLength())
-    return TargetPhraseVectorPtr();
-
-  // Retrieve target phrase collection from phrase table
-  return m_phraseDecoder->CreateTargetPhraseCollection(sourcePhrase, true, false);
+  // Retrieve target phrase collection from phrase table (and delta table)
+  return DecodeWithDelta(sourcePhrase, false);
 }
 
 PhraseDictionaryCompact::
@@ -154,6 +210,8 @@ PhraseDictionaryCompact::
 {
   if(m_phraseDecoder)
     delete m_phraseDecoder;
+  if(m_deltaPhraseDecoder)
+    delete m_deltaPhraseDecoder;
 }
 
 void
@@ -178,6 +236,8 @@ CleanUpAfterSentenceProcessing(const InputType &source)
     m_sentenceCache.reset(new PhraseCache());
 
   m_phraseDecoder->PruneCache();
+  if(m_deltaPhraseDecoder)
+    m_deltaPhraseDecoder->PruneCache();
   m_sentenceCache->clear();
 
   ReduceCache();
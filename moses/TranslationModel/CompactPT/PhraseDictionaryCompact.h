@@ -62,6 +62,26 @@ protected:
   StringVector<unsigned char, size_t, MmapAllocator>  m_targetPhrasesMapped;
   StringVector<unsigned char, size_t, std::allocator> m_targetPhrasesMemory;
 
+  // Optional delta table (delta-path), a small compact table built from new
+  // data that is queried together with the base table. For a source phrase
+  // found in the delta table its target phrases replace those of the base
+  // table; with delta-mode=merge only base target phrases that also occur in
+  // the delta table are replaced.
+  std::string m_deltaFilePath;
+  bool m_deltaMerge;
+  BlockHashIndex m_deltaHash;
+  PhraseDecoder* m_deltaPhraseDecoder;
+
+  StringVector<unsigned char, size_t, MmapAllocator>  m_deltaTargetPhrasesMapped;
+  StringVector<unsigned char, size_t, std::allocator> m_deltaTargetPhrasesMemory;
+
+  void LoadTable(std::string tFilePath, BlockHashIndex &hash,
+                 PhraseDecoder &phraseDecoder,
+                 StringVector<unsigned char, size_t, MmapAllocator> &targetPhrasesMapped,
+                 StringVector<unsigned char, size_t, std::allocator> &targetPhrasesMemory);
+
+  TargetPhraseVectorPtr DecodeWithDelta(const Phrase &sourcePhrase, bool eval) const;
+
 public:
   PhraseDictionaryCompact(const std::string &line);
 
@@ -69,6 +89,8 @@ public:
 
   void Load(AllOptions::ptr const& opts);
 
+  void SetParameter(const std::string& key, const std::string& value);
+
   TargetPhraseCollection::shared_ptr  GetTargetPhraseCollectionNonCacheLEGACY(const Phrase &source) const;
   TargetPhraseVectorPtr GetTargetPhraseCollectionRaw(const Phrase &source) const;
 
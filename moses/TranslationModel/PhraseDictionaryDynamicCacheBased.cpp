@@ -37,6 +37,8 @@ PhraseDictionaryDynamicCacheBased *PhraseDictionaryDynamicCacheBased::s_instance
 //! contructor
 PhraseDictionaryDynamicCacheBased::PhraseDictionaryDynamicCacheBased(const std::string &line)
   : PhraseDictionary(line, true)
+  , m_snapshot(new cacheMap)
+  , m_batchDepth(0)
 {
   std::cerr << "Initializing PhraseDictionaryDynamicCacheBased feature..." << std::endl;
 
@@ -57,7 +59,45 @@ PhraseDictionaryDynamicCacheBased::PhraseDictionaryDynamicCacheBased(const std::
 
 PhraseDictionaryDynamicCacheBased::~PhraseDictionaryDynamicCacheBased()
 {
-  Clear();
+}
+
+PhraseDictionaryDynamicCacheBased::Batch::Batch(PhraseDictionaryDynamicCacheBased& pt)
+  : m_pt(pt)
+{
+#ifdef WITH_THREADS
+  m_pt.m_writeLock.lock();
+#endif
+  if (m_pt.m_batchDepth++ == 0) {
+    m_pt.m_cacheTM = *m_pt.GetSnapshot();
+  }
+}
+
+PhraseDictionaryDynamicCacheBased::Batch::~Batch()
+{
+  if (--m_pt.m_batchDepth == 0) {
+    boost::shared_ptr<cacheMap> snapshot(new cacheMap);
+    snapshot->swap(m_pt.m_cacheTM);
+    boost::atomic_store(&m_pt.m_snapshot, snapshot_t(snapshot));
+    // translations made before (e.g. cached by mosesserver) are outdated
+    StaticData::Instance().BumpModelEpoch();
+  }
+#ifdef WITH_THREADS
+  m_pt.m_writeLock.unlock();
+#endif
+}
+
+PhraseDictionaryDynamicCacheBased::snapshot_t PhraseDictionaryDynamicCacheBased::GetSnapshot() const
+{
+  return boost::atomic_load(&m_snapshot);
+}
+
+TargetPhraseCollection& PhraseDictionaryDynamicCacheBased::Unshare(TargetPhraseCollection::shared_ptr& tpc)
+{
+  // a collection referenced only by m_cacheTM is not visible to readers
+  if (!tpc.unique()) {
+    tpc.reset(new TargetPhraseCollection(*tpc));
+  }
+  return *tpc;
 }
 
 void PhraseDictionaryDynamicCacheBased::Load(AllOptions::ptr const& opts)
@@ -74,6 +114,7 @@ void PhraseDictionaryDynamicCacheBased::Load(AllOptions::ptr const& opts)
 
 void PhraseDictionaryDynamicCacheBased::Load(const std::string filestr)
 {
+  Batch batch(*this);
   VERBOSE(2,"PhraseDictionaryDynamicCacheBased::Load(const std::string filestr)" << std::endl);
 //  std::vector<std::string> files = Tokenize(m_initfiles, "||");
   std::vector<std::string> files = Tokenize(filestr, "||");
@@ -153,12 +194,10 @@ void PhraseDictionaryDynamicCacheBased::InitializeForInput(ttasksptr const& ttas
 
 TargetPhraseCollection::shared_ptr PhraseDictionaryDynamicCacheBased::GetTargetPhraseCollection(const Phrase &source) const
 {
-#ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> read_lock(m_cacheLock);
-#endif
+  snapshot_t cache = GetSnapshot();
   TargetPhraseCollection::shared_ptr tpc;
-  cacheMap::const_iterator it = m_cacheTM.find(source);
-  if(it != m_cacheTM.end()) {
+  cacheMap::const_iterator it = cache->find(source);
+  if(it != cache->end()) {
     tpc.reset(new TargetPhraseCollection(*(it->second).first));
 
     std::vector<const TargetPhrase*>::const_iterator it2 = tpc->begin();
@@ -194,10 +233,6 @@ ChartRuleLookupManager* PhraseDictionaryDynamicCacheBased::CreateRuleLookupManag
 
 void PhraseDictionaryDynamicCacheBased::SetScoreType(size_t type)
 {
-#ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> read_lock(m_cacheLock);
-#endif
-
   m_score_type = type;
   if ( m_score_type != CBTM_SCORE_TYPE_HYPERBOLA
        && m_score_type != CBTM_SCORE_TYPE_POWER
@@ -216,9 +251,6 @@ void PhraseDictionaryDynamicCacheBased::SetScoreType(size_t type)
 
 void PhraseDictionaryDynamicCacheBased::SetMaxAge(unsigned int age)
 {
-#ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> read_lock(m_cacheLock);
-#endif
   m_maxAge = age;
   VERBOSE(2, "PhraseDictionaryCache MaxAge:  " << m_maxAge << std::endl);
 }
@@ -264,9 +296,6 @@ float PhraseDictionaryDynamicCacheBased::decaying_score(const int age)
 void PhraseDictionaryDynamicCacheBased::SetPreComputedScores(const unsigned int numScoreComponent)
 {
   VERBOSE(2, "PhraseDictionaryDynamicCacheBased SetPreComputedScores:  " << m_maxAge << std::endl);
-#ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> lock(m_cacheLock);
-#endif
   float sc;
   for (size_t i=0; i<=m_maxAge; i++) {
     if (i==m_maxAge) {
@@ -302,6 +331,7 @@ Scores PhraseDictionaryDynamicCacheBased::GetPreComputedScores(const unsigned in
 
 void PhraseDictionaryDynamicCacheBased::ClearEntries(std::string &entries)
 {
+  Batch batch(*this);
   if (entries != "") {
     VERBOSE(3,"entries:|" << entries << "|" << std::endl);
     std::vector<std::string> elements = TokenizeMultiCharSeparator(entries, "||||");
@@ -354,12 +384,9 @@ void PhraseDictionaryDynamicCacheBased::ClearEntries(std::string sourcePhraseStr
 void PhraseDictionaryDynamicCacheBased::ClearEntries(Phrase sp, Phrase tp)
 {
   VERBOSE(3,"PhraseDictionaryDynamicCacheBased::ClearEntries(Phrase sp, Phrase tp)" << std::endl);
-#ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> lock(m_cacheLock);
-#endif
   VERBOSE(3, "PhraseDictionaryCache deleting sp:|" << sp << "| tp:|" << tp << "|" << std::endl);
 
-  cacheMap::const_iterator it = m_cacheTM.find(sp);
+  cacheMap::iterator it = m_cacheTM.find(sp);
   VERBOSE(3,"sp:|" << sp << "|" << std::endl);
   if(it!=m_cacheTM.end()) {
     VERBOSE(3,"sp:|" << sp << "| FOUND" << std::endl);
@@ -367,9 +394,8 @@ void PhraseDictionaryDynamicCacheBased::ClearEntries(Phrase sp, Phrase tp)
     // here we have to remove the target phrase from targetphrasecollection and from the TargetAgeMap
     // and then add new entry
 
-    TargetCollectionAgePair TgtCollAgePair = it->second;
-    TargetPhraseCollection::shared_ptr  tpc = TgtCollAgePair.first;
-    AgeCollection* ac = TgtCollAgePair.second;
+    TargetPhraseCollection::shared_ptr& tpc = it->second.first;
+    AgeCollection* ac = &it->second.second;
     const Phrase* p_ptr = NULL;
     TargetPhrase* tp_ptr = NULL;
     bool found = false;
@@ -389,7 +415,7 @@ void PhraseDictionaryDynamicCacheBased::ClearEntries(Phrase sp, Phrase tp)
     } else {
       VERBOSE(3,"tp:|" << tp << "| FOUND" << std::endl);
 
-      tpc->Remove(tp_pos); //delete entry in the Target Phrase Collection
+      Unshare(tpc).Remove(tp_pos); //delete entry in the Target Phrase Collection
       ac->erase(ac->begin() + tp_pos); //delete entry in the Age Collection
       m_entries--;
       VERBOSE(3,"tpc size:|" << tpc->GetSize() << "|" << std::endl);
@@ -398,10 +424,7 @@ void PhraseDictionaryDynamicCacheBased::ClearEntries(Phrase sp, Phrase tp)
     }
     if (tpc->GetSize() == 0) {
       // delete the entry from m_cacheTM in case it points to an empty TargetPhraseCollection and AgeCollection
-      ac->clear();
-      tpc.reset();
-      delete ac;
-      m_cacheTM.erase(sp);
+      m_cacheTM.erase(it);
     }
 
   } else {
@@ -415,6 +438,7 @@ void PhraseDictionaryDynamicCacheBased::ClearEntries(Phrase sp, Phrase tp)
 
 void PhraseDictionaryDynamicCacheBased::ClearSource(std::string &entries)
 {
+  Batch batch(*this);
   if (entries != "") {
     VERBOSE(3,"entries:|" << entries << "|" << std::endl);
     std::vector<std::string> elements = TokenizeMultiCharSeparator(entries, "||||");
@@ -447,22 +471,15 @@ void PhraseDictionaryDynamicCacheBased::ClearSource(std::vector<std::string> ent
 void PhraseDictionaryDynamicCacheBased::ClearSource(Phrase sp)
 {
   VERBOSE(3,"void PhraseDictionaryDynamicCacheBased::ClearSource(Phrase sp) sp:|" << sp << "|" << std::endl);
-  cacheMap::const_iterator it = m_cacheTM.find(sp);
+  cacheMap::iterator it = m_cacheTM.find(sp);
   if (it != m_cacheTM.end()) {
     VERBOSE(3,"found:|" << sp << "|" << std::endl);
     //sp is found
 
-    TargetCollectionAgePair TgtCollAgePair = it->second;
-    TargetPhraseCollection::shared_ptr  tpc = TgtCollAgePair.first;
-    AgeCollection* ac = TgtCollAgePair.second;
+    m_entries-=it->second.first->GetSize(); //reduce the total amount of entries of the cache
 
-    m_entries-=tpc->GetSize(); //reduce the total amount of entries of the cache
-
-    // delete the entry from m_cacheTM in case it points to an empty TargetPhraseCollection and AgeCollection
-    ac->clear();
-    tpc.reset();
-    delete ac;
-    m_cacheTM.erase(sp);
+    // delete the entry from m_cacheTM
+    m_cacheTM.erase(it);
   } else {
     //do nothing
   }
@@ -470,6 +487,7 @@ void PhraseDictionaryDynamicCacheBased::ClearSource(Phrase sp)
 
 void PhraseDictionaryDynamicCacheBased::Insert(std::string &entries)
 {
+  Batch batch(*this);
   if (entries != "") {
     VERBOSE(3,"entries:|" << entries << "|" << std::endl);
     std::vector<std::string> elements = TokenizeMultiCharSeparator(entries, "||||");
@@ -546,12 +564,9 @@ void PhraseDictionaryDynamicCacheBased::Update(std::string sourcePhraseString, s
 void PhraseDictionaryDynamicCacheBased::Update(Phrase sp, TargetPhrase tp, int age, std::string waString)
 {
   VERBOSE(3,"PhraseDictionaryDynamicCacheBased::Update(Phrase sp, TargetPhrase tp, int age, std::string waString)" << std::endl);
-#ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> lock(m_cacheLock);
-#endif
   VERBOSE(3, "PhraseDictionaryCache inserting sp:|" << sp << "| tp:|" << tp << "| age:|" << age << "| word-alignment |" << waString << "|" << std::endl);
 
-  cacheMap::const_iterator it = m_cacheTM.find(sp);
+  cacheMap::iterator it = m_cacheTM.find(sp);
   VERBOSE(3,"sp:|" << sp << "|" << std::endl);
   if(it!=m_cacheTM.end()) {
     VERBOSE(3,"sp:|" << sp << "| FOUND" << std::endl);
@@ -559,16 +574,15 @@ void PhraseDictionaryDynamicCacheBased::Update(Phrase sp, TargetPhrase tp, int a
     // here we have to remove the target phrase from targetphrasecollection and from the TargetAgeMap
     // and then add new entry
 
-    TargetCollectionAgePair TgtCollAgePair = it->second;
-    TargetPhraseCollection::shared_ptr  tpc = TgtCollAgePair.first;
-    AgeCollection* ac = TgtCollAgePair.second;
+    TargetPhraseCollection& tpc = Unshare(it->second.first);
+    AgeCollection& ac = it->second.second;
 //    const TargetPhrase* p_ptr = NULL;
     const Phrase* p_ptr = NULL;
     TargetPhrase* tp_ptr = NULL;
     bool found = false;
     size_t tp_pos=0;
-    while (!found && tp_pos < tpc->GetSize()) {
-      tp_ptr = (TargetPhrase*) tpc->GetTargetPhrase(tp_pos);
+    while (!found && tp_pos < tpc.GetSize()) {
+      tp_ptr = (TargetPhrase*) tpc.GetTargetPhrase(tp_pos);
       p_ptr = (const TargetPhrase*) tp_ptr;
       if ((Phrase) tp == *p_ptr) {
         found = true;
@@ -583,16 +597,16 @@ void PhraseDictionaryDynamicCacheBased::Update(Phrase sp, TargetPhrase tp, int a
       targetPhrase->GetScoreBreakdown().Assign(this, GetPreComputedScores(age));
       if (!waString.empty()) targetPhrase->SetAlignmentInfo(waString);
 
-      tpc->Add(targetPhrase.release());
+      tpc.Add(targetPhrase.release());
 
-      tp_pos = tpc->GetSize()-1;
-      ac->push_back(age);
+      tp_pos = tpc.GetSize()-1;
+      ac.push_back(age);
       m_entries++;
       VERBOSE(3,"sp:|" << sp << "tp:|" << tp << "| INSERTED" << std::endl);
     } else {
       tp_ptr->GetScoreBreakdown().Assign(this, GetPreComputedScores(age));
       if (!waString.empty()) tp_ptr->SetAlignmentInfo(waString);
-      ac->at(tp_pos) = age;
+      ac.at(tp_pos) = age;
       VERBOSE(3,"sp:|" << sp << "tp:|" << tp << "| UPDATED" << std::endl);
     }
   } else {
@@ -601,9 +615,10 @@ void PhraseDictionaryDynamicCacheBased::Update(Phrase sp, TargetPhrase tp, int a
     // create target collection
     // we have to create new target collection age pair and add new entry to target collection age pair
 
-    TargetPhraseCollection::shared_ptr tpc(new TargetPhraseCollection);
-    AgeCollection* ac = new AgeCollection();
-    m_cacheTM.insert(make_pair(sp,make_pair(tpc,ac)));
+    TargetCollectionAgePair& entry = m_cacheTM[sp];
+    entry.first.reset(new TargetPhraseCollection);
+    TargetPhraseCollection::shared_ptr const& tpc = entry.first;
+    AgeCollection& ac = entry.second;
 
     //tp is not found
     std::auto_ptr<TargetPhrase> targetPhrase(new TargetPhrase(tp));
@@ -611,7 +626,7 @@ void PhraseDictionaryDynamicCacheBased::Update(Phrase sp, TargetPhrase tp, int a
     if (!waString.empty()) targetPhrase->SetAlignmentInfo(waString);
 
     tpc->Add(targetPhrase.release());
-    ac->push_back(age);
+    ac.push_back(age);
     m_entries++;
     VERBOSE(3,"sp:|" << sp << "| tp:|" << tp << "| INSERTED" << std::endl);
   }
@@ -619,12 +634,11 @@ void PhraseDictionaryDynamicCacheBased::Update(Phrase sp, TargetPhrase tp, int a
 
 void PhraseDictionaryDynamicCacheBased::Decay()
 {
-#ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> lock(m_cacheLock);
-#endif
-  cacheMap::iterator it;
-  for(it = m_cacheTM.begin(); it!=m_cacheTM.end(); it++) {
-    Decay((*it).first);
+  cacheMap::iterator it = m_cacheTM.begin();
+  while (it != m_cacheTM.end()) {
+    // Decay(Phrase) may erase the entry
+    Phrase const sp = (it++)->first;
+    Decay(sp);
   }
 }
 
@@ -636,35 +650,31 @@ void PhraseDictionaryDynamicCacheBased::Decay(Phrase sp)
     VERBOSE(3,"found:|" << sp << "|" << std::endl);
     //sp is found
 
-    TargetCollectionAgePair TgtCollAgePair = it->second;
-    TargetPhraseCollection::shared_ptr  tpc = TgtCollAgePair.first;
-    AgeCollection* ac = TgtCollAgePair.second;
+    TargetPhraseCollection& tpc = Unshare(it->second.first);
+    AgeCollection& ac = it->second.second;
 
     //loop in inverted order to allow a correct deletion of std::vectors tpc and ac
-    for (int tp_pos = tpc->GetSize() - 1 ; tp_pos >= 0; tp_pos--) {
-      unsigned int tp_age = ac->at(tp_pos); //increase the age by 1
+    for (int tp_pos = tpc.GetSize() - 1 ; tp_pos >= 0; tp_pos--) {
+      unsigned int tp_age = ac.at(tp_pos); //increase the age by 1
       tp_age++; //increase the age by 1
       VERBOSE(3,"sp:|" << sp << "| " << " new tp_age:|" << tp_age << "|" << std::endl);
 
-      TargetPhrase* tp_ptr = (TargetPhrase*) tpc->GetTargetPhrase(tp_pos);
+      TargetPhrase* tp_ptr = (TargetPhrase*) tpc.GetTargetPhrase(tp_pos);
 
       if (tp_age > m_maxAge) {
         VERBOSE(3,"tp_age:|" << tp_age << "| TOO BIG" << std::endl);
-        tpc->Remove(tp_pos); //delete entry in the Target Phrase Collection
-        ac->erase(ac->begin() + tp_pos); //delete entry in the Age Collection
+        tpc.Remove(tp_pos); //delete entry in the Target Phrase Collection
+        ac.erase(ac.begin() + tp_pos); //delete entry in the Age Collection
         m_entries--;
       } else {
         VERBOSE(3,"tp_age:|" << tp_age << "| STILL GOOD" << std::endl);
         tp_ptr->GetScoreBreakdown().Assign(this, GetPreComputedScores(tp_age));
-        ac->at(tp_pos) = tp_age;
+        ac.at(tp_pos) = tp_age;
       }
     }
-    if (tpc->GetSize() == 0) {
+    if (tpc.GetSize() == 0) {
       // delete the entry from m_cacheTM in case it points to an empty TargetPhraseCollection and AgeCollection
-      (((*it).second).second)->clear();
-      delete ((*it).second).second;
-      ((*it).second).first.reset();
-      m_cacheTM.erase(sp);
+      m_cacheTM.erase(it);
     }
   } else {
     //do nothing
@@ -676,6 +686,7 @@ void PhraseDictionaryDynamicCacheBased::Decay(Phrase sp)
 
 void PhraseDictionaryDynamicCacheBased::Execute(std::string command)
 {
+  Batch batch(*this);
   VERBOSE(2,"command:|" << command << "|" << std::endl);
   std::vector<std::string> commands = Tokenize(command, "||");
   Execute(commands);
@@ -702,15 +713,7 @@ void PhraseDictionaryDynamicCacheBased::Execute_Single_Command(std::string comma
 
 void PhraseDictionaryDynamicCacheBased::Clear()
 {
-#ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> lock(m_cacheLock);
-#endif
-  cacheMap::iterator it;
-  for(it = m_cacheTM.begin(); it!=m_cacheTM.end(); it++) {
-    (((*it).second).second)->clear();
-    delete ((*it).second).second;
-    ((*it).second).first.reset();
-  }
+  Batch batch(*this);
   m_cacheTM.clear();
   m_entries = 0;
 }
@@ -718,6 +721,7 @@ void PhraseDictionaryDynamicCacheBased::Clear()
 
 void PhraseDictionaryDynamicCacheBased::ExecuteDlt(std::map<std::string, std::string> dlt_meta)
 {
+  Batch batch(*this);
   if (dlt_meta.find("cbtm") != dlt_meta.end()) {
     Insert(dlt_meta["cbtm"]);
   }
@@ -742,11 +746,9 @@ void PhraseDictionaryDynamicCacheBased::ExecuteDlt(std::map<std::string, std::st
 void PhraseDictionaryDynamicCacheBased::Print() const
 {
   VERBOSE(2,"PhraseDictionaryDynamicCacheBased::Print()" << std::endl);
-#ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> read_lock(m_cacheLock);
-#endif
+  snapshot_t cache = GetSnapshot();
   cacheMap::const_iterator it;
-  for(it = m_cacheTM.begin(); it!=m_cacheTM.end(); it++) {
+  for(it = cache->begin(); it!=cache->end(); it++) {
     std::string source = (it->first).ToString();
     TargetPhraseCollection::shared_ptr  tpc = (it->second).first;
     TargetPhraseCollection::iterator itr;
@@ -25,9 +25,10 @@
 #include "moses/TypeDef.h"
 #include "moses/TranslationModel/PhraseDictionary.h"
 
+#include <boost/shared_ptr.hpp>
+
 #ifdef WITH_THREADS
-#include <boost/thread/shared_mutex.hpp>
-#include <boost/thread/locks.hpp>
+#include <boost/thread/recursive_mutex.hpp>
 #endif
 
 #define CBTM_SCORE_TYPE_UNDEFINED (-1)
@@ -48,16 +49,25 @@ class ChartCellCollectionBase;
 class ChartRuleLookupManager;
 
 /** Implementation of a Cache-based phrase table.
+ *
+ * Lookups read an immutable snapshot of the cache without taking a lock.
+ * Changes are made to a private copy of the current snapshot, which is
+ * published as the new snapshot when a batch of changes (see Batch) is
+ * complete; target phrase collections are copied only when they change.
+ * An old snapshot is freed when the last lookup using it is done.
  */
 class PhraseDictionaryDynamicCacheBased : public PhraseDictionary
 {
 
   typedef std::vector<unsigned int> AgeCollection;
-  typedef std::pair<TargetPhraseCollection::shared_ptr , AgeCollection*> TargetCollectionAgePair;
+  typedef std::pair<TargetPhraseCollection::shared_ptr , AgeCollection> TargetCollectionAgePair;
   typedef std::map<Phrase, TargetCollectionAgePair> cacheMap;
+  typedef boost::shared_ptr<cacheMap const> snapshot_t;
 
   // data structure for the cache
-  cacheMap m_cacheTM;
+  snapshot_t m_snapshot; // the published cache; use GetSnapshot() to read
+  cacheMap m_cacheTM;    // the cache being changed, valid inside a Batch only
+  size_t m_batchDepth;
   std::vector<Scores> precomputedScores;
   unsigned int m_maxAge;
   size_t m_score_type; //scoring type of the match
@@ -68,10 +78,26 @@ class PhraseDictionaryDynamicCacheBased : public PhraseDictionary
   std::string m_name; // internal name to identify this instance of the Cache-based phrase table
 
 #ifdef WITH_THREADS
-  //multiple readers - single writer lock
-  mutable boost::shared_mutex m_cacheLock;
+  // single writer; readers do not lock
+  boost::recursive_mutex m_writeLock;
 #endif
 
+  // Changes made while a Batch exists are published together when the
+  // outermost Batch of the writing thread is destroyed.
+  class Batch
+  {
+    PhraseDictionaryDynamicCacheBased& m_pt;
+  public:
+    Batch(PhraseDictionaryDynamicCacheBased& pt);
+    ~Batch();
+  };
+
+  snapshot_t GetSnapshot() const;
+
+  // the target phrases of an entry of m_cacheTM, copied first if a
+  // published snapshot shares them
+  static TargetPhraseCollection& Unshare(TargetPhraseCollection::shared_ptr& tpc);
+
   friend std::ostream& operator<<(std::ostream&, const PhraseDictionaryDynamicCacheBased&);
 
 public:
@@ -153,6 +179,8 @@ protected:
   float decaying_score(const int age);  // calculates the decay score given the age
   void Insert(std::vector<std::string> entries);
 
+  // those of the functions below that change m_cacheTM must be called
+  // inside a Batch
   void Decay();   // traverse through the cache and decay each entry
   void Decay(Phrase p);   // traverse through the cache and decay each entry for a given Phrase
   void Update(std::vector<std::string> entries, std::string ageString);
@@ -20,6 +20,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "util/string_stream.hh"
 
 #include "moses/TranslationModel/PhraseDictionaryMultiModel.h"
+#include "moses/TranslationTask.h"
+#include "moses/InputPath.h"
 
 using namespace std;
 
@@ -94,35 +96,86 @@ void PhraseDictionaryMultiModel::Load(AllOptions::ptr const& opts)
   }
 }
 
+// without a translation task, only the weights from the config apply
 TargetPhraseCollection::shared_ptr
 PhraseDictionaryMultiModel::
 GetTargetPhraseCollectionLEGACY(const Phrase& src) const
 {
+  return CreateTargetPhraseCollection(src, getSentenceWeights(std::vector<float>()));
+}
+
+TargetPhraseCollection::shared_ptr
+PhraseDictionaryMultiModel::
+GetTargetPhraseCollectionLEGACY(ttasksptr const& ttask, const Phrase& src) const
+{
+  return CreateTargetPhraseCollection(src, GetSentenceState(ttask)->weights);
+}
 
-  std::vector<std::vector<float> > multimodelweights;
-  multimodelweights = getWeights(m_numScoreComponents, true);
-  TargetPhraseCollection::shared_ptr ret;
+void
+PhraseDictionaryMultiModel::
+GetTargetPhraseCollectionBatch(ttasksptr const& ttask,
+                               const InputPathList &inputPathQueue) const
+{
+  SPTR<SentenceState const> state = GetSentenceState(ttask);
+  InputPathList::const_iterator iter;
+  for (iter = inputPathQueue.begin(); iter != inputPathQueue.end(); ++iter) {
+    InputPath &inputPath = **iter;
 
-  std::map<std::string, multiModelStats*>* allStats;
-  allStats = new(std::map<std::string,multiModelStats*>);
-  CollectSufficientStatistics(src, allStats);
-  ret = CreateTargetPhraseCollectionLinearInterpolation(src, allStats, multimodelweights);
-  RemoveAllInMap(*allStats);
-  delete allStats; // ??? Why the detour through malloc? UG
+    // backoff
+    if (!SatisfyBackoff(inputPath)) {
+      continue;
+    }
 
-  ret->NthElement(m_tableLimit); // sort the phrases for pruning later
-  const_cast<PhraseDictionaryMultiModel*>(this)->CacheForCleanup(ret);
+    TargetPhraseCollection::shared_ptr targetPhrases
+    = CreateTargetPhraseCollection(inputPath.GetPhrase(), state->weights);
+    inputPath.SetTargetPhrases(*this, targetPhrases, NULL);
+  }
+}
 
+TargetPhraseCollection::shared_ptr
+PhraseDictionaryMultiModel::
+CreateTargetPhraseCollection
+(const Phrase& src, const std::vector<std::vector<float> > &multimodelweights) const
+{
+  multiModelStatsColl stats;
+  CollectSufficientStatistics(src, stats);
+  TargetPhraseCollection::shared_ptr ret
+  = CreateTargetPhraseCollectionLinearInterpolation(src, stats, multimodelweights);
+  ret->NthElement(m_tableLimit); // sort the phrases for pruning later
   return ret;
 }
 
+void
+PhraseDictionaryMultiModel::
+SetSentenceState(ttasksptr const& ttask,
+                 const std::vector<float> &requested) const
+{
+  SPTR<SentenceState> state(new SentenceState);
+  state->weights = getSentenceWeights(requested);
+  ttask->SetLocal(this, state);
+}
+
+SPTR<PhraseDictionaryMultiModel::SentenceState const>
+PhraseDictionaryMultiModel::
+GetSentenceState(ttasksptr const& ttask) const
+{
+  SPTR<SentenceState const> state = ttask->GetLocal<SentenceState>(this);
+  if (!state) { // not initialized for this task
+    SetSentenceState(ttask, std::vector<float>());
+    state = ttask->GetLocal<SentenceState>(this);
+  }
+  return state;
+}
+
 void
 PhraseDictionaryMultiModel::
 CollectSufficientStatistics
-(const Phrase& src, std::map<std::string, multiModelStats*>* allStats) const
+(const Phrase& src, multiModelStatsColl& stats) const
 {
+  size_t const stride = m_numScoreComponents * m_numModels;
   for(size_t i = 0; i < m_numModels; ++i) {
     const PhraseDictionary &pd = *m_pd[i];
+    const vector<FeatureFunction*> pd_feature(1, m_pd[i]);
 
     TargetPhraseCollection::shared_ptr ret_raw;
     ret_raw = pd.GetTargetPhraseCollectionLEGACY(src);
@@ -139,35 +192,25 @@ CollectSufficientStatistics
         const TargetPhrase * targetPhrase = *iterTargetPhrase;
         std::vector<float> raw_scores = targetPhrase->GetScoreBreakdown().GetScoresForProducer(&pd);
 
-        std::string targetString = targetPhrase->GetStringRep(m_output);
-        if (allStats->find(targetString) == allStats->end()) {
-
-          multiModelStats * statistics = new multiModelStats;
-          statistics->targetPhrase = new TargetPhrase(*targetPhrase); //make a copy so that we don't overwrite the original phrase table info
-          statistics->p.resize(m_numScoreComponents);
-          for(size_t j = 0; j < m_numScoreComponents; ++j) {
-            statistics->p[j].resize(m_numModels);
-          }
+        std::pair<boost::unordered_map<std::string, size_t>::iterator, bool> entry
+        = stats.index.insert(std::make_pair(targetPhrase->GetStringRep(m_output),
+                                            stats.targetPhrases.size()));
+        if (entry.second) {
+          TargetPhrase *copy = new TargetPhrase(*targetPhrase); //make a copy so that we don't overwrite the original phrase table info
+          stats.targetPhrases.push_back(copy);
+          stats.p.resize(stats.p.size() + stride);
 
           //correct future cost estimates and total score
-          statistics->targetPhrase->GetScoreBreakdown().InvertDenseFeatures(&pd);
-          vector<FeatureFunction*> pd_feature;
-          pd_feature.push_back(m_pd[i]);
-          const vector<FeatureFunction*> pd_feature_const(pd_feature);
-          statistics->targetPhrase->EvaluateInIsolation(src, pd_feature_const);
+          copy->GetScoreBreakdown().InvertDenseFeatures(&pd);
+          copy->EvaluateInIsolation(src, pd_feature);
           // zero out scores from original phrase table
-          statistics->targetPhrase->GetScoreBreakdown().ZeroDenseFeatures(&pd);
-
-          (*allStats)[targetString] = statistics;
-
+          copy->GetScoreBreakdown().ZeroDenseFeatures(&pd);
         }
-        multiModelStats * statistics = (*allStats)[targetString];
 
+        float *p = &stats.p[entry.first->second * stride];
         for(size_t j = 0; j < m_numScoreComponents; ++j) {
-          statistics->p[j][i] = UntransformScore(raw_scores[j]);
+          p[j * m_numModels + i] = UntransformScore(raw_scores[j]);
         }
-
-        (*allStats)[targetString] = statistics;
       }
     }
   }
@@ -177,46 +220,48 @@ TargetPhraseCollection::shared_ptr
 PhraseDictionaryMultiModel::
 CreateTargetPhraseCollectionLinearInterpolation
 ( const Phrase& src,
-  std::map<std::string,multiModelStats*>* allStats,
-  std::vector<std::vector<float> > &multimodelweights) const
+  multiModelStatsColl& stats,
+  const std::vector<std::vector<float> > &multimodelweights) const
 {
   TargetPhraseCollection::shared_ptr ret(new TargetPhraseCollection);
-  for ( std::map< std::string, multiModelStats*>::const_iterator iter = allStats->begin(); iter != allStats->end(); ++iter ) {
-
-    multiModelStats * statistics = iter->second;
+  const vector<FeatureFunction*> pd_feature(1, const_cast<PhraseDictionaryMultiModel*>(this));
+  Scores scoreVector(m_numScoreComponents);
+  for (size_t t = 0; t < stats.targetPhrases.size(); ++t) {
+    const float *p = &stats.p[t * m_numScoreComponents * m_numModels];
 
-    Scores scoreVector(m_numScoreComponents);
-
-    for(size_t i = 0; i < m_numScoreComponents; ++i) {
-      scoreVector[i] = TransformScore(std::inner_product(statistics->p[i].begin(), statistics->p[i].end(), multimodelweights[i].begin(), 0.0));
+    for(size_t i = 0; i < m_numScoreComponents; ++i, p += m_numModels) {
+      scoreVector[i] = TransformScore(std::inner_product(p, p + m_numModels, multimodelweights[i].begin(), 0.0));
     }
 
-    statistics->targetPhrase->GetScoreBreakdown().Assign(this, scoreVector);
+    TargetPhrase *targetPhrase = stats.targetPhrases[t];
+    stats.targetPhrases[t] = NULL;
+    targetPhrase->GetScoreBreakdown().Assign(this, scoreVector);
 
     //correct future cost estimates and total score
-    vector<FeatureFunction*> pd_feature;
-    pd_feature.push_back(const_cast<PhraseDictionaryMultiModel*>(this));
-    const vector<FeatureFunction*> pd_feature_const(pd_feature);
-    statistics->targetPhrase->EvaluateInIsolation(src, pd_feature_const);
+    targetPhrase->EvaluateInIsolation(src, pd_feature);
 
-    ret->Add(new TargetPhrase(*statistics->targetPhrase));
+    ret->Add(targetPhrase);
   }
   return ret;
 }
 
-//TODO: is it worth caching the results as long as weights don't change?
 std::vector<std::vector<float> >
 PhraseDictionaryMultiModel::
-getWeights(size_t numWeights, bool normalize) const
+getSentenceWeights(const std::vector<float> &requested) const
 {
-  const std::vector<float>* weights_ptr;
-  std::vector<float> raw_weights;
+  return getWeights(m_numScoreComponents, true, requested);
+}
 
-  weights_ptr = GetTemporaryMultiModelWeightsVector();
+std::vector<std::vector<float> >
+PhraseDictionaryMultiModel::
+getWeights(size_t numWeights, bool normalize,
+           const std::vector<float> &requested) const
+{
+  const std::vector<float>* weights_ptr = &requested;
+  std::vector<float> raw_weights;
 
-  // HIEU - uninitialised variable.
   //checking weights passed to mosesserver; only valid for this sentence; *don't* raise exception if client weights are malformed
-  if (weights_ptr == NULL || weights_ptr->size() == 0) {
+  if (weights_ptr->size() == 0) {
     weights_ptr = &m_multimodelweights; //fall back to weights defined in config
   } else if(weights_ptr->size() != m_numModels && weights_ptr->size() != m_numModels * numWeights) {
     //TODO: can we pass error message to client if weights are malformed?
@@ -278,32 +323,28 @@ CreateRuleLookupManager(const ChartParser &, const ChartCellCollectionBase&,
 }
 
 
-//copied from PhraseDictionaryCompact; free memory allocated to TargetPhraseCollection (and each TargetPhrase) at end of sentence
 void
 PhraseDictionaryMultiModel::
-CacheForCleanup(TargetPhraseCollection::shared_ptr tpc)
+CleanUpAfterSentenceProcessing(const InputType &source)
 {
-  GetPhraseCache().push_back(tpc);
+  CleanUpComponentModels(source);
 }
 
-
 void
 PhraseDictionaryMultiModel::
-CleanUpAfterSentenceProcessing(const InputType &source)
+InitializeForInput(ttasksptr const& ttask)
 {
-  // PhraseCache &ref = GetPhraseCache();
-  // for(PhraseCache::iterator it = ref.begin(); it != ref.end(); it++) {
-  //   it->reset();
-  // }
-
-  // PhraseCache temp;
-  // temp.swap(ref);
-  GetPhraseCache().clear();
-
-  CleanUpComponentModels(source);
+  // keeps the weights set for this task by the server, if any
+  if (!ttask->GetLocal<SentenceState>(this))
+    SetSentenceState(ttask, std::vector<float>());
+}
 
-  std::vector<float> empty_vector;
-  SetTemporaryMultiModelWeightsVector(empty_vector);
+void
+PhraseDictionaryMultiModel::
+CleanUpAfterSentenceProcessing(ttasksptr const& ttask)
+{
+  ttask->SetLocal(this, SPTR<SentenceState>());
+  FeatureFunction::CleanUpAfterSentenceProcessing(ttask);
 }
 
 
@@ -316,32 +357,12 @@ CleanUpComponentModels(const InputType &source)
   }
 }
 
-const std::vector<float>*
-PhraseDictionaryMultiModel::
-GetTemporaryMultiModelWeightsVector() const
-{
-#ifdef WITH_THREADS
-  boost::shared_lock<boost::shared_mutex> read_lock(m_lock_weights);
-  if (m_multimodelweights_tmp.find(boost::this_thread::get_id()) != m_multimodelweights_tmp.end()) {
-    return &m_multimodelweights_tmp.find(boost::this_thread::get_id())->second;
-  } else {
-    return NULL;
-  }
-#else
-  return &m_multimodelweights_tmp;
-#endif
-}
-
 void
 PhraseDictionaryMultiModel::
-SetTemporaryMultiModelWeightsVector(std::vector<float> weights)
+SetTemporaryMultiModelWeightsVector(ttasksptr const& ttask,
+                                    const std::vector<float> &weights) const
 {
-#ifdef WITH_THREADS
-  boost::unique_lock<boost::shared_mutex> lock(m_lock_weights);
-  m_multimodelweights_tmp[boost::this_thread::get_id()] = weights;
-#else
-  m_multimodelweights_tmp = weights;
-#endif
+  SetSentenceState(ttask, weights);
 }
 
 #ifdef WITH_DLIB
@@ -364,8 +385,7 @@ MinimizePerplexity(vector<pair<string, string> > &phrase_pair_vector)
     string source_string = phrase_pair.first;
     string target_string = phrase_pair.second;
 
-    vector<float> fs(m_numModels);
-    map<string,multiModelStats*>* allStats = new(map<string,multiModelStats*>);
+    multiModelStatsColl allStats;
 
     Phrase sourcePhrase(0);
     sourcePhrase.CreateFromString(Input, m_input, source_string, NULL);
@@ -373,20 +393,20 @@ MinimizePerplexity(vector<pair<string, string> > &phrase_pair_vector)
     CollectSufficientStatistics(sourcePhrase, allStats); //optimization potential: only call this once per source phrase
 
     //phrase pair not found; leave cache empty
-    if (allStats->find(target_string) == allStats->end()) {
-      RemoveAllInMap(*allStats);
-      delete allStats;
+    boost::unordered_map<string, size_t>::const_iterator found = allStats.index.find(target_string);
+    if (found == allStats.index.end()) {
       continue;
     }
 
     multiModelStatsOptimization* targetStatistics = new multiModelStatsOptimization();
-    targetStatistics->targetPhrase = new TargetPhrase(*(*allStats)[target_string]->targetPhrase);
-    targetStatistics->p = (*allStats)[target_string]->p;
+    targetStatistics->targetPhrase = new TargetPhrase(*allStats.targetPhrases[found->second]);
+    targetStatistics->p.resize(m_numScoreComponents);
+    for (size_t j = 0; j < m_numScoreComponents; ++j) {
+      vector<float>::const_iterator p = allStats.p.begin() + (found->second * m_numScoreComponents + j) * m_numModels;
+      targetStatistics->p[j].assign(p, p + m_numModels);
+    }
     targetStatistics->f = iter->second;
     optimizerStats.push_back(targetStatistics);
-
-    RemoveAllInMap(*allStats);
-    delete allStats;
   }
 
   Sentence sentence;
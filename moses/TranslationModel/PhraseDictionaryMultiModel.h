@@ -24,7 +24,6 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 
 #include <boost/unordered_map.hpp>
-#include <boost/thread/shared_mutex.hpp>
 #include "moses/StaticData.h"
 #include "moses/TargetPhrase.h"
 #include "moses/Util.h"
@@ -48,6 +47,19 @@ struct multiModelStatsOptimization: multiModelStats {
   size_t f;
 };
 
+/** The target phrases of one source phrase and their probabilities in all
+ * component models, in flat arrays: the probability of target phrase t for
+ * score j in model i is p[(t * numScoreComponents + j) * numModels + i].
+ */
+struct multiModelStatsColl {
+  std::vector<TargetPhrase*> targetPhrases;
+  std::vector<float> p;
+  boost::unordered_map<std::string, size_t> index; // target string -> t
+  ~multiModelStatsColl() {
+    RemoveAllInColl(targetPhrases);
+  };
+};
+
 class OptimizationObjective;
 
 struct multiModelPhrase {
@@ -74,26 +86,41 @@ public:
 
   virtual void
   CollectSufficientStatistics
-  (const Phrase& src, std::map<std::string,multiModelStats*>* allStats)
-  const;
+  (const Phrase& src, multiModelStatsColl& stats) const;
 
+  // hands the target phrases in /stats/ over to the returned collection
   virtual TargetPhraseCollection::shared_ptr
   CreateTargetPhraseCollectionLinearInterpolation
-  (const Phrase& src, std::map<std::string,multiModelStats*>* allStats,
-   std::vector<std::vector<float> > &multimodelweights) const;
+  (const Phrase& src, multiModelStatsColl& stats,
+   const std::vector<std::vector<float> > &multimodelweights) const;
 
+  // the combined translations of /src/, sorted for pruning
+  virtual TargetPhraseCollection::shared_ptr
+  CreateTargetPhraseCollection
+  (const Phrase& src,
+   const std::vector<std::vector<float> > &multimodelweights) const;
+
+  // /requested/: weights passed with the request, empty for config weights
   std::vector<std::vector<float> >
-  getWeights(size_t numWeights, bool normalize) const;
+  getWeights(size_t numWeights, bool normalize,
+             const std::vector<float> &requested) const;
+
+  // the weights used by CreateTargetPhraseCollection()
+  virtual std::vector<std::vector<float> >
+  getSentenceWeights(const std::vector<float> &requested) const;
 
   std::vector<float>
   normalizeWeights(std::vector<float> &weights) const;
 
   void
-  CacheForCleanup(TargetPhraseCollection::shared_ptr tpc);
+  InitializeForInput(ttasksptr const& ttask);
 
   void
   CleanUpAfterSentenceProcessing(const InputType &source);
 
+  void
+  CleanUpAfterSentenceProcessing(ttasksptr const& ttask);
+
   virtual void
   CleanUpComponentModels(const InputType &source);
 
@@ -106,11 +133,13 @@ public:
   virtual TargetPhraseCollection::shared_ptr
   GetTargetPhraseCollectionLEGACY(const Phrase& src) const;
 
+  virtual TargetPhraseCollection::shared_ptr
+  GetTargetPhraseCollectionLEGACY(ttasksptr const& ttask,
+                                  const Phrase& src) const;
+
   virtual void
-  InitializeForInput(ttasksptr const& ttask) {
-    // Don't do anything source specific here as this object is shared
-    // between threads.
-  }
+  GetTargetPhraseCollectionBatch(ttasksptr const& ttask,
+                                 const InputPathList &inputPathQueue) const;
 
   ChartRuleLookupManager*
   CreateRuleLookupManager(const ChartParser &, const ChartCellCollectionBase&,
@@ -119,11 +148,11 @@ public:
   void
   SetParameter(const std::string& key, const std::string& value);
 
-  const std::vector<float>*
-  GetTemporaryMultiModelWeightsVector() const;
-
+  // weights for translation task /ttask/ only; must be set before it is
+  // decoded
   void
-  SetTemporaryMultiModelWeightsVector(std::vector<float> weights);
+  SetTemporaryMultiModelWeightsVector(ttasksptr const& ttask,
+                                      const std::vector<float> &weights) const;
 
 protected:
   std::string m_mode;
@@ -132,37 +161,19 @@ protected:
   size_t m_numModels;
   std::vector<float> m_multimodelweights;
 
-  typedef std::vector<TargetPhraseCollection::shared_ptr> PhraseCache;
-#ifdef WITH_THREADS
-  boost::shared_mutex m_lock_cache;
-  typedef std::map<boost::thread::id, PhraseCache> SentenceCache;
-#else
-  typedef PhraseCache SentenceCache;
-#endif
-  SentenceCache m_sentenceCache;
-
-  PhraseCache& GetPhraseCache() {
-#ifdef WITH_THREADS
-    {
-      // first try read-only lock
-      boost::shared_lock<boost::shared_mutex> read_lock(m_lock_cache);
-      SentenceCache::iterator i = m_sentenceCache.find(boost::this_thread::get_id());
-      if (i != m_sentenceCache.end()) return i->second;
-    }
-    boost::unique_lock<boost::shared_mutex> lock(m_lock_cache);
-    return m_sentenceCache[boost::this_thread::get_id()];
-#else
-    return m_sentenceCache;
-#endif
-  }
+  // Per-sentence state, kept on the translation task itself (see
+  // TranslationTask::GetLocal()), as tasks may share their ContextScope.
+  // It is set before decoding and not modified afterwards.
+  struct SentenceState {
+    std::vector<std::vector<float> > weights;
+  };
 
-#ifdef WITH_THREADS
-  //reader-writer lock
-  mutable boost::shared_mutex m_lock_weights;
-  std::map<boost::thread::id, std::vector<float> > m_multimodelweights_tmp;
-#else
-  std::vector<float> m_multimodelweights_tmp;
-#endif
+  void
+  SetSentenceState(ttasksptr const& ttask,
+                   const std::vector<float> &requested) const;
+
+  SPTR<SentenceState const>
+  GetSentenceState(ttasksptr const& ttask) const;
 };
 
 #ifdef WITH_DLIB
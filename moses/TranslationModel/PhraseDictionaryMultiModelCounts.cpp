@@ -121,12 +121,17 @@ void PhraseDictionaryMultiModelCounts::Load(AllOptions::ptr const& opts)
 }
 
 
-TargetPhraseCollection::shared_ptr PhraseDictionaryMultiModelCounts::GetTargetPhraseCollectionLEGACY(const Phrase& src) const
+vector<vector<float> > PhraseDictionaryMultiModelCounts::getSentenceWeights(const vector<float> &requested) const
 {
-  vector<vector<float> > multimodelweights;
   bool normalize;
   normalize = (m_mode == "interpolate") ? true : false;
-  multimodelweights = getWeights(4,normalize);
+  return getWeights(4,normalize,requested);
+}
+
+
+TargetPhraseCollection::shared_ptr PhraseDictionaryMultiModelCounts::CreateTargetPhraseCollection(const Phrase& src, const vector<vector<float> > &weights) const
+{
+  vector<vector<float> > multimodelweights(weights);
 
   //source phrase frequency is shared among all phrase pairs
   vector<float> fs(m_numModels);
@@ -139,7 +144,6 @@ TargetPhraseCollection::shared_ptr PhraseDictionaryMultiModelCounts::GetTargetPh
   = CreateTargetPhraseCollectionCounts(src, fs, allStats, multimodelweights);
 
   ret->NthElement(m_tableLimit); // sort the phrases for pruning later
-  const_cast<PhraseDictionaryMultiModelCounts*>(this)->CacheForCleanup(ret);
   return ret;
 }
 
@@ -91,15 +91,12 @@ public:
   void FillLexicalCountsJoint(Word &wordS, Word &wordT, std::vector<float> &count, const std::vector<lexicalTable*> &tables) const;
   void FillLexicalCountsMarginal(Word &wordS, std::vector<float> &count, const std::vector<lexicalTable*> &tables) const;
   void LoadLexicalTable( std::string &fileName, lexicalTable* ltable);
-  TargetPhraseCollection::shared_ptr  GetTargetPhraseCollectionLEGACY(const Phrase& src) const;
+  TargetPhraseCollection::shared_ptr CreateTargetPhraseCollection(const Phrase& src, const std::vector<std::vector<float> > &multimodelweights) const;
+  std::vector<std::vector<float> > getSentenceWeights(const std::vector<float> &requested) const;
 #ifdef WITH_DLIB
   std::vector<float> MinimizePerplexity(std::vector<std::pair<std::string, std::string> > &phrase_pair_vector);
 #endif
   // functions below required by base class
-  virtual void InitializeForInput(ttasksptr const& ttask) {
-    /* Don't do anything source specific here as this object is shared between threads.*/
-  }
-
   void SetParameter(const std::string& key, const std::string& value);
 
 private:
@@ -1,11 +1,8 @@
 // vim:tabstop=2
-#include <cstdlib>
-
 #include "PhraseDictionaryTransliteration.h"
 #include "moses/TranslationModel/CYKPlusParser/ChartRuleLookupManagerSkeleton.h"
 #include "moses/DecodeGraph.h"
 #include "moses/DecodeStep.h"
-#include "util/tempfile.hh"
 
 using namespace std;
 
@@ -13,24 +10,18 @@ namespace Moses
 {
 PhraseDictionaryTransliteration::PhraseDictionaryTransliteration(const std::string &line)
   : PhraseDictionary(line, true)
+  , m_nBestSize(50)
+  , m_stackSize(200)
+  , m_maxCacheSize(10000)
 {
   ReadParameters();
-  UTIL_THROW_IF2(m_mosesDir.empty() ||
-                 m_scriptDir.empty() ||
-                 m_externalDir.empty() ||
-                 m_inputLang.empty() ||
-                 m_outputLang.empty(), "Must specify all arguments");
 }
 
 void PhraseDictionaryTransliteration::Load(AllOptions::ptr const& opts)
 {
   m_options = opts;
   SetFeaturesToApply();
-}
-
-void PhraseDictionaryTransliteration::CleanUpAfterSentenceProcessing(const InputType& source)
-{
-  ReduceCache();
+  m_model.reset(new TransliterationModel(m_filePath, m_stackSize));
 }
 
 void PhraseDictionaryTransliteration::GetTargetPhraseCollectionBatch(const InputPathList &inputPathQueue) const
@@ -47,7 +38,7 @@ void PhraseDictionaryTransliteration::GetTargetPhraseCollectionBatch(const Input
     const Phrase &sourcePhrase = inputPath.GetPhrase();
 
     if (sourcePhrase.GetSize() != 1) {
-      // only translit single words. A limitation of the translit script
+      // only translit single words, as the model is trained on words
       continue;
     }
 
@@ -60,80 +51,62 @@ PhraseDictionaryTransliteration::
 GetTargetPhraseCollection(InputPath &inputPath) const
 {
   const Phrase &sourcePhrase = inputPath.GetPhrase();
-  size_t hash = hash_value(sourcePhrase);
-
-  CacheColl &cache = GetCache();
-
-  CacheColl::iterator iter;
-  iter = cache.find(hash);
+  const string source = sourcePhrase.GetWord(0).GetString(m_input, false);
+
+  TargetPhraseCollection::shared_ptr tpColl;
+  {
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_translitCacheLock);
+#endif
+    TranslitCache::iterator iter = m_translitCache.find(source);
+    if (iter != m_translitCache.end()) {
+      // already in cache
+      m_lru.splice(m_lru.begin(), m_lru, iter->second.second);
+      tpColl = iter->second.first;
+    }
+  }
 
-  if (iter != cache.end()) {
-    // already in cache
-    TargetPhraseCollection::shared_ptr tpColl = iter->second.first;
-    inputPath.SetTargetPhrases(*this, tpColl, NULL);
-  } else {
-    // TRANSLITERATE
-    const util::temp_file inFile;
-    const util::temp_dir outDir;
-
-    ofstream inStream(inFile.path().c_str());
-    inStream << sourcePhrase.ToString() << endl;
-    inStream.close();
-
-    string cmd = m_scriptDir + "/Transliteration/prepare-transliteration-phrase-table.pl" +
-                 " --transliteration-model-dir " + m_filePath +
-                 " --moses-src-dir " + m_mosesDir +
-                 " --external-bin-dir " + m_externalDir +
-                 " --input-extension " + m_inputLang +
-                 " --output-extension " + m_outputLang +
-                 " --oov-file " + inFile.path() +
-                 " --out-dir " + outDir.path();
-
-    int ret = system(cmd.c_str());
-    UTIL_THROW_IF2(ret != 0, "Transliteration script error");
-
-    TargetPhraseCollection::shared_ptr tpColl(new TargetPhraseCollection);
-    vector<TargetPhrase*> targetPhrases
-    = CreateTargetPhrases(sourcePhrase, outDir.path());
-    vector<TargetPhrase*>::const_iterator iter;
-    for (iter = targetPhrases.begin(); iter != targetPhrases.end(); ++iter) {
-      TargetPhrase *tp = *iter;
-      tpColl->Add(tp);
+  if (!tpColl) {
+    // TRANSLITERATE, without holding the lock
+    tpColl = CreateTargetPhrases(sourcePhrase);
+
+#ifdef WITH_THREADS
+    boost::mutex::scoped_lock lock(m_translitCacheLock);
+#endif
+    if (m_translitCache.find(source) == m_translitCache.end()) {
+      m_lru.push_front(source);
+      m_translitCache[source] = make_pair(tpColl, m_lru.begin());
+      if (m_translitCache.size() > m_maxCacheSize) {
+        m_translitCache.erase(m_lru.back());
+        m_lru.pop_back();
+      }
     }
-    cache[hash] = CacheCollEntry(tpColl, clock());
-    inputPath.SetTargetPhrases(*this, tpColl, NULL);
   }
+
+  inputPath.SetTargetPhrases(*this, tpColl, NULL);
 }
 
-std::vector<TargetPhrase*> PhraseDictionaryTransliteration::CreateTargetPhrases(const Phrase &sourcePhrase, const string &outDir) const
+TargetPhraseCollection::shared_ptr PhraseDictionaryTransliteration::CreateTargetPhrases(const Phrase &sourcePhrase) const
 {
-  std::vector<TargetPhrase*> ret;
-
-  string outPath = outDir + "/out.txt";
-  ifstream outStream(outPath.c_str());
+  TargetPhraseCollection::shared_ptr tpColl(new TargetPhraseCollection);
 
-  string line;
-  while (getline(outStream, line)) {
-    vector<string> toks;
-    Tokenize(toks, line, "\t");
-    UTIL_THROW_IF2(toks.size() != 2, "Error in transliteration output file. Expecting word\tscore");
+  TransliterationModel::NBestList nBest;
+  m_model->Transliterate(sourcePhrase.GetWord(0).GetString(m_input, false), m_nBestSize, nBest);
 
+  for (size_t i = 0; i < nBest.size(); ++i) {
     TargetPhrase *tp = new TargetPhrase(this);
     Word &word = tp->AddWord();
-    word.CreateFromString(Output, m_output, toks[0], false);
+    word.CreateFromString(Output, m_output, nBest[i].first, false);
 
-    float score = Scan<float>(toks[1]);
-    tp->GetScoreBreakdown().PlusEquals(this, score);
+    tp->GetScoreBreakdown().PlusEquals(this, nBest[i].second);
 
     // score of all other ff when this rule is being loaded
     tp->EvaluateInIsolation(sourcePhrase, GetFeaturesToApply());
 
-    ret.push_back(tp);
+    tpColl->Add(tp);
   }
 
-  outStream.close();
-
-  return ret;
+  return tpColl;
 }
 
 ChartRuleLookupManager* PhraseDictionaryTransliteration::CreateRuleLookupManager(const ChartParser &parser,
@@ -148,16 +121,15 @@ void
 PhraseDictionaryTransliteration::
 SetParameter(const std::string& key, const std::string& value)
 {
-  if (key == "moses-dir") {
-    m_mosesDir = value;
-  } else if (key == "script-dir") {
-    m_scriptDir = value;
-  } else if (key == "external-dir") {
-    m_externalDir = value;
-  } else if (key == "input-lang") {
-    m_inputLang = value;
-  } else if (key == "output-lang") {
-    m_outputLang = value;
+  if (key == "n-best") {
+    m_nBestSize = Scan<size_t>(value);
+  } else if (key == "stack") {
+    m_stackSize = Scan<size_t>(value);
+  } else if (key == "cache-size") {
+    m_maxCacheSize = Scan<size_t>(value);
+  } else if (key == "moses-dir" || key == "script-dir" || key == "external-dir" ||
+             key == "input-lang" || key == "output-lang") {
+    // only needed by the transliteration scripts, which are no longer run
   } else {
     PhraseDictionary::SetParameter(key, value);
   }
@@ -2,7 +2,14 @@
 #pragma once
 
 #include "PhraseDictionary.h"
-#include <boost/thread/tss.hpp>
+#include "TransliterationModel.h"
+#include <list>
+#include <boost/scoped_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#endif
 
 namespace Moses
 {
@@ -11,6 +18,11 @@ class ChartCellCollectionBase;
 class ChartRuleLookupManager;
 class InputPath;
 
+/** Transliterates single unknown words with a character-level model trained
+ * by scripts/Transliteration/train-transliteration-module.pl (path=), which
+ * is loaded once and decoded in process.  The transliterations of the most
+ * recent cache-size words are shared by all threads.
+ */
 class PhraseDictionaryTransliteration : public PhraseDictionary
 {
   friend std::ostream& operator<<(std::ostream&, const PhraseDictionaryTransliteration&);
@@ -20,8 +32,6 @@ public:
 
   void Load(AllOptions::ptr const& opts);
 
-  virtual void CleanUpAfterSentenceProcessing(const InputType& source);
-
   // for phrase-based model
   void GetTargetPhraseCollectionBatch(const InputPathList &inputPathQueue) const;
 
@@ -33,9 +43,20 @@ public:
   TO_STRING();
 
 protected:
-  std::string m_mosesDir, m_scriptDir, m_externalDir, m_inputLang, m_outputLang;
+  typedef std::list<std::string> LRUList;
+  typedef boost::unordered_map<std::string, std::pair<TargetPhraseCollection::shared_ptr, LRUList::iterator> > TranslitCache;
+
+  boost::scoped_ptr<TransliterationModel> m_model;
+  size_t m_nBestSize, m_stackSize, m_maxCacheSize;
+
+  // most recently used first
+  mutable LRUList m_lru;
+  mutable TranslitCache m_translitCache;
+#ifdef WITH_THREADS
+  mutable boost::mutex m_translitCacheLock;
+#endif
 
-  std::vector<TargetPhrase*> CreateTargetPhrases(const Phrase &sourcePhrase, const std::string &outDir) const;
+  TargetPhraseCollection::shared_ptr CreateTargetPhrases(const Phrase &sourcePhrase) const;
 
   void GetTargetPhraseCollection(InputPath &inputPath) const;
 
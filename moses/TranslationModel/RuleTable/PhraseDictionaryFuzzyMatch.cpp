@@ -19,64 +19,22 @@
  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  ***********************************************************************/
 
-#include <cstdio>
-#include <cstdlib>
-#include <cstring>
-#include <climits>
-#include <sys/types.h>
-#include <unistd.h>
-#include <dirent.h>
-
-#include <fstream>
 #include <string>
-#include <iterator>
 #include <algorithm>
-#include "Loader.h"
-#include "LoaderFactory.h"
 #include "PhraseDictionaryFuzzyMatch.h"
-#include "moses/FactorCollection.h"
 #include "moses/Word.h"
 #include "moses/Util.h"
-#include "moses/InputFileStream.h"
-#include "moses/StaticData.h"
-#include "moses/Range.h"
 #include "moses/TranslationModel/CYKPlusParser/ChartRuleLookupManagerMemoryPerSentence.h"
 #include "moses/TranslationModel/fuzzy-match/FuzzyMatchWrapper.h"
-#include "moses/TranslationModel/fuzzy-match/SentenceAlignment.h"
 #include "moses/TranslationTask.h"
-#include "util/file.hh"
 #include "util/exception.hh"
-#include "util/random.hh"
 
-using namespace std;
-
-#if defined __MINGW32__ && !defined mkdtemp
-#include <windows.h>
-#include <cerrno>
-char *mkdtemp(char *tempbuf)
-{
-  int rand_value = 0;
-  char* tempbase = NULL;
-  char tempbasebuf[MAX_PATH] = "";
-
-  if (strcmp(&tempbuf[strlen(tempbuf)-6], "XXXXXX")) {
-    errno = EINVAL;
-    return NULL;
-  }
-
-  util::rand_init();
-  rand_value = util::rand_excl(1e6);
-  tempbase = strrchr(tempbuf, '/');
-  tempbase = tempbase ? tempbase+1 : tempbuf;
-  strcpy(tempbasebuf, tempbase);
-  sprintf(&tempbasebuf[strlen(tempbasebuf)-6], "%d", rand_value);
-  ::GetTempPath(MAX_PATH, tempbuf);
-  strcat(tempbuf, tempbasebuf);
-  ::CreateDirectory(tempbuf, NULL);
-  return tempbuf;
-}
+#ifdef WITH_THREADS
+#include <boost/thread/locks.hpp>
 #endif
 
+using namespace std;
+
 namespace Moses
 {
 
@@ -98,6 +56,10 @@ void PhraseDictionaryFuzzyMatch::Load(AllOptions::ptr const& opts)
   m_options = opts;
   SetFeaturesToApply();
 
+  UTIL_THROW_IF2(GetNumScoreComponents() != 2,
+                 "Fuzzy-match rule table " << GetScoreProducerDescription()
+                 << " needs num-features=2 (inverse and direct rule probability)");
+
   m_FuzzyMatchWrapper = new tmmt::FuzzyMatchWrapper(m_config[0], m_config[1], m_config[2]);
 }
 
@@ -124,184 +86,77 @@ SetParameter(const std::string& key, const std::string& value)
   }
 }
 
-int removedirectoryrecursively(const char *dirname)
-{
-#if defined __MINGW32__
-  //TODO(jie): replace this function with boost implementation
-#else
-  DIR *dir;
-  struct dirent *entry;
-  char path[PATH_MAX];
-
-  dir = opendir(dirname);
-  if (dir == NULL) {
-    perror("Error opendir()");
-    return 0;
-  }
-
-  while ((entry = readdir(dir)) != NULL) {
-    if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
-      snprintf(path, (size_t) PATH_MAX, "%s/%s", dirname, entry->d_name);
-      if (entry->d_type == DT_DIR) {
-        removedirectoryrecursively(path);
-      }
-
-      remove(path);
-      /*
-       * Here, the actual deletion must be done.  Beacuse this is
-       * quite a dangerous thing to do, and this program is not very
-       * well tested, we are just printing as if we are deleting.
-       */
-      //printf("(not really) Deleting: %s\n", path);
-      /*
-       * When you are finished testing this and feel you are ready to do the real
-       * deleting, use this: remove*STUB*(path);
-       * (see "man 3 remove")
-       * Please note that I DONT TAKE RESPONSIBILITY for data you delete with this!
-       */
-    }
-
-  }
-  closedir(dir);
-
-  rmdir(dirname);
-  /*
-   * Now the directory is emtpy, finally delete the directory itself. (Just
-   * printing here, see above)
-   */
-  //printf("(not really) Deleting: %s\n", dirname);
-#endif
-  return 1;
-}
-
 void PhraseDictionaryFuzzyMatch::InitializeForInput(ttasksptr const& ttask)
 {
   InputType const& inputSentence = *ttask->GetSource();
-#if defined __MINGW32__
-  char dirName[] = "moses.XXXXXX";
-#else
-  char dirName[] = "/tmp/moses.XXXXXX";
-#endif // defined
-  char *temp = mkdtemp(dirName);
-  UTIL_THROW_IF2(temp == NULL,
-                 "Couldn't create temporary directory " << dirName);
-
-  string dirNameStr(dirName);
-
-  string inFileName(dirNameStr + "/in");
-
-  ofstream inFile(inFileName.c_str());
 
+  vector<string> input;
   for (size_t i = 1; i < inputSentence.GetSize() - 1; ++i) {
-    inFile << inputSentence.GetWord(i);
+    input.push_back(inputSentence.GetWord(i).GetString(m_input, false));
   }
-  inFile << endl;
-  inFile.close();
 
-  long translationId = inputSentence.GetTranslationId();
-  string ptFileName = m_FuzzyMatchWrapper->Extract(translationId, dirNameStr);
+  // match, extract and score in memory
+  vector<tmmt::FuzzyMatchRule> rules;
+  m_FuzzyMatchWrapper->Extract(input, rules);
 
   // populate with rules for this sentence
-  PhraseDictionaryNodeMemory &rootNode = m_collection[translationId];
-  FormatType format = MosesFormat;
-
-  // data from file
-  InputFileStream inStream(ptFileName);
-
-  // copied from class LoaderStandard
-  PrintUserTime("Start loading fuzzy-match phrase model");
-
-  const StaticData &staticData = StaticData::Instance();
-
-
-  string lineOrig;
-  size_t count = 0;
-
-  while(getline(inStream, lineOrig)) {
-    const string *line;
-    if (format == HieroFormat) { // reformat line
-      UTIL_THROW(util::Exception, "Cannot be Hiero format");
-      //line = ReformatHieroRule(lineOrig);
-    } else {
-      // do nothing to format of line
-      line = &lineOrig;
-    }
-
-    vector<string> tokens;
-    vector<float> scoreVector;
-
-    TokenizeMultiCharSeparator(tokens, *line , "|||" );
-
-    if (tokens.size() != 4 && tokens.size() != 5) {
-      UTIL_THROW2("Syntax error at " << ptFileName << ":" << count);
+  PhraseDictionaryNodeMemory &rootNode = CreateRootNode(inputSentence.GetTranslationId());
+  const tmmt::Vocabulary &vocab = m_FuzzyMatchWrapper->GetVocabulary();
+
+  // all non-terminals and left-hand sides are [X]
+  Word sourceNonTerm(true), targetNonTerm(true);
+  sourceNonTerm.CreateFromString(Input, m_input, "X", true);
+  targetNonTerm.CreateFromString(Output, m_output, "X", true);
+
+  vector<float> scoreVector(2);
+  for (size_t r = 0; r < rules.size(); ++r) {
+    const tmmt::FuzzyMatchRule &rule = rules[r];
+
+    Phrase sourcePhrase(rule.source.size());
+    for (size_t pos = 0; pos < rule.source.size(); ++pos) {
+      if (rule.source[pos] == tmmt::FuzzyMatchWrapper::NON_TERMINAL) {
+        sourcePhrase.AddWord(sourceNonTerm);
+      } else {
+        sourcePhrase.AddWord().CreateFromString(Input, m_input, vocab.GetWord(rule.source[pos]), false);
+      }
     }
 
-    const string &sourcePhraseString = tokens[0]
-                                       , &targetPhraseString = tokens[1]
-                                           , &scoreString        = tokens[2]
-                                               , &alignString        = tokens[3];
-
-    bool isLHSEmpty = (sourcePhraseString.find_first_not_of(" \t", 0) == string::npos);
-    if (isLHSEmpty && !ttask->options()->unk.word_deletion_enabled) {
-      TRACE_ERR( ptFileName << ":" << count << ": pt entry contains empty target, skipping\n");
-      continue;
+    TargetPhrase *targetPhrase = new TargetPhrase(this);
+    for (size_t pos = 0; pos < rule.target.size(); ++pos) {
+      if (rule.target[pos] == tmmt::FuzzyMatchWrapper::NON_TERMINAL) {
+        targetPhrase->AddWord(targetNonTerm);
+      } else {
+        targetPhrase->AddWord().CreateFromString(Output, m_output, vocab.GetWord(rule.target[pos]), false);
+      }
     }
-
-    Tokenize<float>(scoreVector, scoreString);
-    const size_t numScoreComponents = GetNumScoreComponents();
-    if (scoreVector.size() != numScoreComponents) {
-      UTIL_THROW2("Size of scoreVector != number (" << scoreVector.size() << "!="
-                  << numScoreComponents << ") of score components on line " << count);
+    targetPhrase->SetTargetLHS(new Word(targetNonTerm));
+
+    AlignmentInfo::CollType alignTerm, alignNonTerm;
+    for (size_t a = 0; a < rule.alignment.size(); ++a) {
+      const pair<int,int> &point = rule.alignment[a];
+      if (rule.target[point.second] == tmmt::FuzzyMatchWrapper::NON_TERMINAL) {
+        alignNonTerm.insert(point);
+      } else {
+        alignTerm.insert(point);
+      }
     }
+    targetPhrase->SetAlignTerm(alignTerm);
+    targetPhrase->SetAlignNonTerm(alignNonTerm);
 
-    UTIL_THROW_IF2(scoreVector.size() != numScoreComponents,
-                   "Number of scores incorrectly specified");
-
-    // parse source & find pt node
-
-    // constituent labels
-    Word *sourceLHS;
-    Word *targetLHS;
-
-    // source
-    Phrase sourcePhrase( 0);
-    sourcePhrase.CreateFromString(Input, m_input, sourcePhraseString, &sourceLHS);
-
-    // create target phrase obj
-    TargetPhrase *targetPhrase = new TargetPhrase(this);
-    targetPhrase->CreateFromString(Output, m_output, targetPhraseString, &targetLHS);
-
-    // rest of target phrase
-    targetPhrase->SetAlignmentInfo(alignString);
-    targetPhrase->SetTargetLHS(targetLHS);
-    //targetPhrase->SetDebugOutput(string("New Format pt ") + line);
-
-    // component score, for n-best output
-    std::transform(scoreVector.begin(),scoreVector.end(),scoreVector.begin(),TransformScore);
-    std::transform(scoreVector.begin(),scoreVector.end(),scoreVector.begin(),FloorScore);
-
+    // p(f|e) p(e|f), as consolidate writes them
+    scoreVector[0] = FloorScore(TransformScore(rule.countEF / rule.countE));
+    scoreVector[1] = FloorScore(TransformScore(rule.countEF / rule.countF));
     targetPhrase->GetScoreBreakdown().Assign(this, scoreVector);
     targetPhrase->EvaluateInIsolation(sourcePhrase, GetFeaturesToApply());
 
     TargetPhraseCollection::shared_ptr phraseColl
     = GetOrCreateTargetPhraseCollection(rootNode, sourcePhrase,
-                                        *targetPhrase, sourceLHS);
+                                        *targetPhrase, NULL);
     phraseColl->Add(targetPhrase);
-
-    count++;
-
-    if (format == HieroFormat) { // reformat line
-      delete line;
-    } else {
-      // do nothing
-    }
-
   }
 
   // sort and prune each target phrase collection
   SortAndPrune(rootNode);
-
-  //removedirectoryrecursively(dirName);
 }
 
 TargetPhraseCollection::shared_ptr
@@ -320,7 +175,6 @@ PhraseDictionaryNodeMemory &PhraseDictionaryFuzzyMatch::GetOrCreateNode(PhraseDi
     , const TargetPhrase &target
     , const Word *sourceLHS)
 {
-  cerr << source << endl << target << endl;
   const size_t size = source.GetSize();
 
   const AlignmentInfo &alignmentInfo = target.GetAlignNonTerm();
@@ -372,11 +226,26 @@ void PhraseDictionaryFuzzyMatch::SortAndPrune(PhraseDictionaryNodeMemory &rootNo
 
 void PhraseDictionaryFuzzyMatch::CleanUpAfterSentenceProcessing(const InputType &source)
 {
+#ifdef WITH_THREADS
+  boost::unique_lock<boost::shared_mutex> lock(m_collectionLock);
+#endif
   m_collection.erase(source.GetTranslationId());
 }
 
+PhraseDictionaryNodeMemory &PhraseDictionaryFuzzyMatch::CreateRootNode(long translationId)
+{
+  // map nodes are stable, so the trie can be filled without holding the lock
+#ifdef WITH_THREADS
+  boost::unique_lock<boost::shared_mutex> lock(m_collectionLock);
+#endif
+  return m_collection[translationId];
+}
+
 const PhraseDictionaryNodeMemory &PhraseDictionaryFuzzyMatch::GetRootNode(long translationId) const
 {
+#ifdef WITH_THREADS
+  boost::shared_lock<boost::shared_mutex> read_lock(m_collectionLock);
+#endif
   std::map<long, PhraseDictionaryNodeMemory>::const_iterator iter = m_collection.find(translationId);
   UTIL_THROW_IF2(iter == m_collection.end(),
                  "Couldn't find root node for input: " << translationId);
@@ -385,6 +254,9 @@ const PhraseDictionaryNodeMemory &PhraseDictionaryFuzzyMatch::GetRootNode(long t
 PhraseDictionaryNodeMemory &PhraseDictionaryFuzzyMatch::GetRootNode(const InputType &source)
 {
   long transId = source.GetTranslationId();
+#ifdef WITH_THREADS
+  boost::shared_lock<boost::shared_mutex> read_lock(m_collectionLock);
+#endif
   std::map<long, PhraseDictionaryNodeMemory>::iterator iter = m_collection.find(transId);
   UTIL_THROW_IF2(iter == m_collection.end(),
                  "Couldn't find root node for input: " << transId);
@@ -20,6 +20,10 @@
 
 #pragma once
 
+#ifdef WITH_THREADS
+#include <boost/thread/shared_mutex.hpp>
+#endif
+
 #include "Trie.h"
 #include "moses/TranslationModel/PhraseDictionary.h"
 #include "moses/InputType.h"
@@ -73,8 +77,13 @@ protected:
 
   void SortAndPrune(PhraseDictionaryNodeMemory &rootNode);
   PhraseDictionaryNodeMemory &GetRootNode(const InputType &source);
+  PhraseDictionaryNodeMemory &CreateRootNode(long translationId);
 
+  // sentences are translated concurrently, each with its own trie
   std::map<long, PhraseDictionaryNodeMemory> m_collection;
+#ifdef WITH_THREADS
+  mutable boost::shared_mutex m_collectionLock;
+#endif
   std::vector<std::string> m_config;
 
   tmmt::FuzzyMatchWrapper *m_FuzzyMatchWrapper;
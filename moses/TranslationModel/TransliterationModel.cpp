@@ -0,0 +1,307 @@
+// vim:tabstop=2
+#include <algorithm>
+#include <map>
+
+#include "TransliterationModel.h"
+#include "moses/InputFileStream.h"
+#include "moses/TypeDef.h"
+#include "moses/Util.h"
+#include "lm/model.hh"
+#include "util/exception.hh"
+
+using namespace std;
+
+namespace Moses
+{
+
+namespace
+{
+
+struct FeatureSpec {
+  string type;
+  map<string, string> args;
+};
+
+// The [feature] and [weight] sections of a moses.ini written by train-model.perl
+void ReadConfig(const string &path, vector<FeatureSpec> &features, map<string, vector<float> > &weights)
+{
+  InputFileStream in(path);
+  map<string, size_t> typeCounts;
+  string section, line;
+  while (getline(in, line)) {
+    line = Trim(line);
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    if (line[0] == '[') {
+      section = line;
+      continue;
+    }
+    vector<string> toks = Tokenize(line);
+    if (section == "[feature]") {
+      FeatureSpec feature;
+      feature.type = toks[0];
+      for (size_t i = 1; i < toks.size(); ++i) {
+        vector<string> arg = TokenizeFirstOnly(toks[i], "=");
+        UTIL_THROW_IF2(arg.size() != 2, "Bad argument " << toks[i] << " in " << path);
+        feature.args[arg[0]] = arg[1];
+      }
+      // unnamed features are numbered by type, as FeatureFunction does
+      if (feature.args.find("name") == feature.args.end()) {
+        feature.args["name"] = feature.type + SPrint(typeCounts[feature.type]++);
+      }
+      features.push_back(feature);
+    } else if (section == "[weight]") {
+      UTIL_THROW_IF2(toks[0][toks[0].size() - 1] != '=', "Bad weight line " << line << " in " << path);
+      vector<float> &values = weights[toks[0].substr(0, toks[0].size() - 1)];
+      for (size_t i = 1; i < toks.size(); ++i) {
+        values.push_back(Scan<float>(toks[i]));
+      }
+    }
+  }
+}
+
+float GetWeight(const map<string, vector<float> > &weights, const string &name)
+{
+  map<string, vector<float> >::const_iterator iter = weights.find(name);
+  return (iter == weights.end() || iter->second.empty()) ? 0 : iter->second[0];
+}
+
+// split a UTF-8 string into its characters
+void SplitCharacters(const string &word, vector<string> &chars)
+{
+  chars.clear();
+  for (size_t i = 0; i < word.size(); ) {
+    size_t end = i + 1;
+    while (end < word.size() && (word[end] & 0xC0) == 0x80) {
+      ++end;
+    }
+    chars.push_back(word.substr(i, end - i));
+    i = end;
+  }
+}
+
+struct Hypothesis {
+  float score;
+  lm::ngram::State state;
+  string output;
+  bool operator<(const Hypothesis &other) const {
+    return score > other.score;
+  }
+};
+
+// all hypotheses covering the same characters, at most one per output
+class Stack
+{
+public:
+  void Add(const Hypothesis &hypo) {
+    boost::unordered_map<string, size_t>::const_iterator iter = m_index.find(hypo.output);
+    if (iter == m_index.end()) {
+      m_index[hypo.output] = m_hypos.size();
+      m_hypos.push_back(hypo);
+    } else if (m_hypos[iter->second].score < hypo.score) {
+      m_hypos[iter->second] = hypo;
+    }
+  }
+
+  vector<Hypothesis> &Prune(size_t stackSize) {
+    if (m_hypos.size() > stackSize) {
+      nth_element(m_hypos.begin(), m_hypos.begin() + stackSize, m_hypos.end());
+      m_hypos.resize(stackSize);
+    }
+    return m_hypos;
+  }
+
+private:
+  vector<Hypothesis> m_hypos;
+  boost::unordered_map<string, size_t> m_index;
+};
+
+} // namespace
+
+TransliterationModel::TransliterationModel(const string &modelDir, size_t stackSize)
+  : m_maxSourceLength(0)
+  , m_stackSize(stackSize)
+  , m_lmWeight(0)
+{
+  string configPath = modelDir + "/tuning/moses.tuned.ini";
+  if (!FileExists(configPath)) {
+    configPath = modelDir + "/model/moses.ini";
+  }
+  UTIL_THROW_IF2(!FileExists(configPath), "No moses.ini in transliteration model " << modelDir);
+
+  vector<FeatureSpec> features;
+  map<string, vector<float> > weights;
+  ReadConfig(configPath, features, weights);
+
+  float wordPenalty = 0, phrasePenalty = 0, unknownPenalty = 0;
+  string tablePath, lmPath;
+  vector<float> tableWeights;
+  size_t tableLimit = 20;
+  for (size_t i = 0; i < features.size(); ++i) {
+    const string &type = features[i].type;
+    map<string, string> &args = features[i].args;
+    const string &name = args["name"];
+    if (type == "WordPenalty") {
+      wordPenalty = GetWeight(weights, name);
+    } else if (type == "PhrasePenalty") {
+      phrasePenalty = GetWeight(weights, name);
+    } else if (type == "UnknownWordPenalty") {
+      unknownPenalty = GetWeight(weights, name);
+    } else if (type == "PhraseDictionaryMemory") {
+      UTIL_THROW_IF2(!tablePath.empty(), "More than one phrase table in " << configPath);
+      tablePath = args["path"];
+      tableWeights = weights[name];
+      if (args.count("table-limit")) {
+        tableLimit = Scan<size_t>(args["table-limit"]);
+      }
+    } else if (type == "KENLM") {
+      UTIL_THROW_IF2(!lmPath.empty(), "More than one language model in " << configPath);
+      lmPath = args["path"];
+      m_lmWeight = GetWeight(weights, name);
+    } else if (type == "Distortion") {
+      // monotone, so always 0
+    } else {
+      UTIL_THROW2("Feature " << type << " of " << configPath << " is not supported for transliteration");
+    }
+  }
+  UTIL_THROW_IF2(tablePath.empty(), "No PhraseDictionaryMemory in " << configPath);
+
+  // -drop-unknown: no output, but the unknown word and phrase penalties
+  m_unknownScore = unknownPenalty * FloorScore(TransformScore(0)) + phrasePenalty;
+
+  if (!lmPath.empty()) {
+    m_lm.reset(lm::ngram::LoadVirtual(lmPath.c_str()));
+    UTIL_THROW_IF2(m_lm->StateSize() > sizeof(lm::ngram::State),
+                   "Unsupported language model " << lmPath);
+  }
+
+  if (!FileExists(tablePath) && FileExists(tablePath + ".gz")) {
+    tablePath += ".gz";
+  }
+  LoadTable(tablePath, tableWeights, wordPenalty, phrasePenalty, tableLimit);
+}
+
+TransliterationModel::~TransliterationModel()
+{
+}
+
+void TransliterationModel::LoadTable(const string &path, const vector<float> &weights,
+                                     float wordPenalty, float phrasePenalty, size_t tableLimit)
+{
+  InputFileStream in(path);
+  string line;
+  vector<string> fields, targetChars;
+  while (getline(in, line)) {
+    fields.clear();
+    TokenizeMultiCharSeparator(fields, line, "|||");
+    UTIL_THROW_IF2(fields.size() < 3, "Bad line in transliteration phrase table " << path << ": " << line);
+
+    Option option;
+    targetChars = Tokenize(fields[1]);
+    vector<float> scores = Tokenize<float>(fields[2]);
+    UTIL_THROW_IF2(scores.size() != weights.size(),
+                   "Expected " << weights.size() << " scores in " << path << ": " << line);
+    option.score = phrasePenalty - wordPenalty * targetChars.size();
+    for (size_t i = 0; i < scores.size(); ++i) {
+      option.score += weights[i] * FloorScore(TransformScore(scores[i]));
+    }
+    for (size_t i = 0; i < targetChars.size(); ++i) {
+      option.target += targetChars[i];
+      if (m_lm) {
+        option.lmIds.push_back(m_lm->BaseVocabulary().Index(targetChars[i]));
+      }
+    }
+
+    m_table[fields[0]].push_back(option);
+    m_maxSourceLength = max(m_maxSourceLength, Tokenize(fields[0]).size());
+  }
+
+  for (Table::iterator iter = m_table.begin(); iter != m_table.end(); ++iter) {
+    vector<Option> &options = iter->second;
+    sort(options.begin(), options.end());
+    if (tableLimit && options.size() > tableLimit) {
+      options.resize(tableLimit);
+    }
+  }
+}
+
+void TransliterationModel::Transliterate(const string &word, size_t nBest, NBestList &ret) const
+{
+  ret.clear();
+  vector<string> chars;
+  SplitCharacters(word, chars);
+  const size_t size = chars.size();
+
+  vector<Stack> stacks(size + 1);
+  Hypothesis start;
+  start.score = 0;
+  if (m_lm) {
+    m_lm->BeginSentenceWrite(&start.state);
+  }
+  stacks[0].Add(start);
+
+  for (size_t pos = 0; pos < size; ++pos) {
+    // translation options of the spans starting here
+    vector<pair<size_t, const vector<Option>*> > spans;
+    string source;
+    for (size_t end = pos; end < size && end < pos + m_maxSourceLength; ++end) {
+      if (end > pos) {
+        source += ' ';
+      }
+      source += chars[end];
+      Table::const_iterator iter = m_table.find(source);
+      if (iter != m_table.end()) {
+        spans.push_back(make_pair(end + 1, &iter->second));
+      }
+    }
+    const bool unknown = spans.empty() || spans[0].first != pos + 1;
+
+    const vector<Hypothesis> &hypos = stacks[pos].Prune(m_stackSize);
+    for (size_t h = 0; h < hypos.size(); ++h) {
+      const Hypothesis &prev = hypos[h];
+      for (size_t s = 0; s < spans.size(); ++s) {
+        const vector<Option> &options = *spans[s].second;
+        for (size_t o = 0; o < options.size(); ++o) {
+          const Option &option = options[o];
+          Hypothesis next;
+          next.score = prev.score + option.score;
+          next.output = prev.output + option.target;
+          next.state = prev.state;
+          if (m_lm) {
+            float lmScore = 0;
+            lm::ngram::State state;
+            for (size_t i = 0; i < option.lmIds.size(); ++i) {
+              lmScore += m_lm->BaseScore(&next.state, option.lmIds[i], &state);
+              next.state = state;
+            }
+            next.score += m_lmWeight * TransformLMScore(lmScore);
+          }
+          stacks[spans[s].first].Add(next);
+        }
+      }
+      if (unknown) {
+        Hypothesis next = prev;
+        next.score += m_unknownScore;
+        stacks[pos + 1].Add(next);
+      }
+    }
+  }
+
+  vector<Hypothesis> &complete = stacks[size].Prune(m_stackSize);
+  for (size_t h = 0; h < complete.size(); ++h) {
+    if (m_lm) {
+      lm::ngram::State state;
+      complete[h].score += m_lmWeight * TransformLMScore(
+                          m_lm->BaseScore(&complete[h].state, m_lm->BaseVocabulary().EndSentence(), &state));
+    }
+  }
+  sort(complete.begin(), complete.end());
+  for (size_t h = 0; h < complete.size() && ret.size() < nBest; ++h) {
+    if (!complete[h].output.empty()) {
+      ret.push_back(make_pair(complete[h].output, complete[h].score));
+    }
+  }
+}
+
+}  // namespace Moses
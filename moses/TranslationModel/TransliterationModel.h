@@ -0,0 +1,66 @@
+// vim:tabstop=2
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "lm/word_index.hh"
+
+namespace lm
+{
+namespace base
+{
+class Model;
+}
+}
+
+namespace Moses
+{
+
+/** Character-level transliteration model trained by
+ * scripts/Transliteration/train-transliteration-module.pl, decoded in process.
+ *
+ * The model directory holds model/moses.ini (and, after tuning,
+ * tuning/moses.tuned.ini), a text phrase table over characters and a KenLM
+ * character language model.  Words are transliterated with a monotone beam
+ * search using the phrase table, word, phrase and unknown word penalties and
+ * the language model, as the decoder would with -distortion-limit 0
+ * -drop-unknown.  Transliterate() is const and may be called from several
+ * threads at once.
+ */
+class TransliterationModel
+{
+public:
+  typedef std::vector<std::pair<std::string, float> > NBestList;
+
+  TransliterationModel(const std::string &modelDir, size_t stackSize);
+  ~TransliterationModel();
+
+  //! the nBest best distinct transliterations of word with their model scores, best first
+  void Transliterate(const std::string &word, size_t nBest, NBestList &ret) const;
+
+protected:
+  struct Option {
+    std::string target;
+    std::vector<lm::WordIndex> lmIds;
+    float score; // weighted translation model, word and phrase penalty scores
+    bool operator<(const Option &other) const {
+      return score > other.score;
+    }
+  };
+  typedef boost::unordered_map<std::string, std::vector<Option> > Table;
+
+  Table m_table;
+  size_t m_maxSourceLength;
+  size_t m_stackSize;
+  boost::scoped_ptr<lm::base::Model> m_lm;
+  float m_lmWeight, m_unknownScore;
+
+  void LoadTable(const std::string &path, const std::vector<float> &weights,
+                 float wordPenalty, float phrasePenalty, size_t tableLimit);
+};
+
+}  // namespace Moses
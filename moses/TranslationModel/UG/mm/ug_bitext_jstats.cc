@@ -26,6 +26,7 @@ namespace sapt
   jstats(jstats const& other)
   {
     my_rcnt = other.rcnt();
+    my_cnt2 = other.cnt2();
     my_wcnt = other.wcnt();
     my_bcnt = other.bcnt();
     my_aln  = other.aln();
@@ -93,6 +94,39 @@ namespace sapt
     return my_rcnt;
   }
   
+  void
+  jstats::
+  merge(jstats const& other)
+  {
+    boost::lock_guard<boost::mutex> lk(this->lock);
+    if (other.my_cnt2) my_cnt2 = other.my_cnt2;
+    my_rcnt += other.my_rcnt;
+    my_wcnt += other.my_wcnt;
+    my_bcnt += other.my_bcnt;
+    for (size_t k = 0; k < other.my_aln.size(); ++k)
+      {
+        size_t i = 0;
+        while (i < my_aln.size() && my_aln[i].second != other.my_aln[k].second) ++i;
+        if (i == my_aln.size()) my_aln.push_back(other.my_aln[k]);
+        else my_aln[i].first += other.my_aln[k].first;
+      }
+    // the most frequent alignment must come first
+    make_heap(my_aln.begin(), my_aln.end());
+    for (int i = 0; i <= LRModel::NONE; ++i)
+      {
+        ofwd[i] += other.ofwd[i];
+        obwd[i] += other.obwd[i];
+      }
+    if (other.sids)
+      {
+        if (!sids) sids.reset(new std::vector<uint32_t>);
+        sids->insert(sids->end(), other.sids->begin(), other.sids->end());
+      }
+    typedef std::map<uint32_t,uint32_t>::const_iterator iter;
+    for (iter m = other.indoc.begin(); m != other.indoc.end(); ++m)
+      indoc[m->first] += m->second;
+  }
+
   std::vector<std::pair<size_t, std::vector<unsigned char> > > const&
   jstats::
   aln() const
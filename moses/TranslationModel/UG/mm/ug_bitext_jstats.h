@@ -45,6 +45,10 @@ namespace sapt
 	uint32_t fwd_orient, uint32_t bwd_orient, int const docid, uint32_t const sid,
 	bool const track_sid);
 
+    // add the counts of /other/, e.g. from sampling another part of the
+    // occurrences of the same source phrase
+    void merge(jstats const& other);
+
     void invalidate();
     void validate();
     bool valid();
@@ -82,6 +82,27 @@ namespace sapt
     return ret;
   }
 
+  void
+  pstats::
+  merge(pstats const& other)
+  {
+    boost::lock_guard<boost::mutex> guard(this->lock);
+    sample_cnt += other.sample_cnt;
+    good       += other.good;
+    sum_pairs  += other.sum_pairs;
+    for (int i = 0; i <= LRModel::NONE; ++i)
+      {
+        ofwd[i] += other.ofwd[i];
+        obwd[i] += other.obwd[i];
+      }
+    for (indoc_map_t::const_iterator m = other.indoc.begin();
+         m != other.indoc.end(); ++m)
+      indoc[m->first] += m->second;
+    for (trg_map_t::const_iterator m = other.trg.begin();
+         m != other.trg.end(); ++m)
+      trg[m->first].merge(m->second);
+  }
+
   void 
   pstats::
   wait() const
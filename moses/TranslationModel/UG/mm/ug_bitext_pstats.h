@@ -58,6 +58,11 @@ namespace sapt
 		 size_t const num_pairs, // # of phrases extractable here
 		 int const po_fwd,       // fwd phrase orientation
 		 int const po_bwd);      // bwd phrase orientation
+
+    // add the samples of /other/ (but not its raw count), e.g. from
+    // sampling another part of the occurrences of the same phrase
+    void merge(pstats const& other);
+
     void wait() const;
   };
 
@@ -2,7 +2,9 @@
 #pragma once
 
 #include <algorithm>
+#include <cmath>
 
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/random.hpp>
 #include <boost/thread.hpp>
 #include <boost/thread/locks.hpp>
@@ -16,6 +18,7 @@
 #include "ug_bitext_phrase_extraction_record.h"
 #include "moses/TranslationModel/UG/generic/threading/ug_ref_counter.h"
 #include "moses/TranslationModel/UG/generic/threading/ug_thread_safe_counter.h"
+#include "moses/TranslationModel/UG/generic/threading/ug_thread_pool.h"
 #include "moses/TranslationModel/UG/generic/sorting/NBestList.h"
 namespace sapt
 {
@@ -29,6 +32,55 @@ sampling_method
     ranked_sampling2 
   };
   
+// Sampling latency per phrase frequency band: band b holds the phrases
+// with 10^b to 10^(b+1)-1 occurrences (the last one all more frequent
+// phrases), and counts how many took less than 1ms, 10ms, 100ms, 1s and
+// longer to sample.
+class SamplingLatency
+{
+  static size_t const num_bands = 7;
+  static size_t const num_buckets = 5;
+  mutable boost::mutex m_lock;
+  size_t m_count[num_bands][num_buckets];
+  double m_total[num_bands]; // seconds
+public:
+  SamplingLatency()
+  {
+    for (size_t b = 0; b < num_bands; ++b)
+      {
+        m_total[b] = 0;
+        for (size_t k = 0; k < num_buckets; ++k) m_count[b][k] = 0;
+      }
+  }
+
+  void add(size_t const occurrences, double const seconds)
+  {
+    size_t b = 0, k = 0;
+    for (size_t n = occurrences; n >= 10 && b + 1 < num_bands; n /= 10) ++b;
+    for (double t = .001; seconds >= t && k + 1 < num_buckets; t *= 10) ++k;
+    boost::lock_guard<boost::mutex> guard(m_lock);
+    ++m_count[b][k];
+    m_total[b] += seconds;
+  }
+
+  void print(std::ostream& out) const
+  {
+    boost::lock_guard<boost::mutex> guard(m_lock);
+    out << "occurrences\tphrases\tavg_ms\t<1ms\t<10ms\t<100ms\t<1s\t>=1s\n";
+    for (size_t b = 0, lo = 1; b < num_bands; ++b, lo *= 10)
+      {
+        size_t n = 0;
+        for (size_t k = 0; k < num_buckets; ++k) n += m_count[b][k];
+        if (n == 0) continue;
+        out << lo << (b + 1 < num_bands ? "-" : "+");
+        if (b + 1 < num_bands) out << lo * 10 - 1;
+        out << "\t" << n << "\t" << 1000 * m_total[b] / n;
+        for (size_t k = 0; k < num_buckets; ++k) out << "\t" << m_count[b][k];
+        out << "\n";
+      }
+  }
+};
+
 typedef ttrack::Position TokenPosition;
 class CandidateSorter
 {
@@ -72,6 +124,64 @@ BitextSampler : public Moses::reference_counter
   double m_bias_total;
   bool m_track_sids; // track sentence ids in stats?
 
+  // parallel sampling of large ranges, see parallelize()
+  ug::ThreadPool*     m_pool;
+  size_t         m_max_parts;
+  size_t     m_min_part_size;
+  bool const       m_is_part; // samples part of the range of another sampler
+  SamplingLatency* m_latency;
+
+  // The parts of a large range, sampled independently and merged in order
+  // so that the result does not depend on which thread sampled what.  The
+  // thread that splits the range and any number of pool threads take the
+  // next part until none is left, so nobody waits for a part that has not
+  // been started yet, even when all pool threads are splitting ranges.
+  class part_queue
+  {
+    boost::mutex m_lock;
+    boost::condition_variable m_done;
+    size_t m_next, m_finished;
+  public:
+    std::vector<SPTR<BitextSampler> > parts;
+    part_queue() : m_next(0), m_finished(0) {}
+
+    void work()
+    {
+      while (true)
+        {
+          size_t i;
+          {
+            boost::lock_guard<boost::mutex> guard(m_lock);
+            if (m_next == parts.size()) return;
+            i = m_next++;
+          }
+          (*parts[i])();
+          boost::lock_guard<boost::mutex> guard(m_lock);
+          if (++m_finished == parts.size()) m_done.notify_all();
+        }
+    }
+
+    void wait()
+    {
+      boost::unique_lock<boost::mutex> lock(m_lock);
+      while (m_finished < parts.size()) m_done.wait(lock);
+    }
+  };
+
+  struct part_worker
+  {
+    SPTR<part_queue> queue;
+    part_worker(SPTR<part_queue> const& q) : queue(q) {}
+    void operator()() { queue->work(); }
+  };
+
+  BitextSampler(BitextSampler const& parent, 
+                char const* next, char const* stop,
+                size_t const max_samples, size_t const raw_cnt, 
+                double const bias_total, uint32_t const seed);
+
+  bool sample_in_parts();
+
   size_t consider_sample(TokenPosition const& p);
   size_t perform_random_sampling();
   size_t perform_full_phrase_extraction();
@@ -90,6 +200,17 @@ public:
                 sampling_method const method,
                 bool const track_sids);
   ~BitextSampler();
+
+  // Sample ranges of at least 2 * /min_part_size/ occurrences in up to
+  // /max_parts/ parts in parallel, with the help of the threads of /pool/.
+  // Each part gets a share of the samples proportional to its share of
+  // the occurrences (or of the bias).
+  void parallelize(ug::ThreadPool* pool, size_t const max_parts,
+                   size_t const min_part_size);
+
+  // record sampling times in /latency/
+  void record_latency(SamplingLatency* latency);
+
   SPTR<pstats> stats();
   bool done() const;
 #ifdef MMT
@@ -203,12 +324,51 @@ BitextSampler(SPTR<Bitext<Token> const> const& bitext,
   , m_finished(false)
   , m_num_occurrences(phrase.ca())
   , m_rnd(0)
+  , m_bias_total(0)
   , m_track_sids(track_sids)
+  , m_pool(NULL)
+  , m_max_parts(1)
+  , m_min_part_size(0)
+  , m_is_part(false)
+  , m_latency(NULL)
 {
   m_stats.reset(new pstats(m_track_sids));
   m_stats->raw_cnt = phrase.ca();
   m_stats->register_worker();
 }
+
+template<typename Token>
+BitextSampler<Token>::
+BitextSampler(BitextSampler const& parent, char const* next, char const* stop,
+              size_t const max_samples, size_t const raw_cnt, 
+              double const bias_total, uint32_t const seed)
+  : m_bitext(parent.m_bitext)
+  , m_plen(parent.m_plen)
+  , m_fwd(parent.m_fwd)
+  , m_root(parent.m_root)
+  , m_next(next)
+  , m_stop(stop)
+  , m_method(parent.m_method)
+  , m_bias(parent.m_bias)
+  , m_samples(max_samples)
+  , m_min_samples(parent.m_min_samples)
+  , m_ctr(0)
+  , m_total_bias(0)
+  , m_finished(false)
+  , m_num_occurrences(raw_cnt)
+  , m_rnd(seed)
+  , m_bias_total(bias_total)
+  , m_track_sids(parent.m_track_sids)
+  , m_pool(NULL)
+  , m_max_parts(1)
+  , m_min_part_size(0)
+  , m_is_part(true)
+  , m_latency(NULL)
+{
+  m_stats.reset(new pstats(m_track_sids));
+  m_stats->raw_cnt = raw_cnt;
+  m_stats->register_worker();
+}
   
 template<typename Token>
 BitextSampler<Token>::
@@ -225,6 +385,13 @@ BitextSampler(BitextSampler const& other)
   , m_min_samples(other.m_min_samples)
   , m_num_occurrences(other.m_num_occurrences)
   , m_rnd(0)
+  , m_bias_total(other.m_bias_total)
+  , m_track_sids(other.m_track_sids)
+  , m_pool(other.m_pool)
+  , m_max_parts(other.m_max_parts)
+  , m_min_part_size(other.m_min_part_size)
+  , m_is_part(other.m_is_part)
+  , m_latency(other.m_latency)
 {
   // lock both instances
   boost::unique_lock<boost::mutex> mylock(m_lock);
@@ -261,10 +428,10 @@ BitextSampler<Token>::
 perform_random_sampling()
 {
   if (m_next == m_stop) return m_ctr;
-  m_bias_total = 0;
   sapt::tsa::ArrayEntry I(m_next);
-  if (m_bias)
+  if (m_bias && !m_is_part) // parts get their totals from the parent
     {
+      m_bias_total = 0;
       m_stats->raw_cnt = 0;
       while (I.next < m_stop)
         {
@@ -356,17 +523,117 @@ operator()()
 {
   if (m_finished) return true;
   boost::unique_lock<boost::mutex> lock(m_lock);
-  if (m_method == full_coverage)
-    perform_full_phrase_extraction(); // consider all occurrences 
-  else if (m_method == random_sampling)
-    perform_random_sampling();
-  else UTIL_THROW2("Unsupported sampling method.");
+  using namespace boost::posix_time;
+  ptime start = microsec_clock::universal_time();
+  if (m_method != full_coverage && m_method != random_sampling)
+    UTIL_THROW2("Unsupported sampling method.");
+  if (!sample_in_parts())
+    {
+      if (m_method == full_coverage)
+        perform_full_phrase_extraction(); // consider all occurrences 
+      else 
+        perform_random_sampling();
+    }
+  if (m_latency)
+    m_latency->add(m_num_occurrences, (microsec_clock::universal_time() 
+                                       - start).total_microseconds() / 1e6);
   m_finished = true;
   m_ready.notify_all();
   return true;
 }
 #endif
 
+template<typename Token>
+void
+BitextSampler<Token>::
+parallelize(ug::ThreadPool* pool, size_t const max_parts, 
+            size_t const min_part_size)
+{
+  m_pool = pool;
+  m_max_parts = max_parts;
+  m_min_part_size = min_part_size;
+}
+
+template<typename Token>
+void
+BitextSampler<Token>::
+record_latency(SamplingLatency* latency)
+{
+  m_latency = latency;
+}
+
+template<typename Token>
+bool
+BitextSampler<Token>::
+sample_in_parts()
+{
+  if (!m_pool || !m_min_part_size || m_is_part) return false;
+  size_t n = std::min(m_max_parts, m_num_occurrences / m_min_part_size);
+  if (n < 2) return false;
+
+  std::vector<char const*> bounds(1, m_next);
+  for (size_t i = 1; i < n; ++i)
+    {
+      char const* p = m_root->split_point(m_next, m_stop, float(i)/n);
+      if (p > bounds.back()) bounds.push_back(p);
+    }
+  bounds.push_back(m_stop);
+  n = bounds.size() - 1;
+  if (n < 2) return false;
+
+  // occurrences and bias mass of each part; with a bias we count them, 
+  // like perform_random_sampling() does, otherwise we estimate them
+  std::vector<size_t> raw(n, 0);
+  std::vector<double> mass(n, 0);
+  size_t total_raw = 0;
+  double total_mass = 0;
+  for (size_t i = 0; i < n; ++i)
+    {
+      if (m_bias)
+        {
+          sapt::tsa::ArrayEntry I(bounds[i]);
+          while (I.next < bounds[i+1])
+            {
+              m_root->readEntry(I.next, I);
+              ++raw[i];
+              mass[i] += (*m_bias)[I.sid];
+            }
+        }
+      else
+        raw[i] = std::max(size_t(1), size_t(double(m_num_occurrences) 
+                                            * (bounds[i+1] - bounds[i])
+                                            / (m_stop - m_next)));
+      total_raw  += raw[i];
+      total_mass += mass[i];
+    }
+  if (m_bias) m_stats->raw_cnt = total_raw;
+
+  SPTR<part_queue> queue(new part_queue);
+  for (size_t i = 0; i < n; ++i)
+    {
+      double share = (total_mass > 0 ? mass[i] / total_mass 
+                      : double(raw[i]) / total_raw);
+      size_t samples = (m_method == full_coverage ? m_samples
+                        : size_t(ceil(share * m_samples)));
+      queue->parts.push_back(SPTR<BitextSampler>
+                             (new BitextSampler(*this, bounds[i], bounds[i+1],
+                                                samples, raw[i], mass[i], i)));
+    }
+  for (size_t i = 1; i < n; ++i)
+    {
+      part_worker w(queue);
+      m_pool->add(w);
+    }
+  queue->work(); // don't just wait, help!
+  queue->wait();
+
+  BOOST_FOREACH(SPTR<BitextSampler> const& part, queue->parts)
+    {
+      m_stats->merge(*part->stats());
+      m_ctr += part->m_ctr;
+    }
+  return true;
+}
   
 template<typename Token>
 bool
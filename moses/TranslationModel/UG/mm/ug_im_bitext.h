@@ -30,6 +30,12 @@ namespace sapt
 	std::vector<std::string> const& s2,
 	std::vector<std::string> const& a) const;
 
+    // a new bitext with the sentence pairs of this one followed by those
+    // of /other/; neither is modified. Only /other/ is sorted, this
+    // bitext's suffix arrays are merged in linear time.
+    SPTR<imBitext<TKN> >
+    merge(imBitext<TKN> const& other) const;
+
   };
 
   template<typename TKN>
@@ -103,6 +109,40 @@ namespace sapt
     throw "Not yet implemented";
   }
 
+  template<typename TKN>
+  SPTR<imBitext<TKN> >
+  imBitext<TKN>::
+  merge(imBitext<TKN> const& other) const
+  {
+    SPTR<imBitext<TKN> > ret(new imBitext<TKN>(*this));
+    if (!other.myT1) return ret;
+    if (!this->myT1)
+      {
+        ret->myTx = other.myTx;
+        ret->myT1 = other.myT1;
+        ret->myT2 = other.myT2;
+        ret->myI1 = other.myI1;
+        ret->myI2 = other.myI2;
+      }
+    else
+      {
+        ret->myTx = concatenate(*this->myTx, *other.myTx);
+        ret->myT1 = concatenate(*this->myT1, *other.myT1);
+        ret->myT2 = concatenate(*this->myT2, *other.myT2);
+        std::vector<id_type> newsids(other.myT1->size());
+        for (size_t i = 0; i < newsids.size(); ++i)
+          newsids[i] = this->myT1->size() + i;
+        ret->myI1.reset(new imTSA<TKN>(*this->myI1, ret->myT1, newsids, this->V1->tsize()));
+        ret->myI2.reset(new imTSA<TKN>(*this->myI2, ret->myT2, newsids, this->V2->tsize()));
+      }
+    ret->Tx = ret->myTx;
+    ret->T1 = ret->myT1;
+    ret->T2 = ret->myT2;
+    ret->I1 = ret->myI1;
+    ret->I2 = ret->myI2;
+    return ret;
+  }
+
   // What's up with this function???? UG
   template<typename TKN>
   void
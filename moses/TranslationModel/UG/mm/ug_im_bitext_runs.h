@@ -0,0 +1,195 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width:2  -*-
+// Append-optimized dynamic bitext: a log-structured set of in-memory
+// bitexts ("runs").
+#pragma once
+#include <vector>
+#include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+#include "ug_bitext.h"
+
+namespace sapt
+{
+  // Adding sentence pairs to an imBitext copies and re-sorts its whole
+  // suffix arrays, so it gets slower as the bitext grows. imBitextRuns puts
+  // each batch of new sentence pairs into a new, small imBitext instead and
+  // publishes it right away. A background thread merges adjacent runs of
+  // similar size (the older one at most twice the size of the newer one),
+  // which keeps the number of runs logarithmic in the number of sentence
+  // pairs.
+  //
+  // Readers work on immutable snapshots and never wait for additions or
+  // merges; they have to query all runs of a snapshot and pool the results.
+  template<typename TKN>
+  class imBitextRuns
+  {
+  public:
+    typedef imBitext<TKN> run_t;
+
+    struct snapshot
+    {
+      std::vector<SPTR<run_t> > runs; // oldest first
+      SPTR<run_t> largest;            // the largest run, or an empty bitext
+      size_t revision;                // changes when sentence pairs are added
+    };
+
+  private:
+    SPTR<run_t> m_empty;
+    mutable boost::mutex m_lock; // for m_current, m_revision and m_merging
+    SPTR<snapshot const> m_current;
+    size_t m_revision;
+    bool m_merging;
+    SPTR<boost::thread> m_merger;
+
+    // caller must lock
+    void publish(std::vector<SPTR<run_t> > const& runs);
+
+    // merge runs until none is at most twice the size of its successor
+    void merge_runs();
+
+  public:
+    imBitextRuns(SPTR<TokenIndex> const& V1, SPTR<TokenIndex> const& V2,
+                 size_t max_sample = 5000, size_t num_workers = 4);
+    ~imBitextRuns();
+
+    SPTR<snapshot const> get() const;
+
+    void add(std::vector<std::string> const& s1,
+             std::vector<std::string> const& s2,
+             std::vector<std::string> const& a);
+
+    // number of sentence pairs
+    size_t size() const;
+  };
+
+  template<typename TKN>
+  imBitextRuns<TKN>::
+  imBitextRuns(SPTR<TokenIndex> const& V1, SPTR<TokenIndex> const& V2,
+               size_t max_sample, size_t num_workers)
+    : m_empty(new run_t(V1, V2, max_sample, num_workers))
+    , m_revision(0)
+    , m_merging(false)
+  {
+    publish(std::vector<SPTR<run_t> >());
+  }
+
+  template<typename TKN>
+  imBitextRuns<TKN>::
+  ~imBitextRuns()
+  {
+    SPTR<boost::thread> merger;
+    {
+      boost::lock_guard<boost::mutex> guard(m_lock);
+      merger = m_merger;
+    }
+    if (merger) merger->join();
+  }
+
+  template<typename TKN>
+  void
+  imBitextRuns<TKN>::
+  publish(std::vector<SPTR<run_t> > const& runs)
+  {
+    SPTR<snapshot> s(new snapshot);
+    s->runs = runs;
+    s->largest = m_empty;
+    size_t largest = 0;
+    BOOST_FOREACH(SPTR<run_t> const& r, runs)
+      {
+        if (r->T1->size() <= largest) continue;
+        largest = r->T1->size();
+        s->largest = r;
+      }
+    s->revision = m_revision;
+    m_current = s;
+  }
+
+  template<typename TKN>
+  SPTR<typename imBitextRuns<TKN>::snapshot const>
+  imBitextRuns<TKN>::
+  get() const
+  {
+    boost::lock_guard<boost::mutex> guard(m_lock);
+    return m_current;
+  }
+
+  template<typename TKN>
+  size_t
+  imBitextRuns<TKN>::
+  size() const
+  {
+    SPTR<snapshot const> s = get();
+    size_t ret = 0;
+    BOOST_FOREACH(SPTR<run_t> const& r, s->runs)
+      ret += r->T1->size();
+    return ret;
+  }
+
+  template<typename TKN>
+  void
+  imBitextRuns<TKN>::
+  add(std::vector<std::string> const& s1,
+      std::vector<std::string> const& s2,
+      std::vector<std::string> const& a)
+  {
+    if (s1.empty()) return;
+    // build the new run without holding the lock
+    SPTR<run_t> run = m_empty->add(s1, s2, a);
+
+    boost::lock_guard<boost::mutex> guard(m_lock);
+    std::vector<SPTR<run_t> > runs = m_current->runs;
+    runs.push_back(run);
+    ++m_revision;
+    publish(runs);
+    if (!m_merging && runs.size() > 1)
+      {
+        m_merging = true;
+        // a previous merger has cleared m_merging and is about to exit
+        if (m_merger) m_merger->join();
+        m_merger.reset(new boost::thread(&imBitextRuns<TKN>::merge_runs, this));
+      }
+  }
+
+  template<typename TKN>
+  void
+  imBitextRuns<TKN>::
+  merge_runs()
+  {
+    while (true)
+      {
+        SPTR<run_t> a, b;
+        {
+          boost::lock_guard<boost::mutex> guard(m_lock);
+          std::vector<SPTR<run_t> > const& runs = m_current->runs;
+          // newest pair first, so that small runs are merged quickly
+          for (size_t i = runs.size(); i-- > 1;)
+            {
+              if (runs[i-1]->T1->size() <= 2 * runs[i]->T1->size())
+                {
+                  a = runs[i-1];
+                  b = runs[i];
+                  break;
+                }
+            }
+          if (!a)
+            {
+              m_merging = false;
+              return;
+            }
+        }
+
+        SPTR<run_t> ab = a->merge(*b);
+
+        // only this thread removes runs, so a and b are still adjacent
+        boost::lock_guard<boost::mutex> guard(m_lock);
+        std::vector<SPTR<run_t> > runs;
+        runs.reserve(m_current->runs.size() - 1);
+        BOOST_FOREACH(SPTR<run_t> const& r, m_current->runs)
+          {
+            if (r == a) runs.push_back(ab);
+            else if (r != b) runs.push_back(r);
+          }
+        publish(runs);
+      }
+  }
+
+} // end of namespace sapt
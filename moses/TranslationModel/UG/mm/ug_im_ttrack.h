@@ -192,6 +192,21 @@ namespace sapt
     return i;
   }
 
+  /// a new track with the sentences of /a/ followed by those of /b/
+  template<typename TOKEN>
+  boost::shared_ptr<imTtrack<TOKEN> >
+  concatenate(Ttrack<TOKEN> const& a, Ttrack<TOKEN> const& b)
+  {
+    boost::shared_ptr<std::vector<std::vector<TOKEN> > > data;
+    data.reset(new std::vector<std::vector<TOKEN> >());
+    data->reserve(a.size() + b.size());
+    for (size_t sid = 0; sid < a.size(); ++sid)
+      data->push_back(std::vector<TOKEN>(a.sntStart(sid), a.sntEnd(sid)));
+    for (size_t sid = 0; sid < b.size(); ++sid)
+      data->push_back(std::vector<TOKEN>(b.sntStart(sid), b.sntEnd(sid)));
+    return boost::shared_ptr<imTtrack<TOKEN> >(new imTtrack<TOKEN>(data));
+  }
+
   /// add a sentence to the database
   template<typename TOKEN>
   boost::shared_ptr<imTtrack<TOKEN> >
@@ -203,14 +218,15 @@ namespace sapt
     boost::shared_ptr<imTtrack<TOKEN> > ret;
     if (crp == NULL)
       {
+	// no reserve: small tracks (e.g. new runs of imBitextRuns) are common
   	ret.reset(new imTtrack<TOKEN>());
-	ret->myData->reserve(IMTTRACK_INCREMENT_SIZE);
       }
     else if (crp->myData->capacity() == crp->size())
       {
   	ret.reset(new imTtrack<TOKEN>());
 	ret->myData->reserve(crp->size() + IMTTRACK_INCREMENT_SIZE);
-	copy(crp->myData->begin(),crp->myData->end(),ret->myData->begin());
+	ret->myData->assign(crp->myData->begin(),crp->myData->end());
+	ret->numToks = crp->numToks;
       }
     else ret = crp;
     ret->myData->push_back(snt);
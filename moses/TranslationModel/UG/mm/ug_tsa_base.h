@@ -254,6 +254,15 @@ namespace sapt
 
     tsa::ArrayEntry& readEntry(char const* p, tsa::ArrayEntry& I) const;
 
+    /** @return the start of the index entry approximately /fraction/
+     *  between /startRange/ and /stopRange/, for splitting a range into
+     *  parts that can be read independently
+     */
+    char const*
+    split_point(char const* startRange, char const* stopRange,
+                float fraction) const
+    { return index_jump(startRange, stopRange, fraction); }
+
     /** return pointer to the end of the data block */
     char const* dataEnd() const;
 
@@ -10,6 +10,8 @@
 #include "util/exception.hh"
 #include <set>
 #include "util/usage.hh"
+#include "util/murmur_hash.hh"
+#include "moses/Sentence.h"
 
 namespace Moses
 {
@@ -86,6 +88,16 @@ namespace Moses
     // Register();
   }
 
+  Mmsapt::
+  ~Mmsapt()
+  {
+    if (m_sampling_latency)
+      {
+        cerr << "Sampling times of " << GetScoreProducerDescription() << ":\n";
+        m_sampling_latency->print(cerr);
+      }
+  }
+
   void
   Mmsapt::
   read_config_file(string fname, map<string,string>& param)
@@ -191,6 +203,24 @@ namespace Moses
     m_workers = atoi(param.insert(dflt).first->second.c_str());
     if (m_workers == 0) m_workers = StaticData::Instance().ThreadCount();
     else m_workers = min(m_workers,size_t(boost::thread::hardware_concurrency()));
+
+    // frequent phrases are sampled in up to sample-parts parts in parallel,
+    // each covering at least sample-part-size occurrences; the samples
+    // depend on the number of parts, so this is off (1) by default
+    dflt = pair<string,string>("sample-parts","1");
+    m_sample_parts = atoi(param.insert(dflt).first->second.c_str());
+    if (m_sample_parts == 0) m_sample_parts = 1;
+
+    dflt = pair<string,string>("sample-part-size","10000");
+    m_sample_part_size = atoi(param.insert(dflt).first->second.c_str());
+
+    dflt = pair<string,string>("prefetch","1");
+    m_prefetch = Scan<bool>(param.insert(dflt).first->second);
+
+    // report sampling times per phrase frequency on exit?
+    dflt = pair<string,string>("sampling-latency","0");
+    if (Scan<bool>(param.insert(dflt).first->second))
+      m_sampling_latency.reset(new SamplingLatency);
     
     dflt = pair<string,string>("bias-loglevel","0");
     m_bias_loglevel = atoi(param.insert(dflt).first->second.c_str());
@@ -343,9 +373,13 @@ namespace Moses
     known_parameters.push_back("path");
     known_parameters.push_back("pbwd");
     known_parameters.push_back("pfwd");
+    known_parameters.push_back("prefetch");
     known_parameters.push_back("prov");
     known_parameters.push_back("rare");
     known_parameters.push_back("sample");
+    known_parameters.push_back("sample-part-size");
+    known_parameters.push_back("sample-parts");
+    known_parameters.push_back("sampling-latency");
     known_parameters.push_back("min-sample");
     known_parameters.push_back("smooth");
     known_parameters.push_back("table-limit");
@@ -391,11 +425,8 @@ namespace Moses
     while(getline(in2,line)) text2.push_back(line);
     while(getline(ina,line)) symal.push_back(line);
 
-    scoped_ptr<boost::unique_lock<shared_mutex> > guard;
-    if (locking) guard.reset(new boost::unique_lock<shared_mutex>(m_lock));
-    btdyn = btdyn->add(text1,text2,symal);
-    assert(btdyn);
-    cerr << "Loaded " << btdyn->T1->size() << " sentence pairs" << endl;
+    btdyn->add(text1,text2,symal);
+    cerr << "Loaded " << btdyn->size() << " sentence pairs" << endl;
   }
 
   template<typename fftype>
@@ -538,7 +569,7 @@ namespace Moses
     btfix->open(m_bname, L1, L2);
     btfix->setDefaultSampleSize(m_default_sample_size);
 
-    btdyn.reset(new imbitext(btfix->V1, btfix->V2, m_default_sample_size, m_workers));
+    btdyn.reset(new imbitext_runs(btfix->V1, btfix->V2, m_default_sample_size, m_workers));
     if (m_bias_file.size())
       load_bias(m_bias_file);
 
@@ -566,8 +597,72 @@ namespace Moses
     vector<string> S1(1,s1);
     vector<string> S2(1,s2);
     vector<string> ALN(1,a);
-    boost::unique_lock<boost::shared_mutex> guard(m_lock);
-    btdyn = btdyn->add(S1,S2,ALN);
+    btdyn->add(S1,S2,ALN);
+  }
+
+  void
+  Mmsapt::
+  expand_dyn(ttasksptr const& ttask, vector<id_type> const& sphrase,
+             imbitext_runs::snapshot const& dyn,
+             vector<PhrasePair<Token> >& pplist) const
+  {
+    vector<PhrasePair<Token> > all;
+    size_t raw = 0, sample = 0, good = 0;
+    BOOST_FOREACH(SPTR<imbitext> const& run, dyn.runs)
+      {
+        TSA<Token>::tree_iterator m(run->I1.get(), &sphrase[0], sphrase.size());
+        if (m.size() != sphrase.size()) continue;
+        SPTR<pstats> s = run->lookup(ttask, m);
+        if (!s) continue;
+        expand(m, *run, *s, all, m_bias_log);
+        raw += s->raw_cnt;
+        sample += s->sample_cnt;
+        good += s->good;
+      }
+
+    PhrasePair<Token>::SortByTargetIdSeq sort_by_tgt_id;
+    sort(all.begin(), all.end(), sort_by_tgt_id);
+    for (size_t i = 0; i < all.size(); ++i)
+      {
+        if (pplist.size() && sort_by_tgt_id.cmp(pplist.back(), all[i]) == 0)
+          {
+            PhrasePair<Token>& pp = pplist.back();
+            pp += all[i];
+            for (int k = 0; k <= LRModel::NONE; ++k)
+              {
+                pp.dfwd[k] += all[i].dfwd[k];
+                pp.dbwd[k] += all[i].dbwd[k];
+              }
+            typedef std::map<uint32_t,uint32_t>::value_type doc_cnt;
+            BOOST_FOREACH(doc_cnt const& d, all[i].indoc)
+              pp.indoc[d.first] += d.second;
+          }
+        else pplist.push_back(all[i]);
+      }
+
+    BOOST_FOREACH(PhrasePair<Token>& pp, pplist)
+      {
+        pp.raw1 = raw;
+        pp.sample1 = sample;
+        pp.good1 = good;
+        // a target phrase may occur in runs where sphrase does not occur
+        if (dyn.runs.size() > 1)
+          pp.raw2 = count_dyn_target(dyn, pp.start2, pp.len2);
+      }
+  }
+
+  uint32_t
+  Mmsapt::
+  count_dyn_target(imbitext_runs::snapshot const& dyn,
+                   Token const* start, uint32_t len) const
+  {
+    uint32_t ret = 0;
+    BOOST_FOREACH(SPTR<imbitext> const& run, dyn.runs)
+      {
+        TSA<Token>::tree_iterator m(run->I2.get(), start, len);
+        if (m.size() == len) ret += m.approxOccurrenceCount();
+      }
+    return ret;
   }
 
 
@@ -577,8 +672,10 @@ namespace Moses
             Phrase const& src,
             PhrasePair<Token>* fix,
             PhrasePair<Token>* dyn,
-            SPTR<Bitext<Token> > const& dynbt) const
+            imbitext_runs::snapshot const& dynruns) const
   {
+    // features that need corpus statistics use the largest run
+    Bitext<Token> const& dynbt = *dynruns.largest;
     UTIL_THROW_IF2(!fix && !dyn, HERE <<
                    ": Can't create target phrase from nothing.");
     vector<float> fvals(this->m_numScoreComponents);
@@ -591,19 +688,17 @@ namespace Moses
     if (dyn)
       {
         BOOST_FOREACH(SPTR<pscorer> const& ff, m_active_ff_dyn)
-          (*ff)(*dynbt, *dyn, &fvals);
+          (*ff)(dynbt, *dyn, &fvals);
       }
 
     if (fix && dyn) { pool += *dyn; }
     else if (fix)
       {
         PhrasePair<Token> zilch; zilch.init();
-        TSA<Token>::tree_iterator m(dynbt->I2.get(), fix->start2, fix->len2);
-        if (m.size() == fix->len2)
-          zilch.raw2 = m.approxOccurrenceCount();
+        zilch.raw2 = count_dyn_target(dynruns, fix->start2, fix->len2);
         pool += zilch;
         BOOST_FOREACH(SPTR<pscorer> const& ff, m_active_ff_dyn)
-          (*ff)(*dynbt, ff->allowPooling() ? pool : zilch, &fvals);
+          (*ff)(dynbt, ff->allowPooling() ? pool : zilch, &fvals);
       }
     else if (dyn)
       {
@@ -613,7 +708,7 @@ namespace Moses
           zilch.raw2 = m.approxOccurrenceCount();
         pool += zilch;
         BOOST_FOREACH(SPTR<pscorer> const& ff, m_active_ff_fix)
-          (*ff)(*dynbt, ff->allowPooling() ? pool : zilch, &fvals);
+          (*ff)(dynbt, ff->allowPooling() ? pool : zilch, &fvals);
       }
     if (fix)
       {
@@ -623,7 +718,7 @@ namespace Moses
     else
       {
         BOOST_FOREACH(SPTR<pscorer> const& ff, m_active_ff_common)
-          (*ff)(*dynbt, pool, &fvals);
+          (*ff)(dynbt, pool, &fvals);
       }
 
     TargetPhrase* tp = new TargetPhrase(const_cast<ttasksptr&>(ttask), this);
@@ -720,38 +815,36 @@ namespace Moses
     fillIdSeq(src, m_ifactor, *(btfix->V1), sphrase);
     if (sphrase.size() == 0) return ret;
     
-    // Reserve a local copy of the dynamic bitext in its current form. /btdyn/
-    // is set to a new copy of the dynamic bitext every time a sentence pair
-    // is added. /dyn/ keeps the old bitext around as long as we need it.
-    SPTR<imBitext<Token> > dyn;
-    { // braces are needed for scoping mutex lock guard!
-      boost::unique_lock<boost::shared_mutex> guard(m_lock);
-      assert(btdyn);
-      dyn = btdyn;
-    }
-    assert(dyn);
+    // Take a snapshot of the dynamic bitext in its current form. Sentence
+    // pairs added later go into new runs of /btdyn/; /dyn/ keeps the runs
+    // of the snapshot around as long as we need them.
+    SPTR<imbitext_runs::snapshot const> dyn = btdyn->get();
 
     // lookup phrases in both bitexts
     TSA<Token>::tree_iterator mfix(btfix->I1.get(), &sphrase[0], sphrase.size());
-    TSA<Token>::tree_iterator mdyn(dyn->I1.get());
-    if (dyn->I1.get()) // we have a dynamic bitext
-      for (size_t i = 0; mdyn.size() == i && i < sphrase.size(); ++i)
-        mdyn.extend(sphrase[i]);
+    bool found_dyn = false;
+    BOOST_FOREACH(SPTR<imbitext> const& run, dyn->runs)
+      {
+        TSA<Token>::tree_iterator m(run->I1.get(), &sphrase[0], sphrase.size());
+        if ((found_dyn = m.size() == sphrase.size())) break;
+      }
 
-    if (mdyn.size() != sphrase.size() && mfix.size() != sphrase.size())
+    if (!found_dyn && mfix.size() != sphrase.size())
       return ret; // phrase not found in either bitext
 
-    // do we have cached results for this phrase?
+    // do we have cached results for this phrase? Positions in the runs
+    // change when they are merged, so phrases that are only in the dynamic
+    // bitext are keyed by their ids.
     uint64_t phrasekey = (mfix.size() == sphrase.size()
-                          ? (mfix.getPid()<<1) 
-                          : (mdyn.getPid()<<1)+1);
+                          ? (mfix.getPid()<<1)
+                          : (util::MurmurHashNative(&sphrase[0], sphrase.size() * sizeof(id_type))<<1)+1);
 
     // get context-specific cache of items previously looked up
     SPTR<ContextScope> const& scope = ttask->GetScope();
     SPTR<TPCollCache> cache = scope->get<TPCollCache>(cache_key);
     if (!cache) cache = m_cache; // no context-specific cache, use global one
 
-    ret = cache->get(phrasekey, dyn->revision());
+    ret = cache->get(phrasekey, dyn->revision);
     // TO DO: we should revise the revision mechanism: we take the
     // length of the dynamic bitext (in sentences) at the time the PT
     // entry was stored as the time stamp. For each word in the
@@ -777,7 +870,7 @@ namespace Moses
     // TO DO: have Bitexts return lists of PhrasePairs instead of pstats
     // no need to expand pstats at every single lookup again, especially
     // for btfix.
-    SPTR<pstats> sfix,sdyn;
+    SPTR<pstats> sfix;
 
     if (mfix.size() == sphrase.size()) 
       {
@@ -791,14 +884,12 @@ namespace Moses
                                    m_default_sample_size, 
                                    m_sampling_method,
                                    m_track_coord);
+            setup_sampler(s);
             s();
             sfix = s.stats();
           }
       }
 
-    if (mdyn.size() == sphrase.size()) 
-      sdyn = dyn->lookup(ttask, mdyn);
-
     vector<PhrasePair<Token> > ppfix,ppdyn;
     PhrasePair<Token>::SortByTargetIdSeq sort_by_tgt_id;
     if (sfix)
@@ -806,11 +897,8 @@ namespace Moses
         expand(mfix, *btfix, *sfix, ppfix, m_bias_log);
         sort(ppfix.begin(), ppfix.end(),sort_by_tgt_id);
       }
-    if (sdyn)
-      {
-        expand(mdyn, *dyn, *sdyn, ppdyn, m_bias_log);
-        sort(ppdyn.begin(), ppdyn.end(),sort_by_tgt_id);
-      }
+    if (found_dyn)
+      expand_dyn(ttask, sphrase, *dyn, ppdyn);
 
     // now we have two lists of Phrase Pairs, let's merge them
     PhrasePair<Token>::SortByTargetIdSeq sorter;
@@ -818,12 +906,12 @@ namespace Moses
     while (i < ppfix.size() && k < ppdyn.size())
       {
         int cmp = sorter.cmp(ppfix[i], ppdyn[k]);
-        if      (cmp  < 0) ret->Add(mkTPhrase(ttask,src,&ppfix[i++],NULL,dyn));
-        else if (cmp == 0) ret->Add(mkTPhrase(ttask,src,&ppfix[i++],&ppdyn[k++],dyn));
-        else               ret->Add(mkTPhrase(ttask,src,NULL,&ppdyn[k++],dyn));
+        if      (cmp  < 0) ret->Add(mkTPhrase(ttask,src,&ppfix[i++],NULL,*dyn));
+        else if (cmp == 0) ret->Add(mkTPhrase(ttask,src,&ppfix[i++],&ppdyn[k++],*dyn));
+        else               ret->Add(mkTPhrase(ttask,src,NULL,&ppdyn[k++],*dyn));
       }
-    while (i < ppfix.size()) ret->Add(mkTPhrase(ttask,src,&ppfix[i++],NULL,dyn));
-    while (k < ppdyn.size()) ret->Add(mkTPhrase(ttask,src,NULL,&ppdyn[k++],dyn));
+    while (i < ppfix.size()) ret->Add(mkTPhrase(ttask,src,&ppfix[i++],NULL,*dyn));
+    while (k < ppdyn.size()) ret->Add(mkTPhrase(ttask,src,NULL,&ppdyn[k++],*dyn));
 
     // Pruning should not be done here but outside!
     if (m_tableLimit) ret->Prune(true, m_tableLimit);
@@ -919,6 +1007,52 @@ namespace Moses
       }
   }
   
+  void
+  Mmsapt::
+  setup_sampler(BitextSampler<Token>& s) const
+  {
+    s.parallelize(m_thread_pool.get(), m_sample_parts, m_sample_part_size);
+    s.record_latency(m_sampling_latency.get());
+  }
+
+  void
+  Mmsapt::
+  schedule_sampling(SPTR<ContextForQuery> const& context,
+                    TSA<Token>::tree_iterator const& m) const
+  {
+    uint64_t pid = m.getPid();
+    if (context->cache1->get(pid)) return;
+    BitextSampler<Token> s(btfix, m, context->bias, 
+                           m_min_sample_size, m_default_sample_size, 
+                           m_sampling_method, m_track_coord);
+    setup_sampler(s);
+    if (*context->cache1->get(pid, s.stats()) == s.stats())
+      m_thread_pool->add(s);
+  }
+
+  void
+  Mmsapt::
+  prefetch(ttasksptr const& ttask) const
+  {
+    // confusion networks and lattices are looked up path by path
+    Sentence const* snt = dynamic_cast<Sentence const*>(ttask->GetSource().get());
+    if (!snt) return;
+    SPTR<ContextForQuery> context;
+    context = ttask->GetScope()->get<ContextForQuery>(btfix.get(), true);
+    vector<id_type> ids;
+    fillIdSeq(*snt, m_ifactor, *btfix->V1, ids);
+    size_t maxlen = m_options->search.max_phrase_length;
+    for (size_t i = 0; i < ids.size(); ++i)
+      {
+        TSA<Token>::tree_iterator m(btfix->I1.get());
+        for (size_t k = i; k < ids.size() && k - i < maxlen; ++k)
+          {
+            if (!m.extend(ids[k])) break;
+            schedule_sampling(context, m);
+          }
+      }
+  }
+
   void
   Mmsapt::
   InitializeForInput(ttasksptr const& ttask)
@@ -957,6 +1091,9 @@ namespace Moses
         // todo: verify that lr_func implements a hierarchical reordering model
       }
 #endif
+    ctxlock.unlock();
+    mylock.unlock();
+    if (m_prefetch) prefetch(ttask);
   }
 
   bool
@@ -972,36 +1109,23 @@ namespace Moses
     TSA<Token>::tree_iterator mfix(btfix->I1.get(),&myphrase[0],myphrase.size());
     if (mfix.size() == myphrase.size())
       {
-        SPTR<ContextForQuery> context = scope->get<ContextForQuery>(btfix.get(), true);
-        uint64_t pid = mfix.getPid();
-        if (!context->cache1->get(pid))
-          {
-            BitextSampler<Token> s(btfix, mfix, context->bias, 
-                                   m_min_sample_size, m_default_sample_size, 
-                                   m_sampling_method, m_track_coord);
-            if (*context->cache1->get(pid, s.stats()) == s.stats())
-              m_thread_pool->add(s);
-          }
+        schedule_sampling(scope->get<ContextForQuery>(btfix.get(), true), mfix);
         // btfix->prep(ttask, mfix);
         // cerr << phrase << " " << mfix.approxOccurrenceCount() << endl;
         return true;
       }
 
-    SPTR<imBitext<Token> > dyn;
-    { // braces are needed for scoping lock!
-      boost::unique_lock<boost::shared_mutex> guard(m_lock);
-      dyn = btdyn;
-    }
-    assert(dyn);
-    TSA<Token>::tree_iterator mdyn(dyn->I1.get());
-    if (dyn->I1.get())
+    SPTR<imbitext_runs::snapshot const> dyn = btdyn->get();
+    bool found = false;
+    BOOST_FOREACH(SPTR<imbitext> const& run, dyn->runs)
       {
-        for (size_t i = 0; mdyn.size() == i && i < myphrase.size(); ++i)
-          mdyn.extend(myphrase[i]);
+        TSA<Token>::tree_iterator mdyn(run->I1.get(), &myphrase[0], myphrase.size());
+        if (mdyn.size() != myphrase.size()) continue;
         // let's assume a uniform bias over the foreground corpus
-        if (mdyn.size() == myphrase.size()) dyn->prep(ttask, mdyn, m_track_coord);
+        run->prep(ttask, mdyn, m_track_coord);
+        found = true;
       }
-    return mdyn.size() == myphrase.size();
+    return found;
   }
 
 #if 0
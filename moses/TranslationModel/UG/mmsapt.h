@@ -22,6 +22,7 @@
 #include "moses/TranslationModel/UG/mm/tpt_pickler.h"
 #include "moses/TranslationModel/UG/mm/ug_bitext.h"
 #include "moses/TranslationModel/UG/mm/ug_bitext_sampler.h"
+#include "moses/TranslationModel/UG/mm/ug_im_bitext_runs.h"
 #include "moses/TranslationModel/UG/mm/ug_lexical_phrase_scorer2.h"
 
 #include "moses/TranslationModel/UG/TargetPhraseCollectionCache.h"
@@ -66,13 +67,14 @@ namespace Moses
     typedef sapt::L2R_Token<sapt::SimpleWordId> Token;
     typedef sapt::mmBitext<Token> mmbitext;
     typedef sapt::imBitext<Token> imbitext;
+    typedef sapt::imBitextRuns<Token> imbitext_runs;
     typedef sapt::Bitext<Token>     bitext;
     typedef sapt::TSA<Token>           tsa;
     typedef sapt::PhraseScorer<Token> pscorer;
   private:
     // vector<SPTR<bitext> > shards;
     SPTR<mmbitext> btfix;
-    SPTR<imbitext> btdyn;
+    SPTR<imbitext_runs> btdyn;
     std::string m_bname, m_extra_data, m_bias_file,m_bias_server;
     std::string L1;
     std::string L2;
@@ -83,6 +85,10 @@ namespace Moses
     size_t m_default_sample_size;
     size_t m_min_sample_size;
     size_t m_workers;  // number of worker threads for sampling the bitexts
+    size_t m_sample_parts;     // max. number of parts sampled in parallel per phrase
+    size_t m_sample_part_size; // min. number of phrase occurrences per part
+    bool m_prefetch; // start sampling all subphrases in InitializeForInput?
+    boost::scoped_ptr<sapt::SamplingLatency> m_sampling_latency;
     std::vector<std::string> m_feature_set_names; // one or more of: standard, datasource
     std::string m_bias_logfile;
     boost::scoped_ptr<std::ofstream> m_bias_logger; // for logging to a file
@@ -185,7 +191,32 @@ namespace Moses
               Phrase const& src,
               sapt::PhrasePair<Token>* fix,
               sapt::PhrasePair<Token>* dyn,
-              SPTR<sapt::Bitext<Token> > const& dynbt) const;
+              imbitext_runs::snapshot const& dynbt) const;
+
+    // phrase pairs of all runs of the dynamic bitext, pooled by target
+    // phrase and sorted by target id sequence
+    void
+    expand_dyn(ttasksptr const& ttask, std::vector<tpt::id_type> const& sphrase,
+               imbitext_runs::snapshot const& dyn,
+               std::vector<sapt::PhrasePair<Token> >& pplist) const;
+
+    // number of occurrences of a target phrase in the dynamic bitext
+    uint32_t
+    count_dyn_target(imbitext_runs::snapshot const& dyn,
+                     Token const* start, uint32_t len) const;
+
+    // start sampling the occurrences /m/ of a phrase in btfix in the
+    // background, unless that has been done before in this context
+    void
+    schedule_sampling(SPTR<sapt::ContextForQuery> const& context,
+                      sapt::TSA<Token>::tree_iterator const& m) const;
+
+    void
+    setup_sampler(sapt::BitextSampler<Token>& s) const;
+
+    // schedule sampling for all subphrases of the input sentence
+    void
+    prefetch(ttasksptr const& ttask) const;
 
     void
     process_pstats
@@ -216,6 +247,7 @@ namespace Moses
   public:
     // Mmsapt(std::string const& description, std::string const& line);
     Mmsapt(std::string const& line);
+    ~Mmsapt();
 
     void Load(AllOptions::ptr const& opts);
     void Load(AllOptions::ptr const& opts, bool with_checks);
@@ -6,20 +6,23 @@
 //  Copyright 2012 __MyCompanyName__. All rights reserved.
 //
 
+#include <algorithm>
 #include <iostream>
+#include <set>
+#include <boost/unordered_map.hpp>
 #include "FuzzyMatchWrapper.h"
 #include "SentenceAlignment.h"
 #include "Match.h"
-#include "create_xml.h"
 #include "moses/Util.h"
-#include "moses/StaticData.h"
-#include "util/file.hh"
+#include "util/exception.hh"
 
 using namespace std;
 
 namespace tmmt
 {
 
+const WORD_ID FuzzyMatchWrapper::NON_TERMINAL;
+
 FuzzyMatchWrapper::FuzzyMatchWrapper(const std::string &sourcePath, const std::string &targetPath, const std::string &alignmentPath)
   :basic_flag(false)
   ,lsed_flag(true)
@@ -43,62 +46,34 @@ FuzzyMatchWrapper::FuzzyMatchWrapper(const std::string &sourcePath, const std::s
   cerr << "loading alignment" << endl;
   load_alignment(alignmentPath, targetAndAlignment);
 
-  // create suffix array
-  //load_corpus(m_config[0], input);
+  m_vocabSize = GetVocabulary().vocab.size();
 
   cerr << "loading completed" << endl;
 }
 
-string FuzzyMatchWrapper::Extract(long translationId, const string &dirNameStr)
+void FuzzyMatchWrapper::Extract(const vector< WORD > &words, vector< FuzzyMatchRule > &rules)
 {
-  const Moses::StaticData &staticData = Moses::StaticData::Instance();
-
-  WordIndex wordIndex;
-
-  string fuzzyMatchFile = ExtractTM(wordIndex, translationId, dirNameStr);
-
-  // create extrac files
-  create_xml(fuzzyMatchFile);
-
-  // create phrase table with usual Moses scoring and consolidate programs
-  string cmd;
-  cmd = "LC_ALL=C sort " + fuzzyMatchFile + ".extract | gzip -c > "
-        + fuzzyMatchFile + ".extract.sorted.gz";
-  system(cmd.c_str());
-  cmd = "LC_ALL=C sort " + fuzzyMatchFile + ".extract.inv | gzip -c > "
-        + fuzzyMatchFile + ".extract.inv.sorted.gz";
-  system(cmd.c_str());
-
-#ifdef IS_XCODE
-  cmd = "/Users/hieuhoang/unison/workspace/github/moses-smt/bin";
-#elif IS_ECLIPSE
-  cmd = "/home/hieu/workspace/github/moses-smt/bin";
-#else
-  cmd = staticData.GetBinDirectory();
-#endif
-
-  cmd += string("/../scripts/training/train-model.perl -dont-zip -first-step 6 -last-step 6 -f en -e fr -hierarchical ")
-         + " -extract-file " + fuzzyMatchFile + ".extract -lexical-file - -score-options \"--NoLex\" "
-         + " -phrase-translation-table " + fuzzyMatchFile + ".pt";
-  system(cmd.c_str());
-
+  InputSentence input;
+  input.ids.reserve(words.size());
+  for (size_t i = 0; i < words.size(); ++i) {
+    WORD_ID id;
+    if (!GetVocabulary().Find(words[i], id)) {
+      id = m_vocabSize + input.words.size();
+      input.words.push_back(words[i]);
+    }
+    input.ids.push_back(id);
+  }
 
-  return fuzzyMatchFile + ".pt.gz";
+  vector< RuleInstance > instances;
+  ExtractTM(input, instances);
+  score_rules(instances, rules);
 }
 
-string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, const string &dirNameStr)
+void FuzzyMatchWrapper::ExtractTM(const InputSentence &input, vector< RuleInstance > &instances)
 {
-  const std::vector< std::vector< WORD_ID > > &source = suffixArray->GetCorpus();
 
-  string inputPath = dirNameStr + "/in";
-  string fuzzyMatchFile = dirNameStr + "/fuzzyMatchFile";
-  ofstream fuzzyMatchStream(fuzzyMatchFile.c_str());
-
-  vector< vector< WORD_ID > > input;
-  load_corpus(inputPath, input);
-
-  assert(input.size() == 1);
-  size_t sentenceInd = 0;
+  const vector< WORD_ID > &inputIds = input.ids;
+  WordIndex wordIndex;
 
   clock_t start_clock = clock();
   // if (i % 10 == 0) cerr << ".";
@@ -106,7 +81,7 @@ string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, co
   // establish some basic statistics
 
   // int input_length = compute_length( input[i] );
-  int input_length = input[sentenceInd].size();
+  int input_length = inputIds.size();
   int best_cost = input_length * (100-min_match) / 100 + 1;
 
   int match_count = 0; // how many substring matches to be considered
@@ -114,15 +89,15 @@ string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, co
 
   // find match ranges in suffix array
   vector< vector< pair< SuffixArray::INDEX, SuffixArray::INDEX > > > match_range;
-  for(int start=0; start<input[sentenceInd].size(); start++) {
+  for(int start=0; start<inputIds.size(); start++) {
     SuffixArray::INDEX prior_first_match = 0;
     SuffixArray::INDEX prior_last_match = suffixArray->GetSize()-1;
     vector< string > substring;
     bool stillMatched = true;
     vector< pair< SuffixArray::INDEX, SuffixArray::INDEX > > matchedAtThisStart;
     //cerr << "start: " << start;
-    for(size_t word=start; stillMatched && word<input[sentenceInd].size(); word++) {
-      substring.push_back( GetVocabulary().GetWord( input[sentenceInd][word] ) );
+    for(size_t word=start; stillMatched && word<inputIds.size(); word++) {
+      substring.push_back( GetWord( inputIds[word], input ) );
 
       // only look up, if needed (i.e. no unnecessary short gram lookups)
       //				if (! word-start+1 <= short_match_max_length( input_length ) )
@@ -149,14 +124,14 @@ string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, co
   map< int, int > sentence_match_word_count;
 
   // go through all matches, longest first
-  for(int length = input[sentenceInd].size(); length >= 1; length--) {
+  for(int length = inputIds.size(); length >= 1; length--) {
     // do not create matches, if these are handled by the short match function
     if (length <= short_match_max_length( input_length ) ) {
       continue;
     }
 
     unsigned int count = 0;
-    for(int start = 0; start <= input[sentenceInd].size() - length; start++) {
+    for(int start = 0; start <= inputIds.size() - length; start++) {
       if (match_range[start].size() >= length) {
         pair< SuffixArray::INDEX, SuffixArray::INDEX > &range = match_range[start][length-1];
         // cerr << " (" << range.first << "," << range.second << ")";
@@ -244,7 +219,7 @@ string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, co
   int tm_count_word_match2 = 0;
   int pruned_match_count = 0;
   if (short_match_max_length( input_length )) {
-    init_short_matches(wordIndex, translationId, input[sentenceInd] );
+    init_short_matches(wordIndex, inputIds );
   }
   vector< int > best_tm;
   typedef map< int, vector< Match > >::iterator I;
@@ -255,7 +230,8 @@ string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, co
     int tmID = tm->first;
     int tm_length = suffixArray->GetSentenceLength(tmID);
     vector< Match > &match = tm->second;
-    add_short_matches(wordIndex, translationId, match, source[tmID], input_length, best_cost );
+    const vector< WORD_ID > tmSentence = suffixArray->GetSentenceWords(tmID);
+    add_short_matches(wordIndex, match, tmSentence, input_length, best_cost );
 
     //cerr << "match in sentence " << tmID << ": " << match.size() << " [" << tm_length << "]" << endl;
 
@@ -290,7 +266,7 @@ string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, co
     if (! parse_flag ||
         pruned.size()>=10) { // to prevent worst cases
       string path;
-      cost = sed( input[sentenceInd], source[tmID], path, false );
+      cost = sed( inputIds, tmSentence, path, false, input );
       if (cost <  best_cost) {
         best_cost = cost;
       }
@@ -315,21 +291,16 @@ string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, co
 
   cerr << "pruned matches: " << ((float)pruned_match_count/(float)tm_count_word_match2) << endl;
 
-  // create xml and extract files
-  string inputStr, sourceStr;
-  for (size_t pos = 0; pos < input_length; ++pos) {
-    inputStr += GetVocabulary().GetWord(input[sentenceInd][pos]) + " ";
-  }
-
+  // extract rules
   // do not try to find the best ... report multiple matches
   if (multiple_flag) {
     for(size_t si=0; si<best_tm.size(); si++) {
       int s = best_tm[si];
       string path;
-      sed( input[sentenceInd], source[s], path, true );
-      const vector<WORD_ID> &sourceSentence = source[s];
+      const vector<WORD_ID> sourceSentence = suffixArray->GetSentenceWords(s);
+      sed( inputIds, sourceSentence, path, true, input );
       vector<SentenceAlignment> &targets = targetAndAlignment[s];
-      create_extract(sentenceInd, best_cost, sourceSentence, targets, inputStr, path, fuzzyMatchStream);
+      create_extract(sourceSentence, targets, input, path, instances);
 
     }
   } // if (multiple_flag)
@@ -340,11 +311,11 @@ string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, co
     int best_match = -1;
     unsigned int best_letter_cost;
     if (lsed_flag) {
-      best_letter_cost = compute_length( input[sentenceInd] ) * min_match / 100 + 1;
+      best_letter_cost = compute_length( inputIds, input ) * min_match / 100 + 1;
       for(size_t si=0; si<best_tm.size(); si++) {
         int s = best_tm[si];
         string path;
-        unsigned int letter_cost = sed( input[sentenceInd], source[s], path, true );
+        unsigned int letter_cost = sed( inputIds, suffixArray->GetSentenceWords(s), path, true, input );
         if (letter_cost < best_letter_cost) {
           best_letter_cost = letter_cost;
           best_path = path;
@@ -356,7 +327,7 @@ string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, co
     else {
       if (best_tm.size() > 0) {
         string path;
-        sed( input[sentenceInd], source[best_tm[0]], path, false );
+        sed( inputIds, suffixArray->GetSentenceWords(best_tm[0]), path, false, input );
         best_path = path;
         best_match = best_tm[0];
       }
@@ -368,7 +339,7 @@ string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, co
          << " (validation: " << (1000 * (clock_validation_sum) / CLOCKS_PER_SEC) << ")"
          << " )" << endl;
     if (lsed_flag) {
-      //cout << best_letter_cost << "/" << compute_length( input[sentenceInd] ) << " (";
+      //cout << best_letter_cost << "/" << compute_length( inputIds, input ) << " (";
     }
     //cout << best_cost <<"/" << input_length;
     if (lsed_flag) {
@@ -377,39 +348,16 @@ string FuzzyMatchWrapper::ExtractTM(WordIndex &wordIndex, long translationId, co
     //cout << " ||| " << best_match << " ||| " << best_path << endl;
 
     if (best_match == -1) {
-      UTIL_THROW_IF2(source.size() == 0, "Empty source phrase");
+      UTIL_THROW_IF2(suffixArray->GetSentenceCount() == 0, "Empty source phrase");
       best_match = 0;
     }
 
     // creat xml & extracts
-    const vector<WORD_ID> &sourceSentence = source[best_match];
+    const vector<WORD_ID> sourceSentence = suffixArray->GetSentenceWords(best_match);
     vector<SentenceAlignment> &targets = targetAndAlignment[best_match];
-    create_extract(sentenceInd, best_cost, sourceSentence, targets, inputStr, best_path, fuzzyMatchStream);
+    create_extract(sourceSentence, targets, input, best_path, instances);
 
   } // else if (multiple_flag)
-
-  fuzzyMatchStream.close();
-
-  return fuzzyMatchFile;
-}
-
-void FuzzyMatchWrapper::load_corpus( const std::string &fileName, vector< vector< WORD_ID > > &corpus )
-{
-  // source
-  ifstream fileStream;
-  fileStream.open(fileName.c_str());
-  if (!fileStream) {
-    cerr << "file not found: " << fileName << endl;
-    exit(1);
-  }
-  cerr << "loading " << fileName << endl;
-
-  istream *fileStreamP = &fileStream;
-
-  string line;
-  while(getline(*fileStreamP, line)) {
-    corpus.push_back( GetVocabulary().Tokenize( line.c_str() ) );
-  }
 }
 
 void FuzzyMatchWrapper::load_target(const std::string &fileName, vector< vector< SentenceAlignment > > &corpus)
@@ -424,12 +372,13 @@ void FuzzyMatchWrapper::load_target(const std::string &fileName, vector< vector<
 
   istream *fileStreamP = &fileStream;
 
-  WORD_ID delimiter = GetVocabulary().StoreIfNew("|||");
+  Vocabulary &vocabulary = suffixArray->GetVocabulary();
+  WORD_ID delimiter = vocabulary.StoreIfNew("|||");
 
   int lineNum = 0;
   string line;
   while(getline(*fileStreamP, line)) {
-    vector<WORD_ID> toks = GetVocabulary().Tokenize( line.c_str() );
+    vector<WORD_ID> toks = vocabulary.Tokenize( line.c_str() );
 
     corpus.push_back(vector< SentenceAlignment >());
     vector< SentenceAlignment > &vec = corpus.back();
@@ -535,19 +484,20 @@ void FuzzyMatchWrapper::SetLSEDCache(const std::pair< WORD_ID, WORD_ID > &key, c
 
 /* Letter string edit distance, e.g. sub 'their' to 'there' costs 2 */
 
-unsigned int FuzzyMatchWrapper::letter_sed( WORD_ID aIdx, WORD_ID bIdx )
+unsigned int FuzzyMatchWrapper::letter_sed( WORD_ID aIdx, WORD_ID bIdx, const InputSentence &input )
 {
   // check if already computed -> lookup in cache
+  // (words local to the input sentence are not cached)
   pair< WORD_ID, WORD_ID > pIdx = make_pair( aIdx, bIdx );
+  bool cacheable = aIdx < m_vocabSize && bIdx < m_vocabSize;
   unsigned int value;
-  bool ret = GetLSEDCache(pIdx, value);
-  if (ret) {
+  if (cacheable && GetLSEDCache(pIdx, value)) {
     return value;
   }
 
   // get surface strings for word indices
-  const string &a = GetVocabulary().GetWord( aIdx );
-  const string &b = GetVocabulary().GetWord( bIdx );
+  const string &a = GetWord( aIdx, input );
+  const string &b = GetWord( bIdx, input );
 
   // initialize cost matrix
   unsigned int **cost  = (unsigned int**) calloc( sizeof( unsigned int*  ), a.size()+1 );
@@ -583,13 +533,15 @@ unsigned int FuzzyMatchWrapper::letter_sed( WORD_ID aIdx, WORD_ID bIdx )
   free( cost );
 
   // cache and return result
-  SetLSEDCache(pIdx, final);
+  if (cacheable) {
+    SetLSEDCache(pIdx, final);
+  }
   return final;
 }
 
 /* string edit distance implementation */
 
-unsigned int FuzzyMatchWrapper::sed( const vector< WORD_ID > &a, const vector< WORD_ID > &b, string &best_path, bool use_letter_sed )
+unsigned int FuzzyMatchWrapper::sed( const vector< WORD_ID > &a, const vector< WORD_ID > &b, string &best_path, bool use_letter_sed, const InputSentence &input )
 {
 
   // initialize cost and path matrices
@@ -602,7 +554,7 @@ unsigned int FuzzyMatchWrapper::sed( const vector< WORD_ID > &a, const vector< W
     if (i>0) {
       cost[i][0] = cost[i-1][0];
       if (use_letter_sed) {
-        cost[i][0] += GetVocabulary().GetWord( a[i-1] ).size();
+        cost[i][0] += GetWord( a[i-1], input ).size();
       } else {
         cost[i][0]++;
       }
@@ -616,7 +568,7 @@ unsigned int FuzzyMatchWrapper::sed( const vector< WORD_ID > &a, const vector< W
     if (j>0) {
       cost[0][j] = cost[0][j-1];
       if (use_letter_sed) {
-        cost[0][j] +=	GetVocabulary().GetWord( b[j-1] ).size();
+        cost[0][j] +=	GetWord( b[j-1], input ).size();
       } else {
         cost[0][j]++;
       }
@@ -633,9 +585,9 @@ unsigned int FuzzyMatchWrapper::sed( const vector< WORD_ID > &a, const vector< W
       unsigned int del = cost[i][j-1];
       unsigned int match;
       if (use_letter_sed) {
-        ins += GetVocabulary().GetWord( a[i-1] ).size();
-        del += GetVocabulary().GetWord( b[j-1] ).size();
-        match = letter_sed( a[i-1], b[j-1] );
+        ins += GetWord( a[i-1], input ).size();
+        del += GetWord( b[j-1], input ).size();
+        match = letter_sed( a[i-1], b[j-1], input );
       } else {
         ins++;
         del++;
@@ -689,11 +641,11 @@ unsigned int FuzzyMatchWrapper::sed( const vector< WORD_ID > &a, const vector< W
 /* utlility function: compute length of sentence in characters
  (spaces do not count) */
 
-unsigned int FuzzyMatchWrapper::compute_length( const vector< WORD_ID > &sentence )
+unsigned int FuzzyMatchWrapper::compute_length( const vector< WORD_ID > &sentence, const InputSentence &input )
 {
   unsigned int length = 0;
   for( unsigned int i=0; i<sentence.size(); i++ ) {
-    length += GetVocabulary().GetWord( sentence[i] ).size();
+    length += GetWord( sentence[i], input ).size();
   }
   return length;
 }
@@ -703,6 +655,9 @@ unsigned int FuzzyMatchWrapper::compute_length( const vector< WORD_ID > &sentenc
 void FuzzyMatchWrapper::basic_fuzzy_match( vector< vector< WORD_ID > > source,
     vector< vector< WORD_ID > > input )
 {
+  // the sentences only hold vocabulary words
+  const InputSentence noLocalWords;
+
   // go through input set...
   for(unsigned int i=0; i<input.size(); i++) {
     bool use_letter_sed = false;
@@ -710,7 +665,7 @@ void FuzzyMatchWrapper::basic_fuzzy_match( vector< vector< WORD_ID > > source,
     // compute sentence length and worst allowed cost
     unsigned int input_length;
     if (use_letter_sed) {
-      input_length = compute_length( input[i] );
+      input_length = compute_length( input[i], noLocalWords );
     } else {
       input_length = input[i].size();
     }
@@ -722,7 +677,7 @@ void FuzzyMatchWrapper::basic_fuzzy_match( vector< vector< WORD_ID > > source,
     for(unsigned int s=0; s<source.size(); s++) {
       int source_length;
       if (use_letter_sed) {
-        source_length = compute_length( source[s] );
+        source_length = compute_length( source[s], noLocalWords );
       } else {
         source_length = source[s].size();
       }
@@ -733,7 +688,7 @@ void FuzzyMatchWrapper::basic_fuzzy_match( vector< vector< WORD_ID > > source,
 
       // compute string edit distance
       string path;
-      unsigned int cost = sed( input[i], source[s], path, use_letter_sed );
+      unsigned int cost = sed( input[i], source[s], path, use_letter_sed, noLocalWords );
 
       // update if new best
       if (cost < best_cost) {
@@ -767,7 +722,7 @@ int FuzzyMatchWrapper::short_match_max_length( int input_length )
  (to be used by the next function)
  (done here, because this has be done only once for an input sentence) */
 
-void FuzzyMatchWrapper::init_short_matches(WordIndex &wordIndex, long translationId, const vector< WORD_ID > &input )
+void FuzzyMatchWrapper::init_short_matches(WordIndex &wordIndex, const vector< WORD_ID > &input )
 {
   int max_length = short_match_max_length( input.size() );
   if (max_length == 0)
@@ -787,7 +742,7 @@ void FuzzyMatchWrapper::init_short_matches(WordIndex &wordIndex, long translatio
 
 /* add all short matches to list of matches for a sentence */
 
-void FuzzyMatchWrapper::add_short_matches(WordIndex &wordIndex, long translationId, vector< Match > &match, const vector< WORD_ID > &tm, int input_length, int best_cost )
+void FuzzyMatchWrapper::add_short_matches(WordIndex &wordIndex, vector< Match > &match, const vector< WORD_ID > &tm, int input_length, int best_cost )
 {
   int max_length = short_match_max_length( input_length );
   if (max_length == 0)
@@ -1000,29 +955,222 @@ int FuzzyMatchWrapper::parse_matches( vector< Match > &match, int input_length,
 }
 
 
-void FuzzyMatchWrapper::create_extract(int sentenceInd, int cost, const vector< WORD_ID > &sourceSentence, const vector<SentenceAlignment> &targets, const string &inputStr, const string  &path, ofstream &outputFile)
+void FuzzyMatchWrapper::create_extract(const vector< WORD_ID > &sourceSentence, const vector<SentenceAlignment> &targets, const InputSentence &input, const string &path, vector< RuleInstance > &instances)
 {
-  string sourceStr;
-  for (size_t pos = 0; pos < sourceSentence.size(); ++pos) {
-    WORD_ID wordId = sourceSentence[pos];
-    sourceStr += GetVocabulary().GetWord(wordId) + " ";
+  for (size_t targetInd = 0; targetInd < targets.size(); ++targetInd) {
+    RuleInstance rule;
+    create_rule(sourceSentence, input.ids, targets[targetInd], path, rule);
+    // a rule without source side can never be applied
+    if (!rule.source.empty()) {
+      instances.push_back(rule);
+    }
   }
+}
 
-  for (size_t targetInd = 0; targetInd < targets.size(); ++targetInd) {
-    const SentenceAlignment &sentenceAlignment = targets[targetInd];
-    string targetStr = sentenceAlignment.getTargetString(GetVocabulary());
-    string alignStr = sentenceAlignment.getAlignmentString();
-
-    outputFile
-        << sentenceInd << endl
-        << cost << endl
-        << sourceStr << endl
-        << inputStr << endl
-        << targetStr << endl
-        << alignStr << endl
-        << path << endl
-        << sentenceAlignment.count << endl;
+namespace
+{
+// a gap in the tm sentence that is filled by the input words from start_i on
+struct NonTerm {
+  int start_t, start_i;
+  int rule_pos_s, rule_pos_t;
+  NonTerm(int t, int i) : start_t(t), start_i(i), rule_pos_s(0), rule_pos_t(0) {}
+};
+}
+
+/* hierarchical rule for a tm match: the matched words, with the mismatched
+ parts replaced by non-terminals (formerly create_xml.cpp) */
+
+void FuzzyMatchWrapper::create_rule(const vector< WORD_ID > &source, const vector< WORD_ID > &input, const SentenceAlignment &target, const string &tmPath, RuleInstance &rule) const
+{
+  const vector< WORD_ID > &targetWords = target.target;
+  const int sourceSize = source.size();
+  const int inputSize = input.size();
+  const int targetSize = targetWords.size();
+
+  vector< set<int> > alignS2T(sourceSize);
+  for (size_t k = 0; k < target.alignment.size(); ++k) {
+    const pair<int,int> &point = target.alignment[k];
+    UTIL_THROW_IF2(point.first >= sourceSize || point.second >= targetSize,
+                   "Alignment point " << point.first << "-" << point.second << " out of range");
+    alignS2T[point.first].insert(point.second);
+  }
+
+  const string path = tmPath + "X";
+  vector<bool> targetBitmap(targetSize, true);
+  vector<bool> inputBitmap;
+  vector<int> alignI2S(inputSize + 2, 0);
+  vector<NonTerm> nonTerms;
+  const int noTarget = numeric_limits<int>::max();
+
+  // STEP 1: FIND MISMATCHES
+  int s = 0, i = 0;
+  bool currently_matching = false;
+  int start_s = 0, start_i = 0;
+
+  for (size_t p = 0; p < path.size(); ++p) {
+    const char action = path[p];
+
+    // beginning of a mismatch
+    if (currently_matching && action != 'M' && action != 'X') {
+      start_i = i;
+      start_s = s;
+      currently_matching = false;
+    }
+    // end of a mismatch
+    else if (!currently_matching && (action == 'M' || action == 'X')) {
+
+      // remove use of affected target words
+      for (int ss = start_s; ss < s; ss++) {
+        for (set<int>::const_iterator t = alignS2T[ss].begin(); t != alignS2T[ss].end(); ++t) {
+          targetBitmap[*t] = false;
+        }
+      }
+
+      // are there input words that need to be inserted ?
+      if (start_i < i) {
+        // find position for inserted input words: first removed target word
+        int start_t = noTarget;
+        for (int ss = start_s; ss < s; ss++) {
+          if (!alignS2T[ss].empty()) {
+            start_t = min(start_t, *alignS2T[ss].begin());
+          }
+        }
+
+        // end of sentence? add to end
+        if (start_t == noTarget && i > inputSize - 1) {
+          start_t = targetSize - 1;
+        }
+
+        // backtrack to previous words if unaligned
+        if (start_t == noTarget) {
+          start_t = -1;
+          for (int ss = s - 1; start_t == -1 && ss >= 0; ss--) {
+            if (!alignS2T[ss].empty()) {
+              start_t = *alignS2T[ss].rbegin();
+            }
+          }
+        }
+
+        nonTerms.push_back(NonTerm(start_t, start_i));
+      }
+
+      currently_matching = true;
+    }
+
+    if (action != 'I')
+      s++;
+    if (action != 'D') {
+      i++;
+      alignI2S[i] = s;
+    }
+
+    if (action == 'M') {
+      inputBitmap.push_back(true);
+    } else if (action == 'I' || action == 'S') {
+      inputBitmap.push_back(false);
+    }
+  }
+
+  // STEP 2: BUILD RULE
+  int rule_pos_s = 0;
+  map<int, int> ruleAlignS;
+  for (int i = 0; i < int(inputBitmap.size()); ++i) {
+    if (inputBitmap[i]) {
+      rule.source.push_back(input[i]);
+      ruleAlignS[ alignI2S[i] ] = rule_pos_s++;
+    }
+    for (size_t j = 0; j < nonTerms.size(); ++j) {
+      if (i == nonTerms[j].start_i) {
+        rule.source.push_back(NON_TERMINAL);
+        nonTerms[j].rule_pos_s = rule_pos_s++;
+      }
+    }
+  }
+
+  int rule_pos_t = 0;
+  map<int, int> ruleAlignT;
+  for (int t = -1; t < targetSize; t++) {
+    if (t >= 0 && targetBitmap[t]) {
+      rule.target.push_back(targetWords[t]);
+      ruleAlignT[t] = rule_pos_t++;
+    }
+    for (size_t j = 0; j < nonTerms.size(); ++j) {
+      if (t == nonTerms[j].start_t) {
+        rule.target.push_back(NON_TERMINAL);
+        nonTerms[j].rule_pos_t = rule_pos_t++;
+      }
+    }
+  }
+
+  for (map<int, int>::const_iterator iter = ruleAlignS.begin(); iter != ruleAlignS.end(); ++iter) {
+    if (iter->first >= sourceSize) {
+      continue;
+    }
+    const set<int> &targets = alignS2T[iter->first];
+    for (set<int>::const_iterator t = targets.begin(); t != targets.end(); ++t) {
+      map<int, int>::const_iterator posT = ruleAlignT.find(*t);
+      if (posT != ruleAlignT.end()) {
+        rule.alignment.push_back(make_pair(iter->second, posT->second));
+      }
+    }
+  }
+  for (size_t j = 0; j < nonTerms.size(); ++j) {
+    rule.alignment.push_back(make_pair(nonTerms[j].rule_pos_s, nonTerms[j].rule_pos_t));
+  }
+
+  rule.count = target.count;
+}
+
+/* relative frequencies of the extracted rules in both directions, as the
+ score and consolidate programs compute them with --NoLex.  A rule that was
+ extracted with different alignments keeps its most frequent one. */
+
+void FuzzyMatchWrapper::score_rules(vector< RuleInstance > &instances, vector< FuzzyMatchRule > &rules) const
+{
+  typedef boost::unordered_map< vector< WORD_ID >, float > Counts;
+  Counts countF, countE;
+  for (size_t k = 0; k < instances.size(); ++k) {
+    countF[ instances[k].source ] += instances[k].count;
+    countE[ instances[k].target ] += instances[k].count;
+  }
+
+  sort(instances.begin(), instances.end());
+
+  size_t begin = 0;
+  while (begin < instances.size()) {
+    const RuleInstance &first = instances[begin];
+    FuzzyMatchRule rule;
+    rule.source = first.source;
+    rule.target = first.target;
+    rule.countEF = 0;
+
+    float bestAlignmentCount = -1;
+    size_t end = begin;
+    while (end < instances.size()
+           && instances[end].source == first.source
+           && instances[end].target == first.target) {
+      // instances with the same alignment are adjacent
+      size_t alignmentEnd = end;
+      float alignmentCount = 0;
+      while (alignmentEnd < instances.size()
+             && instances[alignmentEnd].source == first.source
+             && instances[alignmentEnd].target == first.target
+             && instances[alignmentEnd].alignment == instances[end].alignment) {
+        alignmentCount += instances[alignmentEnd].count;
+        ++alignmentEnd;
+      }
+      if (alignmentCount >= bestAlignmentCount) {
+        bestAlignmentCount = alignmentCount;
+        rule.alignment = instances[end].alignment;
+      }
+      rule.countEF += alignmentCount;
+      end = alignmentEnd;
+    }
 
+    rule.countF = countF[rule.source];
+    rule.countE = countE[rule.target];
+    rules.push_back(rule);
+    begin = end;
   }
 }
 
@@ -13,24 +13,50 @@
 #include <boost/thread/shared_mutex.hpp>
 #endif
 
-#include <fstream>
+#include <limits>
 #include <string>
+#include <utility>
+#include <vector>
 #include "SuffixArray.h"
 #include "Vocabulary.h"
 #include "Match.h"
+#include "SentenceAlignment.h"
 #include "moses/InputType.h"
 
 namespace tmmt
 {
 class Match;
-struct SentenceAlignment;
+
+/** A hierarchical rule extracted from the translation memory matches of an
+ *  input sentence, with the counts that the phrase table scores are computed
+ *  from: p(f|e) = countEF / countE, p(e|f) = countEF / countF.
+ */
+struct FuzzyMatchRule {
+  // gaps are FuzzyMatchWrapper::NON_TERMINAL, labelled [X] on both sides
+  std::vector< WORD_ID > source;
+  std::vector< WORD_ID > target;
+  // source-target, including the non-terminals
+  std::vector< std::pair<int,int> > alignment;
+  float countEF, countF, countE;
+};
 
 class FuzzyMatchWrapper
 {
 public:
+  static const WORD_ID NON_TERMINAL = std::numeric_limits<WORD_ID>::max();
+
   FuzzyMatchWrapper(const std::string &source, const std::string &target, const std::string &alignment);
 
-  std::string Extract(long translationId, const std::string &dirNameStr);
+  /** Find the best translation memory matches of the input words, extract
+   *  rules from them and score them, as train-model.perl -hierarchical
+   *  -score-options --NoLex would.  Thread-safe: nothing shared is modified
+   *  but the letter edit distance cache.
+   */
+  void Extract(const std::vector< WORD > &input, std::vector< FuzzyMatchRule > &rules);
+
+  const Vocabulary &GetVocabulary() const {
+    return suffixArray->GetVocabulary();
+  }
 
 protected:
   // tm-mt
@@ -48,6 +74,31 @@ protected:
 
   typedef std::map< WORD_ID,std::vector< int > > WordIndex;
 
+  /** An input sentence as word ids.  Words that are not in the vocabulary
+   *  get ids from m_vocabSize on, which are only valid for this sentence, so
+   *  that the shared vocabulary is never modified while decoding. */
+  struct InputSentence {
+    std::vector< WORD_ID > ids;
+    std::vector< WORD > words;
+  };
+
+  // an extracted rule instance, before scoring
+  struct RuleInstance {
+    std::vector< WORD_ID > source;
+    std::vector< WORD_ID > target;
+    std::vector< std::pair<int,int> > alignment;
+    float count;
+
+    bool operator<(const RuleInstance &other) const {
+      if (source != other.source) return source < other.source;
+      if (target != other.target) return target < other.target;
+      return alignment < other.alignment;
+    }
+  };
+
+  // the vocabulary is frozen once the translation memory is loaded
+  WORD_ID m_vocabSize;
+
   // global cache for word pairs
   std::map< std::pair< WORD_ID, WORD_ID >, unsigned int > m_lsed;
 #ifdef WITH_THREADS
@@ -55,7 +106,6 @@ protected:
   mutable boost::shared_mutex m_accessLock;
 #endif
 
-  void load_corpus( const std::string &fileName, std::vector< std::vector< tmmt::WORD_ID > > &corpus );
   void load_target( const std::string &fileName, std::vector< std::vector< tmmt::SentenceAlignment > > &corpus);
   void load_alignment( const std::string &fileName, std::vector< std::vector< tmmt::SentenceAlignment > > &corpus );
 
@@ -65,20 +115,22 @@ protected:
 
   /** utlility function: compute length of sentence in characters
    (spaces do not count) */
-  unsigned int compute_length( const std::vector< tmmt::WORD_ID > &sentence );
-  unsigned int letter_sed( WORD_ID aIdx, WORD_ID bIdx );
-  unsigned int sed( const std::vector< WORD_ID > &a, const std::vector< WORD_ID > &b, std::string &best_path, bool use_letter_sed );
-  void init_short_matches(WordIndex &wordIndex, long translationId, const std::vector< WORD_ID > &input );
+  unsigned int compute_length( const std::vector< tmmt::WORD_ID > &sentence, const InputSentence &input );
+  unsigned int letter_sed( WORD_ID aIdx, WORD_ID bIdx, const InputSentence &input );
+  unsigned int sed( const std::vector< WORD_ID > &a, const std::vector< WORD_ID > &b, std::string &best_path, bool use_letter_sed, const InputSentence &input );
+  void init_short_matches(WordIndex &wordIndex, const std::vector< WORD_ID > &input );
   int short_match_max_length( int input_length );
-  void add_short_matches(WordIndex &wordIndex, long translationId, std::vector< Match > &match, const std::vector< WORD_ID > &tm, int input_length, int best_cost );
+  void add_short_matches(WordIndex &wordIndex, std::vector< Match > &match, const std::vector< WORD_ID > &tm, int input_length, int best_cost );
   std::vector< Match > prune_matches( const std::vector< Match > &match, int best_cost );
   int parse_matches( std::vector< Match > &match, int input_length, int tm_length, int &best_cost );
 
-  void create_extract(int sentenceInd, int cost, const std::vector< WORD_ID > &sourceSentence, const std::vector<SentenceAlignment> &targets, const std::string &inputStr, const std::string  &path, std::ofstream &outputFile);
+  void create_extract(const std::vector< WORD_ID > &sourceSentence, const std::vector<SentenceAlignment> &targets, const InputSentence &input, const std::string &path, std::vector< RuleInstance > &instances);
+  void create_rule(const std::vector< WORD_ID > &source, const std::vector< WORD_ID > &input, const SentenceAlignment &target, const std::string &path, RuleInstance &rule) const;
+  void score_rules(std::vector< RuleInstance > &instances, std::vector< FuzzyMatchRule > &rules) const;
 
-  std::string ExtractTM(WordIndex &wordIndex, long translationId, const std::string &inputPath);
-  Vocabulary &GetVocabulary() {
-    return suffixArray->GetVocabulary();
+  void ExtractTM(const InputSentence &input, std::vector< RuleInstance > &instances);
+  const WORD &GetWord(WORD_ID id, const InputSentence &input) const {
+    return id < m_vocabSize ? GetVocabulary().GetWord(id) : input.words[id - m_vocabSize];
   }
 
   bool GetLSEDCache(const std::pair< WORD_ID, WORD_ID > &key, unsigned int &value) const;
@@ -1,14 +1,109 @@
 #include "SuffixArray.h"
+#include <algorithm>
 #include <string>
 #include <stdlib.h>
 #include <cstring>
+#ifdef WITH_THREADS
+#include <boost/thread.hpp>
+#endif
+#include "util/exception.hh"
+#include "util/file.hh"
 
 using namespace std;
 
 namespace tmmt
 {
 
-SuffixArray::SuffixArray( string fileName )
+namespace
+{
+
+const char kMagic[8] = {'M', 'O', 'S', 'E', 'S', 'F', 'M', '1'};
+
+// Followed by the sections listed in SuffixArray.h, each padded to 8 bytes.
+struct IndexHeader {
+  char magic[8];
+  uint64_t size;
+  uint64_t sentences;
+  uint64_t vocabSize;
+  uint64_t vocabBytes;
+};
+
+inline uint64_t Pad(uint64_t bytes)
+{
+  return (bytes + 7) & ~static_cast<uint64_t>(7);
+}
+
+uint64_t IndexBytes(uint64_t size, uint64_t sentences, uint64_t vocabBytes)
+{
+  return Pad(sizeof(IndexHeader))
+         + Pad(size * sizeof(WORD_ID)) + Pad(size * sizeof(SuffixArray::INDEX))
+         + Pad(size) + Pad(size) + Pad(size * sizeof(SuffixArray::INDEX))
+         + Pad(sentences) + Pad(sentences * sizeof(SuffixArray::INDEX))
+         + Pad(vocabBytes);
+}
+
+template <class T> T *Section(char *&at, uint64_t count)
+{
+  T *ret = reinterpret_cast<T*>(at);
+  at += Pad(count * sizeof(T));
+  return ret;
+}
+
+const uint64_t kMaxLCP = 255;
+
+struct WordOrder {
+  const Vocabulary &vcb;
+  explicit WordOrder(const Vocabulary &v) : vcb(v) {}
+  bool operator()(WORD_ID a, WORD_ID b) const {
+    return vcb.GetWord(a) < vcb.GetWord(b);
+  }
+};
+
+} // namespace
+
+SuffixArray::SuffixArray( string fileName, size_t threads )
+{
+  if (IsIndex(fileName)) {
+    Load(fileName);
+  } else {
+    Build(fileName, threads);
+  }
+}
+
+bool SuffixArray::IsIndex( const string &fileName )
+{
+  ifstream in(fileName.c_str(), ios::in | ios::binary);
+  char magic[sizeof(kMagic)];
+  return in.read(magic, sizeof(magic)) && !memcmp(magic, kMagic, sizeof(kMagic));
+}
+
+// lays out the sections in m_memory, as in the index file
+void SuffixArray::Allocate( uint64_t vocabBytes )
+{
+  util::HugeMalloc(IndexBytes(m_size, m_sentenceCount, vocabBytes), true, m_memory);
+  IndexHeader *header = reinterpret_cast<IndexHeader*>(m_memory.get());
+  memcpy(header->magic, kMagic, sizeof(kMagic));
+  header->size = m_size;
+  header->sentences = m_sentenceCount;
+  header->vocabSize = m_vcb.vocab.size();
+  header->vocabBytes = vocabBytes;
+
+  char *at = reinterpret_cast<char*>(m_memory.get()) + Pad(sizeof(IndexHeader));
+  m_array = Section<WORD_ID>(at, m_size);
+  m_index = Section<INDEX>(at, m_size);
+  m_lcp = Section<unsigned char>(at, m_size);
+  m_wordInSentence = Section<char>(at, m_size);
+  m_sentence = Section<INDEX>(at, m_size);
+  m_sentenceLength = Section<char>(at, m_sentenceCount);
+  m_sentenceStart = Section<INDEX>(at, m_sentenceCount);
+  char *vocab = Section<char>(at, vocabBytes);
+  for (size_t i = 0; i < m_vcb.vocab.size(); ++i) {
+    memcpy(vocab, m_vcb.vocab[i].c_str(), m_vcb.vocab[i].size() + 1);
+    vocab += m_vcb.vocab[i].size() + 1;
+  }
+}
+
+void SuffixArray::Build( const string &fileName, size_t threads )
 {
   m_vcb.StoreIfNew( "<uNk>" );
   m_endOfSentence = m_vcb.StoreIfNew( "<s>" );
@@ -17,6 +112,7 @@ SuffixArray::SuffixArray( string fileName )
 
   // count the number of words first;
   extractFile.open(fileName.c_str());
+  UTIL_THROW_IF2(!extractFile, "Couldn't open translation memory " << fileName);
   istream *fileP = &extractFile;
   m_size = 0;
   size_t sentenceCount = 0;
@@ -31,25 +127,24 @@ SuffixArray::SuffixArray( string fileName )
   cerr << m_size << " words (incl. sentence boundaries)" << endl;
 
   // allocate memory
-  m_array = (WORD_ID*) calloc( sizeof( WORD_ID ), m_size );
-  m_index = (INDEX*) calloc( sizeof( INDEX ), m_size );
-  m_wordInSentence = (char*) calloc( sizeof( char ), m_size );
-  m_sentence = (size_t*) calloc( sizeof( size_t ), m_size );
-  m_sentenceLength = (char*) calloc( sizeof( char ), sentenceCount );
+  m_sentenceCount = sentenceCount;
+  uint64_t vocabBytes = 0;
+  for (size_t i = 0; i < m_vcb.vocab.size(); ++i) {
+    vocabBytes += m_vcb.vocab[i].size() + 1;
+  }
+  Allocate(vocabBytes);
 
   // fill the array
   int wordIndex = 0;
   int sentenceId = 0;
+  extractFile.clear();
   extractFile.open(fileName.c_str());
   fileP = &extractFile;
   while(getline(*fileP, line)) {
     vector< WORD_ID > words = m_vcb.Tokenize( line.c_str() );
 
-    // add to corpus vector
-    corpus.push_back(words);
-
     // create SA
-
+    m_sentenceStart[ sentenceId ] = wordIndex;
     vector< WORD_ID >::const_iterator i;
     for( i=words.begin(); i!=words.end(); i++) {
       m_index[ wordIndex ] = wordIndex;
@@ -65,48 +160,140 @@ SuffixArray::SuffixArray( string fileName )
   cerr << "done reading " << wordIndex << " words, " << sentenceId << " sentences." << endl;
   // List(0,9);
 
-  // sort
-  m_buffer = (INDEX*) calloc( sizeof( INDEX ), m_size );
-  Sort( 0, m_size-1 );
-  free( m_buffer );
+  // sort, comparing words by their rank in string order
+  vector< WORD_ID > byString(m_vcb.vocab.size());
+  for (size_t i = 0; i < byString.size(); ++i) {
+    byString[i] = i;
+  }
+  sort(byString.begin(), byString.end(), WordOrder(m_vcb));
+  m_rank.resize(byString.size());
+  for (size_t i = 0; i < byString.size(); ++i) {
+    m_rank[ byString[i] ] = i;
+  }
+
+  vector< INDEX > buffer( m_size );
+  m_buffer = &buffer[0];
+  if (m_size) {
+    Sort( 0, m_size-1, threads );
+  }
+  m_buffer = NULL;
+  vector< WORD_ID >().swap(m_rank);
   cerr << "done sorting" << endl;
+
+  ComputeLCP();
 }
 
-// good ol' quick sort
-void SuffixArray::Sort(INDEX start, INDEX end)
+void SuffixArray::Load( const string &fileName )
+{
+  util::scoped_fd fd(util::OpenReadOrThrow(fileName.c_str()));
+  const uint64_t fileSize = util::SizeOrThrow(fd.get());
+  UTIL_THROW_IF2(fileSize < sizeof(IndexHeader), "Truncated fuzzy-match index " << fileName);
+  util::MapRead(util::LAZY, fd.get(), 0, fileSize, m_memory);
+
+  const IndexHeader *header = reinterpret_cast<const IndexHeader*>(m_memory.get());
+  UTIL_THROW_IF2(fileSize != IndexBytes(header->size, header->sentences, header->vocabBytes),
+                 "Fuzzy-match index " << fileName << " has the wrong size");
+  m_size = header->size;
+  m_sentenceCount = header->sentences;
+
+  char *at = reinterpret_cast<char*>(m_memory.get()) + Pad(sizeof(IndexHeader));
+  m_array = Section<WORD_ID>(at, m_size);
+  m_index = Section<INDEX>(at, m_size);
+  m_lcp = Section<unsigned char>(at, m_size);
+  m_wordInSentence = Section<char>(at, m_size);
+  m_sentence = Section<INDEX>(at, m_size);
+  m_sentenceLength = Section<char>(at, m_sentenceCount);
+  m_sentenceStart = Section<INDEX>(at, m_sentenceCount);
+  const char *vocab = Section<char>(at, header->vocabBytes);
+  const char *vocabEnd = vocab + header->vocabBytes;
+  m_buffer = NULL;
+
+  // word ids must stay as they were when the index was built
+  for (uint64_t i = 0; i < header->vocabSize; ++i) {
+    const char *end = static_cast<const char*>(memchr(vocab, '\0', vocabEnd - vocab));
+    UTIL_THROW_IF2(end == NULL, "Truncated vocabulary in fuzzy-match index " << fileName);
+    WORD_ID id = m_vcb.StoreIfNew(string(vocab, end - vocab));
+    UTIL_THROW_IF2(id != i, "Duplicate word in fuzzy-match index " << fileName);
+    vocab = end + 1;
+  }
+  m_endOfSentence = m_vcb.GetWordID("<s>");
+  cerr << "loaded fuzzy-match index of " << m_size << " words, " << m_sentenceCount << " sentences." << endl;
+}
+
+void SuffixArray::Save( const string &fileName ) const
+{
+  const IndexHeader *header = reinterpret_cast<const IndexHeader*>(m_memory.get());
+  util::scoped_fd fd(util::CreateOrThrow(fileName.c_str()));
+  util::WriteOrThrow(fd.get(), m_memory.get(),
+                     IndexBytes(header->size, header->sentences, header->vocabBytes));
+}
+
+// merge sort, of the top levels with several threads
+void SuffixArray::Sort(INDEX start, INDEX end, size_t threads)
 {
   if (start == end) return;
   INDEX mid = (start+end+1)/2;
-  Sort( start, mid-1 );
-  Sort( mid, end );
+#ifdef WITH_THREADS
+  if (threads > 1) {
+    boost::thread left(&SuffixArray::Sort, this, start, mid-1, threads/2);
+    Sort( mid, end, threads - threads/2 );
+    left.join();
+  } else
+#endif
+  {
+    Sort( start, mid-1 );
+    Sort( mid, end );
+  }
 
   // merge
   size_t i = start;
   size_t j = mid;
   size_t k = 0;
   size_t length = end-start+1;
+  INDEX *buffer = m_buffer + start;
   while( k<length ) {
     if (i == mid ) {
-      m_buffer[ k++ ] = m_index[ j++ ];
+      buffer[ k++ ] = m_index[ j++ ];
     } else if (j > end ) {
-      m_buffer[ k++ ] = m_index[ i++ ];
+      buffer[ k++ ] = m_index[ i++ ];
     } else {
-      if (CompareIndex( m_index[i], m_index[j] ) < 0) {
-        m_buffer[ k++ ] = m_index[ i++ ];
+      if (CompareRank( m_index[i], m_index[j] ) < 0) {
+        buffer[ k++ ] = m_index[ i++ ];
       } else {
-        m_buffer[ k++ ] = m_index[ j++ ];
+        buffer[ k++ ] = m_index[ j++ ];
       }
     }
   }
 
   memcpy( ((char*)m_index) + sizeof( INDEX ) * start,
-          ((char*)m_buffer), sizeof( INDEX ) * (end-start+1) );
+          ((char*)buffer), sizeof( INDEX ) * (end-start+1) );
+}
+
+// common prefix lengths of neighbouring suffixes [Kasai et al., 2001]
+void SuffixArray::ComputeLCP()
+{
+  vector< INDEX > rank( m_size );
+  for (INDEX i = 0; i < m_size; ++i) {
+    rank[ m_index[i] ] = i;
+  }
+  INDEX h = 0;
+  for (INDEX pos = 0; pos < m_size; ++pos) {
+    if (rank[pos] == 0) {
+      m_lcp[0] = 0;
+      h = 0;
+      continue;
+    }
+    INDEX prev = m_index[ rank[pos]-1 ];
+    while (pos+h < m_size && prev+h < m_size && m_array[pos+h] == m_array[prev+h]) {
+      ++h;
+    }
+    m_lcp[ rank[pos] ] = min<uint64_t>(h, kMaxLCP);
+    if (h > 0) --h;
+  }
 }
 
 SuffixArray::~SuffixArray()
 {
-  free(m_index);
-  free(m_array);
 }
 
 int SuffixArray::CompareIndex( INDEX a, INDEX b ) const
@@ -124,6 +311,21 @@ int SuffixArray::CompareIndex( INDEX a, INDEX b ) const
   return CompareWord( m_array[ a+offset ], m_array[ b+offset ] );
 }
 
+int SuffixArray::CompareRank( INDEX a, INDEX b ) const
+{
+  // as CompareIndex
+  INDEX offset = 0;
+  while( a+offset < m_size &&
+         b+offset < m_size &&
+         m_array[ a+offset ] == m_array[ b+offset ] ) {
+    offset++;
+  }
+
+  if( a+offset == m_size ) return -1;
+  if( b+offset == m_size ) return 1;
+  return m_rank[ m_array[ a+offset ] ] < m_rank[ m_array[ b+offset ] ] ? -1 : 1;
+}
+
 inline int SuffixArray::CompareWord( WORD_ID a, WORD_ID b ) const
 {
   // cerr << "c(" << m_vcb.GetWord(a) << ":" << m_vcb.GetWord(b) << ")=" << m_vcb.GetWord(a).compare( m_vcb.GetWord(b) ) << endl;
@@ -183,7 +385,17 @@ SuffixArray::INDEX SuffixArray::FindLast( const vector< WORD > &phrase, INDEX st
     INDEX mid = ( start + end + (direction>0 ? 0 : 1) )/2;
 
     int match = Match( phrase, mid );
-    int matchNext = Match( phrase, mid+direction );
+    // (nothing before the first or after the last suffix)
+    INDEX next = mid+direction;
+    int matchNext = 1;
+    if (match == 0 && next < m_size) {
+      // the neighbour of a match matches iff their common prefix is long enough
+      if (phrase.size() < kMaxLCP) {
+        matchNext = m_lcp[ direction > 0 ? next : mid ] >= phrase.size() ? 0 : 1;
+      } else {
+        matchNext = Match( phrase, next );
+      }
+    }
     //cerr << "\t" << start << ";" << mid << ";" << end << " -> " << match << "," << matchNext << endl;
 
     if (match == 0 && matchNext != 0) return mid;
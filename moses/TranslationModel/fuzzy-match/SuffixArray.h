@@ -2,34 +2,68 @@
 
 #pragma once
 
+#include <stdint.h>
+#include "util/mmap.hh"
+
 #define LINE_MAX_LENGTH 10000
 
 namespace tmmt
 {
 
+/** Suffix array of the source side of the translation memory.
+ *
+ * It is either built from a text file with one sentence per line, or opened
+ * from an index that was built offline with CreateFuzzyMatchIndex and Save().
+ * The index is memory mapped, so it opens quickly and its pages are shared
+ * by all decoder processes using it.  Both have the same layout:
+ *  - the corpus as word ids, each sentence followed by <s>,
+ *  - the sorted suffixes and the length (in words, at most 255) of the
+ *    common prefix of each suffix with the one before it,
+ *  - for each corpus position its sentence and its position in the sentence,
+ *  - the length and start of each sentence,
+ *  - the words of the vocabulary in id order.
+ */
 class SuffixArray
 {
 public:
   typedef unsigned int INDEX;
 
 private:
-  std::vector< std::vector< WORD_ID > > corpus;
+  util::scoped_memory m_memory;
 
   WORD_ID *m_array;
   INDEX *m_index;
+  unsigned char *m_lcp;
   INDEX *m_buffer;
   char *m_wordInSentence;
-  size_t *m_sentence;
+  INDEX *m_sentence;
   char *m_sentenceLength;
+  INDEX *m_sentenceStart;
   WORD_ID m_endOfSentence;
   Vocabulary m_vcb;
   INDEX m_size;
+  INDEX m_sentenceCount;
+
+  // rank of each word id in string order, while sorting
+  std::vector< WORD_ID > m_rank;
+
+  void Build( const std::string &fileName, size_t threads );
+  void Load( const std::string &fileName );
+  void Allocate( uint64_t vocabBytes );
+  void ComputeLCP();
+  int CompareRank( INDEX a, INDEX b ) const;
 
 public:
-  SuffixArray( std::string fileName );
+  /** fileName is a text file or an index written by Save();
+   *  threads is the number of threads to sort a text file with */
+  SuffixArray( std::string fileName, size_t threads = 1 );
   ~SuffixArray();
 
-  void Sort(INDEX start, INDEX end);
+  /** True iff fileName is an index written by Save() */
+  static bool IsIndex( const std::string &fileName );
+  void Save( const std::string &fileName ) const;
+
+  void Sort(INDEX start, INDEX end, size_t threads = 1);
   int CompareIndex( INDEX a, INDEX b ) const;
   inline int CompareWord( WORD_ID a, WORD_ID b ) const;
   int Count( const std::vector< WORD > &phrase );
@@ -56,14 +90,20 @@ public:
   inline INDEX GetSize() {
     return m_size;
   }
+  inline INDEX GetSentenceCount() const {
+    return m_sentenceCount;
+  }
+  /** the words of a corpus sentence */
+  std::vector< WORD_ID > GetSentenceWords( size_t sentenceId ) const {
+    const WORD_ID *begin = m_array + m_sentenceStart[sentenceId];
+    const WORD_ID *end = begin;
+    while (*end != m_endOfSentence) ++end;
+    return std::vector< WORD_ID >(begin, end);
+  }
 
   Vocabulary &GetVocabulary() {
     return m_vcb;
   }
-  const std::vector< std::vector< WORD_ID > > &GetCorpus() const {
-    return corpus;
-  }
 };
 
 }
-
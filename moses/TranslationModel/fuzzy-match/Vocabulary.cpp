@@ -67,5 +67,16 @@ WORD_ID Vocabulary::GetWordID( const WORD &word )
   return w;
 }
 
+bool Vocabulary::Find( const WORD &word, WORD_ID &id ) const
+{
+#ifdef WITH_THREADS
+  boost::shared_lock<boost::shared_mutex> read_lock(m_accessLock);
+#endif
+  map<WORD, WORD_ID>::const_iterator i = lookup.find( word );
+  if( i == lookup.end() )
+    return false;
+  id = i->second;
+  return true;
 }
 
+}
@@ -27,6 +27,8 @@ public:
   std::vector< WORD > vocab;
   WORD_ID StoreIfNew( const WORD& );
   WORD_ID GetWordID( const WORD& );
+  /** false if word is not in the vocabulary; never adds it */
+  bool Find( const WORD &word, WORD_ID &id ) const;
   std::vector<WORD_ID> Tokenize( const char[] );
   inline WORD &GetWord( WORD_ID id ) const {
     WORD &i = (WORD&) vocab[ id ];
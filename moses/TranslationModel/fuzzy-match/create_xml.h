@@ -1,5 +0,0 @@
-#pragma once
-
-#include <string>
-
-void create_xml(const std::string &inPath);
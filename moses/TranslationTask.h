@@ -14,6 +14,7 @@
 #include "moses/Syntax/S2T/Manager.h"
 #include "moses/Syntax/T2S/Manager.h"
 
+#include <map>
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
 #include <boost/make_shared.hpp>
@@ -68,6 +69,12 @@ protected:
 
   boost::shared_ptr<std::vector<std::string> > m_context;
   // SPTR<std::map<std::string, float> const> m_context_weights;
+
+  // Per-task state of feature functions, keyed by the feature function.
+  // Unlike the ContextScope, which several tasks may share, it belongs to
+  // this task alone and is only used by the thread that runs it, so it
+  // takes no lock.
+  std::map<void const*, boost::shared_ptr<void> > m_local;
 public:
 
   boost::shared_ptr<TranslationTask>
@@ -124,6 +131,22 @@ public:
     return m_scope;
   }
 
+  template<typename T>
+  boost::shared_ptr<T>
+  GetLocal(void const* key) const {
+    std::map<void const*, boost::shared_ptr<void> >::const_iterator m
+    = m_local.find(key);
+    if (m == m_local.end()) return boost::shared_ptr<T>();
+    return boost::static_pointer_cast<T>(m->second);
+  }
+
+  template<typename T>
+  void
+  SetLocal(void const* key, boost::shared_ptr<T> const& val) {
+    if (val) m_local[key] = val;
+    else m_local.erase(key);
+  }
+
   boost::shared_ptr<std::vector<std::string> >
   GetContextWindow() const;
 
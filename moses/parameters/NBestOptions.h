@@ -20,6 +20,8 @@ struct NBestOptions : public OptionsBaseClass
 
   bool include_all_factors;
 
+  bool binary; // write a binary n-best list (see BinaryNBest.h)
+
   std::string output_file_path;
 
   bool init(Parameter const& param);
@@ -40,6 +40,11 @@ ServerOptions()
   , numThreads(15) // why 15?
   , sessionTimeout(1800) // = 30 min
   , sessionCacheSize(25)
+  , clientConcurrency(0)
+  , cacheSize(0)
+  , maxQueue(0)
+  , degradeQueue(0)
+  , deadline(0)
   , port(8080)
   , maxConn(15)
   , maxConnBacklog(15)
@@ -77,6 +82,13 @@ init(Parameter const& P)
   P.SetParameter(timeout_spec, "session-timeout",std::string("30m"));
   this->sessionTimeout = parse_timespec(timeout_spec);
   P.SetParameter(this->sessionCacheSize, "session-cache_size", size_t(25));
+  P.SetParameter(this->clientConcurrency, "server-client-concurrency", size_t(0));
+  P.SetParameter(this->cacheSize, "server-cache-size", size_t(0));
+
+  // admission control
+  P.SetParameter(this->maxQueue, "server-max-queue", size_t(0));
+  P.SetParameter(this->degradeQueue, "server-degrade-queue", size_t(0));
+  P.SetParameter(this->deadline, "server-deadline", size_t(0));
 
   return true;
 }
@@ -13,6 +13,11 @@ namespace Moses
     
     size_t sessionTimeout;   // this is related to Moses translation sessions
     size_t sessionCacheSize; // this is related to Moses translation sessions
+    size_t clientConcurrency; // refuse more requests in flight per client (0: no limit)
+    size_t cacheSize;         // max. number of cached translations (0: no cache)
+    size_t maxQueue;          // reject requests when more are waiting (0: never)
+    size_t degradeQueue;      // degrade search from this queue depth on (0: never)
+    size_t deadline;          // default request deadline in ms (0: none)
 
     int port;              // this is for the abyss server
     std::string logfile;   // this is for the abyss server
@@ -0,0 +1,86 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width: 2 -*-
+#include "AdmissionControl.h"
+#include "moses/StaticData.h"
+#include <algorithm>
+#include <boost/thread/locks.hpp>
+
+namespace MosesServer
+{
+  using namespace std;
+
+  size_t const AdmissionControl::max_level;
+
+  AdmissionControl::
+  AdmissionControl(Moses::ServerOptions const& opts)
+    : m_max_queue(opts.maxQueue)
+    , m_degrade_queue(opts.degradeQueue)
+    , m_deadline(opts.deadline)
+    , m_admitted(0), m_rejected(0), m_degraded(0), m_expired(0)
+  { }
+
+  size_t
+  AdmissionControl::
+  admit(size_t const queue_depth, size_t const n)
+  {
+    boost::lock_guard<boost::mutex> lock(m_lock);
+    if (m_max_queue && queue_depth > m_max_queue)
+      {
+        m_rejected += n;
+        throw xmlrpc_c::fault("Server overloaded, please retry later",
+                              xmlrpc_c::fault::CODE_REQUEST_REFUSED);
+      }
+    m_admitted += n;
+    if (!m_degrade_queue || queue_depth < m_degrade_queue) return 0;
+    m_degraded += n;
+    return min(max_level, queue_depth / m_degrade_queue);
+  }
+
+  size_t
+  AdmissionControl::
+  deadline(params_t const& params) const
+  {
+    params_t::const_iterator si = params.find("deadline");
+    if (si == params.end()) return m_deadline;
+    int const ms = xmlrpc_c::value_int(si->second);
+    return ms > 0 ? ms : 0;
+  }
+
+  void
+  AdmissionControl::
+  expired()
+  {
+    boost::lock_guard<boost::mutex> lock(m_lock);
+    ++m_expired;
+  }
+
+  void
+  AdmissionControl::
+  degrade(Moses::AllOptions& opts, size_t const level)
+  {
+    for (size_t i = 0; i < level; ++i)
+      {
+        opts.search.stack_size = max(opts.search.stack_size / 2, size_t(1));
+        opts.cube.pop_limit = max(opts.cube.pop_limit / 2, size_t(1));
+        opts.search.max_trans_opt_per_cov
+          = max(opts.search.max_trans_opt_per_cov / 2, size_t(1));
+      }
+    VERBOSE(2, "Degraded request (level " << level << "): stack "
+            << opts.search.stack_size << ", cube-pruning-pop-limit "
+            << opts.cube.pop_limit << ", max-trans-opt-per-coverage "
+            << opts.search.max_trans_opt_per_cov << std::endl);
+  }
+
+  AdmissionControl::params_t
+  AdmissionControl::
+  stats(size_t const queue_depth) const
+  {
+    params_t ret;
+    boost::lock_guard<boost::mutex> lock(m_lock);
+    ret["queue-depth"] = xmlrpc_c::value_int(queue_depth);
+    ret["admitted"]    = xmlrpc_c::value_int(m_admitted);
+    ret["rejected"]    = xmlrpc_c::value_int(m_rejected);
+    ret["degraded"]    = xmlrpc_c::value_int(m_degraded);
+    ret["expired"]     = xmlrpc_c::value_int(m_expired);
+    return ret;
+  }
+}
@@ -0,0 +1,54 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width: 2 -*-
+#pragma once
+#include <map>
+#include <string>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <xmlrpc-c/base.hpp>
+#include "moses/parameters/AllOptions.h"
+#include "moses/parameters/ServerOptions.h"
+
+namespace MosesServer
+{
+  // Keeps latency bounded under overload. Depending on the number of
+  // requests waiting for a decoder thread, a new request is
+  // - rejected right away (more than server-max-queue waiting),
+  // - decoded with reduced search effort (degradation level 1 to 3 when
+  //   server-degrade-queue or more are waiting, see degrade()),
+  // - or decoded normally.
+  // Also counts expired requests: those that waited past their deadline
+  // for a thread and are therefore not decoded at all.
+  class AdmissionControl : boost::noncopyable
+  {
+    size_t const m_max_queue;     // 0: no limit
+    size_t const m_degrade_queue; // 0: never degrade
+    size_t const m_deadline;      // default deadline in ms; 0: none
+
+    mutable boost::mutex m_lock;
+    size_t m_admitted, m_rejected, m_degraded, m_expired;
+
+  public:
+    typedef std::map<std::string, xmlrpc_c::value> params_t;
+    static size_t const max_level = 3;
+
+    AdmissionControl(Moses::ServerOptions const& opts);
+
+    // Admits /n/ requests given the current queue depth and returns their
+    // degradation level; throws an xmlrpc_c::fault if they are rejected.
+    // Only the requests already waiting count against the limit, so a
+    // batch larger than server-max-queue is still taken by an idle server.
+    size_t admit(size_t queue_depth, size_t n = 1);
+
+    // the deadline of a request in ms from now ("deadline" parameter or
+    // the server default), 0 for none
+    size_t deadline(params_t const& params) const;
+
+    void expired();
+
+    // Halves the stack size, cube pruning pop limit and translation
+    // options per span for each degradation level.
+    static void degrade(Moses::AllOptions& opts, size_t level);
+
+    params_t stats(size_t queue_depth) const;
+  };
+}
@@ -0,0 +1,121 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width: 2 -*-
+#include "BatchTranslator.h"
+#include "TranslationRequest.h"
+
+namespace MosesServer
+{
+  using namespace std;
+
+  BatchTranslator::
+  BatchTranslator(Translator& translator)
+    : m_translator(translator)
+  {
+    this->_signature = "S:S";
+    this->_help = "Translates a batch of segments. Takes a struct with an array "
+      "'segments' of strings or structs (as for 'translate'); all other "
+      "members are the default options of every segment. Returns a struct "
+      "with an array 'segments' of results, in input order.";
+  }
+
+  void
+  BatchTranslator::
+  execute(xmlrpc_c::paramList const& paramList,
+          xmlrpc_c::callInfo const* const callInfoP,
+          xmlrpc_c::value *   const  retvalP)
+  {
+    typedef std::map<std::string, xmlrpc_c::value> params_t;
+    paramList.verifyEnd(1);
+    params_t shared = paramList.getStruct(0);
+    params_t::iterator si = shared.find("segments");
+    if (si == shared.end())
+      throw xmlrpc_c::fault("Missing segments", xmlrpc_c::fault::CODE_PARSE);
+    vector<xmlrpc_c::value> const segments = xmlrpc_c::value_array(si->second).vectorValueValue();
+    shared.erase(si);
+
+    // all segments of a batch share one session; open it only once
+    si = shared.find("session-id");
+    if (si != shared.end())
+      {
+        uint64_t id = xmlrpc_c::value_int(si->second);
+        si->second = xmlrpc_c::value_int(m_translator.get_session(id).id);
+      }
+
+    // check everything before anything is queued: queued requests refer
+    // to the condition and mutex on this stack
+    AdmissionControl& admission = m_translator.admission();
+    vector<params_t> requests(segments.size(), shared);
+    vector<size_t> deadlines(segments.size());
+    for (size_t i = 0; i < segments.size(); ++i)
+      {
+        if (segments[i].type() == xmlrpc_c::value::TYPE_STRING)
+          requests[i]["text"] = segments[i];
+        else
+          {
+            params_t const seg = xmlrpc_c::value_struct(segments[i]);
+            params_t::const_iterator m;
+            for (m = seg.begin(); m != seg.end(); ++m)
+              requests[i][m->first] = m->second;
+          }
+        if (requests[i].find("text") == requests[i].end())
+          throw xmlrpc_c::fault("Missing source text in segment "
+                                + Moses::SPrint(i), xmlrpc_c::fault::CODE_PARSE);
+        deadlines[i] = admission.deadline(requests[i]);
+      }
+
+    // only segments that are not in the result cache are decoded
+    ResultCache& cache = m_translator.cache();
+    boost::condition_variable cond;
+    boost::mutex mut;
+    string const client = Translator::client_id(callInfoP);
+    vector<string> keys(requests.size());
+    vector<params_t> cached(requests.size());
+    vector<boost::shared_ptr<TranslationRequest> > tasks(requests.size());
+    size_t todo = 0;
+    for (size_t i = 0; i < requests.size(); ++i)
+      {
+        keys[i] = cache.key(requests[i]);
+        if (!cache.get(keys[i], cached[i])) ++todo;
+      }
+
+    // the batch is admitted or rejected as a whole, within the client's
+    // quota and by admission control
+    vector<boost::shared_ptr<ClientLimiter::Slot> > slots;
+    if (todo) slots = m_translator.acquire(client, todo);
+    size_t const level = todo ? admission.admit(m_translator.queue_depth(), todo) : 0;
+    for (size_t i = 0; i < requests.size(); ++i)
+      {
+        if (cached[i].size()) continue; // results are never empty
+        tasks[i] = TranslationRequest::create(&m_translator, requests[i], cond, mut);
+        tasks[i]->SetAdmission(level, deadlines[i]);
+        m_translator.submit(tasks[i], slots.back());
+        slots.pop_back(); // the task gives it back when done
+      }
+
+    vector<xmlrpc_c::value> results;
+    results.reserve(tasks.size());
+    boost::unique_lock<boost::mutex> lock(mut);
+    for (size_t i = 0; i < tasks.size(); ++i)
+      {
+        if (!tasks[i])
+          {
+            results.push_back(xmlrpc_c::value_struct(cached[i]));
+            continue;
+          }
+        while (!tasks[i]->IsDone())
+          cond.wait(lock);
+        if (tasks[i]->IsExpired())
+          {
+            params_t error;
+            error["error"] = xmlrpc_c::value_string("Deadline exceeded");
+            results.push_back(xmlrpc_c::value_struct(error));
+            continue;
+          }
+        if (!level) cache.put(keys[i], tasks[i]->GetRetData());
+        results.push_back(xmlrpc_c::value_struct(tasks[i]->GetRetData()));
+      }
+
+    params_t ret;
+    ret["segments"] = xmlrpc_c::value_array(results);
+    *retvalP = xmlrpc_c::value_struct(ret);
+  }
+}
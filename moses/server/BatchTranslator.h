@@ -0,0 +1,24 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width: 2 -*-
+#pragma once
+#include "Translator.h"
+#include <xmlrpc-c/base.hpp>
+#include <xmlrpc-c/registry.hpp>
+
+namespace MosesServer
+{
+  // Translates many segments in one call ("translate_batch"). The
+  // segments are decoded in parallel on the Translator's thread pool and
+  // the results are returned in input order. Only one server thread waits
+  // for the whole batch, instead of one per segment.
+  class
+  BatchTranslator : public xmlrpc_c::method2
+  {
+    Translator& m_translator;
+  public:
+    BatchTranslator(Translator& translator);
+
+    void execute(xmlrpc_c::paramList const& paramList,
+                 xmlrpc_c::callInfo const* const callInfoP,
+                 xmlrpc_c::value *   const  retvalP);
+  };
+}
@@ -0,0 +1,25 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width: 2 -*-
+#include "CacheStats.h"
+#include "ResultCache.h"
+
+namespace MosesServer
+{
+  CacheStats::
+  CacheStats(ResultCache const& cache)
+    : m_cache(cache)
+  {
+    this->_signature = "S:";
+    this->_help = "Returns hits, misses, hit-rate, entries, capacity, "
+      "evictions and bypassed (uncacheable) requests of the translation "
+      "result cache, and the current model epoch";
+  }
+
+  void
+  CacheStats::
+  execute(xmlrpc_c::paramList const& paramList,
+          xmlrpc_c::value *   const  retvalP)
+  {
+    paramList.verifyEnd(0);
+    *retvalP = xmlrpc_c::value_struct(m_cache.stats());
+  }
+}
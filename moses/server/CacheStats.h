@@ -0,0 +1,21 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width: 2 -*-
+#pragma once
+#include <xmlrpc-c/base.hpp>
+#include <xmlrpc-c/registry.hpp>
+
+namespace MosesServer
+{
+  class ResultCache;
+
+  // reports the hit rate and size of the translation result cache
+  class
+  CacheStats : public xmlrpc_c::method
+  {
+    ResultCache const& m_cache;
+  public:
+    CacheStats(ResultCache const& cache);
+
+    void execute(xmlrpc_c::paramList const& paramList,
+                 xmlrpc_c::value *   const  retvalP);
+  };
+}
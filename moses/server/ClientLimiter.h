@@ -0,0 +1,66 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width: 2 -*-
+#pragma once
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+namespace MosesServer
+{
+  // Limits the number of translation requests (or batch segments) of one
+  // client that are queued or being decoded at the same time, so that a
+  // client sending large batches cannot starve the others. Requests over
+  // the limit are refused at once rather than queued, so that they do not
+  // hold on to a server thread. A limit of 0 means no limit.
+  class ClientLimiter
+  {
+    size_t const m_limit;
+    boost::mutex m_lock;
+    boost::unordered_map<std::string, size_t> m_in_flight;
+
+    void
+    release(std::string const& client)
+    {
+      boost::lock_guard<boost::mutex> lock(m_lock);
+      boost::unordered_map<std::string, size_t>::iterator m;
+      m = m_in_flight.find(client);
+      if (m != m_in_flight.end() && --m->second == 0)
+        m_in_flight.erase(m);
+    }
+
+  public:
+    // a request's claim on its client's quota, given back on destruction
+    class Slot : boost::noncopyable
+    {
+      ClientLimiter& m_limiter;
+      std::string const m_client;
+    public:
+      Slot(ClientLimiter& limiter, std::string const& client)
+        : m_limiter(limiter), m_client(client) { }
+      ~Slot() { m_limiter.release(m_client); }
+    };
+
+    ClientLimiter(size_t const limit) : m_limit(limit) { }
+
+    // /n/ slots for /client/, one per request; none if they would put
+    // the client over the limit
+    std::vector<boost::shared_ptr<Slot> >
+    acquire(std::string const& client, size_t const n = 1)
+    {
+      std::vector<boost::shared_ptr<Slot> > ret;
+      boost::lock_guard<boost::mutex> lock(m_lock);
+      boost::unordered_map<std::string, size_t>::iterator m;
+      m = m_in_flight.find(client);
+      size_t const count = m == m_in_flight.end() ? 0 : m->second;
+      if (m_limit && count + n > m_limit) return ret;
+      m_in_flight[client] = count + n;
+      ret.reserve(n);
+      for (size_t i = 0; i < n; ++i)
+        ret.push_back(boost::shared_ptr<Slot>(new Slot(*this, client)));
+      return ret;
+    }
+  };
+}
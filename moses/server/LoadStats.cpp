@@ -0,0 +1,26 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width: 2 -*-
+#include "LoadStats.h"
+#include "Translator.h"
+
+namespace MosesServer
+{
+  LoadStats::
+  LoadStats(Translator& translator)
+    : m_translator(translator)
+  {
+    this->_signature = "S:";
+    this->_help = "Returns the number of requests waiting for a decoder "
+      "thread (queue-depth) and the numbers of admitted, rejected, "
+      "degraded and expired requests";
+  }
+
+  void
+  LoadStats::
+  execute(xmlrpc_c::paramList const& paramList,
+          xmlrpc_c::value *   const  retvalP)
+  {
+    paramList.verifyEnd(0);
+    *retvalP = xmlrpc_c::value_struct
+      (m_translator.admission().stats(m_translator.queue_depth()));
+  }
+}
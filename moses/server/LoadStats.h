@@ -0,0 +1,21 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width: 2 -*-
+#pragma once
+#include <xmlrpc-c/base.hpp>
+#include <xmlrpc-c/registry.hpp>
+
+namespace MosesServer
+{
+  class Translator;
+
+  // reports the queue depth and the admission control counts
+  class
+  LoadStats : public xmlrpc_c::method
+  {
+    Translator& m_translator;
+  public:
+    LoadStats(Translator& translator);
+
+    void execute(xmlrpc_c::paramList const& paramList,
+                 xmlrpc_c::value *   const  retvalP);
+  };
+}
@@ -1,4 +1,5 @@
 #include "Optimizer.h"
+#include "moses/StaticData.h"
 #include <iostream>
 
 namespace MosesServer
@@ -53,6 +54,7 @@ execute(xmlrpc_c::paramList const& paramList,
   // = (PhraseDictionaryMultiModel*) FindPhraseDictionary(model_name);
   PhraseDictionaryMultiModel* pdmm = FindPhraseDictionary(model_name);
   vector<float> weight_vector = pdmm->MinimizePerplexity(phrase_pairs);
+  Moses::StaticData::Instance().BumpModelEpoch();
 
   vector<xmlrpc_c::value> weight_vector_ret;
   for (size_t i=0; i < weight_vector.size(); i++)
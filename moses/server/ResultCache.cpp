@@ -0,0 +1,214 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width: 2 -*-
+#include "ResultCache.h"
+#include "moses/StaticData.h"
+#include <sstream>
+#include <boost/foreach.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/locks.hpp>
+
+namespace MosesServer
+{
+  using namespace std;
+
+  namespace
+  {
+    // request parameters that change weights, models or the session
+    // context before decoding
+    char const* const uncacheable[] = {
+      "context", "context-scope", "context-weights", "lambda", "weights",
+      "bias", NULL
+    };
+
+    // whitespace does not matter to the decoder
+    string
+    normalize(string const& text)
+    {
+      string ret;
+      ret.reserve(text.size());
+      istringstream in(text);
+      string tok;
+      while (in >> tok)
+        {
+          if (ret.size()) ret += ' ';
+          ret += tok;
+        }
+      return ret;
+    }
+
+    // An unambiguous rendering of /v/; false for types that never occur
+    // in translation requests.
+    bool
+    serialize(xmlrpc_c::value const& v, ostream& out)
+    {
+      switch (v.type())
+        {
+        case xmlrpc_c::value::TYPE_INT:
+          out << 'i' << int(xmlrpc_c::value_int(v)) << ';';
+          return true;
+        case xmlrpc_c::value::TYPE_I8:
+          out << 'i' << (long long)(xmlrpc_c::value_i8(v)) << ';';
+          return true;
+        case xmlrpc_c::value::TYPE_BOOLEAN:
+          out << 'b' << bool(xmlrpc_c::value_boolean(v)) << ';';
+          return true;
+        case xmlrpc_c::value::TYPE_DOUBLE:
+          out.precision(17);
+          out << 'd' << double(xmlrpc_c::value_double(v)) << ';';
+          return true;
+        case xmlrpc_c::value::TYPE_STRING:
+          {
+            string const s = xmlrpc_c::value_string(v);
+            out << 's' << s.size() << ':' << s;
+            return true;
+          }
+        case xmlrpc_c::value::TYPE_ARRAY:
+          {
+            vector<xmlrpc_c::value> const a
+              = xmlrpc_c::value_array(v).vectorValueValue();
+            out << 'a' << a.size() << ':';
+            BOOST_FOREACH(xmlrpc_c::value const& x, a)
+              if (!serialize(x, out)) return false;
+            return true;
+          }
+        case xmlrpc_c::value::TYPE_STRUCT:
+          {
+            ResultCache::params_t const m = xmlrpc_c::value_struct(v);
+            out << 'm' << m.size() << ':';
+            BOOST_FOREACH(ResultCache::params_t::value_type const& x, m)
+              {
+                out << x.first.size() << ':' << x.first;
+                if (!serialize(x.second, out)) return false;
+              }
+            return true;
+          }
+        default:
+          return false;
+        }
+    }
+  }
+
+  ResultCache::
+  ResultCache(size_t capacity, SessionCache const& sessions, size_t num_shards)
+    : m_capacity((capacity + num_shards - 1) / num_shards)
+    , m_sessions(sessions)
+    , m_bypassed(0)
+  {
+    if (!capacity) return;
+    m_shards.resize(num_shards);
+    for (size_t i = 0; i < num_shards; ++i)
+      m_shards[i].reset(new Shard);
+  }
+
+  ResultCache::Shard&
+  ResultCache::
+  shard(string const& key)
+  {
+    return *m_shards[boost::hash<string>()(key) % m_shards.size()];
+  }
+
+  string
+  ResultCache::
+  key(params_t const& params)
+  {
+    if (m_shards.empty()) return "";
+
+    bool cacheable = true;
+    for (char const* const* p = uncacheable; *p && cacheable; ++p)
+      cacheable = params.find(*p) == params.end();
+
+    // an unknown session id (such as 1) opens a new session
+    size_t session_epoch = 0;
+    params_t::const_iterator si = params.find("session-id");
+    if (si != params.end())
+      cacheable = (cacheable && si->second.type() == xmlrpc_c::value::TYPE_INT
+                   && m_sessions.epoch(int(xmlrpc_c::value_int(si->second)),
+                                       session_epoch));
+
+    ostringstream buf;
+    buf << Moses::StaticData::Instance().GetModelEpoch() << ';'
+        << session_epoch << ';';
+    BOOST_FOREACH(params_t::value_type const& p, params)
+      {
+        if (!cacheable) break;
+        if (p.first == "deadline") continue; // does not change the result
+        buf << p.first.size() << ':' << p.first;
+        if (p.first == "text" && p.second.type() == xmlrpc_c::value::TYPE_STRING)
+          serialize(xmlrpc_c::value_string(normalize(xmlrpc_c::value_string(p.second))), buf);
+        else cacheable = serialize(p.second, buf);
+      }
+
+    if (cacheable) return buf.str();
+    boost::lock_guard<boost::mutex> lock(m_lock);
+    ++m_bypassed;
+    return "";
+  }
+
+  bool
+  ResultCache::
+  get(string const& key, params_t& result)
+  {
+    if (key.empty()) return false;
+    Shard& s = shard(key);
+    boost::lock_guard<boost::mutex> lock(s.lock);
+    boost::unordered_map<string, Shard::lru_t::iterator>::iterator m;
+    m = s.index.find(key);
+    if (m == s.index.end())
+      {
+        ++s.misses;
+        return false;
+      }
+    ++s.hits;
+    s.lru.splice(s.lru.begin(), s.lru, m->second);
+    result = m->second->second;
+    return true;
+  }
+
+  void
+  ResultCache::
+  put(string const& key, params_t const& result)
+  {
+    if (key.empty()) return;
+    Shard& s = shard(key);
+    boost::lock_guard<boost::mutex> lock(s.lock);
+    if (s.index.find(key) != s.index.end()) return;
+    s.lru.push_front(make_pair(key, result));
+    s.index[key] = s.lru.begin();
+    if (s.lru.size() > m_capacity)
+      {
+        s.index.erase(s.lru.back().first);
+        s.lru.pop_back();
+        ++s.evictions;
+      }
+  }
+
+  ResultCache::params_t
+  ResultCache::
+  stats() const
+  {
+    size_t hits = 0, misses = 0, evictions = 0, entries = 0;
+    BOOST_FOREACH(boost::shared_ptr<Shard> const& s, m_shards)
+      {
+        boost::lock_guard<boost::mutex> lock(s->lock);
+        hits += s->hits;
+        misses += s->misses;
+        evictions += s->evictions;
+        entries += s->lru.size();
+      }
+    params_t ret;
+    ret["capacity"]  = xmlrpc_c::value_int(m_capacity * m_shards.size());
+    ret["entries"]   = xmlrpc_c::value_int(entries);
+    ret["hits"]      = xmlrpc_c::value_int(hits);
+    ret["misses"]    = xmlrpc_c::value_int(misses);
+    ret["evictions"] = xmlrpc_c::value_int(evictions);
+    {
+      boost::lock_guard<boost::mutex> lock(m_lock);
+      ret["bypassed"] = xmlrpc_c::value_int(m_bypassed);
+    }
+    ret["hit-rate"]  = xmlrpc_c::value_double(hits + misses
+                                              ? double(hits) / (hits + misses)
+                                              : 0.);
+    ret["model-epoch"]
+      = xmlrpc_c::value_int(Moses::StaticData::Instance().GetModelEpoch());
+    return ret;
+  }
+}
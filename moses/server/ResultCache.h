@@ -0,0 +1,69 @@
+// -*- mode: c++; indent-tabs-mode: nil; tab-width: 2 -*-
+#pragma once
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <xmlrpc-c/base.hpp>
+#include "Session.h"
+
+namespace MosesServer
+{
+  // A bounded LRU cache of translation results. The key of a request is
+  // its normalized source text together with all other request
+  // parameters (n-best size, alignment and score options, session id, ...)
+  // and the model epoch (Moses::StaticData::GetModelEpoch()), which
+  // changes whenever weights or models are updated at run time. Requests
+  // within a session also key on the session's epoch, which changes when
+  // a request sets the session's context. Requests that change weights or
+  // context themselves, or name a session that does not exist (yet), are
+  // never cached.
+  //
+  // The cache is split into shards with a lock each, so that concurrent
+  // requests rarely wait for each other.
+  class ResultCache : boost::noncopyable
+  {
+  public:
+    typedef std::map<std::string, xmlrpc_c::value> params_t;
+
+  private:
+    struct Shard
+    {
+      typedef std::list<std::pair<std::string, params_t> > lru_t;
+      boost::mutex lock;
+      lru_t lru; // most recently used first
+      boost::unordered_map<std::string, lru_t::iterator> index;
+      size_t hits, misses, evictions;
+      Shard() : hits(0), misses(0), evictions(0) { }
+    };
+
+    size_t const m_capacity; // per shard
+    SessionCache const& m_sessions;
+    std::vector<boost::shared_ptr<Shard> > m_shards;
+    mutable boost::mutex m_lock; // for m_bypassed
+    size_t m_bypassed;
+
+    Shard& shard(std::string const& key);
+
+  public:
+    // /capacity/ results in total; 0 disables the cache
+    ResultCache(size_t capacity, SessionCache const& sessions,
+                size_t num_shards = 16);
+
+    // The cache key of a request, or an empty string if its result must
+    // not be cached.
+    std::string key(params_t const& params);
+
+    // the cached result for /key/, if there is one
+    bool get(std::string const& key, params_t& result);
+
+    void put(std::string const& key, params_t const& result);
+
+    // counts and hit rate, for the "cache_stats" method
+    params_t stats() const;
+  };
+}
@@ -10,12 +10,21 @@ namespace MosesServer
       m_updater(new Updater),
       m_optimizer(new Optimizer),
       m_translator(new Translator(*this)),
-      m_close_session(new CloseSession(*this))
+      m_batch_translator(new BatchTranslator
+                         (dynamic_cast<Translator&>(*m_translator.get()))),
+      m_close_session(new CloseSession(*this)),
+      m_cache_stats(new CacheStats
+                    (dynamic_cast<Translator&>(*m_translator.get()).cache())),
+      m_load_stats(new LoadStats
+                   (dynamic_cast<Translator&>(*m_translator.get())))
   {
     m_registry.addMethod("translate", m_translator);
+    m_registry.addMethod("translate_batch", m_batch_translator);
     m_registry.addMethod("updater",   m_updater);
     m_registry.addMethod("optimize",  m_optimizer);
     m_registry.addMethod("close_session", m_close_session);
+    m_registry.addMethod("cache_stats", m_cache_stats);
+    m_registry.addMethod("load_stats", m_load_stats);
   }
 
   Server::
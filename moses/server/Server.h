@@ -11,9 +11,12 @@
 #include <xmlrpc-c/registry.hpp>
 #include <xmlrpc-c/server_abyss.hpp>
 #include "Translator.h"
+#include "BatchTranslator.h"
 #include "Optimizer.h"
 #include "Updater.h"
 #include "CloseSession.h"
+#include "CacheStats.h"
+#include "LoadStats.h"
 #include "Session.h"
 #include "moses/parameters/ServerOptions.h"
 #include <string>
@@ -28,7 +31,10 @@ namespace MosesServer
     xmlrpc_c::methodPtr const m_updater;
     xmlrpc_c::methodPtr const m_optimizer;
     xmlrpc_c::methodPtr const m_translator;
+    xmlrpc_c::methodPtr const m_batch_translator;
     xmlrpc_c::methodPtr const m_close_session;
+    xmlrpc_c::methodPtr const m_cache_stats;
+    xmlrpc_c::methodPtr const m_load_stats;
     std::string m_pidfile;
   public:
     Server(Moses::Parameter& params);
@@ -42,5 +48,7 @@ namespace MosesServer
     Session const& 
     get_session(uint64_t session_id);
 
+    SessionCache& sessions() { return m_session_cache; }
+
   };
 }
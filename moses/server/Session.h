@@ -19,11 +19,13 @@ namespace MosesServer{
     time_t last_access;
     boost::shared_ptr<Moses::ContextScope> const scope; // stores local info
     SPTR<std::map<std::string,float> > m_context_weights;
+    size_t epoch; // bumped whenever a request changes the scope
 
     
     Session(uint64_t const session_id) 
       : id(session_id)
       , scope(new Moses::ContextScope) 
+      , epoch(0)
     { 
       last_access = start_time = time(NULL); 
     }
@@ -68,6 +70,25 @@ namespace MosesServer{
       m_cache.erase(id);
     }
 
+    // The epoch of session /id/; false if there is no such session.
+    bool
+    epoch(uint64_t const id, size_t& ret) const
+    {
+      boost::shared_lock<boost::shared_mutex> lock(m_lock);
+      boost::unordered_map<uint64_t, Session>::const_iterator m = m_cache.find(id);
+      if (m == m_cache.end()) return false;
+      ret = m->second.epoch;
+      return true;
+    }
+
+    void
+    bump_epoch(uint64_t const id)
+    {
+      boost::unique_lock<boost::shared_mutex> lock(m_lock);
+      boost::unordered_map<uint64_t, Session>::iterator m = m_cache.find(id);
+      if (m != m_cache.end()) ++m->second.epoch;
+    }
+
 
   };
 
@@ -1,5 +1,6 @@
 #include "TranslationRequest.h"
 #include "PackScores.h"
+#include "AdmissionControl.h"
 #include "moses/ContextScope.h"
 #include <boost/foreach.hpp>
 #include "moses/Util.h"
@@ -32,9 +33,18 @@ boost::shared_ptr<TranslationRequest>
 TranslationRequest::
 create(Translator* translator, xmlrpc_c::paramList const& paramList,
        boost::condition_variable& cond, boost::mutex& mut)
+{
+  paramList.verifyEnd(1); // ??? UG
+  return create(translator, paramList.getStruct(0), cond, mut);
+}
+
+boost::shared_ptr<TranslationRequest>
+TranslationRequest::
+create(Translator* translator, params_t const& params,
+       boost::condition_variable& cond, boost::mutex& mut)
 {
   boost::shared_ptr<TranslationRequest> ret;
-  ret.reset(new TranslationRequest(paramList, cond, mut));
+  ret.reset(new TranslationRequest(params, cond, mut));
   ret->m_self = ret;
   ret->m_translator = translator;
   return ret;
@@ -54,16 +64,51 @@ SetContextWeights(Moses::ContextScope& s, xmlrpc_c::value const& w)
 void
 TranslationRequest::
 Run()
+{
+  if (!m_deadline.is_not_a_date_time()
+      && boost::posix_time::microsec_clock::universal_time() >= m_deadline)
+    {
+      m_expired = true;
+      m_translator->admission().expired();
+    }
+  else decode();
+
+  m_slot.reset();
+  {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_done = true;
+  }
+  // several requests of a batch may share the condition
+  m_cond.notify_all();
+}
+
+void
+TranslationRequest::
+SetAdmission(size_t const level, size_t const deadline)
+{
+  m_degradation = level;
+  if (deadline)
+    m_deadline = (boost::posix_time::microsec_clock::universal_time()
+                  + boost::posix_time::milliseconds(deadline));
+}
+
+void
+TranslationRequest::
+decode()
 {
   typedef std::map<std::string,xmlrpc_c::value> param_t;
-  param_t const& params = m_paramList.getStruct(0);
+  param_t const& params = m_params;
   parse_request(params);
   // cerr << "SESSION ID" << ret->m_session_id << endl;
 
 
   // settings within the session scope
   param_t::const_iterator si = params.find("context-weights");
-  if (si != params.end()) SetContextWeights(*m_scope, si->second);
+  if (si != params.end()) 
+    {
+      SetContextWeights(*m_scope, si->second);
+      if (m_session_id) m_translator->session_changed(m_session_id);
+    }
   
   Moses::StaticData const& SD = Moses::StaticData::Instance();
 
@@ -71,13 +116,6 @@ Run()
     run_chart_decoder();
   else
     run_phrase_decoder();
-
-  {
-    boost::lock_guard<boost::mutex> lock(m_mutex);
-    m_done = true;
-  }
-  m_cond.notify_one();
-
 }
 
 /// add phrase alignment information from a Hypothesis
@@ -225,9 +263,10 @@ insertTranslationOptions(Moses::Manager& manager,
 }
 
 TranslationRequest::
-TranslationRequest(xmlrpc_c::paramList const& paramList,
+TranslationRequest(params_t const& params,
                    boost::condition_variable& cond, boost::mutex& mut)
-  : m_cond(cond), m_mutex(mut), m_done(false), m_paramList(paramList)
+  : m_cond(cond), m_mutex(mut), m_done(false), m_params(params)
+  , m_degradation(0), m_expired(false)
   , m_session_id(0)
 { 
 
@@ -253,8 +292,6 @@ TranslationRequest::
 parse_request(std::map<std::string, xmlrpc_c::value> const& params)
 {
   // parse XMLRPC request
-  m_paramList.verifyEnd(1); // ??? UG
-
   typedef std::map<std::string, xmlrpc_c::value> params_t;
   params_t::const_iterator si;
 
@@ -274,6 +311,15 @@ parse_request(std::map<std::string, xmlrpc_c::value> const& params)
 
   boost::shared_ptr<Moses::AllOptions> opts(new Moses::AllOptions(*StaticData::Instance().options()));
   opts->update(params);
+  if (m_degradation) AdmissionControl::degrade(*opts, m_degradation);
+  if (!m_deadline.is_not_a_date_time())
+    {
+      boost::posix_time::time_duration const left
+        = m_deadline - boost::posix_time::microsec_clock::universal_time();
+      int const secs = std::max(1L, long(left.total_milliseconds() + 999) / 1000);
+      if (opts->search.segment_timeout <= 0 || secs < opts->search.segment_timeout)
+        opts->search.segment_timeout = secs;
+    }
 
   m_withGraphInfo = check(params, "sg");
   if (m_withGraphInfo || opts->nbest.nbest_size > 0) {
@@ -306,7 +352,7 @@ parse_request(std::map<std::string, xmlrpc_c::value> const& params)
 	  string const model_name = xmlrpc_c::value_string(si->second);
 	  PhraseDictionaryMultiModel* pdmm
 	    = (PhraseDictionaryMultiModel*) FindPhraseDictionary(model_name);
-	  pdmm->SetTemporaryMultiModelWeightsVector(w);
+	  pdmm->SetTemporaryMultiModelWeightsVector(self(), w);
 	}
     }
   
@@ -354,6 +400,7 @@ parse_request(std::map<std::string, xmlrpc_c::value> const& params)
 	value->replace(value->begin(), value->end(), record[1]);
 
       }
+      if (m_session_id) m_translator->session_changed(m_session_id);
     }
 
   si = params.find("weights");
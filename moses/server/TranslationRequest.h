@@ -19,20 +19,28 @@
 #include "moses/TreeInput.h"
 #include "moses/TranslationTask.h"
 #include <boost/shared_ptr.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <xmlrpc-c/base.hpp>
 
 #include "Translator.h"
+#include "ClientLimiter.h"
 
 namespace MosesServer
 {
 class
 TranslationRequest : public virtual Moses::TranslationTask
 {
+  typedef std::map<std::string, xmlrpc_c::value> params_t;
+
   boost::condition_variable& m_cond;
   boost::mutex& m_mutex;
   bool m_done;
 
-  xmlrpc_c::paramList const& m_paramList;
+  params_t const m_params;
+  boost::shared_ptr<ClientLimiter::Slot> m_slot; // released when done
+  size_t m_degradation; // see AdmissionControl::degrade()
+  boost::posix_time::ptime m_deadline; // not_a_date_time: none
+  bool m_expired;       // deadline passed before decoding started
   std::map<std::string, xmlrpc_c::value> m_retData;
   std::map<uint32_t,float> m_bias; // for biased sampling
 
@@ -46,10 +54,10 @@ TranslationRequest : public virtual Moses::TranslationTask
   uint64_t m_session_id; // 0 means none, 1 means new
 
   void
-  parse_request();
+  parse_request(std::map<std::string, xmlrpc_c::value> const& req);
 
   void
-  parse_request(std::map<std::string, xmlrpc_c::value> const& req);
+  decode();
 
   virtual void
   run_chart_decoder();
@@ -90,7 +98,7 @@ TranslationRequest : public virtual Moses::TranslationTask
   insertTranslationOptions(Moses::Manager& manager,
                            std::map<std::string, xmlrpc_c::value>& retData);
 protected:
-  TranslationRequest(xmlrpc_c::paramList const& paramList,
+  TranslationRequest(params_t const& params,
                      boost::condition_variable& cond,
                      boost::mutex& mut);
 
@@ -103,6 +111,31 @@ public:
          boost::condition_variable& cond,
          boost::mutex& mut);
 
+  // one request of a batch, or a request already taken apart
+  static
+  boost::shared_ptr<TranslationRequest>
+  create(Translator* translator,
+         std::map<std::string, xmlrpc_c::value> const& params,
+         boost::condition_variable& cond,
+         boost::mutex& mut);
+
+  // the client quota taken by this request, given back when it is done
+  void
+  SetSlot(boost::shared_ptr<ClientLimiter::Slot> const& slot) {
+    m_slot = slot;
+  }
+
+  // Decode with reduced search effort (/level/ > 0) and give up if
+  // decoding cannot start within /deadline/ ms (0: no deadline). Decoding
+  // itself is cut short at the deadline, rounded up to full seconds.
+  void
+  SetAdmission(size_t level, size_t deadline);
+
+  bool
+  IsExpired() const {
+    return m_expired;
+  }
+
 
   virtual bool
   DeleteAfterExecution() {
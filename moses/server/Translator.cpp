@@ -3,6 +3,9 @@
 #include "Translator.h"
 #include "TranslationRequest.h"
 #include "Server.h"
+#include <xmlrpc-c/abyss.h>
+#include <sys/socket.h>
+#include <netdb.h>
 
 namespace MosesServer
 {
@@ -13,7 +16,10 @@ using namespace Moses;
 Translator::
 Translator(Server& server)
   : m_server(server),
-    m_threadPool(server.options().numThreads)
+    m_threadPool(server.options().numThreads),
+    m_limiter(server.options().clientConcurrency),
+    m_cache(server.options().cacheSize, server.sessions()),
+    m_admission(server.options())
 {
   // signature and help strings are documentation -- the client
   // can query this information with a system.methodSignature and
@@ -25,19 +31,81 @@ Translator(Server& server)
 void
 Translator::
 execute(xmlrpc_c::paramList const& paramList,
+        xmlrpc_c::callInfo const* const callInfoP,
         xmlrpc_c::value *   const  retvalP)
 {
+  paramList.verifyEnd(1);
+  ResultCache::params_t const params = paramList.getStruct(0);
+  string const key = m_cache.key(params);
+  ResultCache::params_t result;
+  if (m_cache.get(key, result))
+    {
+      *retvalP = xmlrpc_c::value_struct(result);
+      return;
+    }
+
+  // a malformed deadline must not count as an admitted request
+  size_t const deadline = m_admission.deadline(params);
+  vector<boost::shared_ptr<ClientLimiter::Slot> > const slots
+    = acquire(client_id(callInfoP));
+  size_t const level = m_admission.admit(queue_depth());
   boost::condition_variable cond;
   boost::mutex mut;
   boost::shared_ptr<TranslationRequest> task;
-  task = TranslationRequest::create(this, paramList,cond,mut);
-  m_threadPool.Submit(task);
+  task = TranslationRequest::create(this, params, cond, mut);
+  task->SetAdmission(level, deadline);
+  submit(task, slots[0]);
   boost::unique_lock<boost::mutex> lock(mut);
   while (!task->IsDone())
     cond.wait(lock);
+  if (task->IsExpired())
+    throw xmlrpc_c::fault("Deadline exceeded", xmlrpc_c::fault::CODE_TIMEOUT);
+  // results of a degraded search are not worth keeping
+  if (!level) m_cache.put(key, task->GetRetData());
   *retvalP = xmlrpc_c::value_struct(task->GetRetData());
 }
 
+vector<boost::shared_ptr<ClientLimiter::Slot> >
+Translator::
+acquire(std::string const& client, size_t const n)
+{
+  vector<boost::shared_ptr<ClientLimiter::Slot> > ret;
+  ret = m_limiter.acquire(client, n);
+  if (ret.size() < n)
+    throw xmlrpc_c::fault("Too many requests in flight for client " + client,
+                          xmlrpc_c::fault::CODE_LIMIT_EXCEEDED);
+  return ret;
+}
+
+void
+Translator::
+submit(boost::shared_ptr<TranslationRequest> const& task,
+       boost::shared_ptr<ClientLimiter::Slot> const& slot)
+{
+  task->SetSlot(slot);
+  m_threadPool.Submit(task);
+}
+
+std::string
+Translator::
+client_id(xmlrpc_c::callInfo const* const callInfoP)
+{
+  xmlrpc_c::callInfo_serverAbyss const* info;
+  info = dynamic_cast<xmlrpc_c::callInfo_serverAbyss const*>(callInfoP);
+  void* chanInfoP = NULL;
+  if (info && info->abyssSessionP)
+    SessionGetChannelInfo(info->abyssSessionP, &chanInfoP);
+  if (!chanInfoP) return "unknown";
+
+  struct abyss_unix_chaninfo const* chan;
+  chan = static_cast<struct abyss_unix_chaninfo const*>(chanInfoP);
+  char host[NI_MAXHOST];
+  if (getnameinfo(&chan->peerAddr, chan->peerAddrLen, host, sizeof(host),
+                  NULL, 0, NI_NUMERICHOST))
+    return "unknown";
+  return host;
+}
+
 Session const& 
 Translator::
 get_session(uint64_t const id)
@@ -45,4 +113,11 @@ get_session(uint64_t const id)
   return m_server.get_session(id);
 }
 
+void
+Translator::
+session_changed(uint64_t const id)
+{
+  m_server.sessions().bump_epoch(id);
+}
+
 }
@@ -3,6 +3,9 @@
 
 #include "moses/parameters/ServerOptions.h"
 #include "Session.h"
+#include "ClientLimiter.h"
+#include "ResultCache.h"
+#include "AdmissionControl.h"
 #include <xmlrpc-c/base.hpp>
 #include <xmlrpc-c/registry.hpp>
 #include <xmlrpc-c/server_abyss.hpp>
@@ -15,9 +18,10 @@ namespace MosesServer
 {
 
   class Server;
+  class TranslationRequest;
 
   class
-  Translator : public xmlrpc_c::method
+  Translator : public xmlrpc_c::method2
   {
     Server& m_server;
     // Moses::ServerOptions m_server_options;
@@ -25,11 +29,37 @@ namespace MosesServer
     Translator(Server& server);
     
     void execute(xmlrpc_c::paramList const& paramList,
+                 xmlrpc_c::callInfo const* const callInfoP,
 		 xmlrpc_c::value *   const  retvalP);
     
     Session const& get_session(uint64_t session_id);
+
+    // Called after a request has changed the scope of a persistent
+    // session, so that cached results for the session are not reused.
+    void session_changed(uint64_t session_id);
+
+    // Claims the client quota of /n/ requests; throws CODE_LIMIT_EXCEEDED
+    // if the client would have too many requests in flight.
+    std::vector<boost::shared_ptr<ClientLimiter::Slot> >
+    acquire(std::string const& client, size_t n = 1);
+
+    // Queues /task/ for decoding, holding /slot/ until it is done.
+    void submit(boost::shared_ptr<TranslationRequest> const& task,
+                boost::shared_ptr<ClientLimiter::Slot> const& slot);
+
+    // the client's IP address, or "unknown"
+    static std::string client_id(xmlrpc_c::callInfo const* callInfoP);
+
+    ResultCache& cache() { return m_cache; }
+    AdmissionControl& admission() { return m_admission; }
+
+    // requests waiting for a decoder thread
+    size_t queue_depth() { return m_threadPool.GetQueueSize(); }
   private:
     Moses::ThreadPool m_threadPool;
+    ClientLimiter m_limiter;
+    ResultCache m_cache;
+    AdmissionControl m_admission;
   };
 
 }
@@ -26,6 +26,7 @@ execute(xmlrpc_c::paramList const& paramList,
   breakOutParams(params);
   Mmsapt* pdsa = reinterpret_cast<Mmsapt*>(PhraseDictionary::GetColl()[0]);
   pdsa->add(m_src, m_trg, m_aln);
+  StaticData::Instance().BumpModelEpoch();
   XVERBOSE(1,"Done inserting\n");
   *retvalP = xmlrpc_c::value_string("Phrase table updated");
 #endif
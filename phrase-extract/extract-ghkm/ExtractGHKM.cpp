@@ -29,10 +29,15 @@
 #include <vector>
 
 #include <boost/program_options.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include "syntax-common/exception.h"
 #include "syntax-common/xml_tree_parser.h"
 
+#ifdef WITH_THREADS
+#include "moses/ThreadPool.h"
+#endif
+
 #include "InputFileStream.h"
 #include "OutputFileStream.h"
 #include "SyntaxNode.h"
@@ -60,6 +65,35 @@ namespace Syntax
 namespace GHKM
 {
 
+#ifdef WITH_THREADS
+// Extracts the rules of one sentence pair on a worker thread.
+class ExtractTask : public Moses::Task
+{
+public:
+  ExtractTask(ExtractGHKM &tool, size_t lineNum,
+              const std::string &targetLine, const std::string &sourceLine,
+              const std::string &alignmentLine, const Options &options,
+              ExtractGHKM::SentenceResult &result)
+    : m_tool(tool), m_lineNum(lineNum), m_targetLine(targetLine),
+      m_sourceLine(sourceLine), m_alignmentLine(alignmentLine),
+      m_options(options), m_result(result) {}
+
+  void Run() {
+    m_tool.ExtractSentence(m_lineNum, m_targetLine, m_sourceLine,
+                           m_alignmentLine, m_options, m_result);
+  }
+
+private:
+  ExtractGHKM &m_tool;
+  size_t m_lineNum;
+  const std::string &m_targetLine;
+  const std::string &m_sourceLine;
+  const std::string &m_alignmentLine;
+  const Options &m_options;
+  ExtractGHKM::SentenceResult &m_result;
+};
+#endif
+
 int ExtractGHKM::Main(int argc, char *argv[])
 {
   using Moses::InputFileStream;
@@ -129,173 +163,83 @@ int ExtractGHKM::Main(int argc, char *argv[])
   std::map<std::string, int> sourceWordCount;
   std::map<std::string, std::string> sourceWordLabel;
 
-  std::string targetLine;
-  std::string sourceLine;
-  std::string alignmentLine;
-  Alignment alignment;
-  XmlTreeParser targetXmlTreeParser;
-  XmlTreeParser sourceXmlTreeParser;
-  ScfgRuleWriter scfgWriter(fwdExtractStream, invExtractStream, options);
-  StsgRuleWriter stsgWriter(fwdExtractStream, invExtractStream, options);
+  // Label statistics for the glue grammar, source label set, and unknown word
+  // soft matches.
+  std::set<std::string> targetLabelSet;
+  std::map<std::string, int> targetTopLabelSet;
+  std::set<std::string> sourceLabelSet;
+
+  // Sentences are read in batches.  The sentences of a batch are processed
+  // independently (in parallel if there are multiple threads) and then their
+  // results are merged in corpus order, so the output does not depend on the
+  // number of threads.
+  const size_t batchSize = options.threads > 1 ? 1000 * options.threads : 1;
+  std::vector<std::string> targetLines(batchSize);
+  std::vector<std::string> sourceLines(batchSize);
+  std::vector<std::string> alignmentLines(batchSize);
+  std::vector<SentenceResult> results;
+  PhraseOrientation phraseOrientation;
   size_t lineNum = options.sentenceOffset;
-  while (true) {
-    std::getline(targetStream, targetLine);
-    std::getline(sourceStream, sourceLine);
-    std::getline(alignmentStream, alignmentLine);
-
-    if (targetStream.eof() && sourceStream.eof() && alignmentStream.eof()) {
-      break;
-    }
-
-    if (targetStream.eof() || sourceStream.eof() || alignmentStream.eof()) {
-      Error("Files must contain same number of lines");
-    }
-
-    ++lineNum;
-
-    // Parse target tree.
-    if (targetLine.size() == 0) {
-      std::cerr << "skipping line " << lineNum << " with empty target tree\n";
-      continue;
-    }
-    std::auto_ptr<SyntaxTree> targetParseTree;
-    try {
-      targetParseTree = targetXmlTreeParser.Parse(targetLine);
-      assert(targetParseTree.get());
-    } catch (const Exception &e) {
-      std::ostringstream oss;
-      oss << "Failed to parse target XML tree at line " << lineNum;
-      if (!e.msg().empty()) {
-        oss << ": " << e.msg();
+  bool eof = false;
+  while (!eof) {
+    size_t count = 0;
+    while (count < batchSize) {
+      std::getline(targetStream, targetLines[count]);
+      std::getline(sourceStream, sourceLines[count]);
+      std::getline(alignmentStream, alignmentLines[count]);
+
+      if (targetStream.eof() && sourceStream.eof() && alignmentStream.eof()) {
+        eof = true;
+        break;
       }
-      Error(oss.str());
-    }
 
-    // Read source tokens (and parse tree if using source labels).
-    std::vector<std::string> sourceTokens;
-    std::auto_ptr<SyntaxTree> sourceParseTree;
-    if (!options.sourceLabels) {
-      sourceTokens = ReadTokens(sourceLine);
-    } else {
-      try {
-        sourceParseTree = sourceXmlTreeParser.Parse(sourceLine);
-        assert(sourceParseTree.get());
-      } catch (const Exception &e) {
-        std::ostringstream oss;
-        oss << "Failed to parse source XML tree at line " << lineNum;
-        if (!e.msg().empty()) {
-          oss << ": " << e.msg();
-        }
-        Error(oss.str());
+      if (targetStream.eof() || sourceStream.eof() || alignmentStream.eof()) {
+        Error("Files must contain same number of lines");
       }
-      sourceTokens = sourceXmlTreeParser.words();
-    }
 
-    // Read word alignments.
-    try {
-      ReadAlignment(alignmentLine, alignment);
-    } catch (const Exception &e) {
-      std::ostringstream oss;
-      oss << "Failed to read alignment at line " << lineNum << ": ";
-      oss << e.msg();
-      Error(oss.str());
-    }
-    if (alignment.size() == 0) {
-      std::cerr << "skipping line " << lineNum << " without alignment points\n";
-      continue;
-    }
-    if (options.t2s) {
-      FlipAlignment(alignment);
+      ++count;
     }
 
-    // Record word counts.
-    if (!options.targetUnknownWordFile.empty()) {
-      CollectWordLabelCounts(*targetParseTree, options, targetWordCount,
-                             targetWordLabel);
-    }
-
-    // Record word counts: source side.
-    if (options.sourceLabels && !options.sourceUnknownWordFile.empty()) {
-      CollectWordLabelCounts(*sourceParseTree, options, sourceWordCount,
-                             sourceWordLabel);
-    }
-
-    // Form an alignment graph from the target tree, source words, and
-    // alignment.
-    AlignmentGraph graph(targetParseTree.get(), sourceTokens, alignment);
-
-    // Extract minimal rules, adding each rule to its root node's rule set.
-    graph.ExtractMinimalRules(options);
-
-    // Extract composed rules.
-    if (!options.minimal) {
-      graph.ExtractComposedRules(options);
+    results.clear();
+    results.resize(count);
+#ifdef WITH_THREADS
+    if (options.threads > 1) {
+      Moses::ThreadPool pool(options.threads);
+      for (size_t i = 0; i < count; ++i) {
+        pool.Submit(boost::shared_ptr<Moses::Task>(new ExtractTask(
+                      *this, lineNum+i+1, targetLines[i], sourceLines[i],
+                      alignmentLines[i], options, results[i])));
+      }
+      pool.Stop(true);
+    } else
+#endif
+    {
+      for (size_t i = 0; i < count; ++i) {
+        ExtractSentence(lineNum+i+1, targetLines[i], sourceLines[i],
+                        alignmentLines[i], options, results[i]);
+      }
     }
-
-    // Initialize phrase orientation scoring object
-    PhraseOrientation phraseOrientation(sourceTokens.size(),
-                                        targetXmlTreeParser.words().size(), alignment);
-
-    // Write the rules, subject to scope pruning.
-    const std::vector<Node *> &targetNodes = graph.GetTargetNodes();
-    for (std::vector<Node *>::const_iterator p = targetNodes.begin();
-         p != targetNodes.end(); ++p) {
-
-      const std::vector<const Subgraph *> &rules = (*p)->GetRules();
-
-      PhraseOrientation::REO_CLASS l2rOrientation=PhraseOrientation::REO_CLASS_UNKNOWN, r2lOrientation=PhraseOrientation::REO_CLASS_UNKNOWN;
-      if (options.phraseOrientation && !rules.empty()) {
-        int sourceSpanBegin = *((*p)->GetSpan().begin());
-        int sourceSpanEnd   = *((*p)->GetSpan().rbegin());
-        l2rOrientation = phraseOrientation.GetOrientationInfo(sourceSpanBegin,sourceSpanEnd,PhraseOrientation::REO_DIR_L2R);
-        r2lOrientation = phraseOrientation.GetOrientationInfo(sourceSpanBegin,sourceSpanEnd,PhraseOrientation::REO_DIR_R2L);
-        // std::cerr << "span " << sourceSpanBegin << " " << sourceSpanEnd << std::endl;
-        // std::cerr << "phraseOrientation " << phraseOrientation.GetOrientationInfo(sourceSpanBegin,sourceSpanEnd) << std::endl;
+    lineNum += count;
+
+    // Write the rules and merge the statistics, in corpus order.
+    for (std::vector<SentenceResult>::const_iterator p = results.begin();
+         p != results.end(); ++p) {
+      std::cerr << p->log;
+      fwdExtractStream << p->fwd;
+      invExtractStream << p->inv;
+      MergeWordLabelCounts(p->targetWordCount, p->targetWordLabel,
+                           targetWordCount, targetWordLabel);
+      MergeWordLabelCounts(p->sourceWordCount, p->sourceWordLabel,
+                           sourceWordCount, sourceWordLabel);
+      targetLabelSet.insert(p->targetLabelSet.begin(), p->targetLabelSet.end());
+      for (std::map<std::string, int>::const_iterator q =
+             p->targetTopLabelSet.begin(); q != p->targetTopLabelSet.end(); ++q) {
+        targetTopLabelSet[q->first] += q->second;
       }
-
-      for (std::vector<const Subgraph *>::const_iterator q = rules.begin();
-           q != rules.end(); ++q) {
-        // STSG output.
-        if (options.stsg) {
-          StsgRule rule(**q);
-          if (rule.Scope() <= options.maxScope) {
-            stsgWriter.Write(rule);
-          }
-          continue;
-        }
-        // SCFG output.
-        ScfgRule *r = 0;
-        if (options.sourceLabels) {
-          r = new ScfgRule(**q, &sourceXmlTreeParser.node_collection());
-        } else {
-          r = new ScfgRule(**q);
-        }
-        // TODO Can scope pruning be done earlier?
-        if (r->Scope() <= options.maxScope) {
-          scfgWriter.Write(*r,lineNum,false);
-          if (options.treeFragments) {
-            fwdExtractStream << " {{Tree ";
-            (*q)->PrintTree(fwdExtractStream);
-            fwdExtractStream << "}}";
-          }
-          if (options.partsOfSpeech) {
-            fwdExtractStream << " {{POS";
-            (*q)->PrintPartsOfSpeech(fwdExtractStream);
-            fwdExtractStream << "}}";
-          }
-          if (options.phraseOrientation) {
-            fwdExtractStream << " {{Orientation ";
-            phraseOrientation.WriteOrientation(fwdExtractStream,l2rOrientation);
-            fwdExtractStream << " ";
-            phraseOrientation.WriteOrientation(fwdExtractStream,r2lOrientation);
-            fwdExtractStream << "}}";
-            phraseOrientation.IncrementPriorCount(PhraseOrientation::REO_DIR_L2R,l2rOrientation,1);
-            phraseOrientation.IncrementPriorCount(PhraseOrientation::REO_DIR_R2L,r2lOrientation,1);
-          }
-          fwdExtractStream << std::endl;
-          invExtractStream << std::endl;
-        }
-        delete r;
+      sourceLabelSet.insert(p->sourceLabelSet.begin(), p->sourceLabelSet.end());
+      for (size_t i = 0; i < p->orientations.size(); ++i) {
+        phraseOrientation.IncrementPriorCount(PhraseOrientation::REO_DIR_L2R,p->orientations[i].first,1);
+        phraseOrientation.IncrementPriorCount(PhraseOrientation::REO_DIR_R2L,p->orientations[i].second,1);
       }
     }
   }
@@ -309,7 +253,7 @@ int ExtractGHKM::Main(int argc, char *argv[])
 
   std::map<std::string,size_t> sourceLabels;
   if (options.sourceLabels && !options.sourceLabelSetFile.empty()) {
-    std::set<std::string> extendedLabelSet = sourceXmlTreeParser.label_set();
+    std::set<std::string> extendedLabelSet = sourceLabelSet;
     extendedLabelSet.insert("XLHS"); // non-matching label (left-hand side)
     extendedLabelSet.insert("XRHS"); // non-matching label (right-hand side)
     extendedLabelSet.insert("TOPLABEL");  // as used in the glue grammar
@@ -326,8 +270,7 @@ int ExtractGHKM::Main(int argc, char *argv[])
   std::map<std::string, int> strippedTargetTopLabelSet;
   if (options.stripBitParLabels &&
       (!options.glueGrammarFile.empty() || !options.unknownWordSoftMatchesFile.empty())) {
-    StripBitParLabels(targetXmlTreeParser.label_set(),
-                      targetXmlTreeParser.top_label_set(),
+    StripBitParLabels(targetLabelSet, targetTopLabelSet,
                       strippedTargetLabelSet, strippedTargetTopLabelSet);
   }
 
@@ -335,9 +278,7 @@ int ExtractGHKM::Main(int argc, char *argv[])
     if (options.stripBitParLabels) {
       WriteGlueGrammar(strippedTargetLabelSet, strippedTargetTopLabelSet, sourceLabels, options, glueGrammarStream);
     } else {
-      WriteGlueGrammar(targetXmlTreeParser.label_set(),
-                       targetXmlTreeParser.top_label_set(),
-                       sourceLabels, options, glueGrammarStream);
+      WriteGlueGrammar(targetLabelSet, targetTopLabelSet, sourceLabels, options, glueGrammarStream);
     }
   }
 
@@ -353,14 +294,186 @@ int ExtractGHKM::Main(int argc, char *argv[])
     if (options.stripBitParLabels) {
       WriteUnknownWordSoftMatches(strippedTargetLabelSet, unknownWordSoftMatchesStream);
     } else {
-      WriteUnknownWordSoftMatches(targetXmlTreeParser.label_set(),
-                                  unknownWordSoftMatchesStream);
+      WriteUnknownWordSoftMatches(targetLabelSet, unknownWordSoftMatchesStream);
     }
   }
 
   return 0;
 }
 
+void ExtractGHKM::ExtractSentence(size_t lineNum,
+                                  const std::string &targetLine,
+                                  const std::string &sourceLine,
+                                  const std::string &alignmentLine,
+                                  const Options &options,
+                                  SentenceResult &result)
+{
+  XmlTreeParser targetXmlTreeParser;
+  XmlTreeParser sourceXmlTreeParser;
+  Alignment alignment;
+
+  // Parse target tree.
+  if (targetLine.size() == 0) {
+    std::ostringstream log;
+    log << "skipping line " << lineNum << " with empty target tree\n";
+    result.log = log.str();
+    return;
+  }
+  std::auto_ptr<SyntaxTree> targetParseTree;
+  try {
+    targetParseTree = targetXmlTreeParser.Parse(targetLine);
+    assert(targetParseTree.get());
+  } catch (const Exception &e) {
+    std::ostringstream oss;
+    oss << "Failed to parse target XML tree at line " << lineNum;
+    if (!e.msg().empty()) {
+      oss << ": " << e.msg();
+    }
+    Error(oss.str());
+  }
+  result.targetLabelSet = targetXmlTreeParser.label_set();
+  result.targetTopLabelSet = targetXmlTreeParser.top_label_set();
+
+  // Read source tokens (and parse tree if using source labels).
+  std::vector<std::string> sourceTokens;
+  std::auto_ptr<SyntaxTree> sourceParseTree;
+  if (!options.sourceLabels) {
+    sourceTokens = ReadTokens(sourceLine);
+  } else {
+    try {
+      sourceParseTree = sourceXmlTreeParser.Parse(sourceLine);
+      assert(sourceParseTree.get());
+    } catch (const Exception &e) {
+      std::ostringstream oss;
+      oss << "Failed to parse source XML tree at line " << lineNum;
+      if (!e.msg().empty()) {
+        oss << ": " << e.msg();
+      }
+      Error(oss.str());
+    }
+    sourceTokens = sourceXmlTreeParser.words();
+    result.sourceLabelSet = sourceXmlTreeParser.label_set();
+  }
+
+  // Read word alignments.
+  try {
+    ReadAlignment(alignmentLine, alignment);
+  } catch (const Exception &e) {
+    std::ostringstream oss;
+    oss << "Failed to read alignment at line " << lineNum << ": ";
+    oss << e.msg();
+    Error(oss.str());
+  }
+  if (alignment.size() == 0) {
+    std::ostringstream log;
+    log << "skipping line " << lineNum << " without alignment points\n";
+    result.log = log.str();
+    return;
+  }
+  if (options.t2s) {
+    FlipAlignment(alignment);
+  }
+
+  // Record word counts.
+  if (!options.targetUnknownWordFile.empty()) {
+    CollectWordLabelCounts(*targetParseTree, options, result.targetWordCount,
+                           result.targetWordLabel);
+  }
+
+  // Record word counts: source side.
+  if (options.sourceLabels && !options.sourceUnknownWordFile.empty()) {
+    CollectWordLabelCounts(*sourceParseTree, options, result.sourceWordCount,
+                           result.sourceWordLabel);
+  }
+
+  // Form an alignment graph from the target tree, source words, and
+  // alignment.
+  AlignmentGraph graph(targetParseTree.get(), sourceTokens, alignment);
+
+  // Extract minimal rules, adding each rule to its root node's rule set.
+  graph.ExtractMinimalRules(options);
+
+  // Extract composed rules.
+  if (!options.minimal) {
+    graph.ExtractComposedRules(options);
+  }
+
+  // Initialize phrase orientation scoring object
+  PhraseOrientation phraseOrientation(sourceTokens.size(),
+                                      targetXmlTreeParser.words().size(), alignment);
+
+  // Write the rules, subject to scope pruning.
+  std::ostringstream fwdExtractStream;
+  std::ostringstream invExtractStream;
+  ScfgRuleWriter scfgWriter(fwdExtractStream, invExtractStream, options);
+  StsgRuleWriter stsgWriter(fwdExtractStream, invExtractStream, options);
+  const std::vector<Node *> &targetNodes = graph.GetTargetNodes();
+  for (std::vector<Node *>::const_iterator p = targetNodes.begin();
+       p != targetNodes.end(); ++p) {
+
+    const std::vector<const Subgraph *> &rules = (*p)->GetRules();
+
+    PhraseOrientation::REO_CLASS l2rOrientation=PhraseOrientation::REO_CLASS_UNKNOWN, r2lOrientation=PhraseOrientation::REO_CLASS_UNKNOWN;
+    if (options.phraseOrientation && !rules.empty()) {
+      int sourceSpanBegin = *((*p)->GetSpan().begin());
+      int sourceSpanEnd   = *((*p)->GetSpan().rbegin());
+      l2rOrientation = phraseOrientation.GetOrientationInfo(sourceSpanBegin,sourceSpanEnd,PhraseOrientation::REO_DIR_L2R);
+      r2lOrientation = phraseOrientation.GetOrientationInfo(sourceSpanBegin,sourceSpanEnd,PhraseOrientation::REO_DIR_R2L);
+      // std::cerr << "span " << sourceSpanBegin << " " << sourceSpanEnd << std::endl;
+      // std::cerr << "phraseOrientation " << phraseOrientation.GetOrientationInfo(sourceSpanBegin,sourceSpanEnd) << std::endl;
+    }
+
+    for (std::vector<const Subgraph *>::const_iterator q = rules.begin();
+         q != rules.end(); ++q) {
+      // STSG output.
+      if (options.stsg) {
+        StsgRule rule(**q);
+        if (rule.Scope() <= options.maxScope) {
+          stsgWriter.Write(rule);
+        }
+        continue;
+      }
+      // SCFG output.
+      ScfgRule *r = 0;
+      if (options.sourceLabels) {
+        r = new ScfgRule(**q, &sourceXmlTreeParser.node_collection());
+      } else {
+        r = new ScfgRule(**q);
+      }
+      // TODO Can scope pruning be done earlier?
+      if (r->Scope() <= options.maxScope) {
+        scfgWriter.Write(*r,lineNum,false);
+        if (options.treeFragments) {
+          fwdExtractStream << " {{Tree ";
+          (*q)->PrintTree(fwdExtractStream);
+          fwdExtractStream << "}}";
+        }
+        if (options.partsOfSpeech) {
+          fwdExtractStream << " {{POS";
+          (*q)->PrintPartsOfSpeech(fwdExtractStream);
+          fwdExtractStream << "}}";
+        }
+        if (options.phraseOrientation) {
+          fwdExtractStream << " {{Orientation ";
+          phraseOrientation.WriteOrientation(fwdExtractStream,l2rOrientation);
+          fwdExtractStream << " ";
+          phraseOrientation.WriteOrientation(fwdExtractStream,r2lOrientation);
+          fwdExtractStream << "}}";
+          // The prior counts are shared, so they are incremented when the
+          // results are merged.
+          result.orientations.push_back(std::make_pair(l2rOrientation,
+                                                       r2lOrientation));
+        }
+        fwdExtractStream << std::endl;
+        invExtractStream << std::endl;
+      }
+      delete r;
+    }
+  }
+  result.fwd = fwdExtractStream.str();
+  result.inv = invExtractStream.str();
+}
+
 void ExtractGHKM::ProcessOptions(int argc, char *argv[],
                                  Options &options) const
 {
@@ -456,6 +569,9 @@ void ExtractGHKM::ProcessOptions(int argc, char *argv[],
    "output STSG rules (default is SCFG)")
   ("T2S",
    "enable tree-to-string rule extraction (string-to-tree is assumed by default)")
+  ("Threads",
+   po::value(&options.threads)->default_value(options.threads),
+   "extract rules from this many sentences in parallel")
   ("TreeFragments",
    "output parse tree information")
   ("SourceLabels",
@@ -591,6 +707,16 @@ void ExtractGHKM::ProcessOptions(int argc, char *argv[],
     options.unpairedExtractFormat = true;
   }
 
+  if (options.threads < 1) {
+    Error("Threads must be at least 1");
+  }
+#ifndef WITH_THREADS
+  if (options.threads > 1) {
+    std::cerr << "WARNING: compiled without threading support; ignoring Threads option\n";
+    options.threads = 1;
+  }
+#endif
+
   // Workaround for extract-parallel issue.
   if (options.sentenceOffset > 0) {
     options.targetUnknownWordFile.clear();
@@ -791,6 +917,24 @@ void ExtractGHKM::CollectWordLabelCounts(
   }
 }
 
+void ExtractGHKM::MergeWordLabelCounts(
+  const std::map<std::string, int> &sentenceWordCount,
+  const std::map<std::string, std::string> &sentenceWordLabel,
+  std::map<std::string, int> &wordCount,
+  std::map<std::string, std::string> &wordLabel) const
+{
+  // The label of a word is the one it was last seen with, so this must be
+  // called in corpus order.
+  for (std::map<std::string, int>::const_iterator p = sentenceWordCount.begin();
+       p != sentenceWordCount.end(); ++p) {
+    wordCount[p->first] += p->second;
+  }
+  for (std::map<std::string, std::string>::const_iterator p =
+         sentenceWordLabel.begin(); p != sentenceWordLabel.end(); ++p) {
+    wordLabel[p->first] = p->second;
+  }
+}
+
 std::vector<std::string> ExtractGHKM::ReadTokens(const SyntaxTree &root) const
 {
   std::vector<std::string> tokens;
@@ -26,6 +26,7 @@
 #include <vector>
 
 #include "OutputFileStream.h"
+#include "PhraseOrientation.h"
 #include "SyntaxTree.h"
 
 #include "syntax-common/tool.h"
@@ -47,11 +48,41 @@ public:
   virtual int Main(int argc, char *argv[]);
 
 private:
+  friend class ExtractTask;
+
+  // The rules and statistics extracted from a single sentence pair.  These
+  // are collected per sentence so that sentences can be processed in parallel
+  // and the results merged in corpus order.
+  struct SentenceResult {
+    std::string log;
+    std::string fwd;
+    std::string inv;
+    std::map<std::string, int> targetWordCount;
+    std::map<std::string, std::string> targetWordLabel;
+    std::map<std::string, int> sourceWordCount;
+    std::map<std::string, std::string> sourceWordLabel;
+    std::set<std::string> targetLabelSet;
+    std::map<std::string, int> targetTopLabelSet;
+    std::set<std::string> sourceLabelSet;
+    std::vector<std::pair<PhraseOrientation::REO_CLASS,
+                          PhraseOrientation::REO_CLASS> > orientations;
+  };
+
+  void ExtractSentence(size_t lineNum,
+                       const std::string &targetLine,
+                       const std::string &sourceLine,
+                       const std::string &alignmentLine,
+                       const Options &,
+                       SentenceResult &);
   void RecordTreeLabels(const SyntaxTree &, std::set<std::string> &);
   void CollectWordLabelCounts(SyntaxTree &,
                               const Options &,
                               std::map<std::string, int> &,
                               std::map<std::string, std::string> &);
+  void MergeWordLabelCounts(const std::map<std::string, int> &,
+                            const std::map<std::string, std::string> &,
+                            std::map<std::string, int> &,
+                            std::map<std::string, std::string> &) const;
   void WriteUnknownWordLabel(const std::map<std::string, int> &,
                              const std::map<std::string, std::string> &,
                              const Options &,
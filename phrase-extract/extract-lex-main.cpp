@@ -1,7 +1,18 @@
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
 #include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#include "moses/ThreadPool.h"
+#endif
+
 #include "extract-lex.h"
 #include "InputFileStream.h"
 #include "moses/Util.h"
@@ -9,7 +20,65 @@
 using namespace std;
 using namespace MosesTraining;
 
-float COUNT_INCR = 1;
+namespace
+{
+
+// Sentence pairs are counted in batches of this size, each with a vocabulary
+// of its own, and the batch counts are then added to the totals.  This bounds
+// the memory used per thread.
+const size_t BATCH_SIZE = 10000;
+
+struct Batch {
+  size_t firstLine;
+  vector<string> target, source, align;
+};
+
+void Count(const Batch &batch, ExtractLex &counts)
+{
+  vector<string> toksTarget, toksSource, toksAlign;
+  for (size_t i = 0; i < batch.target.size(); ++i) {
+    toksTarget.clear();
+    toksSource.clear();
+    toksAlign.clear();
+    Moses::Tokenize(toksTarget, batch.target[i]);
+    Moses::Tokenize(toksSource, batch.source[i]);
+    Moses::Tokenize(toksAlign, batch.align[i]);
+
+    /*
+    cerr  << endl
+          << toksTarget.size() << " " << batch.target[i] << endl
+          << toksSource.size() << " " << batch.source[i] << endl
+          << toksAlign.size() << " " << batch.align[i] << endl;
+    */
+
+    counts.Process(toksTarget, toksSource, toksAlign, batch.firstLine + i);
+  }
+}
+
+#ifdef WITH_THREADS
+class CountTask : public Moses::Task
+{
+public:
+  CountTask(boost::shared_ptr<Batch> batch, ExtractLex &totals,
+            boost::mutex &mutex)
+    : m_batch(batch), m_totals(totals), m_mutex(mutex) {}
+
+  void Run() {
+    ExtractLex counts;
+    Count(*m_batch, counts);
+    m_batch.reset();
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_totals.Add(counts);
+  }
+
+private:
+  boost::shared_ptr<Batch> m_batch;
+  ExtractLex &m_totals;
+  boost::mutex &m_mutex;
+};
+#endif
+
+} // namespace
 
 void fix(std::ostream& stream)
 {
@@ -21,13 +90,32 @@ int main(int argc, char* argv[])
 {
   cerr << "Starting...\n";
 
-  assert(argc == 6);
+  if (argc < 6) {
+    cerr << "syntax: extract-lex target source alignment lex.s2t lex.t2s [--threads num]\n";
+    exit(1);
+  }
   char* &filePathTarget = argv[1];
   char* &filePathSource = argv[2];
   char* &filePathAlign  = argv[3];
   char* &filePathLexS2T = argv[4];
   char* &filePathLexT2S = argv[5];
 
+  int threads = 1;
+  for (int i = 6; i < argc; ++i) {
+    if (strcmp(argv[i], "--threads") == 0 && i+1 < argc) {
+      threads = atoi(argv[++i]);
+    } else {
+      cerr << "extract-lex: unknown option " << argv[i] << endl;
+      exit(1);
+    }
+  }
+#ifndef WITH_THREADS
+  if (threads > 1) {
+    cerr << "WARNING: compiled without threading support, using one thread\n";
+    threads = 1;
+  }
+#endif
+
   Moses::InputFileStream streamTarget(filePathTarget);
   Moses::InputFileStream streamSource(filePathSource);
   Moses::InputFileStream streamAlign(filePathAlign);
@@ -42,33 +130,52 @@ int main(int argc, char* argv[])
 
   ExtractLex extractSingleton;
 
-  size_t lineCount = 0;
-  string lineTarget, lineSource, lineAlign;
-  while (getline(streamTarget, lineTarget)) {
-    if (lineCount % 10000 == 0)
-      cerr << lineCount << " ";
-
-    istream &isSource = getline(streamSource, lineSource);
-    assert(isSource);
-    istream &isAlign = getline(streamAlign, lineAlign);
-    assert(isAlign);
-
-    vector<string> toksTarget, toksSource, toksAlign;
-    Moses::Tokenize(toksTarget, lineTarget);
-    Moses::Tokenize(toksSource, lineSource);
-    Moses::Tokenize(toksAlign, lineAlign);
+#ifdef WITH_THREADS
+  boost::mutex mutex;
+  boost::shared_ptr<Moses::ThreadPool> pool;
+  if (threads > 1) {
+    pool.reset(new Moses::ThreadPool(threads));
+    pool->SetQueueLimit(threads);
+  }
+#endif
 
-    /*
-    cerr  << endl
-          << toksTarget.size() << " " << lineTarget << endl
-          << toksSource.size() << " " << lineSource << endl
-          << toksAlign.size() << " " << lineAlign << endl;
-    */
+  size_t lineCount = 0;
+  string lineTarget;
+  while (true) {
+    boost::shared_ptr<Batch> batch(new Batch);
+    batch->firstLine = lineCount;
+    while (batch->target.size() < BATCH_SIZE && getline(streamTarget, lineTarget)) {
+      if (lineCount % 10000 == 0)
+        cerr << lineCount << " ";
+
+      batch->target.push_back(lineTarget);
+      batch->source.push_back(string());
+      batch->align.push_back(string());
+      istream &isSource = getline(streamSource, batch->source.back());
+      assert(isSource);
+      istream &isAlign = getline(streamAlign, batch->align.back());
+      assert(isAlign);
+
+      ++lineCount;
+    }
+    if (batch->target.empty()) {
+      break;
+    }
 
-    extractSingleton.Process(toksTarget, toksSource, toksAlign, lineCount);
+#ifdef WITH_THREADS
+    if (pool) {
+      pool->Submit(boost::shared_ptr<Moses::Task>(new CountTask(batch, extractSingleton, mutex)));
+      continue;
+    }
+#endif
+    Count(*batch, extractSingleton);
+  }
 
-    ++lineCount;
+#ifdef WITH_THREADS
+  if (pool) {
+    pool->Stop(true);
   }
+#endif
 
   extractSingleton.Output(streamLexS2T, streamLexT2S);
 
@@ -84,10 +191,21 @@ int main(int argc, char* argv[])
 namespace MosesTraining
 {
 
-const std::string *Vocab::GetOrAdd(const std::string &word)
+uint32_t Vocab::GetOrAdd(const std::string &word)
+{
+  boost::unordered_map<std::string, uint32_t>::const_iterator iter = m_ids.find(word);
+  if (iter != m_ids.end()) {
+    return iter->second;
+  }
+  uint32_t id = m_words.size();
+  m_ids[word] = id;
+  m_words.push_back(word);
+  return id;
+}
+
+ExtractLex::ExtractLex()
 {
-  const string *ret = &(*m_coll.insert(word).first);
-  return ret;
+  m_null = m_vocab.GetOrAdd("NULL");
 }
 
 void ExtractLex::Process(vector<string> &toksTarget, vector<string> &toksSource, vector<string> &toksAlign, size_t lineCount)
@@ -118,100 +236,119 @@ void ExtractLex::Process(vector<string> &toksTarget, vector<string> &toksSource,
     m_sourceAligned[ alignPos[0] ] = true;
     m_targetAligned[ alignPos[1] ] = true;
 
-    const string &tmpSource = toksSource[ alignPos[0] ];
-    const string &tmpTarget = toksTarget[ alignPos[1] ];
-
-    const string *source = m_vocab.GetOrAdd(tmpSource);
-    const string *target = m_vocab.GetOrAdd(tmpTarget);
+    uint32_t source = m_vocab.GetOrAdd(toksSource[ alignPos[0] ]);
+    uint32_t target = m_vocab.GetOrAdd(toksTarget[ alignPos[1] ]);
 
     Process(target, source);
 
   }
 
-  ProcessUnaligned(toksTarget, toksSource, m_sourceAligned, m_targetAligned);
+  for (size_t pos = 0; pos < m_sourceAligned.size(); ++pos) {
+    if (!m_sourceAligned[pos]) {
+      Process(m_null, m_vocab.GetOrAdd(toksSource[pos]));
+    }
+  }
+
+  for (size_t pos = 0; pos < m_targetAligned.size(); ++pos) {
+    if (!m_targetAligned[pos]) {
+      Process(m_vocab.GetOrAdd(toksTarget[pos]), m_null);
+    }
+  }
 }
 
-void ExtractLex::Process(const std::string *target, const std::string *source)
+void ExtractLex::Process(uint32_t target, uint32_t source)
 {
-  WordCount &wcS2T = m_collS2T[source];
-  WordCount &wcT2S = m_collT2S[target];
+  ++m_pairs[(static_cast<uint64_t>(source) << 32) | target];
+}
 
-  wcS2T.AddCount(COUNT_INCR);
-  wcT2S.AddCount(COUNT_INCR);
+void ExtractLex::Add(const ExtractLex &other)
+{
+  // Map the other object's word IDs to ours.
+  std::vector<uint32_t> ids(other.m_vocab.Size());
+  for (size_t i = 0; i < ids.size(); ++i) {
+    ids[i] = m_vocab.GetOrAdd(other.m_vocab.GetWord(i));
+  }
 
-  Process(wcS2T, target);
-  Process(wcT2S, source);
+  for (PairCounts::const_iterator iter = other.m_pairs.begin(); iter != other.m_pairs.end(); ++iter) {
+    uint64_t source = ids[iter->first >> 32];
+    uint64_t target = ids[iter->first & 0xffffffff];
+    m_pairs[(source << 32) | target] += iter->second;
+  }
 }
 
-void ExtractLex::Process(WordCount &wcIn, const std::string *out)
+void ExtractLex::Output(std::ofstream &streamLexS2T, std::ofstream &streamLexT2S) const
 {
-  std::map<const std::string*, WordCount> &collOut = wcIn.GetColl();
-  WordCount &wcOut = collOut[out];
-  wcOut.AddCount(COUNT_INCR);
+  Output(false, streamLexS2T);
+  Output(true, streamLexT2S);
 }
 
-void ExtractLex::ProcessUnaligned(vector<string> &toksTarget, vector<string> &toksSource
-                                  , const std::vector<bool> &m_sourceAligned, const std::vector<bool> &m_targetAligned)
+namespace
 {
-  const string *nullWord = m_vocab.GetOrAdd("NULL");
 
-  for (size_t pos = 0; pos < m_sourceAligned.size(); ++pos) {
-    bool isAlignedCurr = m_sourceAligned[pos];
-    if (!isAlignedCurr) {
-      const string &tmpWord = toksSource[pos];
-      const string *sourceWord = m_vocab.GetOrAdd(tmpWord);
+// Orders (in << 32 | out) keys by the ranks of in and out in the sorted
+// vocabulary.
+struct RankLess {
+  RankLess(const std::vector<uint32_t> &rank) : m_rank(rank) {}
 
-      Process(nullWord, sourceWord);
+  bool operator()(const std::pair<uint64_t, uint64_t> &a,
+                  const std::pair<uint64_t, uint64_t> &b) const {
+    uint32_t aIn = a.first >> 32, bIn = b.first >> 32;
+    if (aIn != bIn) {
+      return m_rank[aIn] < m_rank[bIn];
     }
+    return m_rank[a.first & 0xffffffff] < m_rank[b.first & 0xffffffff];
   }
 
-  for (size_t pos = 0; pos < m_targetAligned.size(); ++pos) {
-    bool isAlignedCurr = m_targetAligned[pos];
-    if (!isAlignedCurr) {
-      const string &tmpWord = toksTarget[pos];
-      const string *targetWord = m_vocab.GetOrAdd(tmpWord);
+  const std::vector<uint32_t> &m_rank;
+};
 
-      Process(targetWord, nullWord);
-    }
+// Orders word IDs by their strings.
+struct WordLess {
+  WordLess(const Vocab &vocab) : m_vocab(vocab) {}
+
+  bool operator()(uint32_t a, uint32_t b) const {
+    return m_vocab.GetWord(a) < m_vocab.GetWord(b);
   }
 
-}
+  const Vocab &m_vocab;
+};
 
-void ExtractLex::Output(std::ofstream &streamLexS2T, std::ofstream &streamLexT2S)
-{
-  Output(m_collS2T, streamLexS2T);
-  Output(m_collT2S, streamLexT2S);
-}
+} // namespace
 
-void ExtractLex::Output(const std::map<const std::string*, WordCount> &coll, std::ofstream &outStream)
+void ExtractLex::Output(bool inverse, std::ofstream &outStream) const
 {
-  std::map<const std::string*, WordCount>::const_iterator iterOuter;
-  for (iterOuter = coll.begin(); iterOuter != coll.end(); ++iterOuter) {
-    const string &inStr = *iterOuter->first;
-    const WordCount &inWC = iterOuter->second;
-
-    const std::map<const std::string*, WordCount> &outColl = inWC.GetColl();
-
-    std::map<const std::string*, WordCount>::const_iterator iterInner;
-    for (iterInner = outColl.begin(); iterInner != outColl.end(); ++iterInner) {
-      const string &outStr = *iterInner->first;
-      const WordCount &outWC = iterInner->second;
-
-      float prob = outWC.GetCount() / inWC.GetCount();
-      outStream << outStr << " "  << inStr << " " << prob << endl;
-    }
+  // Rank the words in string order, so that the output does not depend on the
+  // order in which IDs were assigned.
+  std::vector<uint32_t> order(m_vocab.Size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), WordLess(m_vocab));
+  std::vector<uint32_t> rank(order.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    rank[order[i]] = i;
   }
-}
 
-std::ostream& operator<<(std::ostream &out, const WordCount &obj)
-{
-  out << "(" << obj.GetCount() << ")";
-  return out;
-}
+  // Re-key the counts as (in << 32 | out) and total them per in word.
+  std::vector<std::pair<uint64_t, uint64_t> > pairs;
+  pairs.reserve(m_pairs.size());
+  std::vector<uint64_t> inCount(m_vocab.Size(), 0);
+  for (PairCounts::const_iterator iter = m_pairs.begin(); iter != m_pairs.end(); ++iter) {
+    uint64_t source = iter->first >> 32;
+    uint64_t target = iter->first & 0xffffffff;
+    uint64_t in = inverse ? target : source;
+    uint64_t out = inverse ? source : target;
+    pairs.push_back(std::make_pair((in << 32) | out, iter->second));
+    inCount[in] += iter->second;
+  }
+  std::sort(pairs.begin(), pairs.end(), RankLess(rank));
 
-void WordCount::AddCount(float incr)
-{
-  m_count += incr;
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    const string &inStr = m_vocab.GetWord(pairs[i].first >> 32);
+    const string &outStr = m_vocab.GetWord(pairs[i].first & 0xffffffff);
+    float prob = float(pairs[i].second) / float(inCount[pairs[i].first >> 32]);
+    outStream << outStr << " "  << inStr << " " << prob << "\n";
+  }
 }
 
 } // namespace
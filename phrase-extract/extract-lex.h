@@ -1,70 +1,63 @@
 #pragma once
 
-#include <map>
-#include <set>
-#include <sstream>
+#include <string>
+#include <vector>
 #include <fstream>
 #include <iostream>
 
+#include <stdint.h>
+
+#include <boost/unordered_map.hpp>
+
 namespace MosesTraining
 {
 
-class WordCount
+class Vocab
 {
-  friend std::ostream& operator<<(std::ostream&, const WordCount&);
+  boost::unordered_map<std::string, uint32_t> m_ids;
+  std::vector<std::string> m_words;
 public:
-  float m_count;
-
-  std::map<const std::string*, WordCount> m_coll;
-
-  WordCount()
-    :m_count(0) {
-  }
+  uint32_t GetOrAdd(const std::string &word);
 
-  //WordCount(const WordCount &copy);
-
-  WordCount(float count)
-    :m_count(count) {
-  }
-
-  void AddCount(float incr);
-
-  std::map<const std::string*, WordCount> &GetColl() {
-    return m_coll;
-  }
-  const std::map<const std::string*, WordCount> &GetColl() const {
-    return m_coll;
+  const std::string &GetWord(uint32_t id) const {
+    return m_words[id];
   }
 
-  const float GetCount() const {
-    return m_count;
+  size_t Size() const {
+    return m_words.size();
   }
-
-};
-
-class Vocab
-{
-  std::set<std::string> m_coll;
-public:
-  const std::string *GetOrAdd(const std::string &word);
 };
 
+// Counts how often each source word is aligned to each target word, with
+// unaligned words counted as aligned to NULL.  Words are mapped to integer IDs
+// of the object's own vocabulary, so counts can be gathered for parts of the
+// corpus independently and added up afterwards.
 class ExtractLex
 {
   Vocab m_vocab;
-  std::map<const std::string*, WordCount> m_collS2T, m_collT2S;
+  uint32_t m_null;
 
-  void Process(const std::string *target, const std::string *source);
-  void Process(WordCount &wcIn, const std::string *out);
-  void ProcessUnaligned(std::vector<std::string> &toksTarget, std::vector<std::string> &toksSource
-                        , const std::vector<bool> &m_sourceAligned, const std::vector<bool> &m_targetAligned);
+  // Link counts, keyed by (source ID << 32 | target ID).
+  typedef boost::unordered_map<uint64_t, uint64_t> PairCounts;
+  PairCounts m_pairs;
 
-  void Output(const std::map<const std::string*, WordCount> &coll, std::ofstream &outStream);
+  void Process(uint32_t target, uint32_t source);
+
+  // Write "out in p(out|in)" lines, sorted by in then out.  If inverse then
+  // the source word is out and the target word is in.
+  void Output(bool inverse, std::ofstream &outStream) const;
 
 public:
+  ExtractLex();
+
   void Process(std::vector<std::string> &toksTarget, std::vector<std::string> &toksSource, std::vector<std::string> &toksAlign, size_t lineCount);
-  void Output(std::ofstream &streamLexS2T, std::ofstream &streamLexT2S);
+
+  // Add the counts of other to this.
+  void Add(const ExtractLex &other);
+
+  void Output(std::ofstream &streamLexS2T, std::ofstream &streamLexT2S) const;
 
 };
 
 } // namespace
+
@@ -11,6 +11,14 @@
 #include <set>
 #include <vector>
 #include <limits>
+#include <deque>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#ifdef WITH_THREADS
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#endif
 
 #include "tables-core.h"
 #include "InputFileStream.h"
@@ -19,6 +27,7 @@
 #include "SentenceAlignmentWithSyntax.h"
 #include "SyntaxNode.h"
 #include "moses/Util.h"
+#include "moses/ThreadPool.h"
 
 using namespace std;
 using namespace MosesTraining;
@@ -67,26 +76,39 @@ bool isAligned (SentenceAlignmentWithSyntax &, int, int);
 
 int sentenceOffset = 0;
 
+class OrderedWriter;
 
-class ExtractTask
+class ExtractTask : public Moses::Task
 {
 public:
   ExtractTask(
-    size_t id, SentenceAlignmentWithSyntax &sentence,
+    size_t id, boost::shared_ptr<SentenceAlignmentWithSyntax> sentence,
     PhraseExtractionOptions &initoptions,
     Moses::OutputFileStream &extractFile,
     Moses::OutputFileStream &extractFileInv,
     Moses::OutputFileStream &extractFileOrientation,
     Moses::OutputFileStream &extractFileContext,
-    Moses::OutputFileStream &extractFileContextInv):
-    m_sentence(sentence),
+    Moses::OutputFileStream &extractFileContextInv,
+    OrderedWriter *writer = NULL):
+    m_sentencePtr(sentence),
+    m_sentence(*sentence),
     m_options(initoptions),
     m_extractFile(extractFile),
     m_extractFileInv(extractFileInv),
     m_extractFileOrientation(extractFileOrientation),
     m_extractFileContext(extractFileContext),
-    m_extractFileContextInv(extractFileContextInv) {}
+    m_extractFileContextInv(extractFileContextInv),
+    m_writer(writer),
+    m_done(false) {}
   void Run();
+  // Write the phrases extracted by Run(), for tasks with a writer.
+  void writePhrasesToFile();
+  bool isDone() const {
+    return m_done;
+  }
+  void setDone() {
+    m_done = true;
+  }
 private:
   vector< string > m_extractedPhrases;
   vector< string > m_extractedPhrasesInv;
@@ -97,7 +119,7 @@ private:
   void extractBase();
   void extract();
   void addPhrase(int, int, int, int, const std::string &);
-  void writePhrasesToFile();
+  void clearPhrases();
   bool checkPlaceholders(int startE, int endE, int startF, int endF) const;
   bool isPlaceholder(const string &word) const;
   bool checkTargetConstituentBoundaries(int startE, int endE, int startF, int endF,
@@ -113,6 +135,7 @@ private:
                           const HSentenceVertices& outBottomRight,
                           std::string &orientationInfo) const;
 
+  boost::shared_ptr<SentenceAlignmentWithSyntax> m_sentencePtr;
   SentenceAlignmentWithSyntax &m_sentence;
   const PhraseExtractionOptions &m_options;
   Moses::OutputFileStream &m_extractFile;
@@ -120,7 +143,72 @@ private:
   Moses::OutputFileStream &m_extractFileOrientation;
   Moses::OutputFileStream &m_extractFileContext;
   Moses::OutputFileStream &m_extractFileContextInv;
+  OrderedWriter *m_writer;
+  bool m_done; // guarded by the writer
 };
+
+#ifdef WITH_THREADS
+// Writes out extraction tasks in the order they were queued, on a thread of
+// its own, while later sentences are still being extracted.
+class OrderedWriter
+{
+public:
+  explicit OrderedWriter(size_t maxPending)
+    : m_maxPending(maxPending), m_closed(false),
+      m_thread(boost::bind(&OrderedWriter::Loop, this)) {}
+
+  // Queue a task for writing; blocks while too many tasks are pending.
+  void Push(boost::shared_ptr<ExtractTask> task) {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    while (m_queue.size() >= m_maxPending) {
+      m_changed.wait(lock);
+    }
+    m_queue.push_back(task);
+  }
+
+  // Called by a task when its phrases are ready to be written.
+  void Finished(ExtractTask *task) {
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    task->setDone();
+    m_changed.notify_all();
+  }
+
+  // Write the remaining tasks and stop.
+  void Close() {
+    {
+      boost::lock_guard<boost::mutex> lock(m_mutex);
+      m_closed = true;
+      m_changed.notify_all();
+    }
+    m_thread.join();
+  }
+
+private:
+  void Loop() {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    while (true) {
+      while (m_queue.empty() ? !m_closed : !m_queue.front()->isDone()) {
+        m_changed.wait(lock);
+      }
+      if (m_queue.empty()) return;
+      boost::shared_ptr<ExtractTask> task = m_queue.front();
+      m_queue.pop_front();
+      m_changed.notify_all();
+      lock.unlock();
+      task->writePhrasesToFile();
+      task.reset();
+      lock.lock();
+    }
+  }
+
+  size_t m_maxPending;
+  bool m_closed;
+  std::deque<boost::shared_ptr<ExtractTask> > m_queue;
+  boost::mutex m_mutex;
+  boost::condition_variable m_changed;
+  boost::thread m_thread;
+};
+#endif
 }
 
 int main(int argc, char* argv[])
@@ -131,7 +219,7 @@ int main(int argc, char* argv[])
   if (argc < 6) {
     cerr << "syntax: extract en de align extract max-length [orientation [ --model [wbe|phrase|hier]-[msd|mslr|mono] ] ";
     cerr << "| --OnlyOutputSpanInfo | --NoTTable | --GZOutput | --IncludeSentenceId | --SentenceOffset n | --InstanceWeights filename ";
-    cerr << "| --TargetConstituentConstrained | --TargetConstituentBoundaries ]" << std::endl;
+    cerr << "| --TargetConstituentConstrained | --TargetConstituentBoundaries | --Threads n ]" << std::endl;
     exit(1);
   }
 
@@ -145,6 +233,7 @@ int main(int argc, char* argv[])
   const char* const &fileNameA = argv[3];
   const string fileNameExtract = string(argv[4]);
   PhraseExtractionOptions options(atoi(argv[5]));
+  size_t threadCount = 1;
 
   for(int i=6; i<argc; i++) {
     if (strcmp(argv[i],"--OnlyOutputSpanInfo") == 0) {
@@ -177,6 +266,18 @@ int main(int argc, char* argv[])
         exit(1);
       }
       options.initInstanceWeightsFile(argv[++i]);
+    } else if (strcmp(argv[i], "--Threads") == 0 || strcmp(argv[i], "--threads") == 0) {
+      if (i+1 >= argc || argv[i+1][0] < '0' || argv[i+1][0] > '9') {
+        cerr << "extract: syntax error, used switch --Threads without a number" << endl;
+        exit(1);
+      }
+      threadCount = atoi(argv[++i]);
+#ifndef WITH_THREADS
+      if (threadCount > 1) {
+        cerr << "extract: thread support not compiled in." << endl;
+        exit(1);
+      }
+#endif
     } else if (strcmp(argv[i], "--Debug") == 0) {
       options.debug = true;
     } else if(strcmp(argv[i],"--model") == 0) {
@@ -291,6 +392,17 @@ int main(int argc, char* argv[])
 
   string englishString, foreignString, alignmentString, weightString;
 
+  // Span info goes straight to stdout, so it is extracted in order.
+  if (options.isOnlyOutputSpanInfo()) threadCount = 1;
+#ifdef WITH_THREADS
+  boost::scoped_ptr<Moses::ThreadPool> pool;
+  boost::scoped_ptr<OrderedWriter> writer;
+  if (threadCount > 1) {
+    pool.reset(new Moses::ThreadPool(threadCount));
+    writer.reset(new OrderedWriter(100 * threadCount));
+  }
+#endif
+
   while (getline(*eFileP, englishString)) {
     // Print progress dots to stderr.
     i++;
@@ -302,10 +414,10 @@ int main(int argc, char* argv[])
       getline(*iwFileP, weightString);
     }
 
-    SentenceAlignmentWithSyntax sentence
-    (targetLabelCollection, sourceLabelCollection,
-     targetTopLabelCollection, sourceTopLabelCollection,
-     targetSyntax, false);
+    boost::shared_ptr<SentenceAlignmentWithSyntax> sentence(new SentenceAlignmentWithSyntax
+        (targetLabelCollection, sourceLabelCollection,
+         targetTopLabelCollection, sourceTopLabelCollection,
+         targetSyntax, false));
     // cout << "read in: " << englishString << " & " << foreignString << " & " << alignmentString << endl;
     //az: output src, tgt, and alingment line
     if (options.isOnlyOutputSpanInfo()) {
@@ -314,14 +426,22 @@ int main(int argc, char* argv[])
       cout << "LOG: ALT: " << alignmentString << endl;
       cout << "LOG: PHRASES_BEGIN:" << endl;
     }
-    if (sentence.create( englishString.c_str(),
-                         foreignString.c_str(),
-                         alignmentString.c_str(),
-                         weightString.c_str(),
-                         i, false)) {
+    if (sentence->create( englishString.c_str(),
+                          foreignString.c_str(),
+                          alignmentString.c_str(),
+                          weightString.c_str(),
+                          i, false)) {
       if (options.placeholders.size()) {
-        sentence.invertAlignment();
+        sentence->invertAlignment();
+      }
+#ifdef WITH_THREADS
+      if (pool) {
+        boost::shared_ptr<ExtractTask> task(new ExtractTask(i-1, sentence, options, extractFile, extractFileInv, extractFileOrientation, extractFileContext, extractFileContextInv, writer.get()));
+        writer->Push(task);
+        pool->Submit(task);
+        continue;
       }
+#endif
       ExtractTask *task = new ExtractTask(i-1, sentence, options, extractFile , extractFileInv, extractFileOrientation, extractFileContext, extractFileContextInv);
       task->Run();
       delete task;
@@ -330,6 +450,13 @@ int main(int argc, char* argv[])
     if (options.isOnlyOutputSpanInfo()) cout << "LOG: PHRASES_END:" << endl; //az: mark end of phrases
   }
 
+#ifdef WITH_THREADS
+  if (pool) {
+    pool->Stop(true);
+    writer->Close();
+  }
+#endif
+
   eFile.Close();
   fFile.Close();
   aFile.Close();
@@ -360,7 +487,18 @@ namespace MosesTraining
 void ExtractTask::Run()
 {
   extract();
+#ifdef WITH_THREADS
+  if (m_writer) {
+    // The writer calls writePhrasesToFile() when it is our turn.
+    m_writer->Finished(this);
+    return;
+  }
+#endif
   writePhrasesToFile();
+}
+
+void ExtractTask::clearPhrases()
+{
   m_extractedPhrases.clear();
   m_extractedPhrasesInv.clear();
   m_extractedPhrasesOri.clear();
@@ -1072,6 +1210,7 @@ void ExtractTask::writePhrasesToFile()
     m_extractFileContext  << outextractFileContext.str();
     m_extractFileContextInv << outextractFileContextInv.str();
   }
+  clearPhrases();
 }
 
 // if proper conditioning, we need the number of times a source phrase occured
@@ -80,7 +80,7 @@ int FilterRuleTable::Main(int argc, char *argv[])
     std::vector<boost::shared_ptr<std::string> > testStrings;
     ReadTestSet(testStream, testStrings);
     StringCfgFilter filter(testStrings);
-    filter.Filter(std::cin, std::cout);
+    filter.Filter(std::cin, std::cout, options.threads);
   } else if (testSentenceFormat == kTree) {
     std::vector<boost::shared_ptr<SyntaxTree> > testTrees;
     ReadTestSet(testStream, testTrees);
@@ -88,10 +88,10 @@ int FilterRuleTable::Main(int argc, char *argv[])
       // TODO Implement TreeCfgFilter
       Warn("tree/cfg filtering algorithm not implemented: input will be copied unchanged to output");
       TreeCfgFilter filter(testTrees);
-      filter.Filter(std::cin, std::cout);
+      filter.Filter(std::cin, std::cout, options.threads);
     } else if (sourceSideRuleFormat == kTsg) {
       TreeTsgFilter filter(testTrees);
-      filter.Filter(std::cin, std::cout);
+      filter.Filter(std::cin, std::cout, options.threads);
     } else {
       assert(false);
     }
@@ -100,7 +100,7 @@ int FilterRuleTable::Main(int argc, char *argv[])
     ReadTestSet(testStream, testForests);
     assert(sourceSideRuleFormat == kTsg);
     ForestTsgFilter filter(testForests);
-    filter.Filter(std::cin, std::cout);
+    filter.Filter(std::cin, std::cout, options.threads);
   }
 
   return 0;
@@ -179,6 +179,11 @@ void FilterRuleTable::ProcessOptions(int argc, char *argv[],
 
   // Declare the command line options that are visible to the user.
   po::options_description visible(usageTop.str());
+  visible.add_options()
+  ("Threads",
+   po::value(&options.threads)->default_value(options.threads),
+   "filter the rule table on this many threads")
+  ;
 
   // Declare the command line options that are hidden from the user
   // (these are used as positional options).
@@ -224,6 +229,15 @@ void FilterRuleTable::ProcessOptions(int argc, char *argv[],
     std::cerr << visible << usageBottom.str() << std::endl;
     std::exit(1);
   }
+
+  if (options.threads < 1) {
+    Error("Threads must be at least 1");
+  }
+#ifndef WITH_THREADS
+  if (options.threads > 1) {
+    Warn("compiled without threading support: Threads option will be ignored");
+  }
+#endif
 }
 
 }  // namespace FilterRuleTable
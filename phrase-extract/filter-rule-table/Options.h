@@ -11,11 +11,14 @@ namespace FilterRuleTable
 
 struct Options {
 public:
-  Options() {}
+  Options() : threads(1) {}
 
   // Positional options
   std::string model;
   std::string testSetFile;
+
+  // All other options
+  int threads;
 };
 
 }  // namespace FilterRuleTable
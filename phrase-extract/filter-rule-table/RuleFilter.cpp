@@ -0,0 +1,174 @@
+#include "RuleFilter.h"
+
+#include <deque>
+
+#include <boost/shared_ptr.hpp>
+
+#ifdef WITH_THREADS
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "moses/ThreadPool.h"
+#endif
+
+#include "util/tokenize_piece.hh"
+
+namespace MosesTraining
+{
+namespace Syntax
+{
+namespace FilterRuleTable
+{
+
+const std::size_t RuleFilter::kBlockSize = 10000;
+
+void RuleFilter::Filter(std::istream &in, std::ostream &out, int threads)
+{
+#ifdef WITH_THREADS
+  if (threads > 1) {
+    FilterParallel(in, out, threads);
+    return;
+  }
+#endif
+
+  const util::MultiCharacter delimiter("|||");
+
+  std::string line;
+  std::string prevLine;
+  StringPiece source;
+  bool keep = true;
+
+  while (std::getline(in, line)) {
+    // Read the source-side of the rule.
+    util::TokenIter<util::MultiCharacter> it(line, delimiter);
+
+    // Check if this rule has the same source-side as the previous rule.  If
+    // it does then we already know whether or not to keep the rule.  This
+    // optimisation is based on the assumption that the rule table is sorted
+    // (which is the case in the standard Moses training pipeline).
+    if (*it == source) {
+      if (keep) {
+        out << line << std::endl;
+      }
+      continue;
+    }
+
+    // The source-side is different from the previous rule's.
+    source = *it;
+    keep = KeepSource(source);
+    if (keep) {
+      out << line << std::endl;
+    }
+
+    // Retain line for the next iteration (in order that the source StringPiece
+    // remains valid).
+    prevLine.swap(line);
+  }
+}
+
+void RuleFilter::FilterBlock(const std::vector<std::string> &lines,
+                             std::string &out) const
+{
+  const util::MultiCharacter delimiter("|||");
+
+  StringPiece source;
+  bool keep = true;
+  for (std::vector<std::string>::const_iterator p = lines.begin();
+       p != lines.end(); ++p) {
+    util::TokenIter<util::MultiCharacter> it(*p, delimiter);
+    // As in Filter(), re-use the decision for a repeated source-side.  The
+    // lines of the block stay put, so source remains valid.
+    if (*it != source) {
+      source = *it;
+      keep = KeepSource(source);
+    }
+    if (keep) {
+      out += *p;
+      out += '\n';
+    }
+  }
+}
+
+#ifdef WITH_THREADS
+
+// Filters one block of the rule table on a worker thread.  The main thread
+// waits for blocks in the order they were read.
+class RuleFilter::BlockTask : public Moses::Task
+{
+public:
+  explicit BlockTask(const RuleFilter &filter)
+    : m_filter(filter), m_done(false) {}
+
+  void Run() {
+    std::string output;
+    m_filter.FilterBlock(m_lines, output);
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_output.swap(output);
+    m_lines.clear();
+    m_done = true;
+    m_cond.notify_one();
+  }
+
+  std::vector<std::string> &Lines() {
+    return m_lines;
+  }
+
+  // Wait until the block has been filtered and return the kept lines.
+  const std::string &Output() {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    while (!m_done) {
+      m_cond.wait(lock);
+    }
+    return m_output;
+  }
+
+private:
+  const RuleFilter &m_filter;
+  std::vector<std::string> m_lines;
+  std::string m_output;
+  bool m_done;
+  boost::mutex m_mutex;
+  boost::condition_variable m_cond;
+};
+
+void RuleFilter::FilterParallel(std::istream &in, std::ostream &out,
+                                int threads)
+{
+  // Bound the number of blocks in memory at once.
+  const std::size_t maxPending = 4 * threads;
+
+  Moses::ThreadPool pool(threads);
+  std::deque<boost::shared_ptr<BlockTask> > pending;
+  std::string line;
+  while (true) {
+    boost::shared_ptr<BlockTask> task(new BlockTask(*this));
+    std::vector<std::string> &lines = task->Lines();
+    lines.reserve(kBlockSize);
+    while (lines.size() < kBlockSize && std::getline(in, line)) {
+      lines.push_back(std::string());
+      lines.back().swap(line);
+    }
+    if (lines.empty()) {
+      break;
+    }
+    pending.push_back(task);
+    pool.Submit(task);
+    while (pending.size() > maxPending) {
+      out << pending.front()->Output();
+      pending.pop_front();
+    }
+  }
+  while (!pending.empty()) {
+    out << pending.front()->Output();
+    pending.pop_front();
+  }
+  out.flush();
+  pool.Stop(true);
+}
+
+#endif
+
+}  // namespace FilterRuleTable
+}  // namespace Syntax
+}  // namespace MosesTraining
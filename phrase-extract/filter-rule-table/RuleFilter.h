@@ -0,0 +1,50 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "util/string_piece.hh"
+
+namespace MosesTraining
+{
+namespace Syntax
+{
+namespace FilterRuleTable
+{
+
+// Base class for CfgFilter and TsgFilter.  Streams a rule table from input to
+// output, keeping the rules whose source-side can be applied to the test set.
+class RuleFilter
+{
+public:
+  virtual ~RuleFilter() {}
+
+  // Read a rule table from 'in' and filter it according to the test sentences.
+  // If threads > 1 then the table is read in blocks that are filtered by a
+  // pool of worker threads and written out in their original order.
+  void Filter(std::istream &in, std::ostream &out, int threads=1);
+
+protected:
+  // Return true if rules with the given source-side can be applied to the
+  // test set.  This is called concurrently from multiple threads, so it must
+  // not modify the filter.
+  virtual bool KeepSource(const StringPiece &source) const = 0;
+
+private:
+  class BlockTask;
+
+  // Number of rule table lines in each block that is given to a worker.
+  static const std::size_t kBlockSize;
+
+  // Filter a block of rule table lines, appending the kept lines to out.
+  void FilterBlock(const std::vector<std::string> &lines,
+                   std::string &out) const;
+
+  void FilterParallel(std::istream &in, std::ostream &out, int threads);
+};
+
+}  // namespace FilterRuleTable
+}  // namespace Syntax
+}  // namespace MosesTraining
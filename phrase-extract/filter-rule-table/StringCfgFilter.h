@@ -29,8 +29,6 @@ public:
   // Initialize the filter for a given set of test sentences.
   StringCfgFilter(const std::vector<boost::shared_ptr<std::string> > &);
 
-  void Filter(std::istream &in, std::ostream &out);
-
 private:
   // Filtering works by converting the source LHSs of translation rules to
   // patterns containing variable length gaps and then pattern matching
@@ -117,6 +115,8 @@ private:
 
   bool IsNonTerminal(const StringPiece &symbol) const;
 
+  bool KeepSource(const StringPiece &) const;
+
   // Try to match the pattern p against any sentence in the test set.
   bool MatchPattern(const Pattern &p) const;
 
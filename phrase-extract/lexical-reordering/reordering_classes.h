@@ -11,6 +11,7 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include <ostream>
 
 #include "util/string_piece.hh"
 #include "../OutputFileStream.h"
@@ -113,9 +114,12 @@ public:
 
 
 //Class for representing each model
-//Contains a modelscore and scorer (which can be of different model types (mslr, msd...)),
+//Contains a modelscore (which may be shared with other models and is not
+//owned by the model) and scorer (which can be of different model types (mslr, msd...)),
 //and file handling.
 //This class also keeps track of bidirectionality, and which language to condition on
+//The scoring functions take the counts to score and the stream to write to,
+//so that several threads can score different phrases with the same model.
 class Model
 {
 private:
@@ -141,8 +145,16 @@ public:
   static Model* createModel(ModelScore*, const std::string&, const std::string&);
   void createSmoothing(double w);
   void createConstSmoothing(double w);
-  void score_fe(const std::string& f, const std::string& e);
-  void score_f(const std::string& f);
+  void score_fe(const ModelScore& counts, const std::string& f,
+                const std::string& e, std::ostream& out) const;
+  void score_f(const ModelScore& counts, const std::string& f,
+               std::ostream& out) const;
+  std::ostream& getOutput() {
+    return outputFile;
+  }
+  const std::string& getFilename() const {
+    return filename;
+  }
   void zipFile();
 };
 
@@ -7,6 +7,7 @@
 
 #include <string>
 #include <vector>
+#include <deque>
 #include <map>
 #include <iostream>
 #include <fstream>
@@ -14,6 +15,19 @@
 #include <cstdlib>
 #include <cstring>
 
+#ifdef WITH_THREADS
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "moses/ThreadPool.h"
+#endif
+
+#ifdef HAVE_CMPH
+#include "moses/TranslationModel/CompactPT/LexicalReorderingTableCreator.h"
+#endif
+
 #include "util/exception.hh"
 #include "util/file_piece.hh"
 #include "util/string_piece.hh"
@@ -36,6 +50,246 @@ public:
   ~FileFormatException() throw() {}
 };
 
+//Scores a run of extract lines for all models.  The counts are kept in
+//the scorer's own ModelScore objects, so that runs starting at different
+//source phrases can be scored at the same time.  Each model's lines are
+//written to the matching output stream.
+class BlockScorer
+{
+public:
+  BlockScorer(const vector<Model*>& models, const vector<string>& modelKeys,
+              const map<string,string>& scoreTypes,
+              const vector<ostream*>& outputs);
+  ~BlockScorer();
+
+  void addLine(const StringPiece& line);
+
+  //Score the last phrase pair and source phrase.
+  void finish();
+
+private:
+  void addExample(ModelScore* modelScore, const StringPiece& orientations,
+                  float weight);
+
+  const vector<Model*>& m_models;
+  const vector<ostream*> m_outputs;
+
+  map<string,ModelScore*> m_scores;
+  vector<const ModelScore*> m_modelScores; //counts of each model
+  ModelScore* m_hier;
+  ModelScore* m_phrase;
+  ModelScore* m_wbe;
+
+  string m_fCurrent;
+  string m_eCurrent;
+  bool m_first;
+};
+
+BlockScorer::BlockScorer(const vector<Model*>& models,
+                         const vector<string>& modelKeys,
+                         const map<string,string>& scoreTypes,
+                         const vector<ostream*>& outputs)
+  : m_models(models), m_outputs(outputs), m_first(true)
+{
+  for (map<string,string>::const_iterator it = scoreTypes.begin(); it != scoreTypes.end(); ++it) {
+    m_scores[it->first] = ModelScore::createModelScore(it->second);
+  }
+  for (size_t i=0; i<modelKeys.size(); ++i) {
+    m_modelScores.push_back(m_scores[modelKeys[i]]);
+  }
+  m_hier = m_scores.count("hier") ? m_scores["hier"] : NULL;
+  m_phrase = m_scores.count("phrase") ? m_scores["phrase"] : NULL;
+  m_wbe = m_scores.count("wbe") ? m_scores["wbe"] : NULL;
+}
+
+BlockScorer::~BlockScorer()
+{
+  for (map<string,ModelScore*>::iterator it = m_scores.begin(); it != m_scores.end(); ++it) {
+    delete it->second;
+  }
+}
+
+void BlockScorer::addExample(ModelScore* modelScore, const StringPiece& orientations, float weight)
+{
+  StringPiece prev, next;
+  get_orientations(orientations, prev, next);
+  modelScore->add_example(prev,next,weight);
+}
+
+void BlockScorer::addLine(const StringPiece& line)
+{
+  StringPiece e,f,w,p,h;
+  float weight = 1;
+  split_line(line,f,e,w,p,h,weight);
+
+  if (m_first) {
+    m_fCurrent = f.as_string(); //FIXME: Avoid the copy.
+    m_eCurrent = e.as_string();
+    m_first = false;
+  } else if (f.compare(m_fCurrent) != 0 || e.compare(m_eCurrent) != 0) {
+    //fe - score
+    for (size_t i=0; i<m_models.size(); ++i) {
+      m_models[i]->score_fe(*m_modelScores[i],m_fCurrent,m_eCurrent,*m_outputs[i]);
+    }
+    //reset
+    for(map<string,ModelScore*>::const_iterator it = m_scores.begin(); it != m_scores.end(); ++it) {
+      it->second->reset_fe();
+    }
+
+    if (f.compare(m_fCurrent) != 0) {
+      //f - score
+      for (size_t i=0; i<m_models.size(); ++i) {
+        m_models[i]->score_f(*m_modelScores[i],m_fCurrent,*m_outputs[i]);
+      }
+      //reset
+      for(map<string,ModelScore*>::const_iterator it = m_scores.begin(); it != m_scores.end(); ++it) {
+        it->second->reset_f();
+      }
+    }
+    m_fCurrent = f.as_string();
+    m_eCurrent = e.as_string();
+  }
+
+  // uppdate counts
+  if (m_hier) {
+    addExample(m_hier, h, weight);
+  }
+  if (m_phrase) {
+    addExample(m_phrase, p, weight);
+  }
+  if (m_wbe) {
+    addExample(m_wbe, w, weight);
+  }
+}
+
+void BlockScorer::finish()
+{
+  if (m_first) {
+    return;
+  }
+  //Score the last phrases
+  for (size_t i=0; i<m_models.size(); ++i) {
+    m_models[i]->score_fe(*m_modelScores[i],m_fCurrent,m_eCurrent,*m_outputs[i]);
+  }
+  for (size_t i=0; i<m_models.size(); ++i) {
+    m_models[i]->score_f(*m_modelScores[i],m_fCurrent,*m_outputs[i]);
+  }
+}
+
+//The source phrase of an extract line.
+StringPiece source_phrase(const StringPiece& line)
+{
+  util::TokenIter<util::MultiCharacter> pipes(line, util::MultiCharacter(" ||| "));
+  return *pipes;
+}
+
+#ifdef WITH_THREADS
+
+//Scores a block of extract lines on a worker thread.  Blocks end at a
+//change of source phrase, so that every block can be scored on its own.
+//The main thread writes the scored blocks out in their original order.
+class ScoreTask : public Moses::Task
+{
+public:
+  ScoreTask(const vector<Model*>& models, const vector<string>& modelKeys,
+            const map<string,string>& scoreTypes)
+    : m_models(models), m_modelKeys(modelKeys), m_scoreTypes(scoreTypes),
+      m_done(false) {}
+
+  void Run() {
+    vector<ostringstream*> streams;
+    vector<ostream*> outputs;
+    for (size_t i=0; i<m_models.size(); ++i) {
+      streams.push_back(new ostringstream());
+      outputs.push_back(streams.back());
+    }
+    {
+      BlockScorer scorer(m_models, m_modelKeys, m_scoreTypes, outputs);
+      for (size_t i=0; i<m_lines.size(); ++i) {
+        scorer.addLine(m_lines[i]);
+      }
+      scorer.finish();
+    }
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    for (size_t i=0; i<streams.size(); ++i) {
+      m_output.push_back(streams[i]->str());
+      delete streams[i];
+    }
+    m_lines.clear();
+    m_done = true;
+    m_cond.notify_one();
+  }
+
+  vector<string>& lines() {
+    return m_lines;
+  }
+
+  //Wait until the block has been scored and return each model's output.
+  const vector<string>& output() {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    while (!m_done) {
+      m_cond.wait(lock);
+    }
+    return m_output;
+  }
+
+private:
+  const vector<Model*>& m_models;
+  const vector<string>& m_modelKeys;
+  const map<string,string>& m_scoreTypes;
+  vector<string> m_lines;
+  vector<string> m_output;
+  bool m_done;
+  boost::mutex m_mutex;
+  boost::condition_variable m_cond;
+};
+
+void write_output(ScoreTask& task, const vector<Model*>& models)
+{
+  const vector<string>& output = task.output();
+  for (size_t i=0; i<models.size(); ++i) {
+    models[i]->getOutput() << output[i];
+  }
+}
+
+void score_parallel(util::FilePiece& eFile, const vector<Model*>& models,
+                    const vector<string>& modelKeys,
+                    const map<string,string>& scoreTypes, int threads)
+{
+  //Minimum number of lines in a block, and bound on the number of blocks
+  //in memory at once.
+  const size_t blockSize = 10000;
+  const size_t maxPending = 4 * threads;
+
+  Moses::ThreadPool pool(threads);
+  deque<boost::shared_ptr<ScoreTask> > pending;
+  boost::shared_ptr<ScoreTask> task(new ScoreTask(models, modelKeys, scoreTypes));
+  StringPiece line;
+  while (eFile.ReadLineOrEOF(line)) {
+    vector<string>& lines = task->lines();
+    if (lines.size() >= blockSize &&
+        source_phrase(line) != source_phrase(lines.back())) {
+      pending.push_back(task);
+      pool.Submit(task);
+      while (pending.size() > maxPending) {
+        write_output(*pending.front(), models);
+        pending.pop_front();
+      }
+      task.reset(new ScoreTask(models, modelKeys, scoreTypes));
+    }
+    task->lines().push_back(line.as_string());
+  }
+  pending.push_back(task);
+  pool.Submit(task);
+  while (!pending.empty()) {
+    write_output(*pending.front(), models);
+    pending.pop_front();
+  }
+  pool.Stop(true);
+}
+
+#endif
+
 int main(int argc, char* argv[])
 {
 
@@ -43,7 +297,7 @@ int main(int argc, char* argv[])
        << "scores lexical reordering models of several types (hierarchical, phrase-based and word-based-extraction\n";
 
   if (argc < 3) {
-    cerr << "syntax: score_reordering extractFile smoothingValue filepath (--model \"type max-orientation (specification-strings)\" )+\n";
+    cerr << "syntax: score_reordering extractFile smoothingValue filepath (--model \"type max-orientation (specification-strings)\" )+ [--threads N] [--compact]\n";
     exit(1);
   }
 
@@ -54,8 +308,12 @@ int main(int argc, char* argv[])
   util::FilePiece eFile(extractFileName);
 
   bool smoothWithCounts = false;
+  int threads = 1;
+  bool compact = false;
   map<string,ModelScore*> modelScores;
+  map<string,string> scoreTypes;
   vector<Model*> models;
+  vector<string> modelKeys;
   bool hier = false;
   bool phrase = false;
   bool wbe = false;
@@ -67,6 +325,24 @@ int main(int argc, char* argv[])
   while (i<argc) {
     if (strcmp(argv[i],"--SmoothWithCounts") == 0) {
       smoothWithCounts = true;
+    } else if (strcmp(argv[i],"--threads") == 0) {
+      if (i+1 >= argc) {
+        cerr << "score: syntax error, no number of threads provided to the option " << argv[i] << endl;
+        exit(1);
+      }
+      threads = atoi(argv[++i]);
+#ifndef WITH_THREADS
+      if (threads > 1) {
+        cerr << "Thread support not compiled in, using one thread" << endl;
+        threads = 1;
+      }
+#endif
+    } else if (strcmp(argv[i],"--compact") == 0) {
+#ifndef HAVE_CMPH
+      cerr << "score: --compact requires Moses to be built with --with-cmph" << endl;
+      exit(1);
+#endif
+      compact = true;
     } else if (strcmp(argv[i],"--model") == 0) {
       if (i+1 >= argc) {
         cerr << "score: syntax error, no model information provided to the option" << argv[i] << endl;
@@ -76,6 +352,7 @@ int main(int argc, char* argv[])
       string m,t;
       is >> m >> t;
       modelScores[m] = ModelScore::createModelScore(t);
+      scoreTypes[m] = t;
       if (m.compare("hier") == 0) {
         hier = true;
       } else if (m.compare("phrase") == 0) {
@@ -94,6 +371,7 @@ int main(int argc, char* argv[])
       //Store all models
       while (is >> config) {
         models.push_back(Model::createModel(modelScores[m],config,filepath));
+        modelKeys.push_back(m);
       }
     } else {
       cerr << "illegal option given to lexical reordering model score\n";
@@ -143,72 +421,49 @@ int main(int argc, char* argv[])
 
   ////////////////////////////////////
   //calculate scores for reordering table
-  string f_current,e_current;
-  bool first = true;
-  while (true) {
-    StringPiece line;
-    try {
-      line = eFile.ReadLine();
-    } catch (util::EndOfFileException &e) {
-      break;
-    }
-    float weight = 1;
-    split_line(line,f,e,w,p,h,weight);
-
-    if (first) {
-      f_current = f.as_string(); //FIXME: Avoid the copy.
-      e_current = e.as_string();
-      first = false;
-    } else if (f.compare(f_current) != 0 || e.compare(e_current) != 0) {
-      //fe - score
-      for (size_t i=0; i<models.size(); ++i) {
-        models[i]->score_fe(f_current,e_current);
-      }
-      //reset
-      for(map<string,ModelScore*>::const_iterator it = modelScores.begin(); it != modelScores.end(); ++it) {
-        it->second->reset_fe();
-      }
-
-      if (f.compare(f_current) != 0) {
-        //f - score
-        for (size_t i=0; i<models.size(); ++i) {
-          models[i]->score_f(f_current);
-        }
-        //reset
-        for(map<string,ModelScore*>::const_iterator it = modelScores.begin(); it != modelScores.end(); ++it) {
-          it->second->reset_f();
-        }
-      }
-      f_current = f.as_string();
-      e_current = e.as_string();
-    }
-
-    // uppdate counts
-    if (hier) {
-      get_orientations(h, prev, next);
-      modelScores["hier"]->add_example(prev,next,weight);
-    }
-    if (phrase) {
-      get_orientations(p, prev, next);
-      modelScores["phrase"]->add_example(prev,next,weight);
+#ifdef WITH_THREADS
+  if (threads > 1) {
+    score_parallel(eFile, models, modelKeys, scoreTypes, threads);
+  } else
+#endif
+  {
+    vector<ostream*> outputs;
+    for (size_t i=0; i<models.size(); ++i) {
+      outputs.push_back(&models[i]->getOutput());
     }
-    if (wbe) {
-      get_orientations(w, prev, next);
-      modelScores["wbe"]->add_example(prev,next,weight);
+    BlockScorer scorer(models, modelKeys, scoreTypes, outputs);
+    StringPiece line;
+    while (eFile.ReadLineOrEOF(line)) {
+      scorer.addLine(line);
     }
-  }
-  //Score the last phrases
-  for (size_t i=0; i<models.size(); ++i) {
-    models[i]->score_fe(f_current,e_current);
-  }
-  for (size_t i=0; i<models.size(); ++i) {
-    models[i]->score_f(f_current);
+    scorer.finish();
   }
 
   // delete model objects (and close files)
+  vector<string> filenames;
   for (size_t i=0; i<models.size(); ++i) {
+    filenames.push_back(models[i]->getFilename());
     delete models[i];
   }
+  for(map<string,ModelScore*>::const_iterator it = modelScores.begin(); it != modelScores.end(); ++it) {
+    delete it->second;
+  }
+
+#ifdef HAVE_CMPH
+  ////////////////////////////////////
+  //binarize the tables as processLexicalTableMin does
+  if (compact) {
+    for (size_t i=0; i<filenames.size(); ++i) {
+      Moses::LexicalReorderingTableCreator(
+        filenames[i] + ".gz", filenames[i] + ".minlexr", "",
+        10, 16, true, 0
+#ifdef WITH_THREADS
+        , threads
+#endif
+      );
+    }
+  }
+#endif
   return 0;
 }
 
@@ -22,7 +22,7 @@ public:
 
   void Load(std::istream &);
 
-  double PermissiveLookup(Vocabulary::IdType s, Vocabulary::IdType t) {
+  double PermissiveLookup(Vocabulary::IdType s, Vocabulary::IdType t) const {
     OuterMap::const_iterator p = m_table.find(s);
     if (p == m_table.end()) {
       return 1.0;
@@ -0,0 +1,108 @@
+#include "LineSorter.h"
+
+#include <algorithm>
+
+#include "util/file.hh"
+#include "util/file_stream.hh"
+
+namespace MosesTraining
+{
+namespace Syntax
+{
+namespace ScoreStsg
+{
+
+namespace
+{
+
+// Rough per-line overhead of std::string and std::vector storage.
+const std::size_t kLineOverhead = sizeof(std::string) + 16;
+
+}  // namespace
+
+LineSorter::LineSorter(std::size_t memoryLimit, const std::string &tempPrefix)
+  : m_memoryLimit(memoryLimit)
+  , m_tempPrefix(tempPrefix)
+  , m_bufferBytes(0)
+  , m_next(0)
+{
+}
+
+void LineSorter::Add(const std::string &line)
+{
+  m_buffer.push_back(line);
+  m_bufferBytes += line.size() + kLineOverhead;
+  if (m_bufferBytes >= m_memoryLimit) {
+    WriteRun();
+  }
+}
+
+void LineSorter::WriteRun()
+{
+  std::sort(m_buffer.begin(), m_buffer.end());
+  std::string prefix = m_tempPrefix;
+  util::NormalizeTempPrefix(prefix);
+  int fd = util::MakeTemp(prefix);
+  {
+    util::FileStream out(fd, 1 << 20);
+    for (std::vector<std::string>::const_iterator p = m_buffer.begin();
+         p != m_buffer.end(); ++p) {
+      out << *p << '\n';
+    }
+  }
+  util::SeekOrThrow(fd, 0);
+  m_runFds.push_back(fd);
+  std::vector<std::string>().swap(m_buffer);
+  m_bufferBytes = 0;
+}
+
+void LineSorter::Finish()
+{
+  if (m_runFds.empty()) {
+    std::sort(m_buffer.begin(), m_buffer.end());
+    return;
+  }
+  if (!m_buffer.empty()) {
+    WriteRun();
+  }
+  for (std::size_t i = 0; i < m_runFds.size(); ++i) {
+    // The FilePiece takes ownership of the file descriptor.
+    m_runs.push_back(boost::shared_ptr<util::FilePiece>(
+                       new util::FilePiece(m_runFds[i])));
+    Advance(i);
+  }
+}
+
+void LineSorter::Advance(std::size_t run)
+{
+  StringPiece line;
+  if (m_runs[run]->ReadLineOrEOF(line, '\n', false)) {
+    Head head;
+    line.CopyToString(&head.line);
+    head.run = run;
+    m_queue.push(head);
+  }
+}
+
+bool LineSorter::Next(std::string &line)
+{
+  if (m_runs.empty()) {
+    if (m_next == m_buffer.size()) {
+      return false;
+    }
+    line.swap(m_buffer[m_next++]);
+    return true;
+  }
+  if (m_queue.empty()) {
+    return false;
+  }
+  const std::size_t run = m_queue.top().run;
+  line = m_queue.top().line;
+  m_queue.pop();
+  Advance(run);
+  return true;
+}
+
+}  // namespace ScoreStsg
+}  // namespace Syntax
+}  // namespace MosesTraining
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "util/file_piece.hh"
+
+namespace MosesTraining
+{
+namespace Syntax
+{
+namespace ScoreStsg
+{
+
+// Sorts lines of text into byte order (the order of LC_ALL=C sort) using a
+// bounded amount of memory.  Lines are added with Add() and, once Finish()
+// has been called, read back in sorted order with Next().
+//
+// Lines are buffered until the buffer reaches the memory limit.  Each full
+// buffer is sorted and written to an (unlinked) temporary file, and Next()
+// merges these runs.  If all lines fit into one buffer then no temporary
+// files are used.
+class LineSorter
+{
+public:
+  // memoryLimit is in bytes.  tempPrefix is as for util::MakeTemp.
+  LineSorter(std::size_t memoryLimit, const std::string &tempPrefix);
+
+  void Add(const std::string &line);
+
+  void Finish();
+
+  // Get the next line in sorted order.  Returns false if there are none left.
+  bool Next(std::string &line);
+
+private:
+  // The next line of a run.
+  struct Head {
+    std::string line;
+    std::size_t run;
+  };
+
+  // Orders Heads so that std::priority_queue puts the smallest line (and for
+  // equal lines, the earliest run) on top.
+  struct HeadGreater {
+    bool operator()(const Head &a, const Head &b) const {
+      int c = a.line.compare(b.line);
+      return c > 0 || (c == 0 && a.run > b.run);
+    }
+  };
+
+  // Sort the buffered lines and write them to a new run.
+  void WriteRun();
+
+  // Read the next line of run i into the merge queue, if there is one.
+  void Advance(std::size_t run);
+
+  const std::size_t m_memoryLimit;
+  const std::string m_tempPrefix;
+
+  std::vector<std::string> m_buffer;
+  std::size_t m_bufferBytes;
+  // Position in m_buffer when reading without any runs.
+  std::size_t m_next;
+
+  std::vector<int> m_runFds;
+  std::vector<boost::shared_ptr<util::FilePiece> > m_runs;
+  std::priority_queue<Head, std::vector<Head>, HeadGreater> m_queue;
+};
+
+}  // namespace ScoreStsg
+}  // namespace Syntax
+}  // namespace MosesTraining
@@ -20,6 +20,10 @@ public:
     , negLogProb(false)
     , noLex(false)
     , noWordAlignment(false)
+    , sort(false)
+    , sortBufferSize(1024)
+    , tempDir("/tmp/")
+    , threads(1)
     , treeScore(false) {}
 
   // Positional options
@@ -36,6 +40,10 @@ public:
   bool negLogProb;
   bool noLex;
   bool noWordAlignment;
+  bool sort;
+  int sortBufferSize;
+  std::string tempDir;
+  int threads;
   bool treeScore;
 };
 
@@ -1,10 +1,9 @@
 #pragma once
 
 #include <cmath>
+#include <ostream>
 #include <string>
 
-#include "OutputFileStream.h"
-
 #include "Options.h"
 #include "TokenizedRuleHalf.h"
 
@@ -18,7 +17,7 @@ namespace ScoreStsg
 class RuleTableWriter
 {
 public:
-  RuleTableWriter(const Options &options, Moses::OutputFileStream &out)
+  RuleTableWriter(const Options &options, std::ostream &out)
     : m_options(options)
     , m_out(out) {}
 
@@ -36,7 +35,7 @@ private:
   void WriteRuleHalf(const TokenizedRuleHalf &);
 
   const Options &m_options;
-  Moses::OutputFileStream &m_out;
+  std::ostream &m_out;
 };
 
 }  // namespace ScoreStsg
@@ -2,6 +2,7 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <deque>
 #include <fstream>
 #include <iostream>
 #include <iterator>
@@ -10,6 +11,14 @@
 #include <vector>
 
 #include <boost/program_options.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#ifdef WITH_THREADS
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#endif
 
 #include "util/string_piece.hh"
 #include "util/string_piece_hash.hh"
@@ -18,9 +27,12 @@
 #include "InputFileStream.h"
 #include "OutputFileStream.h"
 
+#include "moses/ThreadPool.h"
+
 #include "syntax-common/exception.h"
 
 #include "LexicalTable.h"
+#include "LineSorter.h"
 #include "Options.h"
 #include "RuleGroup.h"
 #include "RuleTableWriter.h"
@@ -34,11 +46,164 @@ namespace ScoreStsg
 
 const int ScoreStsg::kCountOfCountsMax = 10;
 
+const std::size_t ScoreStsg::kBlockSize = 10000;
+
+// Scores a block of consecutive rule groups, writing the rule table lines to
+// a buffer.
+class ScoreStsg::ScoreTask : public Moses::Task
+{
+public:
+  explicit ScoreTask(const ScoreStsg &scorer)
+    : m_scorer(scorer)
+    , m_lineCount(0)
+    , m_done(false) {}
+
+  // Add a rule group that was read from lines start to end of the extract
+  // file.
+  void AddRuleGroup(const RuleGroup &group, std::size_t start,
+                    std::size_t end) {
+    m_groups.push_back(Group());
+    m_groups.back().group = group;
+    m_groups.back().start = start;
+    m_groups.back().end = end;
+    m_lineCount += end - start + 1;
+  }
+
+  std::size_t GetLineCount() const {
+    return m_lineCount;
+  }
+
+  void Run() {
+    std::ostringstream out;
+    RuleTableWriter writer(m_scorer.m_options, out);
+    for (std::vector<Group>::const_iterator p = m_groups.begin();
+         p != m_groups.end(); ++p) {
+      m_scorer.ProcessRuleGroupOrDie(p->group, writer, m_countOfCounts,
+                                     p->start, p->end);
+    }
+    m_groups.clear();
+#ifdef WITH_THREADS
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+#endif
+    m_output = out.str();
+    m_done = true;
+#ifdef WITH_THREADS
+    m_cond.notify_one();
+#endif
+  }
+
+  // Wait until Run() has completed.
+  void Wait() {
+#ifdef WITH_THREADS
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    while (!m_done) {
+      m_cond.wait(lock);
+    }
+#endif
+    assert(m_done);
+  }
+
+  const std::string &GetOutput() const {
+    return m_output;
+  }
+
+  const CountOfCounts &GetCountOfCounts() const {
+    return m_countOfCounts;
+  }
+
+private:
+  struct Group {
+    RuleGroup group;
+    std::size_t start;
+    std::size_t end;
+  };
+
+  const ScoreStsg &m_scorer;
+  std::vector<Group> m_groups;
+  std::size_t m_lineCount;
+  std::string m_output;
+  CountOfCounts m_countOfCounts;
+  bool m_done;
+#ifdef WITH_THREADS
+  boost::mutex m_mutex;
+  boost::condition_variable m_cond;
+#endif
+};
+
+// Runs ScoreTasks, on a thread pool if there is more than one thread, and
+// writes their output in the order the tasks were given.
+class ScoreStsg::BlockScorer
+{
+public:
+  BlockScorer(int threads, std::ostream &out, CountOfCounts &countOfCounts)
+    : m_threads(threads)
+    , m_out(out)
+    , m_countOfCounts(countOfCounts) {
+#ifdef WITH_THREADS
+    if (threads > 1) {
+      m_pool.reset(new Moses::ThreadPool(threads));
+    }
+#endif
+  }
+
+  void Score(boost::shared_ptr<ScoreTask> task) {
+#ifdef WITH_THREADS
+    if (m_pool) {
+      m_pending.push_back(task);
+      m_pool->Submit(task);
+      // Bound the number of blocks in memory at once.
+      while (m_pending.size() > 4 * m_threads) {
+        WriteFront();
+      }
+      return;
+    }
+#endif
+    task->Run();
+    m_pending.push_back(task);
+    WriteFront();
+  }
+
+  // Wait for all tasks and write their output.
+  void Finish() {
+    while (!m_pending.empty()) {
+      WriteFront();
+    }
+#ifdef WITH_THREADS
+    if (m_pool) {
+      m_pool->Stop(true);
+    }
+#endif
+  }
+
+private:
+  void WriteFront() {
+    ScoreTask &task = *m_pending.front();
+    task.Wait();
+    m_out << task.GetOutput();
+    m_countOfCounts.Add(task.GetCountOfCounts());
+    m_pending.pop_front();
+  }
+
+  const std::size_t m_threads;
+  std::ostream &m_out;
+  CountOfCounts &m_countOfCounts;
+  std::deque<boost::shared_ptr<ScoreTask> > m_pending;
+#ifdef WITH_THREADS
+  boost::scoped_ptr<Moses::ThreadPool> m_pool;
+#endif
+};
+
+void ScoreStsg::CountOfCounts::Add(const CountOfCounts &other)
+{
+  for (std::size_t i = 0; i < counts.size(); ++i) {
+    counts[i] += other.counts[i];
+  }
+  totalDistinct += other.totalDistinct;
+}
+
 ScoreStsg::ScoreStsg()
   : Tool("score-stsg")
   , m_lexTable(m_srcVocab, m_tgtVocab)
-  , m_countOfCounts(kCountOfCountsMax, 0)
-  , m_totalDistinct(0)
 {
 }
 
@@ -64,15 +229,31 @@ int ScoreStsg::Main(int argc, char *argv[])
     m_lexTable.Load(lexStream);
   }
 
+  // Sort the extract file, if it isn't sorted already.
+  boost::scoped_ptr<LineSorter> sorter;
+  if (m_options.sort) {
+    sorter.reset(new LineSorter(
+                   static_cast<std::size_t>(m_options.sortBufferSize) << 20,
+                   m_options.tempDir));
+    std::string line;
+    while (std::getline(extractStream, line)) {
+      sorter->Add(line);
+    }
+    sorter->Finish();
+  }
+
   const util::MultiCharacter delimiter("|||");
   std::size_t lineNum = 0;
   std::size_t startLine= 0;
   std::string line;
   std::string tmp;
   RuleGroup ruleGroup;
-  RuleTableWriter ruleTableWriter(m_options, outStream);
+  CountOfCounts countOfCounts;
+  BlockScorer blockScorer(m_options.threads, outStream, countOfCounts);
+  boost::shared_ptr<ScoreTask> task(new ScoreTask(*this));
 
-  while (std::getline(extractStream, line)) {
+  while (sorter ? sorter->Next(line)
+         : static_cast<bool>(std::getline(extractStream, line))) {
     ++lineNum;
 
     // Tokenize the input line.
@@ -94,7 +275,11 @@ int ScoreStsg::Main(int argc, char *argv[])
     // line then process the current rule group and start a new one.
     if (source != ruleGroup.GetSource()) {
       if (lineNum > 1) {
-        ProcessRuleGroupOrDie(ruleGroup, ruleTableWriter, startLine, lineNum-1);
+        task->AddRuleGroup(ruleGroup, startLine, lineNum-1);
+        if (task->GetLineCount() >= kBlockSize) {
+          blockScorer.Score(task);
+          task.reset(new ScoreTask(*this));
+        }
       }
       startLine = lineNum;
       ruleGroup.SetNewSource(source);
@@ -105,22 +290,25 @@ int ScoreStsg::Main(int argc, char *argv[])
   }
 
   // Process the final rule group.
-  ProcessRuleGroupOrDie(ruleGroup, ruleTableWriter, startLine, lineNum);
+  task->AddRuleGroup(ruleGroup, startLine, lineNum);
+  blockScorer.Score(task);
+  blockScorer.Finish();
 
   // Write count of counts file.
   if (m_options.goodTuring || m_options.kneserNey) {
     // Kneser-Ney needs the total number of distinct rules.
-    countOfCountsStream << m_totalDistinct << std::endl;
+    countOfCountsStream << countOfCounts.totalDistinct << std::endl;
     // Write out counts of counts.
     for (int i = 1; i <= kCountOfCountsMax; ++i) {
-      countOfCountsStream << m_countOfCounts[i] << std::endl;
+      countOfCountsStream << countOfCounts.counts[i] << std::endl;
     }
   }
 
   return 0;
 }
 
-void ScoreStsg::TokenizeRuleHalf(const std::string &s, TokenizedRuleHalf &half)
+void ScoreStsg::TokenizeRuleHalf(const std::string &s,
+                                 TokenizedRuleHalf &half) const
 {
   // Copy s to half.string, but strip any leading or trailing whitespace.
   std::size_t start = s.find_first_not_of(" \t");
@@ -163,11 +351,12 @@ void ScoreStsg::TokenizeRuleHalf(const std::string &s, TokenizedRuleHalf &half)
 
 void ScoreStsg::ProcessRuleGroupOrDie(const RuleGroup &group,
                                       RuleTableWriter &writer,
+                                      CountOfCounts &countOfCounts,
                                       std::size_t start,
-                                      std::size_t end)
+                                      std::size_t end) const
 {
   try {
-    ProcessRuleGroup(group, writer);
+    ProcessRuleGroup(group, writer, countOfCounts);
   } catch (const Exception &e) {
     std::ostringstream msg;
     msg << "failed to process rule group at lines " << start << "-" << end
@@ -182,14 +371,19 @@ void ScoreStsg::ProcessRuleGroupOrDie(const RuleGroup &group,
 }
 
 void ScoreStsg::ProcessRuleGroup(const RuleGroup &group,
-                                 RuleTableWriter &writer)
+                                 RuleTableWriter &writer,
+                                 CountOfCounts &countOfCounts) const
 {
   const std::size_t totalCount = group.GetTotalCount();
   const std::size_t distinctCount = group.GetSize();
 
-  TokenizeRuleHalf(group.GetSource(), m_sourceHalf);
+  TokenizedRuleHalf sourceHalf;
+  TokenizedRuleHalf targetHalf;
+  ALIGNMENT tgtToSrc;
+
+  TokenizeRuleHalf(group.GetSource(), sourceHalf);
 
-  const bool fullyLexical = m_sourceHalf.IsFullyLexical();
+  const bool fullyLexical = sourceHalf.IsFullyLexical();
 
   // Process each distinct rule in turn.
   for (RuleGroup::ConstIterator p = group.Begin(); p != group.End(); ++p) {
@@ -197,10 +391,10 @@ void ScoreStsg::ProcessRuleGroup(const RuleGroup &group,
 
     // Update count of count statistics.
     if (m_options.goodTuring || m_options.kneserNey) {
-      ++m_totalDistinct;
+      ++countOfCounts.totalDistinct;
       int countInt = rule.count + 0.99999;
       if (countInt <= kCountOfCountsMax) {
-        ++m_countOfCounts[countInt];
+        ++countOfCounts.counts[countInt];
       }
     }
 
@@ -210,7 +404,7 @@ void ScoreStsg::ProcessRuleGroup(const RuleGroup &group,
       continue;
     }
 
-    TokenizeRuleHalf(rule.target, m_targetHalf);
+    TokenizeRuleHalf(rule.target, targetHalf);
 
     // Find the most frequent alignment (if there's a tie, take the first one).
     std::vector<std::pair<std::string, int> >::const_iterator q =
@@ -222,21 +416,21 @@ void ScoreStsg::ProcessRuleGroup(const RuleGroup &group,
       }
     }
     const std::string &bestAlignment = bestAlignmentAndCount->first;
-    ParseAlignmentString(bestAlignment, m_targetHalf.frontierSymbols.size(),
-                         m_tgtToSrc);
+    ParseAlignmentString(bestAlignment, targetHalf.frontierSymbols.size(),
+                         tgtToSrc);
 
     // Compute the lexical translation probability.
-    double lexProb = ComputeLexProb(m_sourceHalf.frontierSymbols,
-                                    m_targetHalf.frontierSymbols, m_tgtToSrc);
+    double lexProb = ComputeLexProb(sourceHalf.frontierSymbols,
+                                    targetHalf.frontierSymbols, tgtToSrc);
 
     // Write a line to the rule table.
-    writer.WriteLine(m_sourceHalf, m_targetHalf, bestAlignment, lexProb,
+    writer.WriteLine(sourceHalf, targetHalf, bestAlignment, lexProb,
                      rule.treeScore, p->count, totalCount, distinctCount);
   }
 }
 
 void ScoreStsg::ParseAlignmentString(const std::string &s, int numTgtWords,
-                                     ALIGNMENT &tgtToSrc)
+                                     ALIGNMENT &tgtToSrc) const
 {
   tgtToSrc.clear();
   tgtToSrc.resize(numTgtWords);
@@ -270,7 +464,7 @@ void ScoreStsg::ParseAlignmentString(const std::string &s, int numTgtWords,
 
 double ScoreStsg::ComputeLexProb(const std::vector<RuleSymbol> &sourceFrontier,
                                  const std::vector<RuleSymbol> &targetFrontier,
-                                 const ALIGNMENT &tgtToSrc)
+                                 const ALIGNMENT &tgtToSrc) const
 {
   double lexScore = 1.0;
   for (std::size_t i = 0; i < targetFrontier.size(); ++i) {
@@ -342,6 +536,18 @@ void ScoreStsg::ProcessOptions(int argc, char *argv[], Options &options) const
    "do not output word alignments")
   ("PCFG",
    "synonym for TreeScore (included for compatibility with score)")
+  ("Sort",
+   "sort the extract file (otherwise it must already be sorted)")
+  ("SortBufferSize",
+   po::value(&options.sortBufferSize)->
+   default_value(options.sortBufferSize),
+   "use up to arg megabytes of memory for sorting")
+  ("TempDir",
+   po::value(&options.tempDir)->default_value(options.tempDir),
+   "directory for temporary sort files")
+  ("Threads",
+   po::value(&options.threads)->default_value(options.threads),
+   "score rule groups on this many threads")
   ("TreeScore",
    "include pre-computed tree score from extract")
   ("UnpairedExtractFormat",
@@ -421,9 +627,25 @@ void ScoreStsg::ProcessOptions(int argc, char *argv[], Options &options) const
   if (vm.count("NoWordAlignment")) {
     options.noWordAlignment = true;
   }
+  if (vm.count("Sort")) {
+    options.sort = true;
+  }
   if (vm.count("TreeScore") || vm.count("PCFG")) {
     options.treeScore = true;
   }
+
+  if (options.sortBufferSize < 1) {
+    Error("SortBufferSize must be at least 1");
+  }
+  if (options.threads < 1) {
+    Error("Threads must be at least 1");
+  }
+#ifndef WITH_THREADS
+  if (options.threads > 1) {
+    Warn("compiled without threading support: Threads option will be ignored");
+    options.threads = 1;
+  }
+#endif
 }
 
 }  // namespace ScoreStsg
@@ -35,33 +35,45 @@ public:
   virtual int Main(int argc, char *argv[]);
 
 private:
+  class BlockScorer;
+  class ScoreTask;
+
   static const int kCountOfCountsMax;
 
+  // Number of extract lines in each block of rule groups that is scored by a
+  // worker thread.
+  static const std::size_t kBlockSize;
+
+  // Count of counts statistics, gathered separately by each block of rule
+  // groups and then added up.
+  struct CountOfCounts {
+    CountOfCounts() : counts(kCountOfCountsMax+1, 0), totalDistinct(0) {}
+    void Add(const CountOfCounts &);
+    std::vector<int> counts;
+    int totalDistinct;
+  };
+
   double ComputeLexProb(const std::vector<RuleSymbol> &,
                         const std::vector<RuleSymbol> &,
-                        const ALIGNMENT &);
+                        const ALIGNMENT &) const;
 
   void ParseAlignmentString(const std::string &, int,
-                            ALIGNMENT &);
+                            ALIGNMENT &) const;
 
   void ProcessOptions(int, char *[], Options &) const;
 
-  void ProcessRuleGroup(const RuleGroup &, RuleTableWriter &);
+  void ProcessRuleGroup(const RuleGroup &, RuleTableWriter &,
+                        CountOfCounts &) const;
 
   void ProcessRuleGroupOrDie(const RuleGroup &, RuleTableWriter &,
-                             std::size_t, std::size_t);
+                             CountOfCounts &, std::size_t, std::size_t) const;
 
-  void TokenizeRuleHalf(const std::string &, TokenizedRuleHalf &);
+  void TokenizeRuleHalf(const std::string &, TokenizedRuleHalf &) const;
 
   Options m_options;
   Vocabulary m_srcVocab;
   Vocabulary m_tgtVocab;
   LexicalTable m_lexTable;
-  std::vector<int> m_countOfCounts;
-  int m_totalDistinct;
-  TokenizedRuleHalf m_sourceHalf;
-  TokenizedRuleHalf m_targetHalf;
-  ALIGNMENT m_tgtToSrc;
 };
 
 }  // namespace ScoreStsg
@@ -165,6 +165,8 @@ my $prev_aggregate_nbl_size = -1; # number of previous step to consider when loa
                                   # 1 means 1 previous data , i.e. from the actual iteration and from the previous one
                                   # and so on
 my $maximum_iterations = 25;
+my $___COLUMNAR = 0; # keep features and scores of all iterations in one columnar file
+my $columnar_file = "columnar.dat";
 
 # Multiple instance parallelization
 my $___MULTI_MOSES = "$SCRIPTS_ROOTDIR/generic/multi_moses.py";
@@ -222,6 +224,7 @@ GetOptions(
   "use-config-weights-for-first-run" => \$___USE_CONFIG_WEIGHTS_FIRST, # use the weights in the configuration file when running the decoder for the first time
   "prev-aggregate-nbestlist=i" => \$prev_aggregate_nbl_size, #number of previous step to consider when loading data (default =-1, i.e. all previous)
   "maximum-iterations=i" => \$maximum_iterations,
+  "columnar" => \$___COLUMNAR,
   "pairwise-ranked" => \$___PAIRWISE_RANKED_OPTIMIZER,
   "pro-starting-point" => \$___PRO_STARTING_POINT,
   "historic-interpolation=f" => \$___HISTORIC_INTERPOLATION,
@@ -311,6 +314,11 @@ Options:
                                      N means this and N previous iterations
 
   --maximum-iterations=ITERS ... Maximum number of iterations. Default: $maximum_iterations
+  --columnar                 ... Keep the features and scores of all iterations
+                                 in the memory-mapped file $columnar_file
+                                 instead of run*.features.dat and
+                                 run*.scores.dat (not with --hg-mira,
+                                 --promix-training or --prev-aggregate-nbestlist)
   --return-best-dev          ... Return the weights according to dev bleu, instead of returning
                                  the last iteration
   --random-directions               ... search only in random directions
@@ -402,6 +410,13 @@ if ($__PROMIX_TRAINING) {
   die "To use promix training, need to specify a filter and binarisation command" unless   $filtercmd =~ /Binarizer/;
 }
 
+if ($___COLUMNAR) {
+  die "--columnar does not work with --hg-mira" if $___HG_MIRA;
+  die "--columnar does not work with --promix-training" if $__PROMIX_TRAINING;
+  die "--columnar keeps all iterations, so it does not work with --prev-aggregate-nbestlist"
+    if $prev_aggregate_nbl_size != -1;
+}
+
 if (!defined $mertargs) {
   if (defined $batch_mira_args) {
     $mertargs = $batch_mira_args;
@@ -649,9 +664,14 @@ if ($continue) {
     print STDERR "First previous needed data index is $firststep\n";
     print STDERR "Checking whether all needed data (from step $firststep to step $step) are available\n";
 
+    if ($___COLUMNAR && ! -e $columnar_file) {
+      die "Can't start from step $step, because $columnar_file was not found!";
+    }
     for (my $prevstep = $firststep; $prevstep <= $step; $prevstep++) {
         print STDERR "Checking whether data of step $prevstep are available\n";
-      if (! -e "run$prevstep.features.dat") {
+      if ($___COLUMNAR) {
+        # features and scores are in $columnar_file
+      } elsif (! -e "run$prevstep.features.dat") {
           die "Can't start from step $step, because run$prevstep.features.dat was not found!";
       } else {
         if (defined $prev_feature_file) {
@@ -660,7 +680,8 @@ if ($continue) {
           $prev_feature_file = "run$prevstep.features.dat";
         }
       }
-      if (! -e "run$prevstep.scores.dat") {
+      if ($___COLUMNAR) {
+      } elsif (! -e "run$prevstep.scores.dat") {
           die "Can't start from step $step, because run$prevstep.scores.dat was not found!";
       } else {
         if (defined $prev_score_file) {
@@ -714,6 +735,9 @@ if ($continue) {
   $start_run = $step + 1;
 }
 
+# a fresh start must not see the iterations of an earlier one
+unlink $columnar_file if $___COLUMNAR && !$continue;
+
 ###### MERT MAIN LOOP
 
 my $run = $start_run - 1;
@@ -838,6 +862,8 @@ while (1) {
     my $score_file        = "run$run.${base_score_file}";
 
     my $cmd = "$mert_extract_cmd $mert_extract_args --scfile $score_file --ffile $feature_file -r " . join(",", @references) . " -n $nbest_file";
+    # the candidates of this iteration are appended to the earlier ones
+    $cmd .= " --columnar $columnar_file" if $___COLUMNAR;
 
   if (! $___HG_MIRA) {
     $cmd .= " -d" if $__PROMIX_TRAINING; # Allow duplicates
@@ -903,6 +929,12 @@ while (1) {
     $scfiles = "$score_file";
   }
 
+  # one file holds the features and scores of all iterations
+  if ($___COLUMNAR) {
+    $ffiles = $columnar_file;
+    $scfiles = $columnar_file;
+  }
+
   my $mira_settings = "";
   if (($___BATCH_MIRA || $___HG_MIRA) && $batch_mira_args) {
     $mira_settings .= "$batch_mira_args ";
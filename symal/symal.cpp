@@ -11,9 +11,21 @@
 #include <vector>
 #include <set>
 #include <algorithm>
+#include <deque>
+#include <cctype>
 #include <cstring>
+#include <stdint.h>
 #include "cmd.h"
 
+#ifdef WITH_THREADS
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "moses/ThreadPool.h"
+#endif
+
 using namespace std;
 
 const int MAX_WORD = 10000;  // maximum lengthsource/target strings
@@ -58,19 +70,40 @@ Enum_T BoolEnum [] = {
 
 // global variables and constants
 
-int* fa; //counters of covered foreign positions
-int* ea; //counters of covered english positions
-int** A; //alignment matrix with information symmetric/direct/inverse alignments
-
 int verbose=0;
 
+//an alignment pair: a[j] is the target position aligned to source
+//position j (direct alignment), b[i] the source position aligned to
+//target position i (inverse alignment), 0 if unaligned.
+
+struct SentenceAlignment {
+  int m,n;
+  vector<int> a,b;
+};
+
 //read an alignment pair from the input stream.
 
 int lc = 0;
 
+//skip over the next whitespace-separated token and return its length
+size_t skiptoken(istream& inp)
+{
+  size_t len=0;
+  if (inp >> ws) {
+    streambuf* sb = inp.rdbuf();
+    int c;
+    while ((c = sb->sgetc()) != EOF && !isspace(c)) {
+      sb->sbumpc();
+      len++;
+    }
+    if (c == EOF) inp.setstate(ios::eofbit);
+  }
+  return len;
+}
+
 int getals(istream& inp,int& m, int *a,int& n, int *b)
 {
-  char w[MAX_WORD], dummy[10];
+  size_t len;
   int i,j,freq;
   if (inp >> freq) {
     ++lc;
@@ -78,15 +111,15 @@ int getals(istream& inp,int& m, int *a,int& n, int *b)
     inp >> n;
     assert(n<MAX_N);
     for (i=1; i<=n; i++) {
-      inp >> setw(MAX_WORD) >> w;
-      if (strlen(w)>=MAX_WORD-1) {
-        cerr << lc << ": target len=" << strlen(w) << " is not less than MAX_WORD-1="
+      len=skiptoken(inp);
+      if (len>=MAX_WORD-1) {
+        cerr << lc << ": target len=" << len << " is not less than MAX_WORD-1="
              << MAX_WORD-1 << endl;
-        assert(strlen(w)<MAX_WORD-1);
+        assert(len<MAX_WORD-1);
       }
     }
 
-    inp >> dummy; //# separator
+    skiptoken(inp); //# separator
     // inverse alignment
     for (i=1; i<=n; i++) inp >> b[i];
 
@@ -94,15 +127,15 @@ int getals(istream& inp,int& m, int *a,int& n, int *b)
     inp >> m;
     assert(m<MAX_M);
     for (j=1; j<=m; j++) {
-      inp >> setw(MAX_WORD) >> w;
-      if (strlen(w)>=MAX_WORD-1) {
-        cerr << lc << ": source len=" << strlen(w) << " is not less than MAX_WORD-1="
+      len=skiptoken(inp);
+      if (len>=MAX_WORD-1) {
+        cerr << lc << ": source len=" << len << " is not less than MAX_WORD-1="
              << MAX_WORD-1 << endl;
-        assert(strlen(w)<MAX_WORD-1);
+        assert(len<MAX_WORD-1);
       }
     }
 
-    inp >> dummy; //# separator
+    skiptoken(inp); //# separator
 
     // direct alignment
     for (j=1; j<=m; j++) {
@@ -120,9 +153,19 @@ int getals(istream& inp,int& m, int *a,int& n, int *b)
     return 0;
 }
 
+int getals(istream& inp,SentenceAlignment& s)
+{
+  int a[MAX_M],b[MAX_N];
+  if (!getals(inp,s.m,a,s.n,b))
+    return 0;
+  s.a.assign(a,a+s.m+1);
+  s.b.assign(b,b+s.n+1);
+  return 1;
+}
+
 
 //compute union alignment
-int prunionalignment(ostream& out,int m,int *a,int n,int* b)
+int prunionalignment(ostream& out,int m,const int *a,int n,const int* b)
 {
 
   ostringstream sout;
@@ -143,7 +186,6 @@ int prunionalignment(ostream& out,int m,int *a,int n,int* b)
     str.replace(str.length()-1,1,"\n");
 
   out << str;
-  out.flush();
 
   return 1;
 }
@@ -151,7 +193,7 @@ int prunionalignment(ostream& out,int m,int *a,int n,int* b)
 
 //Compute intersection alignment
 
-int printersect(ostream& out,int m,int *a,int n,int* b)
+int printersect(ostream& out,int m,const int *a,int n,const int* b)
 {
 
   ostringstream sout;
@@ -168,14 +210,13 @@ int printersect(ostream& out,int m,int *a,int n,int* b)
     str.replace(str.length()-1,1,"\n");
 
   out << str;
-  out.flush();
 
   return 1;
 }
 
 //Compute target-to-source alignment
 
-int printtgttosrc(ostream& out,int m,int *a,int n,int* b)
+int printtgttosrc(ostream& out,int m,const int *a,int n,const int* b)
 {
 
   ostringstream sout;
@@ -192,14 +233,13 @@ int printtgttosrc(ostream& out,int m,int *a,int n,int* b)
     str.replace(str.length()-1,1,"\n");
 
   out << str;
-  out.flush();
 
   return 1;
 }
 
 //Compute source-to-target alignment
 
-int printsrctotgt(ostream& out,int m,int *a,int n,int* b)
+int printsrctotgt(ostream& out,int m,const int *a,int n,const int* b)
 {
 
   ostringstream sout;
@@ -216,26 +256,128 @@ int printsrctotgt(ostream& out,int m,int *a,int n,int* b)
     str.replace(str.length()-1,1,"\n");
 
   out << str;
-  out.flush();
 
   return 1;
 }
 
+//Set of alignment points (i,j) stored as a bit matrix, one row of
+//64-bit words per target position i.  Rows 0 and n+1 and columns 0
+//and m+1 are kept empty so that neighbors never fall off the matrix.
+
+class BitMatrix
+{
+public:
+  BitMatrix() : rows(0), words(0) {}
+
+  void reset(int n,int m) {
+    rows=n+2;
+    words=(m+2+63)/64;
+    bits.assign(rows*words,0);
+  }
+
+  int numwords() const {
+    return words;
+  }
+
+  uint64_t* row(int i) {
+    return &bits[i*words];
+  }
+  const uint64_t* row(int i) const {
+    return &bits[i*words];
+  }
+
+  bool test(int i,int j) const {
+    return (row(i)[j>>6] >> (j&63)) & 1;
+  }
+  void set(int i,int j) {
+    row(i)[j>>6] |= uint64_t(1) << (j&63);
+  }
+
+  //move (i,j) to the next point after it in (i,j) order, as an
+  //iterator over set<pair<int,int> > would; start from (0,-1).
+  //Points inserted behind the current one are picked up, exactly
+  //like with set iteration.
+  bool next(int& i,int& j) const {
+    int w=(j+1)>>6;
+    uint64_t x = w<words ? row(i)[w] & (~uint64_t(0) << ((j+1)&63)) : 0;
+    while (!x) {
+      if (++w>=words) {
+        if (++i>=rows) return false;
+        w=0;
+      }
+      x=row(i)[w];
+    }
+    j=w*64+__builtin_ctzll(x);
+    return true;
+  }
+
+private:
+  int rows,words;
+  vector<uint64_t> bits;
+};
+
+//Working space of printgrow, kept between sentences to avoid
+//reallocating it; one per thread.
+
+struct GrowState {
+  BitMatrix current;  //symmetric alignment
+  BitMatrix unionpts; //union alignment
+  BitMatrix direct;   //points only in the direct alignment
+  BitMatrix inverse;  //points only in the inverse alignment
+  vector<char> fa;    //covered foreign positions
+  vector<char> ea;    //covered english positions
+  vector<uint64_t> facov; //covered foreign positions as bits
+  vector<uint64_t> horiz; //scratch row for canGrow
+};
+
+void cover(GrowState& s,int i,int j)
+{
+  s.current.set(i,j);
+  s.ea[i]=1;
+  s.fa[j]=1;
+  s.facov[j>>6] |= uint64_t(1) << (j&63);
+}
+
+//Check, a row at a time, whether any point of the union alignment that
+//leaves a word uncovered is a neighbor of the current alignment.  If
+//not, a pass of the grow loop cannot add anything.
+bool canGrow(GrowState& s,int n,bool diagonal)
+{
+  const int words=s.current.numwords();
+  uint64_t* horiz=&s.horiz[0];
+  for (int i=1; i<=n; i++) {
+    const uint64_t* up=s.current.row(i-1);
+    const uint64_t* cur=s.current.row(i);
+    const uint64_t* down=s.current.row(i+1);
+    const uint64_t* un=s.unionpts.row(i);
+    //points whose left or right neighbor may be on row i
+    for (int w=0; w<words; w++)
+      horiz[w] = diagonal ? (cur[w] | up[w] | down[w]) : cur[w];
+    for (int w=0; w<words; w++) {
+      uint64_t near = up[w] | down[w] | (horiz[w] << 1) | (horiz[w] >> 1);
+      if (w>0) near |= horiz[w-1] >> 63;
+      if (w+1<words) near |= horiz[w+1] << 63;
+      uint64_t growable = un[w];
+      if (s.ea[i]) growable &= ~s.facov[w];
+      if (near & growable) return true;
+    }
+  }
+  return false;
+}
+
 //Compute Grow Diagonal Alignment
 //Nice property: you will never introduce more points
 //than the unionalignment alignemt. Hence, you will always be able
 //to represent the grow alignment as the unionalignment of a
 //directed and inverted alignment
 
-int printgrow(ostream& out,int m,int *a,int n,int* b, bool diagonal=false,bool isfinal=false,bool bothuncovered=false)
+int printgrow(ostream& out,int m,const int *a,int n,const int* b, GrowState& s, bool diagonal=false,bool isfinal=false,bool bothuncovered=false)
 {
 
   ostringstream sout;
 
   vector <pair <int,int> > neighbors; //neighbors
 
-  pair <int,int> entry;
-
   neighbors.push_back(make_pair(-1,-0));
   neighbors.push_back(make_pair(0,-1));
   neighbors.push_back(make_pair(1,0));
@@ -253,70 +395,48 @@ int printgrow(ostream& out,int m,int *a,int n,int* b, bool diagonal=false,bool i
   int i,j;
   size_t o;
 
-
-  //covered foreign and english positions
-
-  memset(fa,0,(m+1)*sizeof(int));
-  memset(ea,0,(n+1)*sizeof(int));
-
-  //matrix to quickly check if one point is in the symmetric
-  //alignment (value=2), direct alignment (=1) and inverse alignment
-
-  for (int i=1; i<=n; i++) memset(A[i],0,(m+1)*sizeof(int));
-
-  set <pair <int,int> > currentpoints; //symmetric alignment
-  set <pair <int,int> > unionalignment; //union alignment
-
-  pair <int,int> point; //variable to store points
-  set<pair <int,int> >::const_iterator k; //iterator over sets
+  s.current.reset(n,m);
+  s.unionpts.reset(n,m);
+  s.direct.reset(n,m);
+  s.inverse.reset(n,m);
+  s.fa.assign(m+2,0);
+  s.ea.assign(n+2,0);
+  s.facov.assign(s.current.numwords(),0);
+  s.horiz.resize(s.current.numwords());
 
   //fill in the alignments
   for (j=1; j<=m; j++) {
     if (a[j]) {
-      unionalignment.insert(make_pair(a[j],j));
-      if (b[a[j]]==j) {
-        fa[j]=1;
-        ea[a[j]]=1;
-        A[a[j]][j]=2;
-        currentpoints.insert(make_pair(a[j],j));
-      } else
-        A[a[j]][j]=-1;
+      s.unionpts.set(a[j],j);
+      if (b[a[j]]==j)
+        cover(s,a[j],j);
+      else
+        s.direct.set(a[j],j);
     }
   }
 
   for (i=1; i<=n; i++)
     if (b[i] && a[b[i]]!=i) { //not intersection
-      unionalignment.insert(make_pair(i,b[i]));
-      A[i][b[i]]=1;
+      s.unionpts.set(i,b[i]);
+      s.inverse.set(i,b[i]);
     }
 
 
-  int added=1;
-
-  while (added) {
-    added=0;
+  while (canGrow(s,n,diagonal)) {
     ///scan the current alignment
-    for (k=currentpoints.begin(); k!=currentpoints.end(); k++) {
-      //cout << "{"<< (k->second)-1 << "-" << (k->first)-1 << "}";
+    int ki=0, kj=-1;
+    while (s.current.next(ki,kj)) {
       for (o=0; o<neighbors.size(); o++) {
-        //cout << "go over check all neighbors\n";
-        point.first=k->first+neighbors[o].first;
-        point.second=k->second+neighbors[o].second;
-        //cout << point.second-1 << " " << point.first-1 << "\n";
+        i=ki+neighbors[o].first;
+        j=kj+neighbors[o].second;
         //check if neighbor is inside 'matrix'
-        if (point.first>0 && point.first <=n && point.second>0 && point.second<=m)
+        if (i>0 && i<=n && j>0 && j<=m)
           //check if neighbor is in the unionalignment alignment
-          if (b[point.first]==point.second || a[point.second]==point.first) {
-            //cout << "In unionalignment ";cout.flush();
+          if (b[i]==j || a[j]==i) {
             //check if it connects at least one uncovered word
-            if (!(ea[point.first] && fa[point.second])) {
+            if (!(s.ea[i] && s.fa[j])) {
               //insert point in currentpoints!
-              currentpoints.insert(point);
-              A[point.first][point.second]=2;
-              ea[point.first]=1;
-              fa[point.second]=1;
-              added=1;
-              //cout << "added grow: " << point.second-1 << "-" << point.first-1 << "\n";cout.flush();
+              cover(s,i,j);
             }
           }
       }
@@ -324,50 +444,28 @@ int printgrow(ostream& out,int m,int *a,int n,int* b, bool diagonal=false,bool i
   }
 
   if (isfinal) {
-    for (k=unionalignment.begin(); k!=unionalignment.end(); k++)
-      if (A[k->first][k->second]==1) {
-        point.first=k->first;
-        point.second=k->second;
-        //one of the two words is not covered yet
-        //cout << "{" << point.second-1 << "-" << point.first-1 << "} ";
-        if ((bothuncovered &&  !ea[point.first] && !fa[point.second]) ||
-            (!bothuncovered && !(ea[point.first] && fa[point.second]))) {
-          //add it!
-          currentpoints.insert(point);
-          A[point.first][point.second]=2;
-          //keep track of new covered positions
-          ea[point.first]=1;
-          fa[point.second]=1;
-
-          //added=1;
-          //cout << "added final: " << point.second-1 << "-" << point.first-1 << "\n";
-        }
-      }
-
-    for (k=unionalignment.begin(); k!=unionalignment.end(); k++)
-      if (A[k->first][k->second]==-1) {
-        point.first=k->first;
-        point.second=k->second;
+    //inverse-only points first, then direct-only points
+    const BitMatrix* steps[2] = { &s.inverse, &s.direct };
+    for (int step=0; step<2; step++) {
+      i=0;
+      j=-1;
+      while (steps[step]->next(i,j)) {
+        if (s.current.test(i,j)) continue;
         //one of the two words is not covered yet
-        //cout << "{" << point.second-1 << "-" << point.first-1 << "} ";
-        if ((bothuncovered &&  !ea[point.first] && !fa[point.second]) ||
-            (!bothuncovered && !(ea[point.first] && fa[point.second]))) {
+        if ((bothuncovered &&  !s.ea[i] && !s.fa[j]) ||
+            (!bothuncovered && !(s.ea[i] && s.fa[j]))) {
           //add it!
-          currentpoints.insert(point);
-          A[point.first][point.second]=2;
-          //keep track of new covered positions
-          ea[point.first]=1;
-          fa[point.second]=1;
-
-          //added=1;
-          //cout << "added final: " << point.second-1 << "-" << point.first-1 << "\n";
+          cover(s,i,j);
         }
       }
+    }
   }
 
 
-  for (k=currentpoints.begin(); k!=currentpoints.end(); k++)
-    sout << k->second-1 << "-" << k->first-1 << " ";
+  i=0;
+  j=-1;
+  while (s.current.next(i,j))
+    sout << j-1 << "-" << i-1 << " ";
 
 
   //fix the last " "
@@ -378,12 +476,133 @@ int printgrow(ostream& out,int m,int *a,int n,int* b, bool diagonal=false,bool i
     str.replace(str.length()-1,1,"\n");
 
   out << str;
-  out.flush();
-  return 1;
 
   return 1;
 }
 
+struct SymalOptions {
+  int alignment;
+  bool diagonal;
+  bool isfinal;
+  bool bothuncovered;
+};
+
+void symmetrize(ostream& out,const SentenceAlignment& sa,const SymalOptions& opt,GrowState& s)
+{
+  const int *a=&sa.a[0], *b=&sa.b[0];
+  switch (opt.alignment) {
+  case UNION:
+    prunionalignment(out,sa.m,a,sa.n,b);
+    break;
+  case INTERSECT:
+    printersect(out,sa.m,a,sa.n,b);
+    break;
+  case GROW:
+    printgrow(out,sa.m,a,sa.n,b,s,opt.diagonal,opt.isfinal,opt.bothuncovered);
+    break;
+  case TGTTOSRC:
+    printtgttosrc(out,sa.m,a,sa.n,b);
+    break;
+  case SRCTOTGT:
+    printsrctotgt(out,sa.m,a,sa.n,b);
+    break;
+  default:
+    throw runtime_error("Unknown alignment");
+  }
+}
+
+int symmetrizeSerial(istream& inp,ostream& out,const SymalOptions& opt)
+{
+  SentenceAlignment sa;
+  GrowState s;
+  int sents=0;
+  while (getals(inp,sa)) {
+    symmetrize(out,sa,opt,s);
+    sents++;
+  }
+  return sents;
+}
+
+#ifdef WITH_THREADS
+
+//number of sentences handed to a worker thread at a time
+const size_t BLOCK_SIZE = 1000;
+
+//Symmetrizes a block of sentences on a worker thread.  The main
+//thread waits for the blocks in input order and writes them out.
+class SymalTask : public Moses::Task
+{
+public:
+  explicit SymalTask(const SymalOptions& opt) : m_opt(opt), m_done(false) {}
+
+  void Run() {
+    ostringstream out;
+    GrowState s;
+    for (size_t k=0; k<m_sents.size(); k++)
+      symmetrize(out,m_sents[k],m_opt,s);
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_output=out.str();
+    m_sents.clear();
+    m_done=true;
+    m_cond.notify_one();
+  }
+
+  vector<SentenceAlignment>& sentences() {
+    return m_sents;
+  }
+
+  //wait until the block is done and return its output
+  const string& output() {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    while (!m_done) m_cond.wait(lock);
+    return m_output;
+  }
+
+private:
+  const SymalOptions& m_opt;
+  vector<SentenceAlignment> m_sents;
+  string m_output;
+  bool m_done;
+  boost::mutex m_mutex;
+  boost::condition_variable m_cond;
+};
+
+int symmetrizeParallel(istream& inp,ostream& out,const SymalOptions& opt,int threads)
+{
+  //bound the number of blocks in memory at once
+  const size_t maxPending = 4*threads;
+
+  Moses::ThreadPool pool(threads);
+  deque<boost::shared_ptr<SymalTask> > pending;
+  int sents=0;
+  while (true) {
+    boost::shared_ptr<SymalTask> task(new SymalTask(opt));
+    vector<SentenceAlignment>& block=task->sentences();
+    block.resize(BLOCK_SIZE);
+    size_t k=0;
+    while (k<BLOCK_SIZE && getals(inp,block[k])) k++;
+    block.resize(k);
+    sents+=k;
+    if (k==0) break;
+    pending.push_back(task);
+    pool.Submit(task);
+    while (pending.size()>maxPending) {
+      out << pending.front()->output();
+      out.flush();
+      pending.pop_front();
+    }
+    if (k<BLOCK_SIZE) break;
+  }
+  while (!pending.empty()) {
+    out << pending.front()->output();
+    pending.pop_front();
+  }
+  pool.Stop(true);
+  return sents;
+}
+
+#endif
+
 } // namespace
 
 
@@ -399,6 +618,7 @@ int main(int argc, char** argv)
   int diagonal=false;
   int isfinal=false;
   int bothuncovered=false;
+  int threads=1;
 
 
   DeclareParams("a", CMDENUMTYPE,  &alignment, AlignEnum,
@@ -411,6 +631,8 @@ int main(int argc, char** argv)
                 "both", CMDENUMTYPE,  &bothuncovered, BoolEnum,
                 "i", CMDSTRINGTYPE, &input,
                 "o", CMDSTRINGTYPE, &output,
+                "t", CMDINTTYPE, &threads,
+                "threads", CMDINTTYPE, &threads,
                 "v", CMDENUMTYPE,  &verbose, BoolEnum,
                 "verbose", CMDENUMTYPE,  &verbose, BoolEnum,
 
@@ -419,12 +641,15 @@ int main(int argc, char** argv)
   GetParams(&argc, &argv, NULL);
 
   if (alignment==0) {
-    cerr << "usage: symal [-i=<inputfile>] [-o=<outputfile>] -a=[u|i|g] -d=[yes|no] -b=[yes|no] -f=[yes|no] \n"
+    cerr << "usage: symal [-i=<inputfile>] [-o=<outputfile>] -a=[u|i|g] -d=[yes|no] -b=[yes|no] -f=[yes|no] [-t=<threads>]\n"
          << "Input file or std must be in .bal format (see script giza2bal.pl).\n";
 
     exit(1);
   }
 
+  //symal does not use stdio, so let cin and cout do their own buffering
+  ios_base::sync_with_stdio(false);
+
   istream *inp = &std::cin;
   ostream *out = &std::cout;
 
@@ -441,73 +666,50 @@ int main(int argc, char** argv)
       out = fout;
     }
 
-    int a[MAX_M],b[MAX_N],m,n;
-    fa=new int[MAX_M+1];
-    ea=new int[MAX_N+1];
-
-
-    int sents = 0;
-    A=new int *[MAX_N+1];
-    for (int i=1; i<=MAX_N; i++) A[i]=new int[MAX_M+1];
+    SymalOptions opt;
+    opt.alignment=alignment;
+    opt.diagonal=diagonal;
+    opt.isfinal=isfinal;
+    opt.bothuncovered=bothuncovered;
 
     switch (alignment) {
     case UNION:
       cerr << "symal: computing union alignment\n";
-      while(getals(*inp,m,a,n,b)) {
-        prunionalignment(*out,m,a,n,b);
-        sents++;
-      }
-      cerr << "Sents: " << sents << endl;
       break;
     case INTERSECT:
       cerr << "symal: computing intersect alignment\n";
-      while(getals(*inp,m,a,n,b)) {
-        printersect(*out,m,a,n,b);
-        sents++;
-      }
-      cerr << "Sents: " << sents << endl;
       break;
     case GROW:
       cerr << "symal: computing grow alignment: diagonal ("
            << diagonal << ") final ("<< isfinal << ")"
            <<  "both-uncovered (" << bothuncovered <<")\n";
-
-      while(getals(*inp,m,a,n,b))
-        printgrow(*out,m,a,n,b,diagonal,isfinal,bothuncovered);
-
       break;
     case TGTTOSRC:
       cerr << "symal: computing target-to-source alignment\n";
-
-      while(getals(*inp,m,a,n,b)) {
-        printtgttosrc(*out,m,a,n,b);
-        sents++;
-      }
-      cerr << "Sents: " << sents << endl;
       break;
     case SRCTOTGT:
       cerr << "symal: computing source-to-target alignment\n";
-
-      while(getals(*inp,m,a,n,b)) {
-        printsrctotgt(*out,m,a,n,b);
-        sents++;
-      }
-      cerr << "Sents: " << sents << endl;
       break;
     default:
       throw runtime_error("Unknown alignment");
     }
 
-    delete [] fa;
-    delete [] ea;
-    for (int i=1; i<=MAX_N; i++) delete [] A[i];
-    delete [] A;
+    int sents;
+#ifdef WITH_THREADS
+    if (threads>1)
+      sents=symmetrizeParallel(*inp,*out,opt,threads);
+    else
+#endif
+      sents=symmetrizeSerial(*inp,*out,opt);
+    cerr << "Sents: " << sents << endl;
+
+    out->flush();
 
     if (inp != &std::cin) {
       delete inp;
     }
     if (out != &std::cout) {
-      delete inp;
+      delete out;
     }
   } catch (const std::exception &e) {
     cerr << e.what() << std::endl;
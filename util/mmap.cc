@@ -9,9 +9,14 @@
 #include "util/parallel_read.hh"
 #include "util/scoped.hh"
 
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
+#include <sstream>
+#include <string>
 
 #include <cassert>
+#include <cerrno>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -25,6 +30,11 @@
 #include <unistd.h>
 #endif
 
+#ifdef __linux__
+#include <sys/statfs.h>
+#include <sys/syscall.h>
+#endif
+
 namespace util {
 
 std::size_t SizePage() {
@@ -297,7 +307,13 @@ void HugeRealloc(std::size_t to, bool zero_new, scoped_memory &mem) {
   }
 }
 
+const char *const kDefaultHugeDirectory = "/dev/shm";
+
 void MapRead(LoadMethod method, int fd, uint64_t offset, std::size_t size, scoped_memory &out) {
+  MapRead(method, fd, offset, size, out, NUMA_DEFAULT);
+}
+
+void MapRead(LoadMethod method, int fd, uint64_t offset, std::size_t size, scoped_memory &out, NumaPolicy numa, int numa_node, const char *huge_directory) {
   switch (method) {
     case LAZY:
       out.reset(MapOrThrow(size, false, kFileFlags, false, fd, offset), size, scoped_memory::MMAP_ALLOCATED);
@@ -305,6 +321,9 @@ void MapRead(LoadMethod method, int fd, uint64_t offset, std::size_t size, scope
     case POPULATE_OR_LAZY:
 #ifdef MAP_POPULATE
     case POPULATE_OR_READ:
+#endif
+#ifndef __linux__
+    case HUGE_SHARED:
 #endif
       out.reset(MapOrThrow(size, false, kFileFlags, true, fd, offset), size, scoped_memory::MMAP_ALLOCATED);
       break;
@@ -313,14 +332,148 @@ void MapRead(LoadMethod method, int fd, uint64_t offset, std::size_t size, scope
 #endif
     case READ:
       HugeMalloc(size, false, out);
+      // malloc might hand back memory that was already touched or unaligned.
+      if (out.source() != scoped_memory::MALLOC_ALLOCATED) NumaPlace(out.get(), size, numa, numa_node);
       SeekOrThrow(fd, offset);
       ReadOrThrow(fd, out.get(), size);
       break;
     case PARALLEL_READ:
       HugeMalloc(size, false, out);
+      if (out.source() != scoped_memory::MALLOC_ALLOCATED) NumaPlace(out.get(), size, numa, numa_node);
       ParallelRead(fd, out.get(), size, offset);
       break;
+#ifdef __linux__
+    case HUGE_SHARED:
+      MapHugeShared(fd, offset, size, huge_directory ? huge_directory : kDefaultHugeDirectory, numa, numa_node, out);
+      break;
+#endif
+  }
+}
+
+#ifdef __linux__
+namespace {
+
+// Identify the source by device, inode, size, and modification time so that
+// a rebuilt model gets a fresh copy instead of a stale one.
+std::string HugeSharedName(int fd, uint64_t offset, std::size_t size, const char *directory) {
+  struct stat sb;
+  UTIL_THROW_IF_ARG(fstat(fd, &sb), FDException, (fd), "while statting for a shared copy");
+  std::ostringstream name;
+  name << directory << "/kenlm-" << std::hex << static_cast<uint64_t>(sb.st_dev) << '-' << static_cast<uint64_t>(sb.st_ino) << '-' << static_cast<uint64_t>(sb.st_mtime) << std::dec << '-' << offset << '-' << size;
+  return name.str();
+}
+
+// Fill a new copy under a temporary name then rename it into place so that
+// nobody attaches to a half-written copy.  Two processes racing to build the
+// same copy both succeed; the loser's copy is unlinked when it is replaced.
+void BuildHugeShared(int fd, uint64_t offset, std::size_t size, const std::string &name, NumaPolicy numa, int numa_node) {
+  std::string temp(name + ".XXXXXX");
+  scoped_fd building(mkstemp(&temp[0]));
+  UTIL_THROW_IF(-1 == building.get(), ErrnoException, "Failed to create a shared copy in " << temp);
+  try {
+    UTIL_THROW_IF_ARG(fchmod(building.get(), 0644), FDException, (building.get()), "while making the shared copy readable for other processes");
+    // hugetlbfs reports its page size as the block size and insists on it.
+    struct statfs fs;
+    UTIL_THROW_IF_ARG(fstatfs(building.get(), &fs), FDException, (building.get()), "while checking the file system page size");
+    std::size_t block = std::max<std::size_t>(static_cast<std::size_t>(fs.f_bsize), SizePage());
+    std::size_t rounded = RoundUpPow2(size, block);
+    ResizeOrThrow(building.get(), rounded);
+    // hugetlbfs reserves pages on mmap, so running out fails here instead of
+    // with SIGBUS later.
+    scoped_mmap to(MapOrThrow(rounded, true, kFileFlags, false, building.get(), 0), rounded);
+    NumaPlace(to.get(), rounded, numa, numa_node);
+    ErsatzPRead(fd, to.get(), size, offset);
+    UTIL_THROW_IF(rename(temp.c_str(), name.c_str()), ErrnoException, "Failed to rename " << temp << " to " << name);
+  } catch (...) {
+    unlink(temp.c_str());
+    throw;
+  }
+}
+
+} // namespace
+
+void MapHugeShared(int fd, uint64_t offset, std::size_t size, const char *directory, NumaPolicy numa, int numa_node, scoped_memory &out) {
+  const std::string name(HugeSharedName(fd, offset, size, directory));
+  scoped_fd shared(open(name.c_str(), O_RDONLY));
+  if (-1 == shared.get()) {
+    UTIL_THROW_IF(errno != ENOENT, ErrnoException, "Failed to open shared copy " << name);
+    BuildHugeShared(fd, offset, size, name, numa, numa_node);
+    shared.reset(open(name.c_str(), O_RDONLY));
+    UTIL_THROW_IF(-1 == shared.get(), ErrnoException, "Failed to open shared copy " << name << " right after building it");
+  }
+  std::size_t mapped = static_cast<std::size_t>(SizeOrThrow(shared.get()));
+  UTIL_THROW_IF(mapped < size, Exception, "Shared copy " << name << " has " << mapped << " bytes but " << size << " were expected");
+  // The file descriptor can be closed once mapped.
+  out.reset(MapOrThrow(mapped, false, kFileFlags, true, shared.get(), 0), mapped, scoped_memory::MMAP_ALLOCATED);
+}
+
+#else // __linux__
+
+void MapHugeShared(int fd, uint64_t offset, std::size_t size, const char * /*directory*/, NumaPolicy /*numa*/, int /*numa_node*/, scoped_memory &out) {
+  MapRead(POPULATE_OR_READ, fd, offset, size, out);
+}
+
+#endif // __linux__
+
+bool NumaPlace(void *start, std::size_t size, NumaPolicy policy, int node) {
+  if (policy == NUMA_DEFAULT) return true;
+#if defined(__linux__) && defined(SYS_mbind)
+  // Values from linux/mempolicy.h, which isn't always installed.
+  const int kMPolBind = 2, kMPolInterleave = 3;
+  // The kernel intersects the mask with the nodes that actually have memory,
+  // so setting every bit means all nodes.
+  unsigned long mask = ~0UL;
+  int mode = kMPolInterleave;
+  if (policy == NUMA_BIND) {
+    if (node < 0 || node >= static_cast<int>(sizeof(unsigned long) * 8)) return false;
+    mask = 1UL << node;
+    mode = kMPolBind;
   }
+  return !syscall(SYS_mbind, start, RoundUpPow2(size, SizePage()), mode, &mask, sizeof(unsigned long) * 8, 0);
+#else
+  return false;
+#endif
+}
+
+std::size_t MappedPageSize(const void *addr) {
+  std::size_t ret = SizePage();
+#ifdef __linux__
+  std::FILE *smaps = std::fopen("/proc/self/smaps", "r");
+  if (!smaps) return ret;
+  const uintptr_t want = reinterpret_cast<uintptr_t>(addr);
+  bool inside = false;
+  bool huge_pmd = false;
+  char line[512];
+  while (std::fgets(line, sizeof(line), smaps)) {
+    unsigned long begin, end, value;
+    char field[64];
+    if (2 == std::sscanf(line, "%lx-%lx ", &begin, &end)) {
+      if (inside) break;
+      inside = (begin <= want && want < end);
+    } else if (inside && 2 == std::sscanf(line, "%63[^:]: %lu kB", field, &value)) {
+      std::string f(field);
+      if (f == "KernelPageSize") {
+        ret = std::max<std::size_t>(ret, static_cast<std::size_t>(value) << 10);
+      } else if (value && (f == "AnonHugePages" || f == "ShmemPmdMapped" || f == "FilePmdMapped")) {
+        huge_pmd = true;
+      }
+    }
+  }
+  std::fclose(smaps);
+  if (huge_pmd) {
+    // Transparent huge pages are PMD sized.
+    std::size_t pmd = 1ULL << 21;
+    if (std::FILE *f = std::fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r")) {
+      unsigned long value;
+      if (1 == std::fscanf(f, "%lu", &value)) pmd = value;
+      std::fclose(f);
+    }
+    ret = std::max(ret, pmd);
+  }
+#else
+  (void)addr;
+#endif // __linux__
+  return ret;
 }
 
 void *MapZeroedWrite(int fd, std::size_t size) {
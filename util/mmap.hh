@@ -139,10 +139,53 @@ typedef enum {
   READ,
   // malloc and read in parallel (recommended for Lustre)
   PARALLEL_READ,
+  // Copy to a file on tmpfs or hugetlbfs then map that shared.  Backed by
+  // huge pages and shared between processes.  See MapHugeShared.  Falls back
+  // to POPULATE_OR_READ on non-Linux.
+  HUGE_SHARED,
 } LoadMethod;
 
+// Placement of memory on NUMA machines.  Only honored on Linux.
+typedef enum {
+  // Leave it to the kernel (usually first touch).
+  NUMA_DEFAULT,
+  // Spread pages round-robin over all nodes.
+  NUMA_INTERLEAVE,
+  // Put all pages on one node.
+  NUMA_BIND
+} NumaPolicy;
+
+// Where HUGE_SHARED puts copies if no directory is given.
+extern const char *const kDefaultHugeDirectory;
+
 void MapRead(LoadMethod method, int fd, uint64_t offset, std::size_t size, scoped_memory &out);
 
+// Same, but also place pages according to numa (node is only used by
+// NUMA_BIND).  NUMA placement applies to READ, PARALLEL_READ, and
+// HUGE_SHARED; the others use the page cache, which goes where it wants.
+// huge_directory is for HUGE_SHARED; NULL means kDefaultHugeDirectory.
+void MapRead(LoadMethod method, int fd, uint64_t offset, std::size_t size, scoped_memory &out, NumaPolicy numa, int numa_node = 0, const char *huge_directory = NULL);
+
+// Copy [offset, offset + size) of fd into a file in directory and map it
+// shared and read-only.  If directory is a hugetlbfs mount, the copy is backed
+// by the explicit huge pages (2 MB or 1 GB, depending on the mount).  If it is
+// tmpfs (like /dev/shm), the kernel uses transparent huge pages provided
+// /sys/kernel/mm/transparent_hugepage/shmem_enabled allows it.
+// The copy is named after fd's device, inode, size, and modification time, so
+// other processes loading the same file attach to the existing copy instead of
+// reading it again.  The copy outlives the process; delete it to free memory.
+// out.size() is rounded up to the file system's page size.
+void MapHugeShared(int fd, uint64_t offset, std::size_t size, const char *directory, NumaPolicy numa, int numa_node, scoped_memory &out);
+
+// Apply a NUMA policy to memory that has not been touched yet.  start must be
+// page aligned.  Returns false if the kernel refused, e.g. because it was
+// built without NUMA support.  The memory is usable either way.
+bool NumaPlace(void *start, std::size_t size, NumaPolicy policy, int node);
+
+// Largest page size backing the mapping that contains addr, which tells
+// whether huge pages were obtained.  Returns SizePage() when unknown.
+std::size_t MappedPageSize(const void *addr);
+
 // Open file name with mmap of size bytes, all of which are initially zero.
 void *MapZeroedWrite(int fd, std::size_t size);
 void *MapZeroedWrite(const char *name, std::size_t size, scoped_fd &file);